@@ -80,6 +80,7 @@ static int g_device_id = 0;
 static uint16_t g_max_sgl = 1;
 static bool g_transfer = false;
 static bool g_temp_reg = false;
+static bool g_tcp = false;
 
 static int64_t g_key_min_len = DEFAULT_MIN_KEY_LEN;
 static int64_t g_key_max_len = DEFAULT_MAX_KEY_LEN;
@@ -812,7 +813,11 @@ static int priskv_drv_init(job_context *job, void **ctx)
 
     (*priskv_ctx)->job = job;
 
-    (*priskv_ctx)->client = priskv_connect(raddr, rport, laddr, lport, g_nqueue);
+    if (g_tcp) {
+        (*priskv_ctx)->client = priskv_connect_tcp(raddr, rport, laddr, lport, g_nqueue);
+    } else {
+        (*priskv_ctx)->client = priskv_connect(raddr, rport, laddr, lport, g_nqueue);
+    }
     if (!(*priskv_ctx)->client) {
         printf("Failed to connect, exit ... \n");
         return -1;
@@ -1774,6 +1779,7 @@ typedef enum priskv_short_arg {
     OPTARG_PRISKV_VALUE_BLOCK_SIZE,
     OPTARG_TRANSFER,
     OPTARG_TEMP_REG,
+    OPTARG_TCP,
 } priskv_short_arg;
 
 static void priskv_showhelp(void)
@@ -1815,6 +1821,7 @@ static void priskv_showhelp(void)
            "default false\n");
     printf("  --temp-reg\n\tWhether to temporarily register memory to RDMA when making a request, "
            "default false\n");
+    printf("  --tcp\n\tconnect to priskv-server over TCP instead of RDMA, cpu memory only\n");
     exit(0);
 }
 
@@ -1844,6 +1851,7 @@ static struct option priskv_long_opts[] = {
     {"priskv-value-block-size", required_argument, 0, OPTARG_PRISKV_VALUE_BLOCK_SIZE},
     {"transfer", no_argument, 0, OPTARG_TRANSFER},
     {"temp-reg", no_argument, 0, OPTARG_TEMP_REG},
+    {"tcp", no_argument, 0, OPTARG_TCP},
 };
 
 static int parse_range_arg(char *optarg, int64_t *min, int64_t *max)
@@ -2028,6 +2036,10 @@ static int parse_arg(int argc, char *argv[])
             g_temp_reg = true;
             break;
 
+        case OPTARG_TCP:
+            g_tcp = true;
+            break;
+
         default:
             priskv_showhelp();
             ret = -1;
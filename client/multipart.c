@@ -0,0 +1,672 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <endian.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "priskv-log.h"
+#include "priskv.h"
+
+/*
+ * a multipart value is stored as ordinary keys:
+ *   @key: [priskv_multipart_manifest]
+ *   "@key.mp.<upload>.<index>": part @index, the value of [@index * @part_size, @total)
+ * The manifest is in big endian, @upload tells the parts of different SETs of the same key apart.
+ *
+ * Nothing pins the parts to the manifest: a part evicted or expired on its own leaves a manifest
+ * whose GET fails by PRISKV_STATUS_NO_SUCH_KEY. A commit deletes the parts of the replaced upload
+ * right after publishing the new manifest, so a GET missing a part re-reads the manifest and
+ * starts over on a new upload.
+ *
+ * A commit publishes the manifest by a versioned SET of @version + 1 of the manifest it read, so
+ * of the commits racing on the same manifest exactly one replaces it and deletes its parts, the
+ * others fail by PRISKV_STATUS_KEY_EXISTS and delete their own parts. The version counts from
+ * 0 again once the key is deleted or set by a plain SET, the parts replaced that way are left
+ * behind for priskv_multipart_sweep.
+ */
+#define PRISKV_MULTIPART_MAGIC 0x504b4d50 /* "PKMP" */
+
+typedef struct priskv_multipart_manifest {
+    uint32_t magic;
+    uint32_t part_size;
+    uint64_t total;
+    uint64_t upload;
+    uint32_t version; /* the version of the versioned SET publishing it */
+    uint32_t reserved;
+} priskv_multipart_manifest;
+
+/* a GET starting over on a replaced value, give up if replaced this many times meanwhile */
+#define PRISKV_MULTIPART_GET_RETRIES 3
+
+/* ".mp." + 16 hex digits + "." + 10 digits */
+#define PRISKV_MULTIPART_KEY_SUFFIX 32
+
+/* requests in flight of a multipart operation, completed in the context of @priskv_process */
+typedef struct priskv_multipart_batch {
+    uint32_t inflight;
+    priskv_status status; /* the first failure */
+    uint64_t length;      /* the sum of the results */
+} priskv_multipart_batch;
+
+struct priskv_multipart {
+    priskv_client *client;
+    char *key;
+    uint64_t total;
+    uint32_t part_size;
+    uint32_t nparts;
+    uint64_t timeout;
+    uint64_t upload;
+    bool *written;
+    priskv_multipart_batch parts;
+    priskv_multipart_manifest manifest;
+};
+
+typedef struct priskv_multipart_part {
+    priskv_multipart *mp;
+    uint32_t index;
+    uint64_t request_id;
+    priskv_generic_cb cb;
+} priskv_multipart_part;
+
+static inline char *priskv_multipart_part_key(const char *key, uint64_t upload, uint32_t index)
+{
+    size_t len = strlen(key) + PRISKV_MULTIPART_KEY_SUFFIX;
+    char *partkey = malloc(len);
+
+    if (partkey) {
+        snprintf(partkey, len, "%s.mp.%016lx.%u", key, upload, index);
+    }
+
+    return partkey;
+}
+
+static inline uint32_t priskv_multipart_nparts_of(uint64_t total, uint32_t part_size)
+{
+    return (total + part_size - 1) / part_size;
+}
+
+static inline uint64_t priskv_multipart_part_len(uint64_t total, uint32_t part_size, uint32_t index)
+{
+    uint64_t start = (uint64_t)index * part_size;
+
+    return (total - start < part_size) ? total - start : part_size;
+}
+
+/* describe [@offset, @offset + @length) of @sgl * @nsgl by @slice, return the count of SGLs */
+static uint16_t priskv_multipart_slice(priskv_sgl *sgl, uint16_t nsgl, uint64_t offset,
+                                       uint64_t length, priskv_sgl *slice)
+{
+    uint16_t nslice = 0;
+
+    for (uint16_t i = 0; (i < nsgl) && length; i++) {
+        uint64_t len;
+
+        if (offset >= sgl[i].length) {
+            offset -= sgl[i].length;
+            continue;
+        }
+
+        len = sgl[i].length - offset;
+        if (len > length) {
+            len = length;
+        }
+
+        slice[nslice].iova = sgl[i].iova + offset;
+        slice[nslice].length = len;
+        slice[nslice].mem = sgl[i].mem;
+        nslice++;
+
+        offset = 0;
+        length -= len;
+    }
+
+    return nslice;
+}
+
+static inline uint64_t priskv_multipart_sgl_len(priskv_sgl *sgl, uint16_t nsgl)
+{
+    uint64_t len = 0;
+
+    for (uint16_t i = 0; i < nsgl; i++) {
+        len += sgl[i].length;
+    }
+
+    return len;
+}
+
+static inline void priskv_multipart_batch_fail(priskv_multipart_batch *batch, priskv_status status)
+{
+    if ((status != PRISKV_STATUS_OK) && (batch->status == PRISKV_STATUS_OK)) {
+        batch->status = status;
+    }
+}
+
+static void priskv_multipart_batch_cb(uint64_t request_id, priskv_status status, void *result)
+{
+    priskv_multipart_batch *batch = (priskv_multipart_batch *)request_id;
+
+    priskv_multipart_batch_fail(batch, status);
+    if ((status == PRISKV_STATUS_OK) && result) {
+        batch->length += *(uint32_t *)result;
+    }
+    batch->inflight--;
+}
+
+static inline void priskv_multipart_batch_wait(priskv_client *client,
+                                               priskv_multipart_batch *batch)
+{
+    while (batch->inflight) {
+        priskv_process(client, 0);
+    }
+}
+
+/* read the manifest of @key, PRISKV_STATUS_PROTOCOL_ERROR on a value not set by multipart */
+static int priskv_multipart_read_manifest(priskv_client *client, const char *key,
+                                          priskv_multipart_manifest *manifest)
+{
+    priskv_multipart_batch batch = {.inflight = 1};
+    priskv_sgl sgl = {.iova = (uint64_t)manifest, .length = sizeof(*manifest), .mem = NULL};
+
+    priskv_get_async(client, key, &sgl, 1, (uint64_t)&batch, priskv_multipart_batch_cb);
+    priskv_multipart_batch_wait(client, &batch);
+    if (batch.status == PRISKV_STATUS_VALUE_TOO_BIG) {
+        return PRISKV_STATUS_PROTOCOL_ERROR;
+    }
+
+    if (batch.status != PRISKV_STATUS_OK) {
+        return batch.status;
+    }
+
+    if ((batch.length != sizeof(*manifest)) ||
+        (be32toh(manifest->magic) != PRISKV_MULTIPART_MAGIC) || !be32toh(manifest->part_size)) {
+        return PRISKV_STATUS_PROTOCOL_ERROR;
+    }
+
+    manifest->magic = be32toh(manifest->magic);
+    manifest->part_size = be32toh(manifest->part_size);
+    manifest->total = be64toh(manifest->total);
+    manifest->upload = be64toh(manifest->upload);
+    manifest->version = be32toh(manifest->version);
+
+    return PRISKV_STATUS_OK;
+}
+
+/* delete the parts of an upload, the missing ones are ignored */
+static void priskv_multipart_delete_parts(priskv_client *client, const char *key, uint64_t upload,
+                                          uint32_t nparts, bool *written)
+{
+    priskv_multipart_batch batch = {0};
+
+    for (uint32_t i = 0; i < nparts; i++) {
+        char *partkey;
+
+        if (written && !written[i]) {
+            continue;
+        }
+
+        partkey = priskv_multipart_part_key(key, upload, i);
+        if (!partkey) {
+            priskv_log_error("Multipart: failed to delete part %u of %s\n", i, key);
+            continue;
+        }
+
+        batch.inflight++;
+        priskv_delete_async(client, partkey, (uint64_t)&batch, priskv_multipart_batch_cb);
+        free(partkey);
+    }
+
+    priskv_multipart_batch_wait(client, &batch);
+}
+
+priskv_multipart *priskv_multipart_begin(priskv_client *client, const char *key, uint64_t total,
+                                         uint32_t part_size, uint64_t timeout)
+{
+    static uint32_t seq;
+    priskv_multipart *mp;
+    struct timespec ts;
+
+    if (!key || !total) {
+        return NULL;
+    }
+
+    part_size = part_size ? part_size : PRISKV_MULTIPART_DEFAULT_PART_SIZE;
+    if ((total - 1) / part_size >= UINT32_MAX) {
+        return NULL;
+    }
+
+    mp = calloc(1, sizeof(priskv_multipart));
+    if (!mp) {
+        return NULL;
+    }
+
+    mp->client = client;
+    mp->total = total;
+    mp->part_size = part_size;
+    mp->nparts = priskv_multipart_nparts_of(total, mp->part_size);
+    mp->timeout = timeout;
+    mp->key = strdup(key);
+    mp->written = calloc(mp->nparts, sizeof(bool));
+    if (!mp->key || !mp->written) {
+        free(mp->key);
+        free(mp->written);
+        free(mp);
+        return NULL;
+    }
+
+    /* unique among the clients, a retried SET never overwrites the parts of the published one */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    mp->upload = ((uint64_t)ts.tv_sec << 32) ^ ((uint64_t)getpid() << 20) ^ ts.tv_nsec ^ seq++;
+
+    return mp;
+}
+
+uint32_t priskv_multipart_nparts(priskv_multipart *mp)
+{
+    return mp->nparts;
+}
+
+static void priskv_multipart_part_cb(uint64_t request_id, priskv_status status, void *result)
+{
+    priskv_multipart_part *part = (priskv_multipart_part *)request_id;
+    priskv_multipart *mp = part->mp;
+
+    if (status == PRISKV_STATUS_OK) {
+        mp->written[part->index] = true;
+    } else {
+        priskv_log_warn("Multipart: part %u of %s: %s\n", part->index, mp->key,
+                        priskv_status_str(status));
+        priskv_multipart_batch_fail(&mp->parts, status);
+    }
+    mp->parts.inflight--;
+
+    if (part->cb) {
+        part->cb(part->request_id, status, result);
+    }
+    free(part);
+}
+
+/* a part failed before sent also fails the commit */
+static inline void priskv_multipart_part_fail(priskv_multipart *mp, priskv_status status,
+                                              uint64_t request_id, priskv_generic_cb cb)
+{
+    priskv_multipart_batch_fail(&mp->parts, status);
+    if (cb) {
+        cb(request_id, status, NULL);
+    }
+}
+
+int priskv_multipart_set_part_async(priskv_multipart *mp, uint32_t index, priskv_sgl *sgl,
+                                    uint16_t nsgl, uint64_t request_id, priskv_generic_cb cb)
+{
+    priskv_multipart_part *part;
+    char *partkey;
+
+    if ((index >= mp->nparts) || (priskv_multipart_sgl_len(sgl, nsgl) !=
+                                  priskv_multipart_part_len(mp->total, mp->part_size, index))) {
+        priskv_multipart_part_fail(mp, PRISKV_STATUS_INVALID_SGL, request_id, cb);
+        return 0;
+    }
+
+    part = malloc(sizeof(priskv_multipart_part));
+    partkey = priskv_multipart_part_key(mp->key, mp->upload, index);
+    if (!part || !partkey) {
+        free(part);
+        free(partkey);
+        priskv_multipart_part_fail(mp, PRISKV_STATUS_NO_MEM, request_id, cb);
+        return 0;
+    }
+
+    part->mp = mp;
+    part->index = index;
+    part->request_id = request_id;
+    part->cb = cb;
+
+    /* the queues of client are selected in turn, the parts are striped over them */
+    mp->parts.inflight++;
+    priskv_set_async(mp->client, partkey, sgl, nsgl, mp->timeout, (uint64_t)part,
+                     priskv_multipart_part_cb);
+    free(partkey);
+
+    return 0;
+}
+
+static void priskv_multipart_free(priskv_multipart *mp)
+{
+    free(mp->key);
+    free(mp->written);
+    free(mp);
+}
+
+void priskv_multipart_abort(priskv_multipart *mp)
+{
+    priskv_multipart_batch_wait(mp->client, &mp->parts);
+    priskv_multipart_delete_parts(mp->client, mp->key, mp->upload, mp->nparts, mp->written);
+    priskv_multipart_free(mp);
+}
+
+/* publish the manifest of @mp replacing a version less than @version */
+static int priskv_multipart_publish(priskv_multipart *mp, uint32_t version)
+{
+    priskv_multipart_batch batch = {.inflight = 1};
+    priskv_sgl sgl;
+
+    mp->manifest.magic = htobe32(PRISKV_MULTIPART_MAGIC);
+    mp->manifest.part_size = htobe32(mp->part_size);
+    mp->manifest.total = htobe64(mp->total);
+    mp->manifest.upload = htobe64(mp->upload);
+    mp->manifest.version = htobe32(version);
+    mp->manifest.reserved = 0;
+    sgl.iova = (uint64_t)&mp->manifest;
+    sgl.length = sizeof(mp->manifest);
+    sgl.mem = NULL;
+
+    priskv_set_version_async(mp->client, mp->key, &sgl, 1, mp->timeout, version,
+                             (uint64_t)&batch, priskv_multipart_batch_cb);
+    priskv_multipart_batch_wait(mp->client, &batch);
+    if (batch.status != PRISKV_STATUS_INVALID_COMMAND) {
+        return batch.status;
+    }
+
+    /* no versioned SET in tiering mode, a racing commit may leave the parts of a loser behind */
+    batch.inflight = 1;
+    batch.status = PRISKV_STATUS_OK;
+    priskv_set_async(mp->client, mp->key, &sgl, 1, mp->timeout, (uint64_t)&batch,
+                     priskv_multipart_batch_cb);
+    priskv_multipart_batch_wait(mp->client, &batch);
+
+    return batch.status;
+}
+
+int priskv_multipart_commit(priskv_multipart *mp)
+{
+    priskv_multipart_manifest old;
+    int status;
+
+    priskv_multipart_batch_wait(mp->client, &mp->parts);
+    status = mp->parts.status;
+    for (uint32_t i = 0; (i < mp->nparts) && (status == PRISKV_STATUS_OK); i++) {
+        if (!mp->written[i]) {
+            status = PRISKV_STATUS_VALUE_EMPTY;
+        }
+    }
+
+    if (status != PRISKV_STATUS_OK) {
+        priskv_multipart_abort(mp);
+        return status;
+    }
+
+    /* a plain value or none has version 0 */
+    if (priskv_multipart_read_manifest(mp->client, mp->key, &old) != PRISKV_STATUS_OK) {
+        old.part_size = 0;
+        old.version = 0;
+    }
+
+    /* a racing commit publishing @old.version + 1 first wins, and deletes the parts of @old */
+    status = priskv_multipart_publish(mp, old.version + 1);
+    if (status != PRISKV_STATUS_OK) {
+        priskv_multipart_abort(mp);
+        return status;
+    }
+
+    /* the parts of the replaced value become garbage once the new manifest is published */
+    if (old.part_size && (old.upload != mp->upload)) {
+        priskv_multipart_delete_parts(mp->client, mp->key, old.upload,
+                                      priskv_multipart_nparts_of(old.total, old.part_size), NULL);
+    }
+
+    priskv_multipart_free(mp);
+
+    return PRISKV_STATUS_OK;
+}
+
+int priskv_multipart_set(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                         uint32_t part_size, uint64_t timeout)
+{
+    uint64_t total = priskv_multipart_sgl_len(sgl, nsgl);
+    priskv_multipart *mp;
+    priskv_sgl *slice;
+
+    if (!sgl || !total) {
+        return PRISKV_STATUS_VALUE_EMPTY;
+    }
+
+    mp = priskv_multipart_begin(client, key, total, part_size, timeout);
+    slice = malloc(nsgl * sizeof(priskv_sgl));
+    if (!mp || !slice) {
+        if (mp) {
+            priskv_multipart_free(mp);
+        }
+        free(slice);
+        return PRISKV_STATUS_NO_MEM;
+    }
+
+    for (uint32_t i = 0; i < mp->nparts; i++) {
+        uint64_t partlen = priskv_multipart_part_len(total, mp->part_size, i);
+        uint16_t nslice =
+            priskv_multipart_slice(sgl, nsgl, (uint64_t)i * mp->part_size, partlen, slice);
+
+        priskv_multipart_set_part_async(mp, i, slice, nslice, 0, NULL);
+    }
+    free(slice);
+
+    return priskv_multipart_commit(mp);
+}
+
+/* range GET of each part covered by [@offset, @end), the queues of client are selected in turn */
+static int priskv_multipart_get_parts(priskv_client *client, const char *key,
+                                      priskv_multipart_manifest *manifest, priskv_sgl *sgl,
+                                      uint16_t nsgl, priskv_sgl *slice, uint64_t offset,
+                                      uint64_t end)
+{
+    priskv_multipart_batch batch = {0};
+    uint64_t pos;
+
+    for (pos = offset; pos < end;) {
+        uint32_t index = pos / manifest->part_size;
+        uint64_t partoff = pos - (uint64_t)index * manifest->part_size;
+        uint64_t len = priskv_multipart_part_len(manifest->total, manifest->part_size, index);
+        uint16_t nslice;
+        char *partkey;
+
+        len -= partoff;
+        if (len > end - pos) {
+            len = end - pos;
+        }
+
+        partkey = priskv_multipart_part_key(key, manifest->upload, index);
+        if (!partkey) {
+            priskv_multipart_batch_fail(&batch, PRISKV_STATUS_NO_MEM);
+            break;
+        }
+
+        nslice = priskv_multipart_slice(sgl, nsgl, pos - offset, len, slice);
+        batch.inflight++;
+        priskv_get_range_async(client, partkey, slice, nslice, partoff, (uint64_t)&batch,
+                               priskv_multipart_batch_cb);
+        free(partkey);
+        pos += len;
+    }
+
+    priskv_multipart_batch_wait(client, &batch);
+    if (batch.status != PRISKV_STATUS_OK) {
+        return batch.status;
+    }
+
+    /* a part shorter than the manifest tells */
+    return (batch.length == end - offset) ? PRISKV_STATUS_OK : PRISKV_STATUS_PROTOCOL_ERROR;
+}
+
+int priskv_multipart_get(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                         uint64_t offset, uint64_t *length, uint64_t *total)
+{
+    priskv_multipart_manifest manifest;
+    uint64_t upload, end;
+    priskv_sgl *slice;
+    int status, retry = 0;
+
+    *length = 0;
+    if (!sgl || !nsgl) {
+        return PRISKV_STATUS_VALUE_EMPTY;
+    }
+
+    slice = malloc(nsgl * sizeof(priskv_sgl));
+    if (!slice) {
+        return PRISKV_STATUS_NO_MEM;
+    }
+
+    status = priskv_multipart_read_manifest(client, key, &manifest);
+    while (status == PRISKV_STATUS_OK) {
+        if (total) {
+            *total = manifest.total;
+        }
+
+        if (offset >= manifest.total) {
+            status = PRISKV_STATUS_INVALID_RANGE;
+            break;
+        }
+
+        end = offset + priskv_multipart_sgl_len(sgl, nsgl);
+        if (end > manifest.total) {
+            end = manifest.total;
+        }
+
+        status = priskv_multipart_get_parts(client, key, &manifest, sgl, nsgl, slice, offset, end);
+        if (status == PRISKV_STATUS_OK) {
+            *length = end - offset;
+            break;
+        }
+
+        /* the parts of a replaced value are deleted by the commit, the evicted ones never return */
+        if ((status != PRISKV_STATUS_NO_SUCH_KEY) || (retry++ == PRISKV_MULTIPART_GET_RETRIES)) {
+            break;
+        }
+
+        upload = manifest.upload;
+        status = priskv_multipart_read_manifest(client, key, &manifest);
+        if ((status == PRISKV_STATUS_OK) && (manifest.upload == upload)) {
+            status = PRISKV_STATUS_NO_SUCH_KEY;
+            break;
+        }
+    }
+    free(slice);
+
+    return status;
+}
+
+int priskv_multipart_delete(priskv_client *client, const char *key)
+{
+    priskv_multipart_batch batch = {.inflight = 1};
+    priskv_multipart_manifest manifest;
+    int status;
+
+    status = priskv_multipart_read_manifest(client, key, &manifest);
+    if (status != PRISKV_STATUS_OK) {
+        return status;
+    }
+
+    priskv_delete_async(client, key, (uint64_t)&batch, priskv_multipart_batch_cb);
+    priskv_multipart_batch_wait(client, &batch);
+    priskv_multipart_delete_parts(client, key, manifest.upload,
+                                  priskv_multipart_nparts_of(manifest.total, manifest.part_size),
+                                  NULL);
+
+    return batch.status;
+}
+
+/* the POSIX basic regex matching exactly the part keys of @key */
+static char *priskv_multipart_parts_regex(const char *key)
+{
+    static const char suffix[] = "\\.mp\\.[0-9a-f]\\{16\\}\\.[0-9][0-9]*$";
+    char *regex = malloc(1 + strlen(key) * 2 + sizeof(suffix));
+    char *p = regex;
+
+    if (!regex) {
+        return NULL;
+    }
+
+    *p++ = '^';
+    for (const char *c = key; *c; c++) {
+        if (strchr(".[]\\*^$", *c)) {
+            *p++ = '\\';
+        }
+        *p++ = *c;
+    }
+    memcpy(p, suffix, sizeof(suffix));
+
+    return regex;
+}
+
+int priskv_multipart_sweep(priskv_client *client, const char *key, uint32_t *nparts)
+{
+    priskv_multipart_batch batch = {0};
+    priskv_multipart_manifest manifest;
+    priskv_keyset *keyset = NULL;
+    size_t keylen = strlen(key);
+    char *regex;
+    int status;
+
+    *nparts = 0;
+    status = priskv_multipart_read_manifest(client, key, &manifest);
+    if ((status == PRISKV_STATUS_NO_SUCH_KEY) || (status == PRISKV_STATUS_PROTOCOL_ERROR)) {
+        manifest.part_size = 0; /* no upload is published, all the parts are garbage */
+    } else if (status != PRISKV_STATUS_OK) {
+        return status;
+    }
+
+    regex = priskv_multipart_parts_regex(key);
+    if (!regex) {
+        return PRISKV_STATUS_NO_MEM;
+    }
+
+    status = priskv_keys(client, regex, &keyset);
+    free(regex);
+    if (status != PRISKV_STATUS_OK) {
+        return status;
+    }
+
+    for (uint32_t i = 0; i < keyset->nkey; i++) {
+        uint64_t upload = strtoull(keyset->keys[i].key + keylen + strlen(".mp."), NULL, 16);
+
+        if (manifest.part_size && (upload == manifest.upload)) {
+            continue;
+        }
+
+        batch.inflight++;
+        priskv_delete_async(client, keyset->keys[i].key, (uint64_t)&batch,
+                            priskv_multipart_batch_cb);
+        (*nparts)++;
+    }
+    priskv_multipart_batch_wait(client, &batch);
+    priskv_keyset_free(keyset);
+
+    /* a part deleted meanwhile is swept as well */
+    return (batch.status == PRISKV_STATUS_NO_SUCH_KEY) ? PRISKV_STATUS_OK : batch.status;
+}
@@ -33,6 +33,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef struct priskv_client priskv_client;
 typedef struct priskv_memory priskv_memory;
@@ -43,9 +44,18 @@ typedef struct priskv_memory priskv_memory;
  * @laddr: local address. Use system default routing address on NULL @laddr
  * @lport: local port. Ignore port on NULL @laddr
  * @nqueue: the number of worker threads
+ * A server on the same host is reached by shared memory instead if $PRISKV_SHM is 1, see
+ * priskv-shm.h.
  */
 priskv_client *priskv_connect(const char *raddr, int rport, const char *laddr, int lport, int nqueue);
 
+/* Same as @priskv_connect, but over TCP for the hosts without RDMA device. The values are copied
+ * by socket calls, so the memory of @priskv_sgl must be accessible by CPU. One-sided GET/SET and
+ * inline value are RDMA only
+ */
+priskv_client *priskv_connect_tcp(const char *raddr, int rport, const char *laddr, int lport,
+                                  int nqueue);
+
 /* Close a client context created by @priskv_connect */
 void priskv_close(priskv_client *client);
 
@@ -116,6 +126,12 @@ typedef enum priskv_status {
     /* generic server side failure */
     PRISKV_STATUS_SERVER_ERROR,
 
+    /* the offset of range GET is beyond the value */
+    PRISKV_STATUS_INVALID_RANGE,
+
+    /* the key of conditional SET exists, or is not older than the version */
+    PRISKV_STATUS_KEY_EXISTS,
+
     /* no enough memory reported by server side */
     PRISKV_STATUS_NO_MEM = 0x200,
 
@@ -174,6 +190,12 @@ static inline const char *priskv_status_str(priskv_status status)
     case PRISKV_STATUS_SERVER_ERROR:
         return "Server internal error";
 
+    case PRISKV_STATUS_INVALID_RANGE:
+        return "Invalid range";
+
+    case PRISKV_STATUS_KEY_EXISTS:
+        return "Key exists";
+
     case PRISKV_STATUS_NO_MEM:
         return "No memory";
 
@@ -220,10 +242,32 @@ typedef void (*priskv_generic_cb)(uint64_t request_id, priskv_status status, voi
 int priskv_get_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
                    uint64_t request_id, priskv_generic_cb cb);
 
+/* Get a range of value from @offset, store up to the total length of @sgl * @nsgl bytes into
+ * @sgl * @nsgl. The result is the stored length, less than expected at the end of value. An
+ * @offset beyond the value responses PRISKV_STATUS_INVALID_RANGE with the value length. One-sided
+ * GET does not apply to a range.
+ */
+int priskv_get_range_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                           uint64_t offset, uint64_t request_id, priskv_generic_cb cb);
+
 /* Set value of a key */
 int priskv_set_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
                    uint64_t timeout, uint64_t request_id, priskv_generic_cb cb);
 
+/* Set value of a key only if the key is absent. The server checks it before any allocation or
+ * value transfer, an existing key responses PRISKV_STATUS_KEY_EXISTS with the value length.
+ * Not supported by the server in tiering mode.
+ */
+int priskv_setnx_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                       uint64_t timeout, uint64_t request_id, priskv_generic_cb cb);
+
+/* Same as @priskv_setnx_async, but also replaces the key of a version less than @version. A key
+ * set by other SET APIs has version 0.
+ */
+int priskv_set_version_async(priskv_client *client, const char *key, priskv_sgl *sgl,
+                             uint16_t nsgl, uint64_t timeout, uint32_t version,
+                             uint64_t request_id, priskv_generic_cb cb);
+
 /* Test a key-value exist or not */
 int priskv_test_async(priskv_client *client, const char *key, uint64_t request_id, priskv_generic_cb cb);
 
@@ -265,8 +309,17 @@ int priskv_keys_async(priskv_client *client, const char *regex, uint64_t request
 int priskv_get(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
              uint32_t *valuelen);
 
+int priskv_get_range(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                     uint64_t offset, uint32_t *valuelen);
+
 int priskv_set(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl, uint64_t timeout);
 
+int priskv_setnx(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                 uint64_t timeout, uint32_t *valuelen);
+
+int priskv_set_version(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                       uint64_t timeout, uint32_t version, uint32_t *valuelen);
+
 int priskv_test(priskv_client *client, const char *key, uint32_t *valuelen);
 
 int priskv_delete(priskv_client *client, const char *key);
@@ -281,6 +334,108 @@ int priskv_flush(priskv_client *client, const char *regex, uint32_t *nkey);
 
 uint64_t priskv_capacity(priskv_client *client);
 
+/* Values no longer than @max_inline_value bytes travel inside the request(SET) and the
+ * response(GET) instead of RDMA READ/WRITE, the server side limitation also applies. The memory of
+ * @priskv_sgl must be CPU accessible for these values. 0 disables it, default 0.
+ * The server sizes the message slots of a connection for the inline value it asks for, which
+ * @priskv_connect takes from $PRISKV_MAX_INLINE_VALUE(default 0, none). This call only lowers
+ * the negotiated size afterwards.
+ */
+void priskv_set_max_inline_value(priskv_client *client, uint32_t max_inline_value);
+
+/* SET reserves the value on the server, writes it by RDMA WRITE from the client side, then commits
+ * it. This takes one more round trip, but avoids RDMA READ from the server side. The server without
+ * such support(or in tiering mode) falls back to the normal SET. Default false.
+ */
+void priskv_set_direct_write(priskv_client *client, bool enable);
+
+/* GET reads the value by RDMA READ from the index exported by the server(--read-index), without
+ * the server CPU involved. A key absent from the index or being updated falls back to the normal
+ * GET. Default false.
+ */
+void priskv_set_direct_read(priskv_client *client, bool enable);
+
+typedef enum priskv_priority {
+    PRISKV_PRIORITY_NORMAL,
+    PRISKV_PRIORITY_HIGH,
+    PRISKV_PRIORITY_LOW,
+} priskv_priority;
+
+/* The server schedules requests by weighted fair queueing among priorities, and limits the bytes in
+ * flight of a priority(--qos-weights and --qos-budgets of server). The priority applies to the
+ * requests submitted after this call. Default PRISKV_PRIORITY_NORMAL.
+ */
+void priskv_set_priority(priskv_client *client, priskv_priority priority);
+
+/* Trace 1 in @sample requests through the server, a traced request slower than the
+ * --slow-query-threshold-latency-us of server is logged with the time of each step. 0 disables it,
+ * default 1024.
+ */
+void priskv_set_trace_sample(priskv_client *client, uint32_t sample);
+
+/* Multipart SET/GET of a value beyond a single request, the total length is 64 bits. The value is
+ * split into parts of @part_size bytes(the last one may be shorter), each part is stored as an
+ * ordinary key "<key>.mp.<upload>.<index>" and the parts go over the queues of @client in parallel.
+ * The commit stores a manifest as the value of @key, then deletes the parts of the replaced value.
+ * A GET by these APIs racing with a commit starts over on the new manifest, so the completed GET
+ * returns the whole old or the whole new value. The parts are not pinned to the manifest though, a
+ * part evicted or expired on its own fails the GET by PRISKV_STATUS_NO_SUCH_KEY until the value is
+ * set again. The plain GET of @key returns the manifest only, and a plain SET or DELETE of @key
+ * leaves the parts behind for @priskv_multipart_sweep.
+ */
+typedef struct priskv_multipart priskv_multipart;
+
+#define PRISKV_MULTIPART_DEFAULT_PART_SIZE (64U * 1024 * 1024)
+
+/* Begin a multipart SET of @total bytes, 0 @part_size means PRISKV_MULTIPART_DEFAULT_PART_SIZE.
+ * Return NULL on failure. No request is sent until a part is set.
+ */
+priskv_multipart *priskv_multipart_begin(priskv_client *client, const char *key, uint64_t total,
+                                         uint32_t part_size, uint64_t timeout);
+
+/* The number of parts of @mp, a part @index covers [@index * @part_size, @total) at most */
+uint32_t priskv_multipart_nparts(priskv_multipart *mp);
+
+/* Set part @index of @mp, the total length of @sgl * @nsgl must be the length of the part. The
+ * parts may be set in any order, and a part may be set again.
+ */
+int priskv_multipart_set_part_async(priskv_multipart *mp, uint32_t index, priskv_sgl *sgl,
+                                    uint16_t nsgl, uint64_t request_id, priskv_generic_cb cb);
+
+/* Wait for the inflight parts, then publish the manifest if all the parts are set successfully,
+ * the parts of the replaced multipart value are deleted. Otherwise the parts are deleted and the
+ * first failure is returned, PRISKV_STATUS_VALUE_EMPTY if a part has never been set. Of the
+ * commits of the same key racing on the same old value, one wins and the others delete their own
+ * parts and return PRISKV_STATUS_KEY_EXISTS. @mp is freed.
+ */
+int priskv_multipart_commit(priskv_multipart *mp);
+
+/* Wait for the inflight parts, delete the parts and free @mp */
+void priskv_multipart_abort(priskv_multipart *mp);
+
+/* Set the value described by @sgl * @nsgl by multipart */
+int priskv_multipart_set(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                         uint32_t part_size, uint64_t timeout);
+
+/* Get a range of multipart value from @offset into @sgl * @nsgl, the parts are read in parallel.
+ * @length is the stored length, less than expected at the end of value. An @offset beyond the
+ * value returns PRISKV_STATUS_INVALID_RANGE, a key not set by multipart returns
+ * PRISKV_STATUS_PROTOCOL_ERROR, a missing part returns PRISKV_STATUS_NO_SUCH_KEY. @total is the
+ * length of the whole value, NULL to ignore. On failure the memory of @sgl * @nsgl is corrupted.
+ */
+int priskv_multipart_get(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                         uint64_t offset, uint64_t *length, uint64_t *total);
+
+/* Delete a multipart value and its parts */
+int priskv_multipart_delete(priskv_client *client, const char *key);
+
+/* Delete the parts "<key>.mp.*" not of the manifest of @key, @nparts is the count deleted. The
+ * parts leak if the manifest is replaced by a plain SET of @key, or if the key is deleted or
+ * replaced while a commit of it is in progress. A multipart SET of @key in progress loses its
+ * parts too, sweep the key only when it is not being set.
+ */
+int priskv_multipart_sweep(priskv_client *client, const char *key, uint32_t *nparts);
+
 /*
  *assuming max timeout means no timeout
  */
@@ -25,7 +25,13 @@
  */
 
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
+#include <ifaddrs.h>
+#include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <rdma/rdma_cma.h>
@@ -36,6 +42,7 @@
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 
 #include "priskv-threads.h"
 #include "priskv-event.h"
@@ -43,11 +50,22 @@
 #include "priskv-protocol.h"
 #include "priskv-protocol-helper.h"
 #include "priskv-utils.h"
+#include "priskv-slots.h"
+#include "priskv-shm.h"
 #include "priskv-log.h"
 #include "priskv.h"
 #include "list.h"
 
 #define PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND 128
+#define PRISKV_DEFAULT_TRACE_SAMPLE 1024
+#define PRISKV_RDMA_MAX_INLINE_DATA 256
+/* the maximum RDMA WRITE WRs of a one-sided SET in addition to the COMMIT SEND, also the maximum
+ * value RDMA READ WRs of a one-sided GET in addition to the entry READ */
+#define PRISKV_RDMA_MAX_WRITE_WR 8
+/* timeout of reading the index header synchronously after connected */
+#define PRISKV_RDMA_INDEX_TIMEOUT_MS 1000
+/* the buffer of responses received over TCP, the large values are copied to SGLs by pieces */
+#define PRISKV_TCP_RX_BUF_SIZE (64 * 1024)
 
 #define PRISKV_RDMA_DEF_ADDR(id)                                                                     \
     char local_addr[PRISKV_ADDR_LEN] = {0};                                                          \
@@ -75,6 +93,7 @@ enum priskv_rdma_mem_type {
     PRISKV_RDMA_MEM_REQ,
     PRISKV_RDMA_MEM_RESP,
     PRISKV_RDMA_MEM_KEYS,
+    PRISKV_RDMA_MEM_INDEX, /* index entries read by one-sided GET, 2 entries per request */
 
     PRISKV_RDMA_MEM_MAX
 };
@@ -86,6 +105,8 @@ struct priskv_connect_param {
     uint16_t max_key_length;
     /* the maxium command in flight, aka depth of commands */
     uint16_t max_inflight_command;
+    /* the maxium length of a value carried by SEND payload */
+    uint16_t max_inline_value;
 };
 
 struct priskv_memory {
@@ -100,14 +121,31 @@ struct priskv_rdma_conn {
     struct ibv_comp_channel *comp_channel;
     struct ibv_cq *cq;
     struct ibv_qp *qp;
+    uint32_t max_inline_data; /* IBV_SEND_INLINE capability of QP */
+    uint32_t max_write_wr;    /* RDMA WRITE/READ WRs per command in send queue */
 
     uint8_t id;
     priskv_thread *thread;
 
     priskv_rdma_mem rmem[PRISKV_RDMA_MEM_MAX];
+    priskv_slots req_slots; /* free requests of PRISKV_RDMA_MEM_REQ */
+    uint16_t credits;       /* granted by the latest response, 0 means no flow control */
 
     priskv_connect_param param;
     uint64_t capacity;
+
+    /* the index exported by server for one-sided GET, @nentries is 0 if unsupported */
+    struct {
+        uint64_t hdr_addr;
+        uint32_t hdr_rkey;
+        uint64_t entries_addr;
+        uint32_t entries_rkey;
+        uint32_t nentries;
+        uint64_t value_base;
+        uint64_t seg_size;
+        uint32_t nsegs;
+        uint32_t *seg_rkeys;
+    } index;
     int epollfd;
     bool established;
     struct list_head inflight_list;
@@ -116,6 +154,26 @@ struct priskv_rdma_conn {
     priskv_rdma_req *keys_running_req;
     priskv_memory keys_mems;
 
+    /* TCP transport instead of verbs, -1 on RDMA */
+    int sockfd;
+    struct {
+        char local_addr[PRISKV_ADDR_LEN];
+        char peer_addr[PRISKV_ADDR_LEN];
+        uint8_t *tx_buf;
+        uint32_t tx_len;
+        uint32_t tx_sent;
+        uint32_t tx_cap;
+        uint8_t *rx_buf;
+        uint32_t rx_len;
+        priskv_rdma_req *rx_req; /* receiving the value of GET/KEYS */
+        uint32_t rx_valuelen;
+        uint32_t rx_off;
+        /* the stream goes through the rings instead of @sockfd on a co-located server */
+        priskv_shm *shm;
+        int doorbell; /* eventfd to kick server */
+        int kick;     /* eventfd kicked by server */
+    } tcp;
+
     uint64_t stats[PRISKV_COMMAND_MAX];
     uint64_t resps;
     uint64_t wc_recv;
@@ -130,6 +188,13 @@ struct priskv_client {
     int epollfd;
     priskv_workqueue *wq;
     priskv_conn_operation *ops;
+    uint32_t max_inline_value;
+    bool direct_write;
+    bool direct_read;
+    uint8_t priority; /* priskv_request_priority */
+    bool tcp;
+    uint32_t trace_sample; /* trace 1 in @trace_sample requests, 0 disables */
+    uint32_t trace_seq;
 };
 
 struct priskv_sgl_private {
@@ -161,6 +226,25 @@ struct priskv_rdma_req {
     uint32_t length;
     void *result;
     bool delaying;
+    bool inlined; /* PRISKV_REQUEST_FLAG_INLINE */
+    bool traced;  /* PRISKV_REQUEST_FLAG_TRACE */
+    bool range;   /* PRISKV_REQUEST_FLAG_RANGE from @offset */
+    uint64_t offset;
+    uint8_t cond; /* PRISKV_REQUEST_FLAG_NX or PRISKV_REQUEST_FLAG_VERSION of SET */
+    uint32_t version;
+    uint8_t priority; /* priskv_request_priority */
+    /* one-sided SET: RESERVE -> RDMA WRITE & COMMIT */
+    /* one-sided GET: READ entry(INDEX) -> READ value & entry(VALUE) */
+#define PRISKV_RDMA_REQ_PHASE_NONE 0
+#define PRISKV_RDMA_REQ_PHASE_RESERVE 1
+#define PRISKV_RDMA_REQ_PHASE_COMMIT 2
+#define PRISKV_RDMA_REQ_PHASE_INDEX 3
+#define PRISKV_RDMA_REQ_PHASE_VALUE 4
+    uint8_t phase;
+    uint16_t req_idx; /* slot of @req, also locates the entries of PRISKV_RDMA_MEM_INDEX */
+    uint16_t nremote;
+    uint64_t token;
+    priskv_keyed_sgl remote[PRISKV_RESERVE_MAX_SGL]; /* host endian */
 };
 
 struct priskv_conn_operation {
@@ -181,7 +265,13 @@ static int _priskv_rdma_req_cb(void *arg);
 static int priskv_rdma_req_send(void *arg);
 static inline void priskv_rdma_req_free(priskv_rdma_req *rdma_req);
 static inline void priskv_rdma_req_complete(priskv_rdma_conn *conn);
+static inline void priskv_rdma_req_done(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req);
 static inline void priskv_rdma_req_reset(priskv_rdma_req *rdma_req);
+static int priskv_tcp_req_post(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req, uint32_t length);
+static void priskv_tcp_handle_in(int fd, void *opaque, uint32_t ev);
+static void priskv_tcp_handle_out(int fd, void *opaque, uint32_t ev);
+static void priskv_shm_handle_kick(int fd, void *opaque, uint32_t ev);
+static void priskv_shm_handle_sock(int fd, void *opaque, uint32_t ev);
 
 static int priskv_build_check(void)
 {
@@ -198,18 +288,28 @@ static int priskv_build_check(void)
     PRISKV_BUILD_BUG_ON((int)PRISKV_STATUS_KEY_UPDATING != (int)PRISKV_RESP_STATUS_KEY_UPDATING);
     PRISKV_BUILD_BUG_ON((int)PRISKV_STATUS_CONNECT_ERROR != (int)PRISKV_RESP_STATUS_CONNECT_ERROR);
     PRISKV_BUILD_BUG_ON((int)PRISKV_STATUS_SERVER_ERROR != (int)PRISKV_RESP_STATUS_SERVER_ERROR);
+    PRISKV_BUILD_BUG_ON((int)PRISKV_STATUS_INVALID_RANGE != (int)PRISKV_RESP_STATUS_INVALID_RANGE);
+    PRISKV_BUILD_BUG_ON((int)PRISKV_STATUS_KEY_EXISTS != (int)PRISKV_RESP_STATUS_KEY_EXISTS);
     PRISKV_BUILD_BUG_ON((int)PRISKV_STATUS_NO_MEM != (int)PRISKV_RESP_STATUS_NO_MEM);
     return 0;
 }
 
-/* use 64 bytes aligned request buffer. */
+/* use 64 bytes aligned request buffer, the inline value follows the key, then the trace. */
 static inline unsigned int priskv_request_size_aligend(priskv_rdma_conn *conn)
 {
-    uint16_t s = priskv_request_size(conn->param.max_sgl, conn->param.max_key_length);
+    uint32_t s = priskv_request_size(conn->param.max_sgl, conn->param.max_key_length);
 
+    s += conn->param.max_inline_value + sizeof(priskv_request_trace);
     return ALIGN_UP(s, 64);
 }
 
+static inline unsigned int priskv_response_size(priskv_rdma_conn *conn)
+{
+    uint32_t payload = priskv_max_u32(conn->param.max_inline_value, sizeof(priskv_reserve_resp));
+
+    return sizeof(priskv_response) + payload;
+}
+
 static int priskv_rdma_mem_new(priskv_rdma_conn *conn, priskv_rdma_mem *rmem, const char *name,
                              uint32_t size, bool remote_write)
 {
@@ -230,8 +330,9 @@ static int priskv_rdma_mem_new(priskv_rdma_conn *conn, priskv_rdma_mem *rmem, co
         flags |= IBV_ACCESS_REMOTE_WRITE;
     }
 
-    rmem->mr = ibv_reg_mr(conn->cm_id->pd, buf, size, flags);
-    if (!rmem->mr) {
+    /* the buffers are accessed by socket calls only over TCP */
+    rmem->mr = conn->cm_id ? ibv_reg_mr(conn->cm_id->pd, buf, size, flags) : NULL;
+    if (conn->cm_id && !rmem->mr) {
         priskv_log_error("RDMA: failed to reg MR for %s buffer: %m\n", name);
         ret = -errno;
         goto free_mem;
@@ -276,6 +377,11 @@ static inline void priskv_rdma_mem_free_all(priskv_rdma_conn *conn)
 
         priskv_rdma_mem_free(conn, rmem);
     }
+
+    priskv_slots_deinit(&conn->req_slots);
+    free(conn->index.seg_rkeys);
+    conn->index.seg_rkeys = NULL;
+    conn->index.nentries = 0;
 }
 
 #define PRISKV_RDMA_REQUEST_FREE_COMMAND 0xffff
@@ -288,7 +394,12 @@ static void priskv_request_free(priskv_request *req, priskv_rdma_conn *conn)
     assert(ptr < rmem->buf + rmem->buf_size);
     assert(!((ptr - rmem->buf) % priskv_request_size_aligend(conn)));
 
+    if (req->command == PRISKV_RDMA_REQUEST_FREE_COMMAND) {
+        return;
+    }
+
     req->command = PRISKV_RDMA_REQUEST_FREE_COMMAND;
+    priskv_slots_put(&conn->req_slots, (ptr - rmem->buf) / priskv_request_size_aligend(conn));
 }
 
 static int priskv_rdma_mem_new_all(priskv_rdma_conn *conn)
@@ -302,15 +413,19 @@ static int priskv_rdma_mem_new_all(priskv_rdma_conn *conn)
         goto error;
     }
 
+    if (priskv_slots_init(&conn->req_slots, conn->param.max_inflight_command)) {
+        goto error;
+    }
+
     /* additional work: set priskv_request::command as PRISKV_RDMA_REQUEST_FREE_COMMAND */
     priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_REQ];
     for (uint16_t i = 0; i < conn->param.max_inflight_command; i++) {
         priskv_request *req = (priskv_request *)(rmem->buf + i * reqsize);
-        priskv_request_free(req, conn);
+        req->command = PRISKV_RDMA_REQUEST_FREE_COMMAND;
     }
 
     /* #step 2, prepare buffer & MR for response from server */
-    size = sizeof(priskv_response) * conn->param.max_inflight_command;
+    size = priskv_response_size(conn) * conn->param.max_inflight_command;
     if (priskv_rdma_mem_new(conn, &conn->rmem[PRISKV_RDMA_MEM_RESP], "Response", size, false)) {
         goto error;
     }
@@ -321,6 +436,14 @@ static int priskv_rdma_mem_new_all(priskv_rdma_conn *conn)
         goto error;
     }
 
+    /* #step 4, prepare buffer & MR for index entries, also used to read the index header */
+    if (conn->index.hdr_addr) {
+        size = 2 * sizeof(priskv_index_entry) * conn->param.max_inflight_command;
+        if (priskv_rdma_mem_new(conn, &conn->rmem[PRISKV_RDMA_MEM_INDEX], "Index", size, false)) {
+            goto error;
+        }
+    }
+
     return 0;
 
 error:
@@ -334,30 +457,37 @@ static priskv_request *priskv_rdma_unused_command(priskv_rdma_conn *conn, uint16
     uint16_t req_buf_size = priskv_request_size_aligend(conn);
     priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_REQ];
 
-    for (uint16_t i = 0; i < conn->param.max_inflight_command; i++) {
-        priskv_request *req = (priskv_request *)(rmem->buf + i * req_buf_size);
-        if (req->command == PRISKV_RDMA_REQUEST_FREE_COMMAND) {
-            priskv_log_debug("RDMA: use request %d\n", i);
-            req->command = 0xc001;
-            *idx = i;
-            return req;
-        }
+    int64_t i = priskv_slots_get(&conn->req_slots);
+
+    if (i < 0) {
+        return NULL;
     }
 
-    return NULL;
+    priskv_request *req = (priskv_request *)(rmem->buf + i * req_buf_size);
+    assert(req->command == PRISKV_RDMA_REQUEST_FREE_COMMAND);
+    priskv_log_debug("RDMA: use request %ld\n", i);
+    req->command = 0xc001;
+    *idx = i;
+    return req;
 }
 
 static void priskv_rdma_close_conn(priskv_rdma_conn *conn)
 {
     priskv_rdma_req *rdma_req, *tmp;
 
-    if (conn->established) {
+    if (conn->established && conn->cm_id) {
         PRISKV_RDMA_DEF_ADDR(conn->cm_id)
         priskv_log_notice("RDMA: <%s - %s> close. Requests GET %ld, SET %ld, TEST %ld, DELETE %ld, "
                         "Responses %ld\n",
                         local_addr, peer_addr, conn->stats[PRISKV_COMMAND_GET],
                         conn->stats[PRISKV_COMMAND_SET], conn->stats[PRISKV_COMMAND_TEST],
                         conn->stats[PRISKV_COMMAND_DELETE], conn->resps);
+    } else if (conn->established) {
+        priskv_log_notice("TCP: <%s - %s> close. Requests GET %ld, SET %ld, TEST %ld, DELETE %ld, "
+                          "Responses %ld\n",
+                          conn->tcp.local_addr, conn->tcp.peer_addr, conn->stats[PRISKV_COMMAND_GET],
+                          conn->stats[PRISKV_COMMAND_SET], conn->stats[PRISKV_COMMAND_TEST],
+                          conn->stats[PRISKV_COMMAND_DELETE], conn->resps);
     }
 
     conn->established = false;
@@ -367,7 +497,10 @@ static void priskv_rdma_close_conn(priskv_rdma_conn *conn)
     list_for_each_safe (&conn->inflight_list, rdma_req, tmp, entry) {
         list_del(&rdma_req->entry);
 
-        priskv_request_free(rdma_req->req, conn);
+        /* delayed requests have not got a request buffer yet */
+        if (rdma_req->req) {
+            priskv_request_free(rdma_req->req, conn);
+        }
         rdma_req->status = PRISKV_STATUS_DISCONNECTED;
         rdma_req->cb(rdma_req);
     }
@@ -377,6 +510,21 @@ static void priskv_rdma_close_conn(priskv_rdma_conn *conn)
         conn->epollfd = -1;
     }
 
+    if (conn->sockfd >= 0) {
+        close(conn->sockfd);
+        conn->sockfd = -1;
+    }
+    free(conn->tcp.tx_buf);
+    free(conn->tcp.rx_buf);
+    conn->tcp.tx_buf = conn->tcp.rx_buf = NULL;
+    if (conn->tcp.shm) {
+        priskv_shm_detach(conn->tcp.shm);
+        free(conn->tcp.shm);
+        conn->tcp.shm = NULL;
+        close(conn->tcp.doorbell);
+        close(conn->tcp.kick);
+    }
+
     if (conn->qp) {
         if (ibv_destroy_qp(conn->qp)) {
             priskv_log_warn("ibv_destroy_qp failed\n");
@@ -420,7 +568,7 @@ static int priskv_rdma_recv_resp(priskv_rdma_conn *conn, priskv_response *resp)
 {
     struct ibv_sge sge;
     struct ibv_recv_wr recv_wr, *bad_wr;
-    uint16_t resp_buf_size = sizeof(priskv_response);
+    uint32_t resp_buf_size = priskv_response_size(conn);
     priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
     int ret;
 
@@ -481,18 +629,30 @@ static int priskv_rdma_new_qp(priskv_rdma_conn *conn)
         return -errno;
     }
 
-    init_attr.cap.max_send_wr = depth;
+    init_attr.cap.max_send_wr = depth * (1 + PRISKV_RDMA_MAX_WRITE_WR);
     init_attr.cap.max_recv_wr = depth;
     init_attr.cap.max_send_sge = 1;
     init_attr.cap.max_recv_sge = 1;
+    init_attr.cap.max_inline_data = PRISKV_RDMA_MAX_INLINE_DATA;
     init_attr.qp_type = IBV_QPT_RC;
     init_attr.send_cq = conn->cq;
     init_attr.recv_cq = conn->cq;
     conn->qp = ibv_create_qp(conn->cm_id->pd, &init_attr);
     if (!conn->qp) {
-        priskv_log_error("RDMA: ibv_create_qp failed: %m\n");
-        return -errno;
+        /* the device may not support such inline data or WRs, both IBV_SEND_INLINE and one-sided
+         * SET are optional */
+        priskv_log_info("RDMA: ibv_create_qp with inline data %d, send WR %d failed, retry\n",
+                      init_attr.cap.max_inline_data, init_attr.cap.max_send_wr);
+        init_attr.cap.max_inline_data = 0;
+        init_attr.cap.max_send_wr = depth;
+        conn->qp = ibv_create_qp(conn->cm_id->pd, &init_attr);
+        if (!conn->qp) {
+            priskv_log_error("RDMA: ibv_create_qp failed: %m\n");
+            return -errno;
+        }
     }
+    conn->max_inline_data = init_attr.cap.max_inline_data;
+    conn->max_write_wr = priskv_min_u32(init_attr.cap.max_send_wr / depth - 1, PRISKV_RDMA_MAX_WRITE_WR);
 
     return 0;
 }
@@ -516,11 +676,18 @@ static int priskv_rdma_connect(priskv_rdma_conn *conn)
     cm_req.max_sgl = htobe16(param->max_sgl);
     cm_req.max_key_length = htobe16(param->max_key_length);
     cm_req.max_inflight_command = htobe16(param->max_inflight_command);
+    cm_req.max_inline_value = htobe16(param->max_inline_value);
 
     conn_param.private_data = &cm_req;
     conn_param.private_data_len = sizeof(cm_req);
     conn_param.responder_resources = 1;
     conn_param.initiator_depth = 1;
+    /* one-sided GET issues RDMA READs, the server side limitation also applies */
+    struct ibv_device_attr attr;
+    if (!ibv_query_device(cm_id->verbs, &attr)) {
+        conn_param.responder_resources = priskv_min_u32(attr.max_qp_rd_atom, UINT8_MAX);
+        conn_param.initiator_depth = priskv_min_u32(attr.max_qp_init_rd_atom, UINT8_MAX);
+    }
     conn_param.retry_count = 2;
     conn_param.rnr_retry_count = 2;
     conn_param.qp_num = conn->qp->qp_num;
@@ -620,10 +787,11 @@ static int priskv_rdma_modify_max_inflight_command(priskv_rdma_conn *conn,
     priskv_log_info("RDMA: resize CQ to %d\n", conn->param.max_inflight_command);
     struct ibv_qp_attr qp_attr = {0};
 
-    qp_attr.cap.max_send_wr = conn->param.max_inflight_command;
+    qp_attr.cap.max_send_wr = conn->param.max_inflight_command * (1 + conn->max_write_wr);
     qp_attr.cap.max_recv_wr = conn->param.max_inflight_command;
     qp_attr.cap.max_send_sge = 1;
     qp_attr.cap.max_recv_sge = 1;
+    qp_attr.cap.max_inline_data = conn->max_inline_data;
     ret = ibv_modify_qp(conn->qp, &qp_attr, IBV_QP_CAP);
     if (ret) {
         priskv_log_error("RDMA: ibv_modify_qp CAP failed %m\n");
@@ -635,6 +803,107 @@ static int priskv_rdma_modify_max_inflight_command(priskv_rdma_conn *conn,
     return 0;
 }
 
+/* RDMA READ [@raddr, @raddr + @length) into PRISKV_RDMA_MEM_INDEX, poll CQ until completed */
+static int priskv_rdma_read_sync(priskv_rdma_conn *conn, uint64_t raddr, uint32_t rkey,
+                                 uint32_t length)
+{
+    priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_INDEX];
+    struct ibv_send_wr wr = {0}, *bad_wr;
+    struct timeval start, now;
+    struct ibv_sge sge;
+    struct ibv_wc wc;
+    int ret;
+
+    if (length > rmem->buf_size) {
+        return -E2BIG;
+    }
+
+    sge.addr = (uint64_t)rmem->buf;
+    sge.length = length;
+    sge.lkey = rmem->mr->lkey;
+
+    wr.wr_id = 0;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = raddr;
+    wr.wr.rdma.rkey = rkey;
+    if (ibv_post_send(conn->qp, &wr, &bad_wr)) {
+        return -EIO;
+    }
+
+    gettimeofday(&start, NULL);
+    do {
+        ret = ibv_poll_cq(conn->cq, 1, &wc);
+        if (ret < 0) {
+            return -EIO;
+        } else if (ret == 1) {
+            /* no response is expected before established */
+            return (wc.status == IBV_WC_SUCCESS && wc.opcode == IBV_WC_RDMA_READ) ? 0 : -EIO;
+        }
+
+        gettimeofday(&now, NULL);
+    } while (priskv_time_elapsed_us(&start, &now) < PRISKV_RDMA_INDEX_TIMEOUT_MS * 1000);
+
+    return -ETIMEDOUT;
+}
+
+/* read the index header and the rkeys of value segments for one-sided GET */
+static int priskv_rdma_index_import(priskv_rdma_conn *conn)
+{
+    priskv_index_header *hdr = (priskv_index_header *)conn->rmem[PRISKV_RDMA_MEM_INDEX].buf;
+    uint32_t nsegs;
+    int ret;
+
+    ret = priskv_rdma_read_sync(conn, conn->index.hdr_addr, conn->index.hdr_rkey,
+                                sizeof(priskv_index_header));
+    if (ret) {
+        return ret;
+    }
+
+    nsegs = be32toh(hdr->nsegs);
+    conn->index.entries_addr = be64toh(hdr->entries_addr);
+    conn->index.entries_rkey = be32toh(hdr->entries_rkey);
+    conn->index.value_base = be64toh(hdr->value_base);
+    conn->index.seg_size = be64toh(hdr->seg_size);
+    if (!nsegs || !conn->index.seg_size) {
+        return -EPROTO;
+    }
+
+    conn->index.seg_rkeys = calloc(nsegs, sizeof(uint32_t));
+    if (!conn->index.seg_rkeys) {
+        return -ENOMEM;
+    }
+
+    /* the rkeys may not fit into the buffer at once */
+    uint32_t per_read = conn->rmem[PRISKV_RDMA_MEM_INDEX].buf_size / sizeof(uint32_t);
+    uint32_t nentries = be32toh(hdr->nentries);
+    for (uint32_t i = 0; i < nsegs; i += per_read) {
+        uint32_t n = priskv_min_u32(per_read, nsegs - i);
+        uint32_t *rkeys = (uint32_t *)conn->rmem[PRISKV_RDMA_MEM_INDEX].buf;
+
+        ret = priskv_rdma_read_sync(conn,
+                                    conn->index.hdr_addr + sizeof(priskv_index_header) +
+                                        i * sizeof(uint32_t),
+                                    conn->index.hdr_rkey, n * sizeof(uint32_t));
+        if (ret) {
+            return ret;
+        }
+
+        for (uint32_t j = 0; j < n; j++) {
+            conn->index.seg_rkeys[i + j] = be32toh(rkeys[j]);
+        }
+    }
+
+    conn->index.nsegs = nsegs;
+    conn->index.nentries = nentries;
+    priskv_log_info("RDMA: index entries %d, value segments %d, segment size %ld from server\n",
+                    nentries, nsegs, conn->index.seg_size);
+
+    return 0;
+}
+
 static int priskv_rdma_responsed(struct rdma_cm_event *ev, priskv_rdma_conn *conn)
 {
     struct rdma_conn_param *rep_param = &ev->param.conn;
@@ -653,10 +922,13 @@ static int priskv_rdma_responsed(struct rdma_cm_event *ev, priskv_rdma_conn *con
     conn->param.max_key_length = be16toh(rep->max_key_length);
     uint16_t max_inflight_command = be16toh(rep->max_inflight_command);
     conn->capacity = be64toh(rep->capacity);
+    conn->param.max_inline_value = be16toh(rep->max_inline_value);
+    conn->index.hdr_addr = be64toh(rep->index_addr);
+    conn->index.hdr_rkey = be32toh(rep->index_rkey);
     priskv_log_info("RDMA: response version %d, max_sgl %d, max_key_length %d, max_inflight_command "
-                  "%d, capacity %ld from server\n",
+                  "%d, capacity %ld, max_inline_value %d from server\n",
                   version, conn->param.max_sgl, conn->param.max_key_length, max_inflight_command,
-                  conn->capacity);
+                  conn->capacity, conn->param.max_inline_value);
 
     ret = priskv_rdma_modify_max_inflight_command(conn, max_inflight_command);
     if (ret) {
@@ -679,12 +951,24 @@ static int priskv_rdma_responsed(struct rdma_cm_event *ev, priskv_rdma_conn *con
     }
 
     priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
-    priskv_response *resp = (priskv_response *)rmem->buf;
+    uint8_t *resp = rmem->buf;
     for (int i = 0; i < conn->param.max_inflight_command; i++) {
-        ret = priskv_rdma_recv_resp(conn, resp + i);
+        ret = priskv_rdma_recv_resp(conn, (priskv_response *)resp);
         if (ret < 0) {
             return ret;
         }
+
+        resp += ret;
+    }
+
+    /* not fatal, GET falls back to two-sided */
+    if (conn->index.hdr_addr && priskv_rdma_index_import(conn)) {
+        PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+        priskv_log_warn("RDMA: <%s - %s> failed to import index, one-sided GET disabled\n",
+                        local_addr, peer_addr);
+        free(conn->index.seg_rkeys);
+        conn->index.seg_rkeys = NULL;
+        conn->index.nentries = 0;
     }
 
     return 0;
@@ -822,7 +1106,8 @@ static void priskv_conn_process(int fd, void *opaque, uint32_t ev)
     priskv_events_process(conn->epollfd, -1);
 }
 
-static priskv_rdma_conn *priskv_conn_connect(const char *raddr, int rport, const char *laddr, int lport)
+static priskv_rdma_conn *priskv_conn_connect(const char *raddr, int rport, const char *laddr, int lport,
+                                            uint16_t max_inline_value)
 {
     struct rdma_addrinfo hints = {0}, *addrinfo = NULL;
     priskv_rdma_conn *conn = NULL;
@@ -833,10 +1118,12 @@ static priskv_rdma_conn *priskv_conn_connect(const char *raddr, int rport, const
         priskv_log_error("RDMA: failed to allocate memory for RDMA connection\n");
         return NULL;
     }
+    conn->sockfd = -1;
 
     conn->param.max_sgl = 0;
     conn->param.max_key_length = 0;
     conn->param.max_inflight_command = PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND;
+    conn->param.max_inline_value = max_inline_value;
 
     list_head_init(&conn->inflight_list);
     list_head_init(&conn->complete_list);
@@ -926,172 +1213,549 @@ free_addrinfo:
     return conn;
 }
 
-int priskv_conn_close(void *conn)
+/* blocking write/read of the handshake, the socket becomes non-blocking after established.
+ * A shm server passes {memfd, doorbell, kick} along with the reply into @fds */
+static int priskv_tcp_handshake(priskv_rdma_conn *conn, int fds[3])
 {
-    if (!conn) {
-        return 0;
-    }
+    priskv_connect_param *param = &conn->param;
+    priskv_rdma_cm_req cm_req = {0};
+    priskv_tcp_cm_reply reply;
+    char control[CMSG_SPACE(sizeof(int) * 3)];
+    struct msghdr msg = {0};
+    struct iovec iov;
+    struct cmsghdr *cm;
+    uint8_t *buf = (uint8_t *)&reply;
+    uint32_t off = 0;
+    ssize_t n;
 
-    priskv_rdma_close_conn(conn);
-    free(conn);
+    assert(!priskv_build_check());
 
-    return 0;
-}
+    cm_req.version = htobe16(PRISKV_RDMA_CM_VERSION);
+    cm_req.max_sgl = htobe16(param->max_sgl);
+    cm_req.max_key_length = htobe16(param->max_key_length);
+    cm_req.max_inflight_command = htobe16(param->max_inflight_command);
+    if (send(conn->sockfd, &cm_req, sizeof(cm_req), MSG_NOSIGNAL) != sizeof(cm_req)) {
+        priskv_log_error("TCP: failed to send handshake: %m\n");
+        return -EIO;
+    }
 
-static struct ibv_mr *priskv_conn_reg_memory(priskv_rdma_conn *conn, uint64_t offset, size_t length,
-                                           uint64_t iova, int fd)
-{
-    struct ibv_pd *pd = conn->cm_id->pd;
-    unsigned int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ;
-    struct ibv_mr *mr = NULL;
+    while (off < sizeof(reply)) {
+        iov.iov_base = buf + off;
+        iov.iov_len = sizeof(reply) - off;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = fds ? control : NULL;
+        msg.msg_controllen = fds ? sizeof(control) : 0;
+        n = recvmsg(conn->sockfd, &msg, MSG_CMSG_CLOEXEC);
+        if (n <= 0) {
+            priskv_log_error("TCP: failed to receive handshake: %m\n");
+            return -ECONNREFUSED;
+        }
 
-    if (fd >= 0) {
-#if LIBIBVERBS_VERSION_MINOR >= 12
-        mr = ibv_reg_dmabuf_mr(pd, offset, length, iova, fd, access);
-#else
-        priskv_log_error("RDMA: the libibverbs before 1.12 does not support ibv_reg_dmabuf_mr\n");
-#endif
-    } else {
-        mr = ibv_reg_mr_iova(pd, (void *)offset, length, iova, access);
+        /* the fds arrive along with the first byte of reply */
+        for (cm = fds ? CMSG_FIRSTHDR(&msg) : NULL; cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if ((cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SCM_RIGHTS) &&
+                (cm->cmsg_len == CMSG_LEN(sizeof(int) * 3))) {
+                memcpy(fds, CMSG_DATA(cm), sizeof(int) * 3);
+            }
+        }
+        off += n;
     }
 
-    if (!mr) {
-        priskv_log_error("RDMA: failed to reg mr 0x%lx:%ld %m. If you are using GPU memory, check if "
-                       "the nvidia_peermem module is installed\n",
-                       offset, length);
+    uint16_t status = be16toh(reply.status);
+    if (status) {
+        priskv_log_error("TCP: reject status: %s(%d), supported value %ld from server\n",
+                         priskv_rdma_cm_status_str(status), status, be64toh(reply.rej.value));
+        return -ECONNREFUSED;
     }
 
-    return mr;
-}
+    param->max_sgl = be16toh(reply.rep.max_sgl);
+    param->max_key_length = be16toh(reply.rep.max_key_length);
+    param->max_inflight_command = be16toh(reply.rep.max_inflight_command);
+    param->max_inline_value = 0;
+    conn->capacity = be64toh(reply.rep.capacity);
+    priskv_log_info("TCP: response version %d, max_sgl %d, max_key_length %d, max_inflight_command "
+                    "%d, capacity %ld from server\n",
+                    be16toh(reply.rep.version), param->max_sgl, param->max_key_length,
+                    param->max_inflight_command, conn->capacity);
 
-static void priskv_conn_dereg_memory(struct ibv_mr *mr)
-{
-    ibv_dereg_mr(mr);
+    return 0;
 }
 
-static int priskv_mq_init(priskv_client *client, const char *raddr, int rport, const char *laddr,
-                        int lport, int nqueue)
+static priskv_rdma_conn *priskv_conn_connect_tcp(const char *raddr, int rport, const char *laddr,
+                                                 int lport)
 {
-    client->wq = priskv_workqueue_create(client->epollfd);
-    if (!client->wq) {
-        priskv_log_error("RDMA: failed to create workqueue\n");
-        return -1;
-    }
+    struct addrinfo hints = {0}, *addrinfo = NULL;
+    struct sockaddr_storage local, peer;
+    socklen_t local_len = sizeof(local), peer_len = sizeof(peer);
+    struct epoll_event event = {0};
+    priskv_rdma_conn *conn = NULL;
+    char _port[6]; /* strlen("65535") */
+    int one = 1;
 
-    client->pool = priskv_threadpool_create("priskv", nqueue, 0, 0);
-    if (!client->pool) {
-        priskv_log_error("RDMA: failed to create threadpool\n");
-        return -1;
+    conn = calloc(sizeof(struct priskv_rdma_conn), 1);
+    if (!conn) {
+        priskv_log_error("TCP: failed to allocate memory for TCP connection\n");
+        return NULL;
     }
 
-    client->conns = calloc(nqueue, sizeof(priskv_rdma_conn *));
-    if (!client->conns) {
-        priskv_log_error("RDMA: failed to allocate memory for connections\n");
-        return -1;
-    }
-    client->nqueue = nqueue;
+    conn->sockfd = -1;
+    conn->param.max_inflight_command = PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND;
+    list_head_init(&conn->inflight_list);
+    list_head_init(&conn->complete_list);
+    conn->keys_mems.count = 1;
+    conn->keys_mems.mrs = calloc(sizeof(struct ibv_mr *), 1);
 
-    for (uint8_t i = 0; i < nqueue; i++) {
-        client->conns[i] = priskv_conn_connect(raddr, rport, laddr, lport);
-        if (!client->conns[i]) {
-            priskv_log_error("RDMA: failed to connect to %s:%d\n", raddr, rport);
-            return -1;
-        }
+    conn->epollfd = epoll_create1(0);
+    if (conn->epollfd < 0) {
+        priskv_log_error("TCP: failed to create epoll fd\n");
+        goto error;
+    }
 
-        client->conns[i]->id = i;
-        client->conns[i]->thread = priskv_threadpool_get_iothread(client->pool, i);
+    priskv_set_fd_handler(conn->epollfd, priskv_conn_process, NULL, conn);
+    priskv_set_nonblock(conn->epollfd);
 
-        priskv_thread_add_event_handler(client->conns[i]->thread, client->conns[i]->epollfd);
+    snprintf(_port, 6, "%d", rport);
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(raddr, _port, &hints, &addrinfo)) {
+        priskv_log_error("TCP: failed to get remote addr info %s:%d\n", raddr, rport);
+        goto error;
     }
 
-    client->cur_conn = 0;
+    conn->sockfd = socket(addrinfo->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn->sockfd < 0) {
+        priskv_log_error("TCP: failed to create socket: %m\n");
+        goto error;
+    }
 
-    return 0;
-}
+    /* bind local address if user specify one */
+    if (laddr) {
+        struct addrinfo *laddrinfo = NULL;
 
-static void priskv_mq_deinit(priskv_client *client)
-{
-    if (client->conns) {
-        for (int i = 0; i < client->nqueue; i++) {
-            priskv_thread_call_function(priskv_threadpool_get_iothread(client->pool, i),
-                                      priskv_conn_close, client->conns[i]);
+        snprintf(_port, 6, "%d", lport);
+        hints.ai_flags = AI_PASSIVE;
+        if (getaddrinfo(laddr, _port, &hints, &laddrinfo) ||
+            bind(conn->sockfd, laddrinfo->ai_addr, laddrinfo->ai_addrlen)) {
+            priskv_log_error("TCP: failed to bind local addr info %s:%d\n", laddr, lport);
+            if (laddrinfo) {
+                freeaddrinfo(laddrinfo);
+            }
+            goto error;
         }
+        freeaddrinfo(laddrinfo);
     }
 
-    priskv_threadpool_destroy(client->pool);
-    priskv_workqueue_destroy(client->wq);
-    free(client->conns);
-}
+    if (connect(conn->sockfd, addrinfo->ai_addr, addrinfo->ai_addrlen)) {
+        priskv_log_error("TCP: failed to connect to %s:%d: %m\n", raddr, rport);
+        goto error;
+    }
 
-static priskv_rdma_conn *priskv_mq_select_conn(priskv_client *client)
-{
-    return client->conns[client->cur_conn++ % client->nqueue];
-}
+    setsockopt(conn->sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    getsockname(conn->sockfd, (struct sockaddr *)&local, &local_len);
+    getpeername(conn->sockfd, (struct sockaddr *)&peer, &peer_len);
+    priskv_inet_ntop((struct sockaddr *)&local, conn->tcp.local_addr);
+    priskv_inet_ntop((struct sockaddr *)&peer, conn->tcp.peer_addr);
 
-static priskv_memory *priskv_mq_reg_memory(priskv_client *client, uint64_t offset, size_t length,
-                                       uint64_t iova, int fd)
-{
-    priskv_memory *mem = malloc(sizeof(priskv_memory));
+    if (priskv_tcp_handshake(conn, NULL) || priskv_rdma_mem_new_all(conn)) {
+        goto error;
+    }
 
-    mem->client = client;
-    mem->count = client->nqueue;
-    mem->mrs = malloc(client->nqueue * sizeof(struct ibv_mr *));
+    conn->tcp.rx_buf = malloc(PRISKV_TCP_RX_BUF_SIZE);
+    if (!conn->tcp.rx_buf) {
+        goto error;
+    }
 
-    for (int i = 0; i < mem->count; i++) {
-        mem->mrs[i] = priskv_conn_reg_memory(client->conns[i], offset, length, iova, fd);
+    /* EPOLLOUT resumes the pending requests on a full socket */
+    priskv_set_nonblock(conn->sockfd);
+    priskv_set_fd_handler(conn->sockfd, priskv_tcp_handle_in, priskv_tcp_handle_out, conn);
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.fd = conn->sockfd;
+    if (epoll_ctl(conn->epollfd, EPOLL_CTL_ADD, conn->sockfd, &event)) {
+        priskv_log_error("TCP: failed to add socket into epoll fd: %m\n");
+        goto error;
     }
 
-    return mem;
-}
+    conn->established = true;
+    priskv_log_notice("TCP: <%s - %s> established\n", conn->tcp.local_addr, conn->tcp.peer_addr);
+    freeaddrinfo(addrinfo);
 
-static void priskv_mq_dereg_memory(priskv_memory *mem)
-{
-    for (int i = 0; i < mem->count; i++) {
-        priskv_conn_dereg_memory(mem->mrs[i]);
+    return conn;
+
+error:
+    if (addrinfo) {
+        freeaddrinfo(addrinfo);
     }
-    free(mem->mrs);
-    free(mem);
-}
+    priskv_rdma_close_conn(conn);
+    free(conn);
 
-static struct ibv_mr *priskv_mq_get_mr(priskv_memory *mem, int connid)
-{
-    return mem->mrs[connid];
+    return NULL;
 }
 
-static void priskv_mq_rdma_req_submit(priskv_rdma_req *rdma_req)
+/* the server of shm runs as our own user, root, or $PRISKV_SHM_SERVER_UID */
+static bool priskv_shm_server_trusted(uid_t uid)
 {
-    priskv_thread_submit_function(rdma_req->conn->thread, priskv_rdma_req_send, rdma_req);
-}
+    const char *env = getenv("PRISKV_SHM_SERVER_UID");
+    int64_t val;
 
-static void priskv_mq_rdma_req_cb(priskv_rdma_req *rdma_req)
-{
-    priskv_workqueue_submit(rdma_req->main_wq, _priskv_rdma_req_cb, rdma_req);
-}
+    if ((uid == geteuid()) || (uid == 0)) {
+        return true;
+    }
 
-static priskv_conn_operation priskv_mq_ops = {
-    .init = priskv_mq_init,
-    .deinit = priskv_mq_deinit,
-    .select_conn = priskv_mq_select_conn,
-    .reg_memory = priskv_mq_reg_memory,
-    .dereg_memory = priskv_mq_dereg_memory,
-    .get_mr = priskv_mq_get_mr,
-    .rdma_req_submit = priskv_mq_rdma_req_submit,
-    .rdma_req_cb = priskv_mq_rdma_req_cb,
-};
+    return env && !priskv_str2num(env, &val) && (val == uid);
+}
 
-static int priskv_sq_init(priskv_client *client, const char *raddr, int rport, const char *laddr,
-                        int lport, int nqueue)
+static priskv_rdma_conn *priskv_conn_connect_shm(const char *path)
 {
-    client->conns = calloc(1, sizeof(priskv_rdma_conn *));
-    if (!client->conns) {
-        priskv_log_error("RDMA: failed to allocate memory for connections\n");
-        return -1;
-    }
+    struct sockaddr_un sun = {.sun_family = AF_UNIX};
+    priskv_rdma_conn *conn = NULL;
+    int fds[3] = {-1, -1, -1};
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
 
-    client->conns[0] = priskv_conn_connect(raddr, rport, laddr, lport);
-    if (!client->conns[0]) {
-        priskv_log_error("RDMA: failed to connect to %s:%d\n", raddr, rport);
-        return -1;
+    conn = calloc(sizeof(struct priskv_rdma_conn), 1);
+    if (!conn) {
+        priskv_log_error("TCP: failed to allocate memory for shm connection\n");
+        return NULL;
+    }
+
+    conn->sockfd = -1;
+    conn->param.max_inflight_command = PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND;
+    list_head_init(&conn->inflight_list);
+    list_head_init(&conn->complete_list);
+    conn->keys_mems.count = 1;
+    conn->keys_mems.mrs = calloc(sizeof(struct ibv_mr *), 1);
+
+    conn->epollfd = epoll_create1(0);
+    if (conn->epollfd < 0) {
+        priskv_log_error("TCP: failed to create epoll fd\n");
+        goto error;
+    }
+
+    priskv_set_fd_handler(conn->epollfd, priskv_conn_process, NULL, conn);
+    priskv_set_nonblock(conn->epollfd);
+
+    conn->sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn->sockfd < 0) {
+        priskv_log_error("TCP: failed to create socket: %m\n");
+        goto error;
+    }
+
+    snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path);
+    if (connect(conn->sockfd, (struct sockaddr *)&sun, sizeof(sun))) {
+        priskv_log_info("TCP: failed to connect to %s: %m\n", path);
+        goto error;
+    }
+
+    /* whoever listens to the path gets our requests, check the process actually listening */
+    if (getsockopt(conn->sockfd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) ||
+        !priskv_shm_server_trusted(cred.uid)) {
+        priskv_log_error("TCP: untrusted shm server on %s\n", path);
+        goto error;
+    }
+
+    snprintf(conn->tcp.local_addr, sizeof(conn->tcp.local_addr), "shm-%d", getpid());
+    snprintf(conn->tcp.peer_addr, sizeof(conn->tcp.peer_addr), "%s", path);
+    if (priskv_tcp_handshake(conn, fds) || (fds[0] < 0)) {
+        goto error;
+    }
+
+    conn->tcp.shm = calloc(1, sizeof(priskv_shm));
+    if (!conn->tcp.shm || priskv_shm_attach(conn->tcp.shm, fds[0])) {
+        priskv_log_error("TCP: failed to map shm from %s\n", path);
+        free(conn->tcp.shm);
+        conn->tcp.shm = NULL;
+        goto error;
+    }
+    conn->tcp.doorbell = fds[1];
+    conn->tcp.kick = fds[2];
+    fds[0] = fds[1] = fds[2] = -1;
+
+    if (priskv_rdma_mem_new_all(conn)) {
+        goto error;
+    }
+
+    /* sleep on the responses from now on, the server kicks once it produces */
+    priskv_shm_wait_readable(conn->tcp.shm, PRISKV_SHM_RING_RESP);
+    priskv_set_nonblock(conn->sockfd);
+    priskv_set_nonblock(conn->tcp.kick);
+    priskv_set_fd_handler(conn->sockfd, priskv_shm_handle_sock, NULL, conn);
+    priskv_set_fd_handler(conn->tcp.kick, priskv_shm_handle_kick, NULL, conn);
+    if (priskv_add_event_fd(conn->epollfd, conn->sockfd) ||
+        priskv_add_event_fd(conn->epollfd, conn->tcp.kick)) {
+        priskv_log_error("TCP: failed to add shm fds into epoll fd: %m\n");
+        goto error;
+    }
+
+    conn->established = true;
+    priskv_log_notice("TCP: <%s - %s> established over shm\n", conn->tcp.local_addr,
+                      conn->tcp.peer_addr);
+
+    return conn;
+
+error:
+    for (int i = 0; i < 3; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    priskv_rdma_close_conn(conn);
+    free(conn);
+
+    return NULL;
+}
+
+/* a server on this host is reachable by shm if $PRISKV_SHM is 1, @raddr is local and a trusted
+ * server listens to shm */
+static bool priskv_shm_lookup(const char *raddr, int rport, char *path)
+{
+    struct addrinfo hints = {0}, *addrinfo = NULL, *ai;
+    struct ifaddrs *ifaddrs = NULL, *ifa;
+    const char *dir = getenv("PRISKV_SHM_DIR"), *enable = getenv("PRISKV_SHM");
+    bool local = false;
+    struct stat st;
+
+    if (!enable || strcmp(enable, "1")) {
+        return false;
+    }
+
+    priskv_shm_sock_path(dir ? dir : PRISKV_SHM_DEFAULT_DIR, rport, path);
+    if (lstat(path, &st) || !S_ISSOCK(st.st_mode)) {
+        return false;
+    }
+
+    if (!priskv_shm_server_trusted(st.st_uid)) {
+        priskv_log_warn("TCP: ignore %s owned by untrusted uid %d\n", path, st.st_uid);
+        return false;
+    }
+
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(raddr, NULL, &hints, &addrinfo) || getifaddrs(&ifaddrs)) {
+        goto out;
+    }
+
+    for (ai = addrinfo; ai && !local; ai = ai->ai_next) {
+        for (ifa = ifaddrs; ifa && !local; ifa = ifa->ifa_next) {
+            if (!ifa->ifa_addr || (ifa->ifa_addr->sa_family != ai->ai_family)) {
+                continue;
+            }
+
+            if (ai->ai_family == AF_INET) {
+                local = !memcmp(&((struct sockaddr_in *)ai->ai_addr)->sin_addr,
+                                &((struct sockaddr_in *)ifa->ifa_addr)->sin_addr,
+                                sizeof(struct in_addr));
+            } else if (ai->ai_family == AF_INET6) {
+                local = !memcmp(&((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr,
+                                &((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr,
+                                sizeof(struct in6_addr));
+            }
+        }
+    }
+
+out:
+    if (addrinfo) {
+        freeaddrinfo(addrinfo);
+    }
+    if (ifaddrs) {
+        freeifaddrs(ifaddrs);
+    }
+
+    return local;
+}
+
+/* prefer shm on a co-located server, otherwise the transport of @client */
+static priskv_rdma_conn *priskv_client_connect_conn(priskv_client *client, const char *raddr,
+                                                   int rport, const char *laddr, int lport)
+{
+    char path[PRISKV_SHM_SOCK_PATH_MAX];
+    priskv_rdma_conn *conn;
+
+    if (priskv_shm_lookup(raddr, rport, path)) {
+        conn = priskv_conn_connect_shm(path);
+        if (conn) {
+            return conn;
+        }
+        priskv_log_notice("TCP: shm of %s:%d unavailable, fall back\n", raddr, rport);
+    }
+
+    return client->tcp ? priskv_conn_connect_tcp(raddr, rport, laddr, lport)
+                       : priskv_conn_connect(raddr, rport, laddr, lport, client->max_inline_value);
+}
+
+int priskv_conn_close(void *conn)
+{
+    if (!conn) {
+        return 0;
+    }
+
+    priskv_rdma_close_conn(conn);
+    free(conn);
+
+    return 0;
+}
+
+static struct ibv_mr *priskv_conn_reg_memory(priskv_rdma_conn *conn, uint64_t offset, size_t length,
+                                           uint64_t iova, int fd)
+{
+    unsigned int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ;
+    struct ibv_mr *mr = NULL;
+    struct ibv_pd *pd;
+
+    /* the values are copied by socket calls over TCP, no MR required */
+    if (!conn->cm_id) {
+        return NULL;
+    }
+
+    pd = conn->cm_id->pd;
+
+    if (fd >= 0) {
+#if LIBIBVERBS_VERSION_MINOR >= 12
+        mr = ibv_reg_dmabuf_mr(pd, offset, length, iova, fd, access);
+#else
+        priskv_log_error("RDMA: the libibverbs before 1.12 does not support ibv_reg_dmabuf_mr\n");
+#endif
+    } else {
+        mr = ibv_reg_mr_iova(pd, (void *)offset, length, iova, access);
+    }
+
+    if (!mr) {
+        priskv_log_error("RDMA: failed to reg mr 0x%lx:%ld %m. If you are using GPU memory, check if "
+                       "the nvidia_peermem module is installed\n",
+                       offset, length);
+    }
+
+    return mr;
+}
+
+static void priskv_conn_dereg_memory(struct ibv_mr *mr)
+{
+    if (mr) {
+        ibv_dereg_mr(mr);
+    }
+}
+
+static int priskv_mq_init(priskv_client *client, const char *raddr, int rport, const char *laddr,
+                        int lport, int nqueue)
+{
+    client->wq = priskv_workqueue_create(client->epollfd);
+    if (!client->wq) {
+        priskv_log_error("RDMA: failed to create workqueue\n");
+        return -1;
+    }
+
+    client->pool = priskv_threadpool_create("priskv", nqueue, 0, 0);
+    if (!client->pool) {
+        priskv_log_error("RDMA: failed to create threadpool\n");
+        return -1;
+    }
+
+    client->conns = calloc(nqueue, sizeof(priskv_rdma_conn *));
+    if (!client->conns) {
+        priskv_log_error("RDMA: failed to allocate memory for connections\n");
+        return -1;
+    }
+    client->nqueue = nqueue;
+
+    for (uint8_t i = 0; i < nqueue; i++) {
+        client->conns[i] = priskv_client_connect_conn(client, raddr, rport, laddr, lport);
+        if (!client->conns[i]) {
+            priskv_log_error("RDMA: failed to connect to %s:%d\n", raddr, rport);
+            return -1;
+        }
+
+        client->conns[i]->id = i;
+        client->conns[i]->thread = priskv_threadpool_get_iothread(client->pool, i);
+
+        priskv_thread_add_event_handler(client->conns[i]->thread, client->conns[i]->epollfd);
+    }
+
+    client->cur_conn = 0;
+
+    return 0;
+}
+
+static void priskv_mq_deinit(priskv_client *client)
+{
+    if (client->conns) {
+        for (int i = 0; i < client->nqueue; i++) {
+            priskv_thread_call_function(priskv_threadpool_get_iothread(client->pool, i),
+                                      priskv_conn_close, client->conns[i]);
+        }
+    }
+
+    priskv_threadpool_destroy(client->pool);
+    priskv_workqueue_destroy(client->wq);
+    free(client->conns);
+}
+
+static priskv_rdma_conn *priskv_mq_select_conn(priskv_client *client)
+{
+    return client->conns[client->cur_conn++ % client->nqueue];
+}
+
+static priskv_memory *priskv_mq_reg_memory(priskv_client *client, uint64_t offset, size_t length,
+                                       uint64_t iova, int fd)
+{
+    priskv_memory *mem = malloc(sizeof(priskv_memory));
+
+    mem->client = client;
+    mem->count = client->nqueue;
+    mem->mrs = malloc(client->nqueue * sizeof(struct ibv_mr *));
+
+    for (int i = 0; i < mem->count; i++) {
+        mem->mrs[i] = priskv_conn_reg_memory(client->conns[i], offset, length, iova, fd);
+    }
+
+    return mem;
+}
+
+static void priskv_mq_dereg_memory(priskv_memory *mem)
+{
+    for (int i = 0; i < mem->count; i++) {
+        priskv_conn_dereg_memory(mem->mrs[i]);
+    }
+    free(mem->mrs);
+    free(mem);
+}
+
+static struct ibv_mr *priskv_mq_get_mr(priskv_memory *mem, int connid)
+{
+    return mem->mrs[connid];
+}
+
+static void priskv_mq_rdma_req_submit(priskv_rdma_req *rdma_req)
+{
+    priskv_thread_submit_function(rdma_req->conn->thread, priskv_rdma_req_send, rdma_req);
+}
+
+static void priskv_mq_rdma_req_cb(priskv_rdma_req *rdma_req)
+{
+    priskv_workqueue_submit(rdma_req->main_wq, _priskv_rdma_req_cb, rdma_req);
+}
+
+static priskv_conn_operation priskv_mq_ops = {
+    .init = priskv_mq_init,
+    .deinit = priskv_mq_deinit,
+    .select_conn = priskv_mq_select_conn,
+    .reg_memory = priskv_mq_reg_memory,
+    .dereg_memory = priskv_mq_dereg_memory,
+    .get_mr = priskv_mq_get_mr,
+    .rdma_req_submit = priskv_mq_rdma_req_submit,
+    .rdma_req_cb = priskv_mq_rdma_req_cb,
+};
+
+static int priskv_sq_init(priskv_client *client, const char *raddr, int rport, const char *laddr,
+                        int lport, int nqueue)
+{
+    client->conns = calloc(1, sizeof(priskv_rdma_conn *));
+    if (!client->conns) {
+        priskv_log_error("RDMA: failed to allocate memory for connections\n");
+        return -1;
+    }
+
+    client->conns[0] = priskv_client_connect_conn(client, raddr, rport, laddr, lport);
+    if (!client->conns[0]) {
+        priskv_log_error("RDMA: failed to connect to %s:%d\n", raddr, rport);
+        return -1;
     }
 
     priskv_add_event_fd(client->epollfd, client->conns[0]->epollfd);
@@ -1157,21 +1821,43 @@ static priskv_conn_operation priskv_sq_ops = {
     .rdma_req_cb = priskv_sq_rdma_req_cb,
 };
 
-priskv_client *priskv_connect(const char *raddr, int rport, const char *laddr, int lport, int nqueue)
+/* the inline value slots are sized at connect, so the size a client asks for comes from env */
+static uint16_t priskv_env_max_inline_value(void)
 {
-    priskv_client *client = NULL;
+    const char *env = getenv("PRISKV_MAX_INLINE_VALUE");
+    int64_t val;
 
-    if (lport && nqueue > 1) {
-        priskv_log_error("RDMA: unable to bind local port when queues > 1\n");
-        return NULL;
+    if (!env) {
+        return 0;
     }
 
-    client = calloc(sizeof(priskv_client), 1);
-    if (!client) {
-        priskv_log_error("RDMA: failed to allocate memory for client\n");
+    if (priskv_str2num(env, &val) || val < 0 || val > UINT16_MAX) {
+        priskv_log_warn("RDMA: invalid PRISKV_MAX_INLINE_VALUE %s, inline value disabled\n", env);
+        return 0;
+    }
+
+    return val;
+}
+
+static priskv_client *__priskv_connect(const char *raddr, int rport, const char *laddr, int lport,
+                                       int nqueue, bool tcp)
+{
+    priskv_client *client = NULL;
+
+    if (lport && nqueue > 1) {
+        priskv_log_error("RDMA: unable to bind local port when queues > 1\n");
         return NULL;
     }
 
+    client = calloc(sizeof(priskv_client), 1);
+    if (!client) {
+        priskv_log_error("RDMA: failed to allocate memory for client\n");
+        return NULL;
+    }
+
+    client->tcp = tcp;
+    client->trace_sample = PRISKV_DEFAULT_TRACE_SAMPLE;
+    client->max_inline_value = priskv_env_max_inline_value();
     client->epollfd = epoll_create1(0);
     if (client->epollfd < 0) {
         priskv_log_error("RDMA: failed to create epoll fd\n");
@@ -1199,6 +1885,17 @@ err:
     return NULL;
 }
 
+priskv_client *priskv_connect(const char *raddr, int rport, const char *laddr, int lport, int nqueue)
+{
+    return __priskv_connect(raddr, rport, laddr, lport, nqueue, false);
+}
+
+priskv_client *priskv_connect_tcp(const char *raddr, int rport, const char *laddr, int lport,
+                                  int nqueue)
+{
+    return __priskv_connect(raddr, rport, laddr, lport, nqueue, true);
+}
+
 void priskv_close(priskv_client *client)
 {
 
@@ -1230,11 +1927,24 @@ static inline void priskv_fillup_sql(priskv_rdma_req *rdma_req, priskv_keyed_sgl
 
     for (uint16_t i = 0; i < rdma_req->nsgl; i++) {
         priskv_sgl_private *_sgl = &rdma_req->sgl[i];
+        priskv_keyed_sgl *_keyed_sgl = &keyed_sgl[i];
         struct ibv_mr *mr;
 
+        /* inline GET and TCP: the SGLs only describe the expected length, no MR required */
+        if (rdma_req->inlined || (conn->sockfd >= 0)) {
+            _keyed_sgl->addr = htobe64(_sgl->sgl.iova);
+            _keyed_sgl->length = htobe32(_sgl->sgl.length);
+            _keyed_sgl->key = 0;
+            continue;
+        }
+
         if (!_sgl->sgl.mem) {
-            mr = _sgl->mr =
-                priskv_conn_reg_memory(conn, _sgl->sgl.iova, _sgl->sgl.length, _sgl->sgl.iova, -1);
+            /* a resent request has registered already */
+            if (!_sgl->mr) {
+                _sgl->mr = priskv_conn_reg_memory(conn, _sgl->sgl.iova, _sgl->sgl.length,
+                                                  _sgl->sgl.iova, -1);
+            }
+            mr = _sgl->mr;
         } else {
             if (rdma_req->cmd != PRISKV_COMMAND_KEYS) {
                 mr = rdma_req->ops->get_mr(_sgl->sgl.mem, conn->id);
@@ -1243,8 +1953,6 @@ static inline void priskv_fillup_sql(priskv_rdma_req *rdma_req, priskv_keyed_sgl
             }
         }
 
-        priskv_keyed_sgl *_keyed_sgl = &keyed_sgl[i];
-
         _keyed_sgl->addr = htobe64(_sgl->sgl.iova);
         _keyed_sgl->length = htobe32(_sgl->sgl.length);
         _keyed_sgl->key = htobe32(mr->rkey);
@@ -1254,6 +1962,71 @@ static inline void priskv_fillup_sql(priskv_rdma_req *rdma_req, priskv_keyed_sgl
     }
 }
 
+/* build RDMA WRITE WRs of one-sided SET into the reserved SGLs, return the count of WRs */
+static int priskv_rdma_req_fill_writes(priskv_rdma_req *rdma_req, struct ibv_send_wr *wrs,
+                                       struct ibv_sge *sges)
+{
+    priskv_rdma_conn *conn = rdma_req->conn;
+    uint16_t r = 0;
+    uint32_t roff = 0;
+    int n = 0;
+
+    for (uint16_t i = 0; i < rdma_req->nsgl; i++) {
+        priskv_sgl_private *_sgl = &rdma_req->sgl[i];
+        struct ibv_mr *mr = _sgl->mr ? _sgl->mr : rdma_req->ops->get_mr(_sgl->sgl.mem, conn->id);
+        uint32_t loff = 0;
+
+        while (loff < _sgl->sgl.length && r < rdma_req->nremote) {
+            priskv_keyed_sgl *remote = &rdma_req->remote[r];
+            uint32_t len = priskv_min_u32(_sgl->sgl.length - loff, remote->length - roff);
+
+            assert(n < conn->max_write_wr);
+            sges[n].addr = _sgl->sgl.iova + loff;
+            sges[n].length = len;
+            sges[n].lkey = mr->lkey;
+
+            memset(&wrs[n], 0x00, sizeof(struct ibv_send_wr));
+            wrs[n].sg_list = &sges[n];
+            wrs[n].num_sge = 1;
+            wrs[n].opcode = IBV_WR_RDMA_WRITE;
+            wrs[n].wr.rdma.remote_addr = remote->addr + roff;
+            wrs[n].wr.rdma.rkey = remote->key;
+            wrs[n].next = &wrs[n + 1];
+            n++;
+
+            loff += len;
+            roff += len;
+            if (roff == remote->length) {
+                r++;
+                roff = 0;
+            }
+        }
+    }
+
+    return n;
+}
+
+/* copy between @buf and the SGLs of an inline request, return the copied length */
+static uint32_t priskv_rdma_req_copy_inline(priskv_rdma_req *rdma_req, uint8_t *buf, uint32_t len,
+                                          bool to_sgl)
+{
+    uint32_t offset = 0;
+
+    for (uint16_t i = 0; i < rdma_req->nsgl && offset < len; i++) {
+        priskv_sgl *sgl = &rdma_req->sgl[i].sgl;
+        uint32_t copylen = priskv_min_u32(sgl->length, len - offset);
+
+        if (to_sgl) {
+            memcpy((void *)sgl->iova, buf + offset, copylen);
+        } else {
+            memcpy(buf + offset, (void *)sgl->iova, copylen);
+        }
+        offset += copylen;
+    }
+
+    return offset;
+}
+
 static int _priskv_rdma_req_cb(void *arg)
 {
     priskv_rdma_req *rdma_req = arg;
@@ -1272,6 +2045,24 @@ static void priskv_rdma_req_cb(priskv_rdma_req *rdma_req)
     rdma_req->ops->rdma_req_cb(rdma_req);
 }
 
+/* one-sided SET goes on with COMMIT after RESERVE, or falls back to SET on old servers */
+static void priskv_rdma_write_set_cb(priskv_rdma_req *rdma_req)
+{
+    if (rdma_req->phase == PRISKV_RDMA_REQ_PHASE_RESERVE) {
+        uint16_t status = rdma_req->status;
+
+        if ((status == PRISKV_STATUS_OK) || (status == PRISKV_STATUS_NO_SUCH_COMMAND)) {
+            priskv_rdma_req_reset(rdma_req);
+            rdma_req->phase = (status == PRISKV_STATUS_OK) ? PRISKV_RDMA_REQ_PHASE_COMMIT
+                                                           : PRISKV_RDMA_REQ_PHASE_NONE;
+            priskv_rdma_req_send(rdma_req);
+            return;
+        }
+    }
+
+    priskv_rdma_req_cb(rdma_req);
+}
+
 static void priskv_rdma_keys_req_cb(priskv_rdma_req *rdma_req)
 {
     priskv_rdma_conn *conn = rdma_req->conn;
@@ -1427,6 +2218,204 @@ static inline void priskv_rdma_req_reset(priskv_rdma_req *rdma_req)
     rdma_req->status = PRISKV_STATUS_OK;
     rdma_req->length = 0;
     rdma_req->delaying = false;
+    rdma_req->inlined = false;
+}
+
+static inline priskv_index_entry *priskv_rdma_req_entries(priskv_rdma_req *rdma_req)
+{
+    priskv_rdma_mem *rmem = &rdma_req->conn->rmem[PRISKV_RDMA_MEM_INDEX];
+
+    return (priskv_index_entry *)rmem->buf + 2 * rdma_req->req_idx;
+}
+
+/* one-sided GET goes on with two-sided GET, on any inconsistency or unsupported value */
+static void priskv_rdma_req_read_fallback(priskv_rdma_req *rdma_req)
+{
+    bool inlined = rdma_req->inlined;
+
+    priskv_request_free(rdma_req->req, rdma_req->conn);
+    priskv_rdma_req_reset(rdma_req);
+    rdma_req->inlined = inlined;
+    rdma_req->phase = PRISKV_RDMA_REQ_PHASE_NONE;
+    priskv_rdma_req_send(rdma_req);
+}
+
+/* the one-sided GET fails without fallback, the QP is broken */
+static void priskv_rdma_req_read_error(priskv_rdma_req *rdma_req)
+{
+    priskv_request_free(rdma_req->req, rdma_req->conn);
+    rdma_req->status = PRISKV_STATUS_RDMA_ERROR;
+    rdma_req->cb(rdma_req);
+}
+
+static int priskv_rdma_req_read_index(priskv_rdma_req *rdma_req)
+{
+    priskv_rdma_conn *conn = rdma_req->conn;
+    priskv_index_entry *entries = priskv_rdma_req_entries(rdma_req);
+    uint64_t keyhash = priskv_index_keyhash((uint8_t *)rdma_req->key, rdma_req->keylen);
+    struct ibv_send_wr wr = {0}, *bad_wr;
+    struct ibv_sge sge;
+
+    sge.addr = (uint64_t)&entries[0];
+    sge.length = sizeof(priskv_index_entry);
+    sge.lkey = conn->rmem[PRISKV_RDMA_MEM_INDEX].mr->lkey;
+
+    wr.wr_id = (uint64_t)rdma_req;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr =
+        conn->index.entries_addr + (keyhash % conn->index.nentries) * sizeof(priskv_index_entry);
+    wr.wr.rdma.rkey = conn->index.entries_rkey;
+    if (ibv_post_send(conn->qp, &wr, &bad_wr)) {
+        priskv_log_error("RDMA: ibv_post_send index entry failed: %m\n");
+        priskv_rdma_req_read_error(rdma_req);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* build RDMA READ WRs of one-sided GET into the local SGLs, return the count of WRs, or -1 if the
+ * WRs exceed the limitation */
+static int priskv_rdma_req_fill_reads(priskv_rdma_req *rdma_req, uint64_t value_off,
+                                      uint32_t valuelen, struct ibv_send_wr *wrs,
+                                      struct ibv_sge *sges)
+{
+    priskv_rdma_conn *conn = rdma_req->conn;
+    uint32_t roff = 0;
+    int n = 0;
+
+    for (uint16_t i = 0; i < rdma_req->nsgl && roff < valuelen; i++) {
+        priskv_sgl_private *_sgl = &rdma_req->sgl[i];
+        struct ibv_mr *mr;
+        uint32_t loff = 0;
+
+        if (_sgl->sgl.mem) {
+            mr = rdma_req->ops->get_mr(_sgl->sgl.mem, conn->id);
+        } else {
+            if (!_sgl->mr) {
+                _sgl->mr = priskv_conn_reg_memory(conn, _sgl->sgl.iova, _sgl->sgl.length,
+                                                  _sgl->sgl.iova, -1);
+            }
+            mr = _sgl->mr;
+        }
+
+        if (!mr) {
+            return -1;
+        }
+
+        while (loff < _sgl->sgl.length && roff < valuelen) {
+            uint64_t off = value_off + roff;
+            uint32_t seg = off / conn->index.seg_size;
+            uint64_t seg_left = (uint64_t)(seg + 1) * conn->index.seg_size - off;
+            uint32_t len = priskv_min_u32(_sgl->sgl.length - loff, valuelen - roff);
+
+            len = priskv_min_u64(len, seg_left);
+            if (n == conn->max_write_wr) {
+                return -1;
+            }
+
+            sges[n].addr = _sgl->sgl.iova + loff;
+            sges[n].length = len;
+            sges[n].lkey = mr->lkey;
+
+            memset(&wrs[n], 0x00, sizeof(struct ibv_send_wr));
+            wrs[n].sg_list = &sges[n];
+            wrs[n].num_sge = 1;
+            wrs[n].opcode = IBV_WR_RDMA_READ;
+            wrs[n].wr.rdma.remote_addr = conn->index.value_base + off;
+            wrs[n].wr.rdma.rkey = conn->index.seg_rkeys[seg];
+            wrs[n].next = &wrs[n + 1];
+            n++;
+
+            loff += len;
+            roff += len;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * the entry is read: READ the value and the entry again by a single post. The responder may
+ * execute the READs in any order, so the re-read of the entry is fenced to start after the value
+ * READs complete, an unchanged version then proves the value is not torn.
+ */
+static void priskv_rdma_req_read_value(priskv_rdma_req *rdma_req)
+{
+    priskv_rdma_conn *conn = rdma_req->conn;
+    priskv_index_entry *entries = priskv_rdma_req_entries(rdma_req);
+    priskv_index_entry *entry = &entries[0];
+    uint64_t keyhash = priskv_index_keyhash((uint8_t *)rdma_req->key, rdma_req->keylen);
+    uint64_t value_off = be64toh(entry->value_off);
+    uint32_t valuelen = be32toh(entry->valuelen);
+    struct ibv_send_wr wrs[PRISKV_RDMA_MAX_WRITE_WR + 1], *bad_wr;
+    struct ibv_sge sges[PRISKV_RDMA_MAX_WRITE_WR + 1];
+    uint64_t sgl_length = 0;
+    int n;
+
+    for (uint16_t i = 0; i < rdma_req->nsgl; i++) {
+        sgl_length += rdma_req->sgl[i].sgl.length;
+    }
+
+    if ((be64toh(entry->version) & 1) || (be64toh(entry->keyhash) != keyhash) ||
+        (be16toh(entry->keylen) != rdma_req->keylen) || !valuelen || (valuelen > sgl_length) ||
+        (value_off + valuelen > conn->index.nsegs * conn->index.seg_size)) {
+        priskv_rdma_req_read_fallback(rdma_req);
+        return;
+    }
+
+    n = priskv_rdma_req_fill_reads(rdma_req, value_off, valuelen, wrs, sges);
+    if (n <= 0) {
+        priskv_rdma_req_read_fallback(rdma_req);
+        return;
+    }
+
+    sges[n].addr = (uint64_t)&entries[1];
+    sges[n].length = sizeof(priskv_index_entry);
+    sges[n].lkey = conn->rmem[PRISKV_RDMA_MEM_INDEX].mr->lkey;
+
+    memset(&wrs[n], 0x00, sizeof(struct ibv_send_wr));
+    wrs[n].wr_id = (uint64_t)rdma_req;
+    wrs[n].sg_list = &sges[n];
+    wrs[n].num_sge = 1;
+    wrs[n].opcode = IBV_WR_RDMA_READ;
+    wrs[n].send_flags = IBV_SEND_SIGNALED | IBV_SEND_FENCE;
+    wrs[n].wr.rdma.remote_addr =
+        conn->index.entries_addr + (keyhash % conn->index.nentries) * sizeof(priskv_index_entry);
+    wrs[n].wr.rdma.rkey = conn->index.entries_rkey;
+    wrs[n].next = NULL;
+
+    rdma_req->phase = PRISKV_RDMA_REQ_PHASE_VALUE;
+    rdma_req->length = valuelen;
+    if (ibv_post_send(conn->qp, wrs, &bad_wr)) {
+        priskv_log_error("RDMA: ibv_post_send value READ failed: %m\n");
+        priskv_rdma_req_read_error(rdma_req);
+    }
+}
+
+static void priskv_rdma_handle_read(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req)
+{
+    priskv_index_entry *entries = priskv_rdma_req_entries(rdma_req);
+
+    if (rdma_req->phase == PRISKV_RDMA_REQ_PHASE_INDEX) {
+        priskv_rdma_req_read_value(rdma_req);
+        return;
+    }
+
+    assert(rdma_req->phase == PRISKV_RDMA_REQ_PHASE_VALUE);
+    if (entries[0].version != entries[1].version) {
+        priskv_rdma_req_read_fallback(rdma_req);
+        return;
+    }
+
+    rdma_req->status = PRISKV_STATUS_OK;
+    rdma_req->result = &rdma_req->length;
+    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_DONE;
+    conn->stats[PRISKV_COMMAND_GET]++;
+    priskv_rdma_req_done(conn, rdma_req);
 }
 
 static int priskv_rdma_req_send(void *arg)
@@ -1445,156 +2434,620 @@ static int priskv_rdma_req_send(void *arg)
         return -1;
     }
 
-    if (rdma_req->cmd == PRISKV_COMMAND_KEYS) {
-        if (conn->keys_running_req && conn->keys_running_req != rdma_req) {
-            rdma_req->status = PRISKV_STATUS_BUSY;
-            rdma_req->cb(rdma_req);
-            return -1;
-        } else {
-            conn->keys_running_req = rdma_req;
-        }
+    if (rdma_req->cmd == PRISKV_COMMAND_KEYS) {
+        if (conn->keys_running_req && conn->keys_running_req != rdma_req) {
+            rdma_req->status = PRISKV_STATUS_BUSY;
+            rdma_req->cb(rdma_req);
+            return -1;
+        } else {
+            conn->keys_running_req = rdma_req;
+        }
+    }
+
+    priskv_req_command cmd = rdma_req->cmd;
+    if (rdma_req->phase == PRISKV_RDMA_REQ_PHASE_RESERVE) {
+        cmd = PRISKV_COMMAND_RESERVE;
+    } else if (rdma_req->phase == PRISKV_RDMA_REQ_PHASE_COMMIT) {
+        cmd = PRISKV_COMMAND_COMMIT;
+    }
+
+    /* the server grants less credits than @max_inflight_command on its backlog */
+    if (conn->credits && (priskv_slots_inuse(&conn->req_slots) >= conn->credits)) {
+        req = NULL;
+    } else {
+        req = priskv_rdma_unused_command(conn, &req_idx);
+    }
+    if (!req) {
+        if (rdma_req->delaying) {
+            list_add(&conn->inflight_list, &rdma_req->entry);
+        } else {
+            list_add_tail(&conn->inflight_list, &rdma_req->entry);
+            rdma_req->delaying = true;
+        }
+        return EAGAIN;
+    }
+
+    rdma_req->req_idx = req_idx;
+    if (rdma_req->phase == PRISKV_RDMA_REQ_PHASE_INDEX) {
+        /* the request buffer is unused, but holds a slot of inflight command */
+        req->request_id = htobe64((uint64_t)rdma_req);
+        rdma_req->req = req;
+        return priskv_rdma_req_read_index(rdma_req);
+    }
+
+    char key_short[16] = {0};
+    priskv_string_shorten(rdma_req->key, rdma_req->keylen, key_short, sizeof(key_short));
+
+    priskv_log_debug(
+        "RDMA: Request command length %u, request_id 0x%lx, %s[0x%x], nsgl %u, key[%u] %s\n",
+        rsge.length, rdma_req->request_id, priskv_command_str(cmd), cmd, rdma_req->nsgl,
+        rdma_req->keylen, key_short);
+
+    /* inline SET carries the value following the key instead of SGLs, COMMIT carries the token */
+    uint16_t nsgl = rdma_req->nsgl;
+    if (rdma_req->inlined && rdma_req->cmd == PRISKV_COMMAND_SET) {
+        nsgl = 0;
+    } else if (cmd == PRISKV_COMMAND_COMMIT) {
+        nsgl = 1;
+    }
+
+    req->request_id = htobe64((uint64_t)rdma_req);
+    req->command = htobe16(cmd);
+    req->flags = rdma_req->inlined ? PRISKV_REQUEST_FLAG_INLINE : 0;
+    req->flags |= rdma_req->traced ? PRISKV_REQUEST_FLAG_TRACE : 0;
+    req->flags |= rdma_req->range ? PRISKV_REQUEST_FLAG_RANGE : 0;
+    req->flags |= rdma_req->cond;
+    if (rdma_req->cond & PRISKV_REQUEST_FLAG_VERSION) {
+        req->version = htobe64(rdma_req->version);
+    } else {
+        req->offset = htobe64(rdma_req->offset);
+    }
+    req->priority = rdma_req->priority;
+    req->nsgl = htobe16(nsgl);
+    req->timeout = htobe64(rdma_req->timeout);
+    req->key_length = htobe16(rdma_req->keylen);
+
+    uint32_t inline_len = 0;
+    if (cmd == PRISKV_COMMAND_COMMIT) {
+        uint32_t valuelen = 0;
+
+        for (uint16_t i = 0; i < rdma_req->nremote; i++) {
+            valuelen += rdma_req->remote[i].length;
+        }
+        req->sgls[0].addr = htobe64(rdma_req->token);
+        req->sgls[0].length = htobe32(valuelen);
+        req->sgls[0].key = 0;
+    } else if (nsgl) {
+        priskv_fillup_sql(rdma_req, req->sgls);
+    } else if (rdma_req->nsgl) {
+        uint8_t *inline_val = priskv_request_inline_value(req, nsgl, rdma_req->keylen);
+        inline_len = priskv_rdma_req_copy_inline(rdma_req, inline_val,
+                                                 conn->param.max_inline_value, false);
+    }
+    memcpy(priskv_request_key(req, nsgl), rdma_req->key, rdma_req->keylen);
+
+    /* the trace ends the message, the value of SET follows it on TCP */
+    uint32_t length = priskv_request_size(nsgl, rdma_req->keylen) + inline_len;
+    if (rdma_req->traced) {
+        priskv_request_trace trace = {0};
+
+        priskv_request_trace_stamp(&trace.client_metadata_send);
+        memcpy((uint8_t *)req + length, &trace, sizeof(trace));
+        length += sizeof(trace);
+    }
+
+    rdma_req->req = req;
+
+    if (conn->sockfd >= 0) {
+        return priskv_tcp_req_post(conn, rdma_req, length);
+    }
+
+    rsge.addr = (uint64_t)req;
+    rsge.length = length;
+    rsge.lkey = rmem->mr->lkey;
+
+    wr.wr_id = (uint64_t)req;
+    wr.sg_list = &rsge;
+    wr.num_sge = 1;
+    wr.opcode = IBV_WR_SEND;
+    wr.send_flags = IBV_SEND_SIGNALED; /* MLX needs a SIGNALED to kick SQ */
+    if (rsge.length <= conn->max_inline_data) {
+        wr.send_flags |= IBV_SEND_INLINE;
+    }
+
+    /* RDMA WRITEs of one-sided SET precede the COMMIT, unsignaled */
+    struct ibv_send_wr *first_wr = &wr;
+    struct ibv_send_wr write_wrs[PRISKV_RDMA_MAX_WRITE_WR + 1];
+    struct ibv_sge write_sges[PRISKV_RDMA_MAX_WRITE_WR];
+    if (cmd == PRISKV_COMMAND_COMMIT) {
+        int nwrites = priskv_rdma_req_fill_writes(rdma_req, write_wrs, write_sges);
+        if (nwrites) {
+            write_wrs[nwrites - 1].next = &wr;
+            first_wr = write_wrs;
+        }
+    }
+
+    int ret = ibv_post_send(conn->qp, first_wr, &bad_wr);
+    if (ret) {
+        PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+        priskv_log_notice("RDMA: <%s - %s> close. Requests GET %ld, SET %ld, TEST %ld, DELETE %ld, "
+                        "Responses %ld\n",
+                        local_addr, peer_addr, conn->stats[PRISKV_COMMAND_GET],
+                        conn->stats[PRISKV_COMMAND_SET], conn->stats[PRISKV_COMMAND_TEST],
+                        conn->stats[PRISKV_COMMAND_DELETE], conn->resps);
+
+        priskv_log_error(
+            "RDMA: ibv_post_send addr %p, length %d. wc_recv %ld, wc_send %ld, failed: %d\n", req,
+            rsge.length, conn->wc_recv, conn->wc_send, ret);
+        rdma_req->status = PRISKV_STATUS_RDMA_ERROR;
+        rdma_req->cb(rdma_req);
+        return -1;
+    }
+
+    conn->stats[cmd]++;
+
+    return 0;
+}
+
+static inline void priskv_rdma_req_submit(priskv_rdma_req *rdma_req)
+{
+    rdma_req->ops->rdma_req_submit(rdma_req);
+}
+
+static inline void priskv_rdma_req_delay_send(priskv_rdma_conn *conn)
+{
+    priskv_rdma_req *rdma_req, *tmp;
+
+    list_for_each_safe (&conn->inflight_list, rdma_req, tmp, entry) {
+        list_del(&rdma_req->entry);
+
+        if (priskv_rdma_req_send(rdma_req) == EAGAIN) {
+            return;
+        }
+    }
+}
+
+static inline void priskv_rdma_req_done(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req)
+{
+    if ((rdma_req->flags & PRISKV_RDMA_REQ_FLAG_DONE) == PRISKV_RDMA_REQ_FLAG_DONE) {
+        list_add_tail(&conn->complete_list, &rdma_req->entry);
+    }
+}
+
+static inline void priskv_rdma_req_complete(priskv_rdma_conn *conn)
+{
+    priskv_rdma_req *rdma_req, *tmp;
+
+    list_for_each_safe (&conn->complete_list, rdma_req, tmp, entry) {
+        list_del(&rdma_req->entry);
+
+        priskv_request_free(rdma_req->req, conn);
+        rdma_req->cb(rdma_req);
+    }
+}
+
+static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_response *resp, uint32_t len)
+{
+    uint64_t request_id = be64toh(resp->request_id);
+    uint16_t status = be16toh(resp->status);
+    uint32_t length = be32toh(resp->length);
+    priskv_rdma_req *rdma_req;
+    uint32_t inline_len;
+
+    if (len < sizeof(priskv_response)) {
+        priskv_log_warn("RDMA: recv %d, expected %ld\n", len, sizeof(priskv_response));
+        return -EPROTO;
+    }
+
+    priskv_log_debug("Response request_id 0x%lx, status(%d) %s, length %d\n", request_id, status,
+                   priskv_resp_status_str(status), length);
+    rdma_req = (priskv_rdma_req *)request_id;
+    rdma_req->status = status;
+    rdma_req->length = length;
+    conn->credits = be16toh(resp->credits);
+
+    inline_len = len - sizeof(priskv_response);
+    if (rdma_req->phase == PRISKV_RDMA_REQ_PHASE_RESERVE && status == PRISKV_STATUS_OK) {
+        priskv_reserve_resp *rresp = (priskv_reserve_resp *)priskv_response_inline_value(resp);
+        uint16_t nremote = be16toh(rresp->nsgl);
+
+        if ((inline_len < sizeof(priskv_reserve_resp)) || !nremote ||
+            (nremote > PRISKV_RESERVE_MAX_SGL)) {
+            priskv_log_warn("RDMA: unexpected reserve response %d, nsgl %d\n", inline_len, nremote);
+            return -EPROTO;
+        }
+
+        rdma_req->token = be64toh(rresp->token);
+        rdma_req->nremote = nremote;
+        for (uint16_t i = 0; i < nremote; i++) {
+            rdma_req->remote[i].addr = be64toh(rresp->sgls[i].addr);
+            rdma_req->remote[i].length = be32toh(rresp->sgls[i].length);
+            rdma_req->remote[i].key = be32toh(rresp->sgls[i].key);
+        }
+    } else if (inline_len) {
+        if (!rdma_req->inlined || (rdma_req->cmd != PRISKV_COMMAND_GET) ||
+            (status != PRISKV_STATUS_OK) || (inline_len != length)) {
+            priskv_log_warn("RDMA: unexpected inline value %d, length %d, status %d\n", inline_len,
+                          length, status);
+            return -EPROTO;
+        }
+
+        priskv_rdma_req_copy_inline(rdma_req, priskv_response_inline_value(resp), inline_len, true);
+    }
+
+    if (rdma_req->cmd != PRISKV_COMMAND_KEYS) {
+        rdma_req->result = &rdma_req->length;
+    }
+
+    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_RECV;
+    priskv_rdma_req_done(conn, rdma_req);
+
+    conn->resps++;
+    priskv_rdma_recv_resp(conn, resp);
+
+    return 0;
+}
+
+static void priskv_rdma_handle_send(priskv_rdma_conn *conn, priskv_request *req)
+{
+    priskv_rdma_req *rdma_req = (priskv_rdma_req *)be64toh(req->request_id);
+
+    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_SEND;
+    priskv_rdma_req_done(conn, rdma_req);
+}
+
+static void priskv_tcp_disconnect(priskv_rdma_conn *conn)
+{
+    if (!conn->established) {
+        return;
+    }
+
+    priskv_log_error("TCP: <%s - %s> disconnected. Requests GET %ld, SET %ld, Responses %ld\n",
+                     conn->tcp.local_addr, conn->tcp.peer_addr, conn->stats[PRISKV_COMMAND_GET],
+                     conn->stats[PRISKV_COMMAND_SET], conn->resps);
+    conn->established = false;
+    epoll_ctl(conn->epollfd, EPOLL_CTL_DEL, conn->sockfd, NULL);
+    if (conn->tcp.shm) {
+        epoll_ctl(conn->epollfd, EPOLL_CTL_DEL, conn->tcp.kick, NULL);
+    }
+}
+
+static void priskv_shm_kick(priskv_rdma_conn *conn)
+{
+    uint64_t kick = 1;
+
+    if (write(conn->tcp.doorbell, &kick, sizeof(kick)) < 0) {
+        priskv_log_warn("TCP: <%s - %s> failed to kick server: %m\n", conn->tcp.local_addr,
+                        conn->tcp.peer_addr);
+    }
+}
+
+/* copy the staged requests into the request ring, wait for the server on a full ring */
+static void priskv_shm_flush(priskv_rdma_conn *conn)
+{
+    priskv_shm *shm = conn->tcp.shm;
+    uint64_t space, len;
+    bool produced = false;
+
+    while (conn->tcp.tx_sent < conn->tcp.tx_len) {
+        space = priskv_shm_writable(shm, PRISKV_SHM_RING_REQ);
+        if (!space) {
+            if (priskv_shm_wait_writable(shm, PRISKV_SHM_RING_REQ)) {
+                continue;
+            }
+            break;
+        }
+
+        len = priskv_min_u64(space, conn->tcp.tx_len - conn->tcp.tx_sent);
+        memcpy(priskv_shm_write_ptr(shm, PRISKV_SHM_RING_REQ), conn->tcp.tx_buf + conn->tcp.tx_sent,
+               len);
+        priskv_shm_produce(shm, PRISKV_SHM_RING_REQ, len);
+        conn->tcp.tx_sent += len;
+        produced = true;
+    }
+
+    if (conn->tcp.tx_sent == conn->tcp.tx_len) {
+        conn->tcp.tx_len = conn->tcp.tx_sent = 0;
+    }
+
+    if (produced && priskv_shm_kick_consumer(shm, PRISKV_SHM_RING_REQ)) {
+        priskv_shm_kick(conn);
     }
+}
 
-    req = priskv_rdma_unused_command(conn, &req_idx);
-    if (!req) {
-        if (rdma_req->delaying) {
-            list_add(&conn->inflight_list, &rdma_req->entry);
-        } else {
-            list_add_tail(&conn->inflight_list, &rdma_req->entry);
-            rdma_req->delaying = true;
+/* return 0 if all sent or the socket is full, negative error code on failure */
+static int priskv_tcp_flush(priskv_rdma_conn *conn)
+{
+    ssize_t n;
+
+    if (conn->tcp.shm) {
+        priskv_shm_flush(conn);
+        return 0;
+    }
+
+    while (conn->tcp.tx_sent < conn->tcp.tx_len) {
+        n = send(conn->sockfd, conn->tcp.tx_buf + conn->tcp.tx_sent,
+                 conn->tcp.tx_len - conn->tcp.tx_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                return 0;
+            }
+
+            priskv_log_error("TCP: <%s - %s> send failed: %m\n", conn->tcp.local_addr,
+                             conn->tcp.peer_addr);
+            return -errno;
         }
-        return EAGAIN;
+
+        conn->tcp.tx_sent += n;
     }
 
-    char key_short[16] = {0};
-    priskv_string_shorten(rdma_req->key, rdma_req->keylen, key_short, sizeof(key_short));
+    conn->tcp.tx_len = conn->tcp.tx_sent = 0;
 
-    priskv_log_debug(
-        "RDMA: Request command length %u, request_id 0x%lx, %s[0x%x], nsgl %u, key[%u] %s\n",
-        rsge.length, rdma_req->request_id, priskv_command_str(rdma_req->cmd), rdma_req->cmd,
-        rdma_req->nsgl, rdma_req->keylen, key_short);
+    return 0;
+}
 
-    req->request_id = htobe64((uint64_t)rdma_req);
-    req->command = htobe16(rdma_req->cmd);
-    req->nsgl = htobe16(rdma_req->nsgl);
-    req->timeout = htobe64(rdma_req->timeout);
-    req->key_length = htobe16(rdma_req->keylen);
+static int priskv_tcp_append(priskv_rdma_conn *conn, uint32_t length)
+{
+    uint32_t cap = conn->tcp.tx_cap;
+    uint8_t *buf;
 
-    struct timeval client_metadata_send_time;
-    gettimeofday(&client_metadata_send_time, NULL);
-    req->runtime.client_metadata_send_time = client_metadata_send_time;
+    if (conn->tcp.tx_len + length <= cap) {
+        return 0;
+    }
 
-    priskv_fillup_sql(rdma_req, req->sgls);
-    memcpy(priskv_request_key(req, rdma_req->nsgl), rdma_req->key, rdma_req->keylen);
+    while (cap < conn->tcp.tx_len + length) {
+        cap = cap ? cap * 2 : PRISKV_TCP_RX_BUF_SIZE;
+    }
 
-    rdma_req->req = req;
+    buf = realloc(conn->tcp.tx_buf, cap);
+    if (!buf) {
+        return -ENOMEM;
+    }
 
-    rsge.addr = (uint64_t)req;
-    rsge.length = priskv_request_size(rdma_req->nsgl, rdma_req->keylen);
-    rsge.lkey = rmem->mr->lkey;
+    conn->tcp.tx_buf = buf;
+    conn->tcp.tx_cap = cap;
 
-    wr.wr_id = (uint64_t)req;
-    wr.sg_list = &rsge;
-    wr.num_sge = 1;
-    wr.opcode = IBV_WR_SEND;
-    wr.send_flags = IBV_SEND_SIGNALED; /* MLX needs a SIGNALED to kick SQ */
+    return 0;
+}
 
-    int ret = ibv_post_send(conn->qp, &wr, &bad_wr);
-    if (ret) {
-        PRISKV_RDMA_DEF_ADDR(conn->cm_id)
-        priskv_log_notice("RDMA: <%s - %s> close. Requests GET %ld, SET %ld, TEST %ld, DELETE %ld, "
-                        "Responses %ld\n",
-                        local_addr, peer_addr, conn->stats[PRISKV_COMMAND_GET],
-                        conn->stats[PRISKV_COMMAND_SET], conn->stats[PRISKV_COMMAND_TEST],
-                        conn->stats[PRISKV_COMMAND_DELETE], conn->resps);
+/* the request and the value of SET are copied into the stream, so SEND completes at once */
+static int priskv_tcp_req_post(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req, uint32_t length)
+{
+    priskv_shm *shm = conn->tcp.shm;
+    uint32_t valuelen = 0;
+    uint8_t *buf;
 
-        priskv_log_error(
-            "RDMA: ibv_post_send addr %p, length %d. wc_recv %ld, wc_send %ld, failed: %d\n", req,
-            rsge.length, conn->wc_recv, conn->wc_send, ret);
-        rdma_req->status = PRISKV_STATUS_RDMA_ERROR;
+    if (rdma_req->cmd == PRISKV_COMMAND_SET) {
+        for (uint16_t i = 0; i < rdma_req->nsgl; i++) {
+            valuelen += rdma_req->sgl[i].sgl.length;
+        }
+    }
+
+    /* nothing staged ahead, copy the value into the request ring directly */
+    if (shm && !conn->tcp.tx_len &&
+        (priskv_shm_writable(shm, PRISKV_SHM_RING_REQ) >= length + valuelen)) {
+        buf = priskv_shm_write_ptr(shm, PRISKV_SHM_RING_REQ);
+        memcpy(buf, rdma_req->req, length);
+        priskv_rdma_req_copy_inline(rdma_req, buf + length, valuelen, false);
+        priskv_shm_produce(shm, PRISKV_SHM_RING_REQ, length + valuelen);
+        if (priskv_shm_kick_consumer(shm, PRISKV_SHM_RING_REQ)) {
+            priskv_shm_kick(conn);
+        }
+
+        conn->stats[rdma_req->cmd]++;
+        rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_SEND;
+        return 0;
+    }
+
+    if (priskv_tcp_append(conn, length + valuelen)) {
+        priskv_request_free(rdma_req->req, conn);
+        rdma_req->status = PRISKV_STATUS_NO_MEM;
         rdma_req->cb(rdma_req);
         return -1;
     }
 
+    memcpy(conn->tcp.tx_buf + conn->tcp.tx_len, rdma_req->req, length);
+    conn->tcp.tx_len += length;
+    conn->tcp.tx_len +=
+        priskv_rdma_req_copy_inline(rdma_req, conn->tcp.tx_buf + conn->tcp.tx_len, valuelen, false);
+
     conn->stats[rdma_req->cmd]++;
+    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_SEND;
+
+    if (priskv_tcp_flush(conn)) {
+        priskv_tcp_disconnect(conn);
+    }
 
     return 0;
 }
 
-static inline void priskv_rdma_req_submit(priskv_rdma_req *rdma_req)
+static void priskv_tcp_handle_out(int fd, void *opaque, uint32_t ev)
 {
-    rdma_req->ops->rdma_req_submit(rdma_req);
+    priskv_rdma_conn *conn = opaque;
+
+    if (conn->established && priskv_tcp_flush(conn)) {
+        priskv_tcp_disconnect(conn);
+    }
 }
 
-static inline void priskv_rdma_req_delay_send(priskv_rdma_conn *conn)
+/* copy a piece of value at @offset into the SGLs of @rdma_req */
+static void priskv_tcp_copy_to_sgl(priskv_rdma_req *rdma_req, uint32_t offset, uint8_t *buf,
+                                   uint32_t len)
 {
-    priskv_rdma_req *rdma_req, *tmp;
+    for (uint16_t i = 0; i < rdma_req->nsgl && len; i++) {
+        priskv_sgl *sgl = &rdma_req->sgl[i].sgl;
+        uint32_t copylen;
 
-    list_for_each_safe (&conn->inflight_list, rdma_req, tmp, entry) {
-        list_del(&rdma_req->entry);
-
-        if (priskv_rdma_req_send(rdma_req) == EAGAIN) {
-            return;
+        if (offset >= sgl->length) {
+            offset -= sgl->length;
+            continue;
         }
+
+        copylen = priskv_min_u32(sgl->length - offset, len);
+        memcpy((uint8_t *)sgl->iova + offset, buf, copylen);
+        buf += copylen;
+        len -= copylen;
+        offset = 0;
     }
 }
 
-static inline void priskv_rdma_req_done(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req)
+static void priskv_tcp_req_recv(priskv_rdma_conn *conn, priskv_rdma_req *rdma_req)
 {
-    if ((rdma_req->flags & PRISKV_RDMA_REQ_FLAG_DONE) == PRISKV_RDMA_REQ_FLAG_DONE) {
-        list_add_tail(&conn->complete_list, &rdma_req->entry);
+    if (rdma_req->cmd != PRISKV_COMMAND_KEYS) {
+        rdma_req->result = &rdma_req->length;
     }
+
+    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_RECV;
+    priskv_rdma_req_done(conn, rdma_req);
+    conn->resps++;
 }
 
-static inline void priskv_rdma_req_complete(priskv_rdma_conn *conn)
+/* consume the received data, return the consumed bytes, 0 if more data needed */
+static uint32_t priskv_tcp_consume(priskv_rdma_conn *conn, uint8_t *buf, uint32_t len)
 {
-    priskv_rdma_req *rdma_req, *tmp;
+    priskv_rdma_req *rdma_req = conn->tcp.rx_req;
+    priskv_response *resp;
+    uint32_t copylen;
+
+    if (rdma_req) {
+        copylen = priskv_min_u32(len, conn->tcp.rx_valuelen - conn->tcp.rx_off);
+        priskv_tcp_copy_to_sgl(rdma_req, conn->tcp.rx_off, buf, copylen);
+        conn->tcp.rx_off += copylen;
+        if (conn->tcp.rx_off == conn->tcp.rx_valuelen) {
+            conn->tcp.rx_req = NULL;
+            priskv_tcp_req_recv(conn, rdma_req);
+        }
 
-    list_for_each_safe (&conn->complete_list, rdma_req, tmp, entry) {
-        list_del(&rdma_req->entry);
+        return copylen;
+    }
 
-        priskv_request_free(rdma_req->req, conn);
-        rdma_req->cb(rdma_req);
+    if (len < sizeof(priskv_response)) {
+        return 0;
+    }
+
+    resp = (priskv_response *)buf;
+    rdma_req = (priskv_rdma_req *)be64toh(resp->request_id);
+    rdma_req->status = be16toh(resp->status);
+    rdma_req->length = be32toh(resp->length);
+    conn->credits = be16toh(resp->credits);
+    priskv_log_debug("Response request_id 0x%lx, status(%d) %s, length %d\n",
+                     be64toh(resp->request_id), rdma_req->status,
+                     priskv_resp_status_str(rdma_req->status), rdma_req->length);
+
+    /* the value of GET/KEYS follows the response on success */
+    if ((rdma_req->status == PRISKV_STATUS_OK) && rdma_req->length &&
+        ((rdma_req->cmd == PRISKV_COMMAND_GET) || (rdma_req->cmd == PRISKV_COMMAND_KEYS))) {
+        conn->tcp.rx_req = rdma_req;
+        conn->tcp.rx_valuelen = rdma_req->length;
+        conn->tcp.rx_off = 0;
+    } else {
+        priskv_tcp_req_recv(conn, rdma_req);
     }
+
+    return sizeof(priskv_response);
 }
 
-static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_response *resp, uint32_t len)
+static void priskv_tcp_handle_in(int fd, void *opaque, uint32_t ev)
 {
-    uint64_t request_id = be64toh(resp->request_id);
-    uint16_t status = be16toh(resp->status);
-    uint32_t length = be32toh(resp->length);
-    priskv_rdma_req *rdma_req;
+    priskv_rdma_conn *conn = opaque;
+    uint32_t off, consumed;
+    ssize_t n;
+
+    while (conn->established) {
+        n = recv(conn->sockfd, conn->tcp.rx_buf + conn->tcp.rx_len,
+                 PRISKV_TCP_RX_BUF_SIZE - conn->tcp.rx_len, MSG_DONTWAIT);
+        if (n <= 0) {
+            if ((n < 0) && (errno == EAGAIN)) {
+                break;
+            }
 
-    if (len != sizeof(priskv_response)) {
-        priskv_log_warn("RDMA: recv %d, expected %ld\n", len, sizeof(priskv_response));
-        return -EPROTO;
+            priskv_tcp_disconnect(conn);
+            break;
+        }
+
+        conn->tcp.rx_len += n;
+        off = 0;
+        while ((consumed = priskv_tcp_consume(conn, conn->tcp.rx_buf + off,
+                                              conn->tcp.rx_len - off))) {
+            off += consumed;
+        }
+
+        conn->tcp.rx_len -= off;
+        memmove(conn->tcp.rx_buf, conn->tcp.rx_buf + off, conn->tcp.rx_len);
     }
 
-    priskv_log_debug("Response request_id 0x%lx, status(%d) %s, length %d\n", request_id, status,
-                   priskv_resp_status_str(status), length);
-    rdma_req = (priskv_rdma_req *)request_id;
-    rdma_req->status = status;
-    rdma_req->length = length;
+    priskv_rdma_req_complete(conn);
+    priskv_rdma_req_delay_send(conn);
+}
 
-    if (rdma_req->cmd != PRISKV_COMMAND_KEYS) {
-        rdma_req->result = &rdma_req->length;
+/* the server produced responses, or consumed requests of a full ring */
+static void priskv_shm_handle_kick(int fd, void *opaque, uint32_t ev)
+{
+    priskv_rdma_conn *conn = opaque;
+    priskv_shm *shm = conn->tcp.shm;
+    uint64_t kick, len, off;
+    uint32_t consumed;
+    uint8_t *buf;
+
+    while (read(fd, &kick, sizeof(kick)) > 0) {
+        ;
     }
 
-    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_RECV;
-    priskv_rdma_req_done(conn, rdma_req);
+    if (!conn->established) {
+        return;
+    }
 
-    conn->resps++;
-    priskv_rdma_recv_resp(conn, resp);
+    priskv_shm_flush(conn);
+    for (;;) {
+        /* the value is copied out of the ring into the SGLs by a single memcpy */
+        len = priskv_min_u64(priskv_shm_readable(shm, PRISKV_SHM_RING_RESP), UINT32_MAX);
+        buf = priskv_shm_read_ptr(shm, PRISKV_SHM_RING_RESP);
+        off = 0;
+        while ((consumed = priskv_tcp_consume(conn, buf + off, len - off))) {
+            off += consumed;
+        }
 
-    return 0;
+        if (off) {
+            priskv_shm_consume(shm, PRISKV_SHM_RING_RESP, off);
+            if (priskv_shm_kick_producer(shm, PRISKV_SHM_RING_RESP)) {
+                priskv_shm_kick(conn);
+            }
+            continue;
+        }
+
+        /* sleep until the server produces more */
+        if (!priskv_shm_wait_readable(shm, PRISKV_SHM_RING_RESP) ||
+            (priskv_shm_readable(shm, PRISKV_SHM_RING_RESP) == len)) {
+            break;
+        }
+    }
+
+    if (shm->broken) {
+        priskv_log_error("TCP: <%s - %s> invalid index of shm ring\n", conn->tcp.local_addr,
+                         conn->tcp.peer_addr);
+        priskv_tcp_disconnect(conn);
+        priskv_rdma_req_complete(conn);
+        return;
+    }
+
+    priskv_rdma_req_complete(conn);
+    priskv_rdma_req_delay_send(conn);
 }
 
-static void priskv_rdma_handle_send(priskv_rdma_conn *conn, priskv_request *req)
+/* the socket of an established shm connection only reports the disconnection */
+static void priskv_shm_handle_sock(int fd, void *opaque, uint32_t ev)
 {
-    priskv_rdma_req *rdma_req = (priskv_rdma_req *)be64toh(req->request_id);
+    priskv_rdma_conn *conn = opaque;
+    uint8_t buf[64];
+    ssize_t n;
 
-    rdma_req->flags |= PRISKV_RDMA_REQ_FLAG_SEND;
-    priskv_rdma_req_done(conn, rdma_req);
+    n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if ((n < 0) && (errno == EAGAIN)) {
+        return;
+    }
+
+    priskv_tcp_disconnect(conn);
+    priskv_rdma_req_complete(conn);
 }
 
 static int priskv_rdma_handle_cq(priskv_rdma_conn *conn)
@@ -1653,6 +3106,10 @@ poll_cq:
         conn->wc_send++;
         break;
 
+    case IBV_WC_RDMA_READ:
+        priskv_rdma_handle_read(conn, (priskv_rdma_req *)wc.wr_id);
+        break;
+
     default:
         priskv_log_error("unexpected opcode 0x%x", wc.opcode);
         return -EIO;
@@ -1679,9 +3136,10 @@ static inline priskv_rdma_conn *priskv_select_conn(priskv_client *client)
     return client->ops->select_conn(client);
 }
 
-static void priskv_send_command(priskv_client *client, uint64_t request_id, const char *key,
-                              priskv_sgl *sgl, uint16_t nsgl, uint64_t timeout, priskv_req_command cmd,
-                              priskv_generic_cb cb)
+static priskv_rdma_req *priskv_new_command(priskv_client *client, uint64_t request_id,
+                                           const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                                           uint64_t timeout, priskv_req_command cmd,
+                                           priskv_generic_cb cb)
 {
     priskv_rdma_conn *conn = priskv_select_conn(client);
     priskv_connect_param *param = &conn->param;
@@ -1691,25 +3149,66 @@ static void priskv_send_command(priskv_client *client, uint64_t request_id, cons
     assert(cmd < PRISKV_COMMAND_MAX);
     if (!key || !keylen) {
         cb(request_id, PRISKV_STATUS_KEY_EMPTY, NULL);
+        return NULL;
     }
 
     if (keylen > param->max_key_length) {
         cb(request_id, PRISKV_STATUS_KEY_TOO_BIG, NULL);
+        return NULL;
     }
 
     if (nsgl > param->max_sgl) {
         priskv_log_error("RDMA: nsgl %d > max_sgl %d\n", nsgl, param->max_sgl);
         cb(request_id, PRISKV_STATUS_INVALID_SGL, NULL);
+        return NULL;
     }
 
     rdma_req =
         priskv_rdma_req_new(client, conn, request_id, key, keylen, sgl, nsgl, timeout, cmd, cb);
     if (!rdma_req) {
         cb(request_id, PRISKV_STATUS_NO_MEM, NULL);
-        return;
+        return NULL;
     }
 
-    priskv_rdma_req_submit(rdma_req);
+    rdma_req->priority = client->priority;
+    rdma_req->traced = client->trace_sample && !(client->trace_seq++ % client->trace_sample);
+    if ((cmd == PRISKV_COMMAND_GET) || (cmd == PRISKV_COMMAND_SET)) {
+        uint32_t max_inline_value = priskv_min_u32(client->max_inline_value, param->max_inline_value);
+        uint64_t valuelen = 0;
+
+        for (uint16_t i = 0; i < nsgl; i++) {
+            valuelen += sgl[i].length;
+        }
+
+        rdma_req->inlined = valuelen && (valuelen <= max_inline_value);
+
+        /* a piece of local SGL and reserved SGL takes a RDMA WRITE */
+        if ((cmd == PRISKV_COMMAND_SET) && !rdma_req->inlined && client->direct_write &&
+            (nsgl + PRISKV_RESERVE_MAX_SGL - 1 <= conn->max_write_wr)) {
+            rdma_req->phase = PRISKV_RDMA_REQ_PHASE_RESERVE;
+            rdma_req->cb = priskv_rdma_write_set_cb;
+        }
+
+        /* a value READ may be split by the value segments of server */
+        if ((cmd == PRISKV_COMMAND_GET) && client->direct_read && conn->index.nentries &&
+            (nsgl < conn->max_write_wr)) {
+            rdma_req->phase = PRISKV_RDMA_REQ_PHASE_INDEX;
+        }
+    }
+
+    return rdma_req;
+}
+
+static void priskv_send_command(priskv_client *client, uint64_t request_id, const char *key,
+                              priskv_sgl *sgl, uint16_t nsgl, uint64_t timeout, priskv_req_command cmd,
+                              priskv_generic_cb cb)
+{
+    priskv_rdma_req *rdma_req =
+        priskv_new_command(client, request_id, key, sgl, nsgl, timeout, cmd, cb);
+
+    if (rdma_req) {
+        priskv_rdma_req_submit(rdma_req);
+    }
 }
 
 int priskv_get_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
@@ -1724,6 +3223,30 @@ int priskv_get_async(priskv_client *client, const char *key, priskv_sgl *sgl, ui
     return 0;
 }
 
+int priskv_get_range_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                           uint64_t offset, uint64_t request_id, priskv_generic_cb cb)
+{
+    priskv_rdma_req *rdma_req;
+
+    if (!sgl || !nsgl) {
+        cb(request_id, PRISKV_STATUS_VALUE_EMPTY, 0);
+        return 0;
+    }
+
+    rdma_req = priskv_new_command(client, request_id, key, sgl, nsgl, 0, PRISKV_COMMAND_GET, cb);
+    if (!rdma_req) {
+        return 0;
+    }
+
+    /* the index of one-sided GET locates the whole value only */
+    rdma_req->phase = PRISKV_RDMA_REQ_PHASE_NONE;
+    rdma_req->range = true;
+    rdma_req->offset = offset;
+    priskv_rdma_req_submit(rdma_req);
+
+    return 0;
+}
+
 int priskv_set_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
                    uint64_t timeout, uint64_t request_id, priskv_generic_cb cb)
 {
@@ -1736,6 +3259,45 @@ int priskv_set_async(priskv_client *client, const char *key, priskv_sgl *sgl, ui
     return 0;
 }
 
+static int priskv_set_cond_async(priskv_client *client, const char *key, priskv_sgl *sgl,
+                                 uint16_t nsgl, uint64_t timeout, uint8_t cond, uint32_t version,
+                                 uint64_t request_id, priskv_generic_cb cb)
+{
+    priskv_rdma_req *rdma_req;
+
+    if (!sgl || !nsgl) {
+        cb(request_id, PRISKV_STATUS_VALUE_EMPTY, 0);
+        return 0;
+    }
+
+    rdma_req = priskv_new_command(client, request_id, key, sgl, nsgl, timeout, PRISKV_COMMAND_SET,
+                                  cb);
+    if (!rdma_req) {
+        return 0;
+    }
+
+    rdma_req->cond = cond;
+    rdma_req->version = version;
+    priskv_rdma_req_submit(rdma_req);
+
+    return 0;
+}
+
+int priskv_setnx_async(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                       uint64_t timeout, uint64_t request_id, priskv_generic_cb cb)
+{
+    return priskv_set_cond_async(client, key, sgl, nsgl, timeout, PRISKV_REQUEST_FLAG_NX, 0,
+                                 request_id, cb);
+}
+
+int priskv_set_version_async(priskv_client *client, const char *key, priskv_sgl *sgl,
+                             uint16_t nsgl, uint64_t timeout, uint32_t version,
+                             uint64_t request_id, priskv_generic_cb cb)
+{
+    return priskv_set_cond_async(client, key, sgl, nsgl, timeout, PRISKV_REQUEST_FLAG_VERSION,
+                                 version, request_id, cb);
+}
+
 int priskv_test_async(priskv_client *client, const char *key, uint64_t request_id, priskv_generic_cb cb)
 {
     priskv_send_command(client, request_id, key, NULL, 0, 0, PRISKV_COMMAND_TEST, cb);
@@ -1775,6 +3337,40 @@ int priskv_flush_async(priskv_client *client, const char *regex, uint64_t reques
     return 0;
 }
 
+void priskv_set_max_inline_value(priskv_client *client, uint32_t max_inline_value)
+{
+    client->max_inline_value = max_inline_value;
+}
+
+void priskv_set_direct_write(priskv_client *client, bool enable)
+{
+    client->direct_write = enable;
+}
+
+void priskv_set_direct_read(priskv_client *client, bool enable)
+{
+    client->direct_read = enable;
+}
+
+void priskv_set_priority(priskv_client *client, priskv_priority priority)
+{
+    switch (priority) {
+    case PRISKV_PRIORITY_HIGH:
+        client->priority = PRISKV_REQUEST_PRIORITY_HIGH;
+        break;
+    case PRISKV_PRIORITY_LOW:
+        client->priority = PRISKV_REQUEST_PRIORITY_LOW;
+        break;
+    default:
+        client->priority = PRISKV_REQUEST_PRIORITY_NORMAL;
+    }
+}
+
+void priskv_set_trace_sample(priskv_client *client, uint32_t sample)
+{
+    client->trace_sample = sample;
+}
+
 uint64_t priskv_capacity(priskv_client *client)
 {
     return client->conns[0]->capacity;
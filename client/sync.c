@@ -72,6 +72,19 @@ int priskv_get(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t
     return rdma_req_sync.status;
 }
 
+int priskv_get_range(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                     uint64_t offset, uint32_t *valuelen)
+{
+    priskv_rdma_req_sync rdma_req_sync = {.status = 0xffff, .done = false};
+
+    priskv_get_range_async(client, key, sgl, nsgl, offset, (uint64_t)&rdma_req_sync,
+                           priskv_common_sync_cb);
+    priskv_sync_wait(client, &rdma_req_sync.done);
+    *valuelen = rdma_req_sync.valuelen;
+
+    return rdma_req_sync.status;
+}
+
 int priskv_set(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl, uint64_t timeout)
 {
     priskv_rdma_req_sync rdma_req_sync = {.status = 0xffff, .done = false};
@@ -82,6 +95,32 @@ int priskv_set(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t
     return rdma_req_sync.status;
 }
 
+int priskv_setnx(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                 uint64_t timeout, uint32_t *valuelen)
+{
+    priskv_rdma_req_sync rdma_req_sync = {.status = 0xffff, .done = false};
+
+    priskv_setnx_async(client, key, sgl, nsgl, timeout, (uint64_t)&rdma_req_sync,
+                       priskv_common_sync_cb);
+    priskv_sync_wait(client, &rdma_req_sync.done);
+    *valuelen = rdma_req_sync.valuelen;
+
+    return rdma_req_sync.status;
+}
+
+int priskv_set_version(priskv_client *client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                       uint64_t timeout, uint32_t version, uint32_t *valuelen)
+{
+    priskv_rdma_req_sync rdma_req_sync = {.status = 0xffff, .done = false};
+
+    priskv_set_version_async(client, key, sgl, nsgl, timeout, version, (uint64_t)&rdma_req_sync,
+                             priskv_common_sync_cb);
+    priskv_sync_wait(client, &rdma_req_sync.done);
+    *valuelen = rdma_req_sync.valuelen;
+
+    return rdma_req_sync.status;
+}
+
 int priskv_test(priskv_client *client, const char *key, uint32_t *valuelen)
 {
     priskv_rdma_req_sync rdma_req_sync = {.status = 0xffff, .done = false};
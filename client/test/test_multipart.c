@@ -0,0 +1,516 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Multipart SET/GET tests over an in-memory store in place of the server, the requests complete
+ * in @priskv_process as the client does.
+ */
+
+#include <assert.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "priskv.h"
+
+#define TEST_MAX_KEYS 256
+#define TEST_MAX_PENDING 256
+
+typedef struct test_kv {
+    char *key;
+    uint8_t *val;
+    uint64_t len;
+    uint32_t version;
+} test_kv;
+
+typedef struct test_pending {
+    uint64_t request_id;
+    priskv_generic_cb cb;
+    priskv_status status;
+    uint32_t length;
+} test_pending;
+
+static test_kv store[TEST_MAX_KEYS];
+static test_pending pending[TEST_MAX_PENDING];
+static int npending;
+static priskv_client *client = (priskv_client *)&store;
+
+/* called once before the next range GET looks up its key */
+static void (*before_range)(void);
+
+/* called once before the next versioned SET looks up its key */
+static void (*before_version)(void);
+
+static test_kv *test_find(const char *key)
+{
+    for (int i = 0; i < TEST_MAX_KEYS; i++) {
+        if (store[i].key && !strcmp(store[i].key, key)) {
+            return &store[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int test_nkeys(void)
+{
+    int n = 0;
+
+    for (int i = 0; i < TEST_MAX_KEYS; i++) {
+        n += !!store[i].key;
+    }
+
+    return n;
+}
+
+static void test_drop(test_kv *kv)
+{
+    free(kv->key);
+    free(kv->val);
+    memset(kv, 0, sizeof(*kv));
+}
+
+static void test_complete(uint64_t request_id, priskv_generic_cb cb, priskv_status status,
+                          uint32_t length)
+{
+    assert(npending < TEST_MAX_PENDING);
+    pending[npending].request_id = request_id;
+    pending[npending].cb = cb;
+    pending[npending].status = status;
+    pending[npending].length = length;
+    npending++;
+}
+
+static uint64_t test_sgl_len(priskv_sgl *sgl, uint16_t nsgl)
+{
+    uint64_t len = 0;
+
+    for (uint16_t i = 0; i < nsgl; i++) {
+        len += sgl[i].length;
+    }
+
+    return len;
+}
+
+/* copy [@offset, @offset + @len) of @kv into @sgl */
+static void test_copy_out(test_kv *kv, uint64_t offset, uint64_t len, priskv_sgl *sgl)
+{
+    for (uint16_t i = 0; len; i++) {
+        uint64_t n = sgl[i].length < len ? sgl[i].length : len;
+
+        memcpy((void *)sgl[i].iova, kv->val + offset, n);
+        offset += n;
+        len -= n;
+    }
+}
+
+int priskv_process(priskv_client *_client, uint32_t event)
+{
+    while (npending) {
+        test_pending p = pending[0];
+        uint32_t length = p.length;
+
+        memmove(pending, pending + 1, --npending * sizeof(test_pending));
+        p.cb(p.request_id, p.status, &length);
+    }
+
+    return 0;
+}
+
+int priskv_get_async(priskv_client *_client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                     uint64_t request_id, priskv_generic_cb cb)
+{
+    test_kv *kv = test_find(key);
+
+    if (!kv) {
+        test_complete(request_id, cb, PRISKV_STATUS_NO_SUCH_KEY, 0);
+    } else if (kv->len > test_sgl_len(sgl, nsgl)) {
+        test_complete(request_id, cb, PRISKV_STATUS_VALUE_TOO_BIG, kv->len);
+    } else {
+        test_copy_out(kv, 0, kv->len, sgl);
+        test_complete(request_id, cb, PRISKV_STATUS_OK, kv->len);
+    }
+
+    return 0;
+}
+
+int priskv_get_range_async(priskv_client *_client, const char *key, priskv_sgl *sgl,
+                           uint16_t nsgl, uint64_t offset, uint64_t request_id,
+                           priskv_generic_cb cb)
+{
+    void (*hook)(void) = before_range;
+    uint64_t len;
+    test_kv *kv;
+
+    before_range = NULL;
+    if (hook) {
+        hook();
+    }
+
+    kv = test_find(key);
+    if (!kv) {
+        test_complete(request_id, cb, PRISKV_STATUS_NO_SUCH_KEY, 0);
+    } else if (offset >= kv->len) {
+        test_complete(request_id, cb, PRISKV_STATUS_INVALID_RANGE, kv->len);
+    } else {
+        len = kv->len - offset;
+        if (len > test_sgl_len(sgl, nsgl)) {
+            len = test_sgl_len(sgl, nsgl);
+        }
+        test_copy_out(kv, offset, len, sgl);
+        test_complete(request_id, cb, PRISKV_STATUS_OK, len);
+    }
+
+    return 0;
+}
+
+static test_kv *test_store(const char *key, priskv_sgl *sgl, uint16_t nsgl)
+{
+    test_kv *kv = test_find(key);
+    uint64_t len = test_sgl_len(sgl, nsgl), off = 0;
+
+    if (kv) {
+        test_drop(kv);
+    }
+
+    for (int i = 0; !kv && (i < TEST_MAX_KEYS); i++) {
+        kv = store[i].key ? NULL : &store[i];
+    }
+    assert(kv);
+
+    kv->key = strdup(key);
+    kv->val = malloc(len);
+    kv->len = len;
+    for (uint16_t i = 0; i < nsgl; i++) {
+        memcpy(kv->val + off, (void *)sgl[i].iova, sgl[i].length);
+        off += sgl[i].length;
+    }
+
+    return kv;
+}
+
+int priskv_set_async(priskv_client *_client, const char *key, priskv_sgl *sgl, uint16_t nsgl,
+                     uint64_t timeout, uint64_t request_id, priskv_generic_cb cb)
+{
+    test_kv *kv = test_store(key, sgl, nsgl);
+
+    test_complete(request_id, cb, PRISKV_STATUS_OK, kv->len);
+
+    return 0;
+}
+
+int priskv_set_version_async(priskv_client *_client, const char *key, priskv_sgl *sgl,
+                             uint16_t nsgl, uint64_t timeout, uint32_t version,
+                             uint64_t request_id, priskv_generic_cb cb)
+{
+    void (*hook)(void) = before_version;
+    test_kv *kv;
+
+    before_version = NULL;
+    if (hook) {
+        hook();
+    }
+
+    kv = test_find(key);
+    if (kv && (kv->version >= version)) {
+        test_complete(request_id, cb, PRISKV_STATUS_KEY_EXISTS, kv->len);
+        return 0;
+    }
+
+    kv = test_store(key, sgl, nsgl);
+    kv->version = version;
+    test_complete(request_id, cb, PRISKV_STATUS_OK, kv->len);
+
+    return 0;
+}
+
+int priskv_delete_async(priskv_client *_client, const char *key, uint64_t request_id,
+                        priskv_generic_cb cb)
+{
+    test_kv *kv = test_find(key);
+
+    if (!kv) {
+        test_complete(request_id, cb, PRISKV_STATUS_NO_SUCH_KEY, 0);
+        return 0;
+    }
+
+    test_drop(kv);
+    test_complete(request_id, cb, PRISKV_STATUS_OK, 0);
+
+    return 0;
+}
+
+int priskv_keys(priskv_client *_client, const char *regex, priskv_keyset **keyset)
+{
+    regex_t re;
+
+    assert(!regcomp(&re, regex, REG_NEWLINE));
+    *keyset = calloc(1, sizeof(priskv_keyset));
+    (*keyset)->keys = calloc(TEST_MAX_KEYS, sizeof(priskv_key));
+    for (int i = 0; i < TEST_MAX_KEYS; i++) {
+        if (store[i].key && !regexec(&re, store[i].key, 0, NULL, 0)) {
+            (*keyset)->keys[(*keyset)->nkey++].key = strdup(store[i].key);
+        }
+    }
+    regfree(&re);
+
+    return PRISKV_STATUS_OK;
+}
+
+void priskv_keyset_free(priskv_keyset *keyset)
+{
+    for (uint32_t i = 0; i < keyset->nkey; i++) {
+        free(keyset->keys[i].key);
+    }
+    free(keyset->keys);
+    free(keyset);
+}
+
+static void test_noop_cb(uint64_t request_id, priskv_status status, void *result)
+{
+    assert(status == PRISKV_STATUS_OK);
+}
+
+static void test_fill(uint8_t *buf, uint64_t len, uint8_t seed)
+{
+    for (uint64_t i = 0; i < len; i++) {
+        buf[i] = (i * 7 + seed) % 251;
+    }
+}
+
+static int test_set(const char *key, uint8_t *val, uint64_t len, uint32_t part_size)
+{
+    /* two SGLs not aligned to the parts */
+    priskv_sgl sgl[2] = {{.iova = (uint64_t)val, .length = len / 3},
+                         {.iova = (uint64_t)val + len / 3, .length = len - len / 3}};
+
+    return priskv_multipart_set(client, key, sgl, 2, part_size, 0);
+}
+
+static int test_get(const char *key, uint8_t *buf, uint64_t offset, uint64_t len,
+                    uint64_t *length, uint64_t *total)
+{
+    priskv_sgl sgl = {.iova = (uint64_t)buf, .length = len};
+
+    return priskv_multipart_get(client, key, &sgl, 1, offset, length, total);
+}
+
+/* the whole value and a range over several parts read back, the plain GET sees the manifest */
+static void test_commit_read(void)
+{
+    uint8_t val[1000], buf[1000];
+    uint64_t length, total;
+
+    test_fill(val, sizeof(val), 1);
+    assert(test_set("mp", val, sizeof(val), 64) == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 1 + 16);
+    assert(test_find("mp")->len < 64);
+
+    assert(test_get("mp", buf, 0, sizeof(buf), &length, &total) == PRISKV_STATUS_OK);
+    assert((length == sizeof(val)) && (total == sizeof(val)) && !memcmp(buf, val, length));
+
+    memset(buf, 0, sizeof(buf));
+    assert(test_get("mp", buf, 100, 300, &length, NULL) == PRISKV_STATUS_OK);
+    assert((length == 300) && !memcmp(buf, val + 100, length));
+
+    assert(test_get("mp", buf, 900, 300, &length, NULL) == PRISKV_STATUS_OK);
+    assert((length == 100) && !memcmp(buf, val + 900, length));
+
+    assert(test_get("mp", buf, 1000, 1, &length, &total) == PRISKV_STATUS_INVALID_RANGE);
+    assert(!length && (total == sizeof(val)));
+
+    assert(priskv_multipart_delete(client, "mp") == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 0);
+}
+
+/* a commit replaces the manifest and deletes the old parts */
+static void test_replace(void)
+{
+    uint8_t val[1000], val2[500], buf[1000];
+    uint64_t length;
+
+    test_fill(val, sizeof(val), 1);
+    test_fill(val2, sizeof(val2), 2);
+    assert(test_set("mp", val, sizeof(val), 64) == PRISKV_STATUS_OK);
+    assert(test_set("mp", val2, sizeof(val2), 100) == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 1 + 5);
+
+    assert(test_get("mp", buf, 0, sizeof(buf), &length, NULL) == PRISKV_STATUS_OK);
+    assert((length == sizeof(val2)) && !memcmp(buf, val2, length));
+
+    assert(priskv_multipart_delete(client, "mp") == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 0);
+}
+
+static uint8_t race_val[500];
+
+static void test_race_commit(void)
+{
+    assert(test_set("mp", race_val, sizeof(race_val), 100) == PRISKV_STATUS_OK);
+}
+
+/* a GET holding the replaced manifest starts over on the new value */
+static void test_replace_race(void)
+{
+    uint8_t val[1000], buf[1000];
+    uint64_t length, total;
+
+    test_fill(val, sizeof(val), 1);
+    test_fill(race_val, sizeof(race_val), 3);
+    assert(test_set("mp", val, sizeof(val), 64) == PRISKV_STATUS_OK);
+
+    before_range = test_race_commit;
+    assert(test_get("mp", buf, 0, sizeof(buf), &length, &total) == PRISKV_STATUS_OK);
+    assert(!before_range);
+    assert((length == sizeof(race_val)) && (total == sizeof(race_val)));
+    assert(!memcmp(buf, race_val, length));
+
+    assert(priskv_multipart_delete(client, "mp") == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 0);
+}
+
+static uint8_t race_val2[700];
+
+static void test_racing_commit(void)
+{
+    assert(test_set("mp", race_val2, sizeof(race_val2), 100) == PRISKV_STATUS_OK);
+}
+
+/* of two commits read the same old manifest, the later one deletes its own parts */
+static void test_commit_race(void)
+{
+    uint8_t val[1000], val2[500], buf[1000];
+    uint64_t length;
+
+    test_fill(val, sizeof(val), 1);
+    test_fill(val2, sizeof(val2), 2);
+    test_fill(race_val2, sizeof(race_val2), 4);
+    assert(test_set("mp", val, sizeof(val), 64) == PRISKV_STATUS_OK);
+
+    before_version = test_racing_commit;
+    assert(test_set("mp", val2, sizeof(val2), 100) == PRISKV_STATUS_KEY_EXISTS);
+    assert(!before_version);
+    assert(test_nkeys() == 1 + 7);
+
+    assert(test_get("mp", buf, 0, sizeof(buf), &length, NULL) == PRISKV_STATUS_OK);
+    assert((length == sizeof(race_val2)) && !memcmp(buf, race_val2, length));
+
+    assert(priskv_multipart_delete(client, "mp") == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 0);
+}
+
+/* a plain SET over a manifest leaves its parts, the sweep deletes them but the current ones */
+static void test_sweep(void)
+{
+    uint8_t val[1000];
+    priskv_sgl sgl = {.iova = (uint64_t)val, .length = 10};
+    uint32_t nparts;
+
+    test_fill(val, sizeof(val), 1);
+    assert(test_set("mp", val, sizeof(val), 64) == PRISKV_STATUS_OK);
+    assert(test_set("mp.mp", val, sizeof(val), 100) == PRISKV_STATUS_OK);
+    assert(!priskv_set_async(client, "mp", &sgl, 1, 0, 0, test_noop_cb));
+    priskv_process(client, 0);
+    assert(test_nkeys() == 2 + 16 + 10);
+
+    assert(test_set("mp", val, sizeof(val), 500) == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 2 + 16 + 10 + 2);
+
+    assert(priskv_multipart_sweep(client, "mp", &nparts) == PRISKV_STATUS_OK);
+    assert((nparts == 16) && (test_nkeys() == 2 + 10 + 2));
+    assert(priskv_multipart_sweep(client, "mp", &nparts) == PRISKV_STATUS_OK);
+    assert(!nparts);
+
+    assert(priskv_multipart_delete(client, "mp") == PRISKV_STATUS_OK);
+    assert(priskv_multipart_delete(client, "mp.mp") == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 0);
+
+    /* no manifest at all */
+    assert(test_set("mp", val, sizeof(val), 100) == PRISKV_STATUS_OK);
+    test_drop(test_find("mp"));
+    assert(priskv_multipart_sweep(client, "mp", &nparts) == PRISKV_STATUS_OK);
+    assert((nparts == 10) && (test_nkeys() == 0));
+}
+
+/* a part evicted on its own fails the GET, not a mix of the values */
+static void test_evicted(void)
+{
+    uint8_t val[1000], buf[1000];
+    uint64_t length;
+    char *dot;
+
+    test_fill(val, sizeof(val), 1);
+    assert(test_set("mp", val, sizeof(val), 64) == PRISKV_STATUS_OK);
+    for (int i = 0; i < TEST_MAX_KEYS; i++) {
+        dot = store[i].key ? strrchr(store[i].key, '.') : NULL;
+        if (dot && !strcmp(dot, ".5")) {
+            test_drop(&store[i]);
+        }
+    }
+    assert(test_nkeys() == 1 + 15);
+
+    assert(test_get("mp", buf, 0, 64, &length, NULL) == PRISKV_STATUS_OK);
+    assert(test_get("mp", buf, 0, sizeof(buf), &length, NULL) == PRISKV_STATUS_NO_SUCH_KEY);
+    assert(!length);
+
+    assert(priskv_multipart_delete(client, "mp") == PRISKV_STATUS_OK);
+    assert(test_nkeys() == 0);
+}
+
+/* a commit missing a part publishes nothing and deletes the parts set */
+static void test_incomplete(void)
+{
+    uint8_t val[1000], buf[1000];
+    priskv_sgl sgl = {.iova = (uint64_t)val, .length = 64};
+    priskv_multipart *mp;
+    uint64_t length;
+
+    test_fill(val, sizeof(val), 1);
+    mp = priskv_multipart_begin(client, "mp", sizeof(val), 64, 0);
+    assert(mp && (priskv_multipart_nparts(mp) == 16));
+    for (uint32_t i = 0; i < 15; i++) {
+        sgl.iova = (uint64_t)val + i * 64;
+        assert(!priskv_multipart_set_part_async(mp, i, &sgl, 1, 0, NULL));
+    }
+    assert(priskv_multipart_commit(mp) == PRISKV_STATUS_VALUE_EMPTY);
+    assert(test_nkeys() == 0);
+
+    /* a part of a wrong length */
+    mp = priskv_multipart_begin(client, "mp", sizeof(val), 64, 0);
+    assert(!priskv_multipart_set_part_async(mp, 15, &sgl, 1, 0, NULL));
+    assert(priskv_multipart_commit(mp) == PRISKV_STATUS_INVALID_SGL);
+    assert(test_nkeys() == 0);
+
+    /* a plain value is not a manifest */
+    sgl.iova = (uint64_t)val;
+    assert(!priskv_set_async(client, "plain", &sgl, 1, 0, 0, test_noop_cb));
+    priskv_process(client, 0);
+    assert(test_get("plain", buf, 0, sizeof(buf), &length, NULL) == PRISKV_STATUS_PROTOCOL_ERROR);
+    test_drop(test_find("plain"));
+}
+
+int main()
+{
+    test_commit_read();
+    test_replace();
+    test_replace_race();
+    test_commit_race();
+    test_sweep();
+    test_evicted();
+    test_incomplete();
+    printf("TEST multipart: OK\n");
+
+    return 0;
+}
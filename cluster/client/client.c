@@ -54,7 +54,7 @@ typedef struct priskvClusterMemoryCtx priskvClusterMemoryCtx;
 typedef struct priskvClusterRequest priskvClusterRequest;
 
 struct list_head retry_req_list = LIST_HEAD_INIT(retry_req_list);
-typedef enum { GET, SET, TEST, DELETE } RequestType;
+typedef enum { GET, SET, TEST, DELETE, GET_RANGE, SET_NX } RequestType;
 
 struct priskvClusterMetaServer {
     char *addr;
@@ -109,6 +109,7 @@ struct priskvClusterRequest {
     const char *key;
     priskvClusterSGL *cluster_sgl; /* 集群通信sgl, 存放通信内存块起始地址, 重试用 */
     uint64_t timeout;
+    uint64_t offset; /* GET_RANGE only */
     priskvClusterNode *node;
     priskvClusterClient *client;
     struct list_node entry;
@@ -391,6 +392,7 @@ static priskvClusterRequest *priskvClusterRequestNew(priskvClusterNode *node, pr
     req->key = key;
     req->cluster_sgl = malloc(sizeof(priskvClusterSGL) * nsgl);
     req->timeout = timeout;
+    req->offset = 0;
     req->node = node;
     req->client = client;
 
@@ -492,10 +494,18 @@ int priskvClusterSubmitRequest(priskvClusterRequest *req)
             priskv_get_async(req->node->client, req->key, req->sgl, req->nsgl, (uint64_t)req,
                            priskvClusterRequestCallback);
             break;
+        case GET_RANGE:
+            priskv_get_range_async(req->node->client, req->key, req->sgl, req->nsgl, req->offset,
+                                   (uint64_t)req, priskvClusterRequestCallback);
+            break;
         case SET:
             priskv_set_async(req->node->client, req->key, req->sgl, req->nsgl, req->timeout,
                            (uint64_t)req, priskvClusterRequestCallback);
             break;
+        case SET_NX:
+            priskv_setnx_async(req->node->client, req->key, req->sgl, req->nsgl, req->timeout,
+                               (uint64_t)req, priskvClusterRequestCallback);
+            break;
         case TEST:
             priskv_test_async(req->node->client, req->key, (uint64_t)req, priskvClusterRequestCallback);
             break;
@@ -741,6 +751,19 @@ int priskvClusterAsyncGet(priskvClusterClient *client, const char *key, priskvCl
     return priskvClusterSubmitRequest(req);
 }
 
+int priskvClusterAsyncGetRange(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
+                               uint16_t nsgl, uint64_t offset, priskvClusterCallback cb,
+                               void *cbarg)
+{
+    priskvClusterRequest *req =
+        priskvClusterGetRequest(client, key, sgl, nsgl, cb, cbarg, 0, GET_RANGE);
+    if (req == NULL)
+        return -1;
+
+    req->offset = offset;
+    return priskvClusterSubmitRequest(req);
+}
+
 int priskvClusterAsyncSet(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
                         uint16_t nsgl, uint64_t timeout, priskvClusterCallback cb, void *cbarg)
 {
@@ -752,6 +775,17 @@ int priskvClusterAsyncSet(priskvClusterClient *client, const char *key, priskvCl
     return priskvClusterSubmitRequest(req);
 }
 
+int priskvClusterAsyncSetNX(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
+                            uint16_t nsgl, uint64_t timeout, priskvClusterCallback cb, void *cbarg)
+{
+    priskvClusterRequest *req =
+        priskvClusterGetRequest(client, key, sgl, nsgl, cb, cbarg, timeout, SET_NX);
+    if (req == NULL)
+        return -1;
+
+    return priskvClusterSubmitRequest(req);
+}
+
 int priskvClusterAsyncTest(priskvClusterClient *client, const char *key, priskvClusterCallback cb,
                          void *cbarg)
 {
@@ -790,6 +824,26 @@ priskvClusterStatus priskvClusterGet(priskvClusterClient *client, const char *ke
     return priskvClusterStatusFromPRISKVStatus(status);
 }
 
+priskvClusterStatus priskvClusterGetRange(priskvClusterClient *client, const char *key,
+                                          priskvClusterSGL *sgl, uint16_t nsgl, uint64_t offset,
+                                          uint32_t *value_len)
+{
+    priskvClusterNode *node = priskvClusterGetNode(client, key);
+    if (!node) {
+        return PRISKV_CLUSTER_STATUS_NO_SUCH_KEY;
+    }
+
+    priskvClusterRequest *req =
+        priskvClusterRequestNew(node, sgl, nsgl, NULL, NULL, GET_RANGE, key, 0, client);
+
+    priskv_status status =
+        priskv_get_range(node->client, key, req->sgl, req->nsgl, offset, value_len);
+
+    priskvClusterRequestFree(req);
+
+    return priskvClusterStatusFromPRISKVStatus(status);
+}
+
 priskvClusterStatus priskvClusterSet(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
                                  uint16_t nsgl, uint64_t timeout)
 {
@@ -808,6 +862,26 @@ priskvClusterStatus priskvClusterSet(priskvClusterClient *client, const char *ke
     return priskvClusterStatusFromPRISKVStatus(status);
 }
 
+priskvClusterStatus priskvClusterSetNX(priskvClusterClient *client, const char *key,
+                                       priskvClusterSGL *sgl, uint16_t nsgl, uint64_t timeout,
+                                       uint32_t *value_len)
+{
+    priskvClusterNode *node = priskvClusterGetNode(client, key);
+    if (!node) {
+        return PRISKV_CLUSTER_STATUS_NO_SUCH_KEY;
+    }
+
+    priskvClusterRequest *req =
+        priskvClusterRequestNew(node, sgl, nsgl, NULL, NULL, SET_NX, key, timeout, client);
+
+    priskv_status status =
+        priskv_setnx(node->client, key, req->sgl, req->nsgl, timeout, value_len);
+
+    priskvClusterRequestFree(req);
+
+    return priskvClusterStatusFromPRISKVStatus(status);
+}
+
 priskvClusterStatus priskvClusterTest(priskvClusterClient *client, const char *key, uint32_t *value_len)
 {
     priskvClusterNode *node = priskvClusterGetNode(client, key);
@@ -78,6 +78,12 @@ typedef enum priskvClusterStatus {
     /* key is updating */
     PRISKV_CLUSTER_STATUS_KEY_UPDATING,
 
+    /* the offset of range GET is beyond the value */
+    PRISKV_CLUSTER_STATUS_INVALID_RANGE = PRISKV_STATUS_INVALID_RANGE,
+
+    /* the key of SETNX exists */
+    PRISKV_CLUSTER_STATUS_KEY_EXISTS = PRISKV_STATUS_KEY_EXISTS,
+
     /* no enough memory reported by server side */
     PRISKV_CLUSTER_STATUS_NO_MEM = 0x200,
 
@@ -130,6 +136,12 @@ static inline const char *priskv_cluster_status_str(priskvClusterStatus status)
     case PRISKV_CLUSTER_STATUS_KEY_UPDATING:
         return "Key is updating";
 
+    case PRISKV_CLUSTER_STATUS_INVALID_RANGE:
+        return "Invalid range";
+
+    case PRISKV_CLUSTER_STATUS_KEY_EXISTS:
+        return "Key exists";
+
     case PRISKV_CLUSTER_STATUS_NO_MEM:
         return "No memory";
 
@@ -156,8 +168,13 @@ typedef void (*priskvClusterCallback)(priskvClusterStatus status, uint32_t value
 /* async APIs */
 int priskvClusterAsyncGet(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
                         uint16_t nsgl, priskvClusterCallback cb, void *cbarg);
+int priskvClusterAsyncGetRange(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
+                               uint16_t nsgl, uint64_t offset, priskvClusterCallback cb,
+                               void *cbarg);
 int priskvClusterAsyncSet(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
                         uint16_t nsgl, uint64_t timeout, priskvClusterCallback cb, void *cbarg);
+int priskvClusterAsyncSetNX(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
+                            uint16_t nsgl, uint64_t timeout, priskvClusterCallback cb, void *cbarg);
 int priskvClusterAsyncTest(priskvClusterClient *client, const char *key, priskvClusterCallback cb,
                          void *cbarg);
 int priskvClusterAsyncDelete(priskvClusterClient *client, const char *key, priskvClusterCallback cb,
@@ -166,8 +183,14 @@ int priskvClusterAsyncDelete(priskvClusterClient *client, const char *key, prisk
 /* sync APIs */
 priskvClusterStatus priskvClusterGet(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
                                  uint16_t nsgl, uint32_t *value_len);
+priskvClusterStatus priskvClusterGetRange(priskvClusterClient *client, const char *key,
+                                          priskvClusterSGL *sgl, uint16_t nsgl, uint64_t offset,
+                                          uint32_t *value_len);
 priskvClusterStatus priskvClusterSet(priskvClusterClient *client, const char *key, priskvClusterSGL *sgl,
                                  uint16_t nsgl, uint64_t timeout);
+priskvClusterStatus priskvClusterSetNX(priskvClusterClient *client, const char *key,
+                                       priskvClusterSGL *sgl, uint16_t nsgl, uint64_t timeout,
+                                       uint32_t *value_len);
 priskvClusterStatus priskvClusterTest(priskvClusterClient *client, const char *key, uint32_t *value_len);
 priskvClusterStatus priskvClusterDelete(priskvClusterClient *client, const char *key);
 priskvClusterStatus priskvClusterKeys(priskvClusterClient *client, const char *regex,
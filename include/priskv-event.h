@@ -32,6 +32,7 @@ extern "C"
 {
 #endif
 
+#include <stdbool.h>
 #include <sys/epoll.h>
 
 typedef void priskv_event_handler(int fd, void *opaque, uint32_t events);
@@ -48,6 +49,25 @@ void priskv_set_fd_handler(int fd, priskv_event_handler *pollin, priskv_event_ha
 void priskv_fd_handler_event(struct epoll_event *event);
 void priskv_events_process(int epollfd, int timeout);
 
+/*
+ * Work deferred to the end of the current event pass of the calling thread, e.g. to flush
+ * everything queued by the handlers of one pass at once.
+ */
+typedef struct priskv_event_deferred priskv_event_deferred;
+typedef void priskv_event_deferred_fn(void *opaque);
+
+struct priskv_event_deferred {
+    priskv_event_deferred_fn *fn;
+    void *opaque;
+    bool scheduled;
+    priskv_event_deferred *next;
+};
+
+/* run @deferred once at the end of the current pass, right away if not called from a pass */
+void priskv_events_defer(priskv_event_deferred *deferred);
+/* drop @deferred if scheduled, e.g. before freeing it */
+void priskv_events_cancel(priskv_event_deferred *deferred);
+
 #if defined(__cplusplus)
 }
 #endif
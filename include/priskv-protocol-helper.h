@@ -33,6 +33,8 @@ extern "C"
 #endif
 
 #include <stddef.h>
+#include <endian.h>
+#include <sys/time.h>
 #include "priskv-protocol.h"
 
 static inline uint16_t priskv_request_key_off(uint16_t nsgl)
@@ -53,10 +55,69 @@ static inline uint8_t *priskv_request_key(priskv_request *req, uint16_t nsgl)
     return base + priskv_request_key_off(nsgl);
 }
 
+/* the inline value of PRISKV_REQUEST_FLAG_INLINE SET follows the key */
+static inline uint8_t *priskv_request_inline_value(priskv_request *req, uint16_t nsgl,
+                                                   uint16_t keylen)
+{
+    return priskv_request_key(req, nsgl) + keylen;
+}
+
+static inline uint32_t priskv_request_trace_size(priskv_request *req)
+{
+    return (req->flags & PRISKV_REQUEST_FLAG_TRACE) ? sizeof(priskv_request_trace) : 0;
+}
+
+static inline void priskv_request_trace_stamp(uint64_t *stamp)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    *stamp = htobe64(now.tv_sec * 1000000UL + now.tv_usec);
+}
+
+/* narrow @val and @valuelen to the range of PRISKV_REQUEST_FLAG_RANGE GET, up to @expected bytes */
+static inline priskv_resp_status priskv_request_range(priskv_request *req, uint32_t expected,
+                                                      uint8_t **val, uint32_t *valuelen)
+{
+    uint64_t offset = be64toh(req->offset);
+
+    if (!(req->flags & PRISKV_REQUEST_FLAG_RANGE)) {
+        return PRISKV_RESP_STATUS_OK;
+    }
+
+    if (offset >= *valuelen) {
+        return PRISKV_RESP_STATUS_INVALID_RANGE;
+    }
+
+    *val += offset;
+    *valuelen -= offset;
+    if (*valuelen > expected) {
+        *valuelen = expected;
+    }
+
+    return PRISKV_RESP_STATUS_OK;
+}
+
+/* the conditions of SET, PRISKV_REQUEST_FLAG_NX and PRISKV_REQUEST_FLAG_VERSION */
+static inline uint8_t priskv_request_cond(priskv_request *req)
+{
+    return req->flags & (PRISKV_REQUEST_FLAG_NX | PRISKV_REQUEST_FLAG_VERSION);
+}
+
+static inline uint32_t priskv_request_version(priskv_request *req)
+{
+    return be64toh(req->version);
+}
+
+static inline uint8_t *priskv_response_inline_value(priskv_response *resp)
+{
+    return (uint8_t *)(resp + 1);
+}
+
 static inline const char *priskv_command_str(priskv_req_command cmd)
 {
-    static const char *cmd_str[] = {"GET",    "SET",  "TEST",   "DELETE",
-                                    "EXPIRE", "KEYS", "NRKEYS", "FLUSH"};
+    static const char *cmd_str[] = {"GET",  "SET",    "TEST",  "DELETE",  "EXPIRE",
+                                    "KEYS", "NRKEYS", "FLUSH", "RESERVE", "COMMIT"};
 
     if (cmd >= PRISKV_COMMAND_MAX) {
         return "unknown";
@@ -107,6 +168,12 @@ static inline const char *priskv_resp_status_str(priskv_resp_status status)
     case PRISKV_RESP_STATUS_SERVER_ERROR:
         return "Server internal error";
 
+    case PRISKV_RESP_STATUS_INVALID_RANGE:
+        return "Invalid range";
+
+    case PRISKV_RESP_STATUS_KEY_EXISTS:
+        return "Key exists";
+
     case PRISKV_RESP_STATUS_NO_MEM:
         return "No memory";
     }
@@ -142,6 +209,19 @@ static inline const char *priskv_rdma_cm_status_str(priskv_rdma_cm_status status
     return "Unknown";
 }
 
+/* FNV-1a hash of key for the one-sided GET index */
+static inline uint64_t priskv_index_keyhash(const uint8_t *key, uint16_t keylen)
+{
+    uint64_t hash = 0xcbf29ce484222325UL;
+
+    for (uint16_t i = 0; i < keylen; i++) {
+        hash ^= key[i];
+        hash *= 0x100000001b3UL;
+    }
+
+    return hash;
+}
+
 static inline uint32_t priskv_sgl_size_from_be(priskv_keyed_sgl *sgls, uint16_t nsgl)
 {
     uint32_t size = 0;
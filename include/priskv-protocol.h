@@ -55,6 +55,35 @@ typedef struct priskv_keys_resp {
     uint32_t valuelen;
 } priskv_keys_resp;
 
+/*
+ * the maximum SGLs of a reserved value, a value may cross MRs of the server.
+ */
+#define PRISKV_RESERVE_MAX_SGL 4
+
+/*
+ * a reservation not committed in time is dropped by server, the late COMMIT gets
+ * PRISKV_RESP_STATUS_INVALID_SGL.
+ */
+#define PRISKV_RESERVE_TIMEOUT_MS 10000
+
+/*
+ * response payload of PRISKV_COMMAND_RESERVE, follows @priskv_response.
+ * [priskv_response][priskv_reserve_resp]
+ *
+ * The client writes the value into @sgls by RDMA WRITE, then sends PRISKV_COMMAND_COMMIT with the
+ * same key and a single SGL: @addr is @token, @length is the value length, @key is ignored.
+ * A RDMA WRITE is ordered before the following SEND on the same QP, so the commit command could
+ * be posted right after the WRITEs.
+ * The @key of @sgls is the rkey of a memory window covering that SGL only, it is invalidated on
+ * commit or expiry, so a RDMA WRITE after them fails with a remote access error.
+ */
+typedef struct priskv_reserve_resp {
+    uint64_t token;
+    uint16_t nsgl;
+    uint8_t reserved[6];
+    priskv_keyed_sgl sgls[PRISKV_RESERVE_MAX_SGL];
+} priskv_reserve_resp;
+
 /*
  * command of request
  */
@@ -68,22 +97,60 @@ typedef enum priskv_req_command {
     /* get the number of keys by regex, priskv_keys_resp::valuelen indicates it. */
     PRISKV_COMMAND_NRKEYS = 0x06,
     PRISKV_COMMAND_FLUSH = 0x07, /* flush keys by regex */
+    /* reserve value of a key for client RDMA WRITE, the response carries priskv_reserve_resp */
+    PRISKV_COMMAND_RESERVE = 0x08,
+    PRISKV_COMMAND_COMMIT = 0x09, /* commit a reserved value, the key becomes visible */
 
     PRISKV_COMMAND_MAX /* not a part of protocol, keep last */
 } priskv_req_command;
 
 /*
- * request runtime in whole query
+ * trace of a sampled request in whole query, carried by PRISKV_REQUEST_FLAG_TRACE.
+ * All the stamps are microseconds since the epoch in big endian, the client fills
+ * @client_metadata_send, the server fills the others in place.
+ */
+typedef struct priskv_request_trace {
+    uint64_t client_metadata_send; // Step 1: Client sends metadata request time
+    uint64_t server_metadata_recv; // Step 2: Server receives metadata request time
+    uint64_t server_rw_kv;         // Step 3: Server reads/writes KV data time
+    uint64_t server_data_send;     // Step 4: Server sends data request time
+    uint64_t server_data_recv;     // Step 5: Server receives data request completion time
+    uint64_t server_resp_send;     // Step 6: Server sends response time
+} priskv_request_trace;
+
+/*
+ * flags of request
+ *
+ * PRISKV_REQUEST_FLAG_INLINE: the value travels inside the SEND payload instead of RDMA READ/WRITE.
+ *   SET: the value follows the key, @nsgl is 0 and @key_length is mandatory.
+ *   GET: the value follows @priskv_response on success, the SGLs only describe the expected length.
+ *   The value must not exceed @max_inline_value of @priskv_rdma_cm_rep.
+ * PRISKV_REQUEST_FLAG_TRACE: a @priskv_request_trace ends the request message, after the key and
+ *   the inline value. The client samples the requests to trace, untraced ones carry nothing.
+ * PRISKV_REQUEST_FLAG_RANGE: GET transfers up to the length of SGLs from @offset of the value, the
+ *   response carries the transferred length. @offset beyond the value responds
+ *   PRISKV_RESP_STATUS_INVALID_RANGE with the value length.
+ * PRISKV_REQUEST_FLAG_NX: SET(or RESERVE) only if the key is absent.
+ * PRISKV_REQUEST_FLAG_VERSION: SET(or RESERVE) the key with the lower 32 bits of @version, only if
+ *   the key is absent or the version of it is less. A key set without this flag has version 0.
+ * Either condition is checked before any allocation or data transfer, a key in the way responds
+ *   PRISKV_RESP_STATUS_KEY_EXISTS with the value length. Not supported in tiering mode.
  */
-typedef struct priskv_request_runtime {
-    struct timeval server_metadata_recv_time; // Step 2: Server receives metadata request time
-    struct timeval server_rw_kv_time;         // Step 3: Server reads/writes KV data time
-    struct timeval server_data_send_time;     // Step 4: Server sends data request time
-    struct timeval server_data_recv_time;     // Step 5: Server receives data request completion time
-    struct timeval server_resp_send_time;     // Step 6: Server sends response time
+#define PRISKV_REQUEST_FLAG_INLINE (1 << 0)
+#define PRISKV_REQUEST_FLAG_TRACE (1 << 1)
+#define PRISKV_REQUEST_FLAG_RANGE (1 << 2)
+#define PRISKV_REQUEST_FLAG_NX (1 << 3)
+#define PRISKV_REQUEST_FLAG_VERSION (1 << 4)
 
-    struct timeval client_metadata_send_time; // Step 1: Client sends metadata request time
-} priskv_request_runtime;
+/*
+ * priority of request, the server schedules the requests of a worker thread by weighted fair
+ * queueing among priorities. An unknown priority is treated as PRISKV_REQUEST_PRIORITY_NORMAL.
+ */
+typedef enum priskv_request_priority {
+    PRISKV_REQUEST_PRIORITY_NORMAL = 0x00,
+    PRISKV_REQUEST_PRIORITY_HIGH = 0x01,
+    PRISKV_REQUEST_PRIORITY_LOW = 0x02,
+} priskv_request_priority;
 
 /*
  * request from client, submitted by @IBV_WR_SEND
@@ -92,10 +159,15 @@ typedef struct priskv_request {
     uint64_t request_id;
     uint64_t timeout; /* in ms */
     uint16_t command; /* priskv_req_command */
-    uint8_t reserved[4];
+    uint8_t flags;    /* PRISKV_REQUEST_FLAG_* */
+    uint8_t priority; /* priskv_request_priority */
+    uint8_t reserved[2];
     uint16_t nsgl; /* how many SGL contains following */
     uint16_t key_length;
-    priskv_request_runtime runtime;
+    union {
+        uint64_t offset;  /* of value, PRISKV_REQUEST_FLAG_RANGE only */
+        uint64_t version; /* PRISKV_REQUEST_FLAG_VERSION only */
+    };
     priskv_keyed_sgl sgls[0];
 } priskv_request;
 
@@ -117,25 +189,36 @@ typedef enum priskv_resp_status {
     PRISKV_RESP_STATUS_KEY_UPDATING,
     PRISKV_RESP_STATUS_CONNECT_ERROR,
     PRISKV_RESP_STATUS_SERVER_ERROR,
+    PRISKV_RESP_STATUS_INVALID_RANGE,
+    PRISKV_RESP_STATUS_KEY_EXISTS,
 
     PRISKV_RESP_STATUS_NO_MEM = 0x200
 } priskv_resp_status;
 
 /*
  * response to client, submitted by @IBV_WR_SEND
+ * [priskv_response][inline value] on PRISKV_REQUEST_FLAG_INLINE GET,
+ * [priskv_response][priskv_reserve_resp] on PRISKV_COMMAND_RESERVE, otherwise [priskv_response]
+ *
+ * @credits: the commands the client may keep in flight on this connection since now, it never
+ * exceeds @max_inflight_command of @priskv_rdma_cm_rep. The server grants less credits on the
+ * backlog of itself. 0 means no flow control.
  */
 typedef struct priskv_response {
     uint64_t request_id;
     uint64_t timeout; /* in ms */
     uint32_t length;  /* the length of value */
     uint16_t status;  /* priskv_resp_status */
-    uint8_t reserved[10];
+    uint16_t credits;
+    uint8_t reserved[8];
 } priskv_response;
 
 /*
- * currently version 0x01 is supported only.
+ * currently version 0x03 is supported only. Version 0x01 embedded a trace block of six
+ * struct timeval into every request, version 0x02 carries it on PRISKV_REQUEST_FLAG_TRACE only.
+ * Version 0x03 adds @offset to @priskv_request.
  */
-#define PRISKV_RDMA_CM_VERSION 0x01
+#define PRISKV_RDMA_CM_VERSION 0x03
 
 /*
  * rdma connect request
@@ -144,21 +227,28 @@ typedef struct priskv_response {
  * @max_sgl: request max SGLs from client.
  * @max_key_length: request max key length in bytes from client.
  * @max_inflight_command: request max inflight command(aka command depth) from client.
+ * @max_inline_value: request max inline value length in bytes from client.
  *
  * @max_sgl, @max_key_length, @max_inflight_command must be less than or equal to the
  * limitations from the server side, otherwise the server rejects connection. Or specify 0 to
- * use the maximum value from server.
+ * use the maximum value from server. @max_inline_value is clamped to the server limitation, 0
+ * disables inline value on the connection.
  */
 typedef struct priskv_rdma_cm_req {
     uint16_t version;
     uint16_t max_sgl;
     uint16_t max_key_length;
     uint16_t max_inflight_command;
-    uint8_t reserved[24];
+    uint16_t max_inline_value;
+    uint8_t reserved[22];
 } priskv_rdma_cm_req;
 
 /*
  * rdma connect reply
+ *
+ * @max_inline_value: the max value length carried by PRISKV_REQUEST_FLAG_INLINE, 0 means
+ * unsupported.
+ * @index_rkey, @index_addr: the @priskv_index_header for one-sided GET, 0 means unsupported.
  */
 typedef struct priskv_rdma_cm_rep {
     uint16_t version;
@@ -166,9 +256,48 @@ typedef struct priskv_rdma_cm_rep {
     uint16_t max_key_length;
     uint16_t max_inflight_command;
     uint64_t capacity;
-    uint8_t reserved[16];
+    uint16_t max_inline_value;
+    uint8_t reserved[2];
+    uint32_t index_rkey;
+    uint64_t index_addr;
 } priskv_rdma_cm_rep;
 
+/*
+ * header of the index exported by server for one-sided GET, read by client after connected.
+ * [priskv_index_header][seg_rkeys[nsegs]]
+ *
+ * The value at @value_off of an entry is located in segment (@value_off / @seg_size), the address
+ * is (@value_base + @value_off).
+ */
+typedef struct priskv_index_header {
+    uint64_t entries_addr;
+    uint32_t entries_rkey;
+    uint32_t nentries;
+    uint64_t value_base;
+    uint64_t seg_size;
+    uint32_t nsegs;
+    uint32_t reserved;
+    uint32_t seg_rkeys[0];
+} priskv_index_header;
+
+/*
+ * entry of the one-sided GET index, a key is placed at (priskv_index_keyhash() % @nentries). The
+ * entry is a hint only, a key may be absent because of a hash conflict.
+ *
+ * The server bumps @version to odd before updating an entry or freeing the value, and bumps it to
+ * even after that. A client reads the entry, then reads the value and the entry again by a single
+ * post(READs are executed in order), the value is valid if both @version are the same and even.
+ * Otherwise the client falls back to PRISKV_COMMAND_GET.
+ */
+typedef struct priskv_index_entry {
+    uint64_t version;
+    uint64_t keyhash;
+    uint64_t value_off;
+    uint32_t valuelen; /* 0 means empty entry */
+    uint16_t keylen;
+    uint8_t reserved[34];
+} __attribute__((aligned(64))) priskv_index_entry;
+
 /*
  * status on RDMA CM rejection
  */
@@ -193,6 +322,26 @@ typedef struct priskv_rdma_cm_rej {
     uint64_t value; /* indicate the supported value */
 } priskv_rdma_cm_rej;
 
+/*
+ * TCP transport, for hosts without RDMA device.
+ *
+ * The client sends @priskv_rdma_cm_req, the server replies @priskv_tcp_cm_reply, and closes the
+ * connection on rejection. Then the request and the response follow the same framing as RDMA,
+ * except that the value travels in the stream instead of RDMA READ/WRITE:
+ *   request:  [priskv_request][sgls[nsgl]][key][priskv_request_trace][value of SET]
+ *   response: [priskv_response][value of GET/KEYS]
+ * The SGLs only describe the length of value, @addr and @key are ignored. @key_length is mandatory.
+ * PRISKV_COMMAND_RESERVE and PRISKV_COMMAND_COMMIT are not supported.
+ */
+typedef struct priskv_tcp_cm_reply {
+    uint16_t status; /* 0 on acceptance, otherwise priskv_rdma_cm_status */
+    uint8_t reserved[6];
+    union {
+        priskv_rdma_cm_rep rep;
+        priskv_rdma_cm_rej rej;
+    };
+} priskv_tcp_cm_reply;
+
 /*
  *assuming max timeout means no timeout
  */
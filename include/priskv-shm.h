@@ -0,0 +1,199 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#ifndef __PRISKV_SHM__
+#define __PRISKV_SHM__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Same-host transport. A memfd holds a page of header and two byte rings, the requests from client
+ * to server and the responses back, in the same framing as TCP (see priskv_tcp_cm_reply). Each
+ * ring is mapped twice back to back, so any window of up to @size bytes is contiguous in memory
+ * and the values are copied in and out by a single memcpy.
+ *
+ * Each ring has a single producer and a single consumer. A consumer marks itself waiting before
+ * sleeping on its eventfd, a producer kicks the eventfd only if the consumer is waiting. Also a
+ * producer waits for the space of a full ring in the same way.
+ *
+ * The server creates the socket directory private to its user, and only accepts the peers whose
+ * uid is its own or allowed by --shm-allow-uid. A client tries shm only if $PRISKV_SHM is 1, and
+ * only talks to a server running as its own user, root or $PRISKV_SHM_SERVER_UID.
+ */
+#define PRISKV_SHM_MAGIC 0x5052534d /* "PRSM" */
+#define PRISKV_SHM_DEFAULT_DIR "/tmp/priskv-shm"
+#define PRISKV_SHM_DEFAULT_RING_SIZE (4UL * 1024 * 1024)
+#define PRISKV_SHM_SOCK_PATH_MAX 108 /* sizeof(sockaddr_un::sun_path) */
+
+typedef enum priskv_shm_ring_type {
+    PRISKV_SHM_RING_REQ,
+    PRISKV_SHM_RING_RESP,
+
+    PRISKV_SHM_RING_MAX
+} priskv_shm_ring_type;
+
+typedef struct priskv_shm_ring {
+    uint64_t head __attribute__((aligned(64))); /* updated by consumer */
+    uint32_t producer_waiting;
+    uint64_t tail __attribute__((aligned(64))); /* updated by producer */
+    uint32_t consumer_waiting;
+} priskv_shm_ring;
+
+typedef struct priskv_shm_hdr {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t ring_size;
+    priskv_shm_ring rings[PRISKV_SHM_RING_MAX];
+} priskv_shm_hdr;
+
+typedef struct priskv_shm {
+    int memfd;
+    uint64_t ring_size;
+    priskv_shm_hdr *hdr;
+    uint8_t *data[PRISKV_SHM_RING_MAX]; /* mapped twice */
+    /*
+     * the own index of each ring, head of the consumed one and tail of the produced one. The copy
+     * in @hdr is only published to the peer, who may write anything into the shared memory
+     */
+    uint64_t pos[PRISKV_SHM_RING_MAX];
+    bool broken; /* the peer published an index out of the ring, nothing is readable or writable */
+} priskv_shm;
+
+/* create a memfd of @ring_size rings, @ring_size is rounded up to page size */
+int priskv_shm_create(priskv_shm *shm, uint64_t ring_size);
+/* map a memfd created by the peer, the @memfd is owned by @shm on success */
+int priskv_shm_attach(priskv_shm *shm, int memfd);
+void priskv_shm_detach(priskv_shm *shm);
+/* the unix socket path of a server listening to @port */
+void priskv_shm_sock_path(const char *dir, int port, char *path);
+
+static inline priskv_shm_ring *priskv_shm_get_ring(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    return &shm->hdr->rings[type];
+}
+
+/* the peer is treated as broken once its index is more than a ring away from ours */
+static inline uint64_t priskv_shm_check(priskv_shm *shm, uint64_t len)
+{
+    if (len > shm->ring_size) {
+        shm->broken = true;
+    }
+
+    return shm->broken ? 0 : len;
+}
+
+/* consumer side */
+static inline uint64_t priskv_shm_readable(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    return priskv_shm_check(shm, __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - shm->pos[type]);
+}
+
+static inline uint8_t *priskv_shm_read_ptr(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    return shm->data[type] + shm->pos[type] % shm->ring_size;
+}
+
+static inline void priskv_shm_consume(priskv_shm *shm, priskv_shm_ring_type type, uint64_t len)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    shm->pos[type] += len;
+    __atomic_store_n(&ring->head, shm->pos[type], __ATOMIC_RELEASE);
+}
+
+/* producer side */
+static inline uint64_t priskv_shm_writable(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+    uint64_t used = priskv_shm_check(shm, shm->pos[type] -
+                                              __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE));
+
+    return shm->broken ? 0 : shm->ring_size - used;
+}
+
+static inline uint8_t *priskv_shm_write_ptr(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    return shm->data[type] + shm->pos[type] % shm->ring_size;
+}
+
+static inline void priskv_shm_produce(priskv_shm *shm, priskv_shm_ring_type type, uint64_t len)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    shm->pos[type] += len;
+    __atomic_store_n(&ring->tail, shm->pos[type], __ATOMIC_RELEASE);
+}
+
+/* return true if the peer sleeps on the update of @type, the caller kicks the peer then */
+static inline bool priskv_shm_kick_consumer(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_exchange_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+static inline bool priskv_shm_kick_producer(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_exchange_n(&ring->producer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+/* return false if the caller may sleep, or true if more data arrived meanwhile */
+static inline bool priskv_shm_wait_readable(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return priskv_shm_readable(shm, type) != 0;
+}
+
+/* return false if the caller may sleep, or true if more space is released meanwhile */
+static inline bool priskv_shm_wait_writable(priskv_shm *shm, priskv_shm_ring_type type)
+{
+    priskv_shm_ring *ring = priskv_shm_get_ring(shm, type);
+
+    __atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return priskv_shm_writable(shm, type) != 0;
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __PRISKV_SHM__ */
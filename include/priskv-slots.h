@@ -0,0 +1,161 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#ifndef __PRISKV_SLOTS__
+#define __PRISKV_SLOTS__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+/*
+ * O(1) allocator of fixed count slots, a stack of free slot indexes. Not thread safe, the owner
+ * (typically a connection) serializes the get/put operations.
+ */
+typedef struct priskv_slots {
+    uint32_t *free;     /* stack of free slot indexes */
+    uint32_t nfree;
+    uint32_t nslots;
+    uint32_t peak;      /* the maximum slots in use */
+    uint64_t exhausted; /* times of getting slot from an empty stack */
+} priskv_slots;
+
+static inline int priskv_slots_init(priskv_slots *slots, uint32_t nslots)
+{
+    slots->free = malloc(sizeof(uint32_t) * nslots);
+    if (!slots->free) {
+        return -ENOMEM;
+    }
+
+    /* pop from the lowest index, keep the same order as a linear scan */
+    for (uint32_t i = 0; i < nslots; i++) {
+        slots->free[i] = nslots - 1 - i;
+    }
+
+    slots->nfree = nslots;
+    slots->nslots = nslots;
+    slots->peak = 0;
+    slots->exhausted = 0;
+
+    return 0;
+}
+
+static inline void priskv_slots_deinit(priskv_slots *slots)
+{
+    free(slots->free);
+    slots->free = NULL;
+    slots->nfree = 0;
+    slots->nslots = 0;
+}
+
+static inline uint32_t priskv_slots_inuse(priskv_slots *slots)
+{
+    return slots->nslots - slots->nfree;
+}
+
+/* return the index of a free slot, or -1 if all the slots are in use */
+static inline int64_t priskv_slots_get(priskv_slots *slots)
+{
+    if (!slots->nfree) {
+        slots->exhausted++;
+        return -1;
+    }
+
+    uint32_t idx = slots->free[--slots->nfree];
+    uint32_t inuse = priskv_slots_inuse(slots);
+    if (inuse > slots->peak) {
+        slots->peak = inuse;
+    }
+
+    return idx;
+}
+
+static inline void priskv_slots_put(priskv_slots *slots, uint32_t idx)
+{
+    slots->free[slots->nfree++] = idx;
+}
+
+/*
+ * fixed size object pool on top of priskv_slots, the objects are carved from a single buffer
+ * allocated at initialization. Not thread safe either.
+ */
+typedef struct priskv_pool {
+    uint8_t *buf;
+    uint32_t objsize;
+    priskv_slots slots;
+} priskv_pool;
+
+static inline int priskv_pool_init(priskv_pool *pool, uint32_t objsize, uint32_t nobjs)
+{
+    pool->objsize = (objsize + 7) & ~7; /* keep objects 8 bytes aligned */
+    pool->buf = calloc(nobjs, pool->objsize);
+    if (!pool->buf) {
+        return -ENOMEM;
+    }
+
+    if (priskv_slots_init(&pool->slots, nobjs)) {
+        free(pool->buf);
+        pool->buf = NULL;
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+static inline void priskv_pool_deinit(priskv_pool *pool)
+{
+    priskv_slots_deinit(&pool->slots);
+    free(pool->buf);
+    pool->buf = NULL;
+}
+
+/* return an uninitialized object, or NULL if all the objects are in use */
+static inline void *priskv_pool_get(priskv_pool *pool)
+{
+    int64_t idx = priskv_slots_get(&pool->slots);
+
+    if (idx < 0) {
+        return NULL;
+    }
+
+    return pool->buf + idx * pool->objsize;
+}
+
+static inline void priskv_pool_put(priskv_pool *pool, void *obj)
+{
+    priskv_slots_put(&pool->slots, ((uint8_t *)obj - pool->buf) / pool->objsize);
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __PRISKV_SLOTS__ */
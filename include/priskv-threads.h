@@ -47,6 +47,13 @@ typedef struct priskv_thread_hooks {
     void *arg;
 } priskv_thread_hooks;
 
+/* load of a thread, accumulated or per second */
+typedef struct priskv_thread_load {
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t busy_ns;
+} priskv_thread_load;
+
 int priskv_thread_call_function(priskv_thread *thread, int (*func)(void *arg), void *arg);
 void priskv_thread_submit_function(priskv_thread *thread, int (*func)(void *arg), void *arg);
 int priskv_thread_add_event_handler(priskv_thread *thread, int fd);
@@ -55,6 +62,14 @@ int priskv_thread_del_event_handler(priskv_thread *thread, int fd);
 void priskv_thread_set_user_data(priskv_thread *thread, void *user_data);
 void *priskv_thread_get_user_data(priskv_thread *thread);
 int priskv_thread_get_epollfd(priskv_thread *thread);
+int priskv_thread_get_index(priskv_thread *thread);
+/* the current priskv_thread, NULL if not called from a priskv_thread */
+priskv_thread *priskv_thread_self(void);
+
+/* account the load of @thread, called by @thread itself */
+void priskv_thread_account(priskv_thread *thread, uint64_t ops, uint64_t bytes, uint64_t busy_ns);
+void priskv_thread_get_load(priskv_thread *thread, priskv_thread_load *load, priskv_thread_load *rate);
+uint64_t priskv_thread_load_score(priskv_thread *thread);
 
 typedef struct priskv_threadpool priskv_threadpool;
 priskv_threadpool *priskv_threadpool_create(const char *prefix, int niothread, int nbgthread,
@@ -70,6 +85,10 @@ void priskv_threadpool_destroy(priskv_threadpool *pool);
 priskv_thread *priskv_threadpool_get_iothread(priskv_threadpool *pool, int index);
 priskv_thread *priskv_threadpool_get_bgthread(priskv_threadpool *pool, int index);
 priskv_thread *priskv_threadpool_find_iothread(priskv_threadpool *pool);
+priskv_thread *priskv_threadpool_find_busiest_iothread(priskv_threadpool *pool);
+/* update the rate of iothreads load, the rate is between the last two calls */
+void priskv_threadpool_update_load(priskv_threadpool *pool);
+int priskv_threadpool_get_niothread(priskv_threadpool *pool);
 priskv_thread *priskv_threadpool_find_bgthread(priskv_threadpool *pool);
 
 #if defined(__cplusplus)
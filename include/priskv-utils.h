@@ -104,6 +104,16 @@ static inline uint32_t priskv_min_u32(uint32_t a, uint32_t b)
     return a < b ? a : b;
 }
 
+static inline uint64_t priskv_min_u64(uint64_t a, uint64_t b)
+{
+    return a < b ? a : b;
+}
+
+static inline uint32_t priskv_max_u32(uint32_t a, uint32_t b)
+{
+    return a > b ? a : b;
+}
+
 static inline int priskv_atomic_inc(int *ptr)
 {
     return __atomic_add_fetch(ptr, 1, __ATOMIC_SEQ_CST);
@@ -94,6 +94,70 @@ void priskv_fd_handler_event(struct epoll_event *event)
     }
 }
 
+/* deferred work is per thread, in scheduling order */
+static __thread bool events_in_pass;
+static __thread priskv_event_deferred *deferred_head, *deferred_tail;
+
+void priskv_events_defer(priskv_event_deferred *deferred)
+{
+    if (!events_in_pass) {
+        deferred->fn(deferred->opaque);
+        return;
+    }
+
+    if (deferred->scheduled) {
+        return;
+    }
+
+    deferred->scheduled = true;
+    deferred->next = NULL;
+    if (deferred_tail) {
+        deferred_tail->next = deferred;
+    } else {
+        deferred_head = deferred;
+    }
+    deferred_tail = deferred;
+}
+
+void priskv_events_cancel(priskv_event_deferred *deferred)
+{
+    priskv_event_deferred *prev = NULL, *cur;
+
+    if (!deferred->scheduled) {
+        return;
+    }
+
+    for (cur = deferred_head; cur; prev = cur, cur = cur->next) {
+        if (cur == deferred) {
+            if (prev) {
+                prev->next = cur->next;
+            } else {
+                deferred_head = cur->next;
+            }
+            if (deferred_tail == cur) {
+                deferred_tail = prev;
+            }
+            break;
+        }
+    }
+    deferred->scheduled = false;
+}
+
+/* a deferred callback may defer more work, it runs in the same pass */
+static void priskv_events_run_deferred(void)
+{
+    priskv_event_deferred *deferred;
+
+    while ((deferred = deferred_head)) {
+        deferred_head = deferred->next;
+        if (!deferred_head) {
+            deferred_tail = NULL;
+        }
+        deferred->scheduled = false;
+        deferred->fn(deferred->opaque);
+    }
+}
+
 void priskv_events_process(int epollfd, int timeout)
 {
     const int maxevents = 128;
@@ -105,8 +169,11 @@ void priskv_events_process(int epollfd, int timeout)
         return;
     }
 
+    events_in_pass = true;
     for (i = 0; i < nevents; i++) {
         struct epoll_event *event = &events[i];
         priskv_fd_handler_event(event);
     }
+    priskv_events_run_deferred();
+    events_in_pass = false;
 }
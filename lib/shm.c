@@ -0,0 +1,161 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "priskv-utils.h"
+#include "priskv-shm.h"
+
+/* map [@offset, @offset + @size) of @fd twice back to back */
+static uint8_t *priskv_shm_map_mirror(int fd, uint64_t offset, uint64_t size)
+{
+    uint8_t *base;
+
+    base = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    if ((mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) ==
+         MAP_FAILED) ||
+        (mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) ==
+         MAP_FAILED)) {
+        munmap(base, size * 2);
+        return NULL;
+    }
+
+    return base;
+}
+
+static int priskv_shm_map(priskv_shm *shm)
+{
+    uint64_t page_size = getpagesize();
+
+    shm->hdr = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->memfd, 0);
+    if (shm->hdr == MAP_FAILED) {
+        shm->hdr = NULL;
+        return -errno;
+    }
+
+    for (int i = 0; i < PRISKV_SHM_RING_MAX; i++) {
+        shm->data[i] = priskv_shm_map_mirror(shm->memfd, page_size + i * shm->ring_size,
+                                             shm->ring_size);
+        if (!shm->data[i]) {
+            return -ENOMEM;
+        }
+    }
+
+    return 0;
+}
+
+int priskv_shm_create(priskv_shm *shm, uint64_t ring_size)
+{
+    uint64_t page_size = getpagesize();
+    int ret;
+
+    memset(shm, 0x00, sizeof(priskv_shm));
+    shm->ring_size = ALIGN_UP(ring_size, page_size);
+    shm->memfd = memfd_create("priskv-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (shm->memfd < 0) {
+        return -errno;
+    }
+
+    /* the peer may not shrink the memfd under the mappings of creator */
+    if (ftruncate(shm->memfd, page_size + PRISKV_SHM_RING_MAX * shm->ring_size) ||
+        fcntl(shm->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        ret = -errno;
+        goto error;
+    }
+
+    ret = priskv_shm_map(shm);
+    if (ret) {
+        goto error;
+    }
+
+    shm->hdr->magic = PRISKV_SHM_MAGIC;
+    shm->hdr->ring_size = shm->ring_size;
+
+    return 0;
+
+error:
+    priskv_shm_detach(shm);
+    return ret;
+}
+
+int priskv_shm_attach(priskv_shm *shm, int memfd)
+{
+    uint64_t page_size = getpagesize();
+    priskv_shm_hdr hdr;
+    int ret;
+
+    memset(shm, 0x00, sizeof(priskv_shm));
+    shm->memfd = -1;
+    if ((pread(memfd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) || (hdr.magic != PRISKV_SHM_MAGIC) ||
+        !hdr.ring_size || (hdr.ring_size % page_size)) {
+        return -EPROTO;
+    }
+
+    shm->memfd = memfd;
+    shm->ring_size = hdr.ring_size;
+    ret = priskv_shm_map(shm);
+    if (ret) {
+        shm->memfd = -1; /* closed by the caller */
+        priskv_shm_detach(shm);
+        return ret;
+    }
+
+    return 0;
+}
+
+void priskv_shm_detach(priskv_shm *shm)
+{
+    for (int i = 0; i < PRISKV_SHM_RING_MAX; i++) {
+        if (shm->data[i]) {
+            munmap(shm->data[i], shm->ring_size * 2);
+            shm->data[i] = NULL;
+        }
+    }
+
+    if (shm->hdr) {
+        munmap(shm->hdr, getpagesize());
+        shm->hdr = NULL;
+    }
+
+    if (shm->memfd >= 0) {
+        close(shm->memfd);
+        shm->memfd = -1;
+    }
+}
+
+void priskv_shm_sock_path(const char *dir, int port, char *path)
+{
+    snprintf(path, PRISKV_SHM_SOCK_PATH_MAX, "%s/priskv-%d.sock", dir, port);
+}
@@ -28,6 +28,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "priskv-event.h"
 
@@ -89,6 +91,52 @@ static void *test_handle_event(void *arg)
     return NULL;
 }
 
+static int deferred_runs;
+static priskv_event_deferred deferred, cancelled;
+
+static void priskv_test_deferred(void *opaque)
+{
+    deferred_runs++;
+}
+
+static void priskv_test_defer_handler(int fd, void *opaque, uint32_t events)
+{
+    uint64_t v;
+
+    assert(read(fd, &v, sizeof(v)) == sizeof(v));
+
+    /* scheduled once however many times it is deferred in one pass */
+    priskv_events_defer(&deferred);
+    priskv_events_defer(&deferred);
+    priskv_events_defer(&cancelled);
+    priskv_events_cancel(&cancelled);
+    assert(deferred_runs == 0);
+}
+
+static void test_deferred(void)
+{
+    int epollfd = epoll_create1(0);
+    int efd = eventfd(1, 0);
+    struct epoll_event event = {.data.fd = efd, .events = EPOLLIN};
+
+    assert(epollfd >= 0 && efd >= 0);
+    deferred.fn = priskv_test_deferred;
+    cancelled.fn = priskv_test_deferred;
+
+    /* outside a pass it runs right away */
+    priskv_events_defer(&deferred);
+    assert(deferred_runs == 1);
+
+    deferred_runs = 0;
+    priskv_set_fd_handler(efd, priskv_test_defer_handler, NULL, NULL);
+    assert(!epoll_ctl(epollfd, EPOLL_CTL_ADD, efd, &event));
+    priskv_events_process(epollfd, 1000);
+    assert(deferred_runs == 1 && !deferred.scheduled && !cancelled.scheduled);
+
+    close(efd);
+    close(epollfd);
+}
+
 int main()
 {
     int threads = 4;
@@ -121,5 +169,7 @@ int main()
         assert(!pthread_join(thread[i], NULL));
     }
 
+    test_deferred();
+
     return 0;
 }
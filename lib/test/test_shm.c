@@ -0,0 +1,188 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <sys/wait.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "priskv-shm.h"
+
+#define PRISKV_TEST_SHM_RING_SIZE (64 * 1024)
+
+/* a window across the end of ring is contiguous by the mirrored mapping */
+static void test_shm_wrap(void)
+{
+    priskv_shm shm, peer;
+    uint8_t buf[5000];
+
+    assert(!priskv_shm_create(&shm, PRISKV_TEST_SHM_RING_SIZE - 1));
+    assert(shm.ring_size == PRISKV_TEST_SHM_RING_SIZE);
+    assert(!priskv_shm_attach(&peer, dup(shm.memfd)));
+    assert(peer.ring_size == shm.ring_size);
+
+    /* move the head & tail close to the end */
+    priskv_shm_produce(&shm, PRISKV_SHM_RING_REQ, PRISKV_TEST_SHM_RING_SIZE - 1000);
+    assert(priskv_shm_readable(&peer, PRISKV_SHM_RING_REQ) == PRISKV_TEST_SHM_RING_SIZE - 1000);
+    priskv_shm_consume(&peer, PRISKV_SHM_RING_REQ, PRISKV_TEST_SHM_RING_SIZE - 1000);
+    assert(priskv_shm_writable(&shm, PRISKV_SHM_RING_REQ) == PRISKV_TEST_SHM_RING_SIZE);
+
+    for (int i = 0; i < sizeof(buf); i++) {
+        buf[i] = i & 0xff;
+    }
+    memcpy(priskv_shm_write_ptr(&shm, PRISKV_SHM_RING_REQ), buf, sizeof(buf));
+    priskv_shm_produce(&shm, PRISKV_SHM_RING_REQ, sizeof(buf));
+
+    assert(priskv_shm_readable(&peer, PRISKV_SHM_RING_REQ) == sizeof(buf));
+    assert(!memcmp(priskv_shm_read_ptr(&peer, PRISKV_SHM_RING_REQ), buf, sizeof(buf)));
+    /* the wrapped part lives at the beginning of ring */
+    assert(!memcmp(peer.data[PRISKV_SHM_RING_REQ], buf + 1000, sizeof(buf) - 1000));
+    priskv_shm_consume(&peer, PRISKV_SHM_RING_REQ, sizeof(buf));
+
+    /* the response ring is independent */
+    assert(!priskv_shm_readable(&shm, PRISKV_SHM_RING_RESP));
+
+    priskv_shm_detach(&peer);
+    priskv_shm_detach(&shm);
+}
+
+static void test_shm_wait(void)
+{
+    priskv_shm shm, peer;
+
+    assert(!priskv_shm_create(&shm, PRISKV_TEST_SHM_RING_SIZE));
+    assert(!priskv_shm_attach(&peer, dup(shm.memfd)));
+
+    /* no kick until the consumer waits */
+    assert(!priskv_shm_wait_readable(&peer, PRISKV_SHM_RING_RESP));
+    priskv_shm_produce(&shm, PRISKV_SHM_RING_RESP, 1);
+    assert(priskv_shm_kick_consumer(&shm, PRISKV_SHM_RING_RESP));
+    assert(!priskv_shm_kick_consumer(&shm, PRISKV_SHM_RING_RESP));
+    assert(priskv_shm_wait_readable(&peer, PRISKV_SHM_RING_RESP));
+
+    /* a full ring */
+    priskv_shm_produce(&shm, PRISKV_SHM_RING_REQ, PRISKV_TEST_SHM_RING_SIZE);
+    assert(!priskv_shm_writable(&shm, PRISKV_SHM_RING_REQ));
+    assert(!priskv_shm_wait_writable(&shm, PRISKV_SHM_RING_REQ));
+    priskv_shm_consume(&peer, PRISKV_SHM_RING_REQ, 10);
+    assert(priskv_shm_kick_producer(&peer, PRISKV_SHM_RING_REQ));
+    assert(priskv_shm_writable(&shm, PRISKV_SHM_RING_REQ) == 10);
+
+    priskv_shm_detach(&peer);
+    priskv_shm_detach(&shm);
+}
+
+/* the indexes published by a peer out of the ring are detected, never followed */
+static void test_shm_broken(void)
+{
+    priskv_shm shm, peer;
+
+    assert(!priskv_shm_create(&shm, PRISKV_TEST_SHM_RING_SIZE));
+    assert(!priskv_shm_attach(&peer, dup(shm.memfd)));
+
+    /* the memfd is sealed against shrinking under the mappings */
+    assert(ftruncate(peer.memfd, 0) < 0);
+
+    /* the peer rewrites the index owned by us, which is private */
+    priskv_shm_produce(&peer, PRISKV_SHM_RING_REQ, 100);
+    priskv_shm_get_ring(&peer, PRISKV_SHM_RING_REQ)->head = 50;
+    assert(priskv_shm_readable(&shm, PRISKV_SHM_RING_REQ) == 100);
+    priskv_shm_consume(&shm, PRISKV_SHM_RING_REQ, 100);
+    assert(!priskv_shm_readable(&shm, PRISKV_SHM_RING_REQ) && !shm.broken);
+
+    /* a tail more than a ring ahead */
+    priskv_shm_get_ring(&peer, PRISKV_SHM_RING_REQ)->tail = 100 + PRISKV_TEST_SHM_RING_SIZE + 1;
+    assert(!priskv_shm_readable(&shm, PRISKV_SHM_RING_REQ) && shm.broken);
+    priskv_shm_get_ring(&peer, PRISKV_SHM_RING_REQ)->tail = 200;
+    assert(!priskv_shm_readable(&shm, PRISKV_SHM_RING_REQ));
+    priskv_shm_detach(&shm);
+
+    /* a head behind the tail, or ahead of it */
+    assert(!priskv_shm_create(&shm, PRISKV_TEST_SHM_RING_SIZE));
+    priskv_shm_get_ring(&shm, PRISKV_SHM_RING_RESP)->head = 1;
+    assert(!priskv_shm_writable(&shm, PRISKV_SHM_RING_RESP) && shm.broken);
+    assert(!priskv_shm_wait_writable(&shm, PRISKV_SHM_RING_RESP));
+
+    priskv_shm_detach(&peer);
+    priskv_shm_detach(&shm);
+}
+
+/* stream random sized messages from a child process */
+static void test_shm_stream(void)
+{
+    priskv_shm shm;
+    uint64_t sent = 0, received = 0, total = 64 * PRISKV_TEST_SHM_RING_SIZE;
+    pid_t pid;
+    int status;
+
+    assert(!priskv_shm_create(&shm, PRISKV_TEST_SHM_RING_SIZE));
+
+    pid = fork();
+    assert(pid >= 0);
+    if (!pid) {
+        srand(1);
+        while (sent < total) {
+            uint64_t len = priskv_shm_writable(&shm, PRISKV_SHM_RING_REQ);
+            uint8_t *ptr = priskv_shm_write_ptr(&shm, PRISKV_SHM_RING_REQ);
+
+            len = len < (total - sent) ? len : (total - sent);
+            len = len ? rand() % len + 1 : 0;
+            for (uint64_t i = 0; i < len; i++) {
+                ptr[i] = (sent + i) & 0xff;
+            }
+            priskv_shm_produce(&shm, PRISKV_SHM_RING_REQ, len);
+            sent += len;
+        }
+        _exit(0);
+    }
+
+    while (received < total) {
+        uint64_t len = priskv_shm_readable(&shm, PRISKV_SHM_RING_REQ);
+        uint8_t *ptr = priskv_shm_read_ptr(&shm, PRISKV_SHM_RING_REQ);
+
+        for (uint64_t i = 0; i < len; i++) {
+            assert(ptr[i] == ((received + i) & 0xff));
+        }
+        priskv_shm_consume(&shm, PRISKV_SHM_RING_REQ, len);
+        received += len;
+    }
+
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && !WEXITSTATUS(status));
+    priskv_shm_detach(&shm);
+}
+
+int main()
+{
+    test_shm_wrap();
+    test_shm_wait();
+    test_shm_broken();
+    test_shm_stream();
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "priskv-slots.h"
+
+#define PRISKV_TEST_SLOTS 4096
+
+static void test_slots_basic(void)
+{
+    priskv_slots slots;
+    bool used[PRISKV_TEST_SLOTS];
+
+    memset(used, 0x00, sizeof(used));
+    assert(!priskv_slots_init(&slots, PRISKV_TEST_SLOTS));
+
+    /* the lowest index first */
+    for (uint32_t i = 0; i < PRISKV_TEST_SLOTS; i++) {
+        int64_t idx = priskv_slots_get(&slots);
+        assert(idx == i);
+        assert(!used[idx]);
+        used[idx] = true;
+    }
+
+    assert(priskv_slots_inuse(&slots) == PRISKV_TEST_SLOTS);
+    assert(slots.peak == PRISKV_TEST_SLOTS);
+    assert(priskv_slots_get(&slots) == -1);
+    assert(slots.exhausted == 1);
+
+    /* the latest released slot is reused first */
+    priskv_slots_put(&slots, 100);
+    priskv_slots_put(&slots, 7);
+    assert(priskv_slots_inuse(&slots) == PRISKV_TEST_SLOTS - 2);
+    assert(priskv_slots_get(&slots) == 7);
+    assert(priskv_slots_get(&slots) == 100);
+
+    for (uint32_t i = 0; i < PRISKV_TEST_SLOTS; i++) {
+        priskv_slots_put(&slots, i);
+    }
+    assert(!priskv_slots_inuse(&slots));
+    assert(slots.peak == PRISKV_TEST_SLOTS);
+
+    priskv_slots_deinit(&slots);
+}
+
+static void test_slots_random(void)
+{
+    priskv_slots slots;
+    int64_t inuse[PRISKV_TEST_SLOTS];
+    uint32_t ninuse = 0;
+    bool used[PRISKV_TEST_SLOTS];
+
+    memset(used, 0x00, sizeof(used));
+    assert(!priskv_slots_init(&slots, PRISKV_TEST_SLOTS));
+
+    srand(0);
+    for (int loop = 0; loop < 1000000; loop++) {
+        if ((rand() % 2) && ninuse) {
+            uint32_t pos = rand() % ninuse;
+            int64_t idx = inuse[pos];
+
+            inuse[pos] = inuse[--ninuse];
+            assert(used[idx]);
+            used[idx] = false;
+            priskv_slots_put(&slots, idx);
+        } else {
+            int64_t idx = priskv_slots_get(&slots);
+            if (ninuse == PRISKV_TEST_SLOTS) {
+                assert(idx == -1);
+                continue;
+            }
+
+            assert(idx >= 0 && idx < PRISKV_TEST_SLOTS);
+            assert(!used[idx]);
+            used[idx] = true;
+            inuse[ninuse++] = idx;
+        }
+
+        assert(priskv_slots_inuse(&slots) == ninuse);
+    }
+
+    priskv_slots_deinit(&slots);
+}
+
+static void test_pool(void)
+{
+    priskv_pool pool;
+    uint8_t *objs[PRISKV_TEST_SLOTS];
+
+    /* objsize is rounded up to 8 bytes */
+    assert(!priskv_pool_init(&pool, 13, PRISKV_TEST_SLOTS));
+    assert(pool.objsize == 16);
+
+    for (uint32_t i = 0; i < PRISKV_TEST_SLOTS; i++) {
+        objs[i] = priskv_pool_get(&pool);
+        assert(objs[i] == pool.buf + i * pool.objsize);
+        memset(objs[i], i & 0xff, 13);
+    }
+    assert(!priskv_pool_get(&pool));
+
+    for (uint32_t i = 0; i < PRISKV_TEST_SLOTS; i++) {
+        assert(objs[i][12] == (i & 0xff));
+    }
+
+    priskv_pool_put(&pool, objs[42]);
+    assert(priskv_pool_get(&pool) == objs[42]);
+
+    for (uint32_t i = 0; i < PRISKV_TEST_SLOTS; i++) {
+        priskv_pool_put(&pool, objs[i]);
+    }
+    assert(!priskv_slots_inuse(&pool.slots));
+
+    priskv_pool_deinit(&pool);
+}
+
+int main()
+{
+    test_slots_basic();
+    test_slots_random();
+    test_pool();
+
+    return 0;
+}
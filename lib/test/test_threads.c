@@ -56,6 +56,41 @@ static void test_timer_pollin(int fd, void *opaque, uint32_t events)
     printf("Timer HIT: %d\n", t->counter);
 }
 
+static int test_account(void *arg)
+{
+    priskv_thread *thread = arg;
+
+    assert(priskv_thread_self() == thread);
+    priskv_thread_account(thread, 1000, 4096 * 1000, 500 * 1000 * 1000);
+
+    return 0;
+}
+
+static void test_load(priskv_threadpool *pool)
+{
+    priskv_thread *busy = priskv_threadpool_get_iothread(pool, 0);
+    priskv_thread *idle = priskv_threadpool_get_iothread(pool, 1);
+    priskv_thread_load load, rate;
+
+    assert(!priskv_thread_self());
+    priskv_thread_call_function(busy, test_account, busy);
+    priskv_threadpool_update_load(pool);
+
+    priskv_thread_get_load(busy, &load, &rate);
+    assert(load.ops == 1000);
+    assert(load.bytes == 4096 * 1000);
+    assert(load.busy_ns == 500 * 1000 * 1000);
+    assert(rate.busy_ns > 0);
+
+    priskv_thread_get_load(idle, &load, &rate);
+    assert(!load.ops && !rate.busy_ns);
+
+    assert(priskv_threadpool_find_iothread(pool) == idle);
+    assert(priskv_threadpool_find_busiest_iothread(pool) == busy);
+    printf("Load: busy thread %d, idle thread %d\n", priskv_thread_get_index(busy),
+           priskv_thread_get_index(idle));
+}
+
 int main()
 {
     // priskv_set_log_level(priskv_log_debug);
@@ -96,6 +131,8 @@ int main()
 
     assert(timer.counter > (TEST_DURATION * 1000 * 1000 * 1000 / TEST_INTERVAL));
 
+    test_load(pool);
+
     priskv_threadpool_destroy(pool);
 
     return 0;
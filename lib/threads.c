@@ -44,6 +44,9 @@
 #define PRISKV_THREAD_INVALID_THREAD 0xff
 #define PRISKV_THREAD_MAX_THREAD (PRISKV_THREAD_INVALID_THREAD - 1)
 
+/* an event handler weighs as 1% busy of an iothread, spread new handlers among idle threads */
+#define PRISKV_THREAD_EVENT_BUSY_NS (10 * 1000 * 1000)
+
 /* Thread-local storage for priskv_thread pointer */
 static __thread priskv_thread *thread_self_ptr = NULL;
 
@@ -55,6 +58,10 @@ struct priskv_thread {
     int nevent; /* atomic */
     int epollfd;
 
+    priskv_thread_load load; /* accumulated by the thread itself, atomic */
+    priskv_thread_load last; /* snapshot of @load on priskv_threadpool_update_load */
+    priskv_thread_load rate; /* per second, between the last two priskv_threadpool_update_load */
+
     priskv_threadpool *pool;
     priskv_workqueue *wq;
 
@@ -71,6 +78,8 @@ struct priskv_threadpool {
     pthread_barrier_t barrier;
 
     struct priskv_thread_hooks *hooks;
+
+    struct timespec load_ts; /* the last priskv_threadpool_update_load */
 };
 
 static void priskv_thread_setname(priskv_thread *thd, const char *prefix, const char *infix, int index)
@@ -227,6 +236,38 @@ int priskv_thread_get_epollfd(priskv_thread *thread)
     return thread->epollfd;
 }
 
+int priskv_thread_get_index(priskv_thread *thread)
+{
+    return thread->index;
+}
+
+priskv_thread *priskv_thread_self(void)
+{
+    return thread_self_ptr;
+}
+
+void priskv_thread_account(priskv_thread *thread, uint64_t ops, uint64_t bytes, uint64_t busy_ns)
+{
+    __atomic_fetch_add(&thread->load.ops, ops, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&thread->load.bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&thread->load.busy_ns, busy_ns, __ATOMIC_RELAXED);
+}
+
+void priskv_thread_get_load(priskv_thread *thread, priskv_thread_load *load, priskv_thread_load *rate)
+{
+    if (load) {
+        load->ops = __atomic_load_n(&thread->load.ops, __ATOMIC_RELAXED);
+        load->bytes = __atomic_load_n(&thread->load.bytes, __ATOMIC_RELAXED);
+        load->busy_ns = __atomic_load_n(&thread->load.busy_ns, __ATOMIC_RELAXED);
+    }
+
+    if (rate) {
+        rate->ops = __atomic_load_n(&thread->rate.ops, __ATOMIC_RELAXED);
+        rate->bytes = __atomic_load_n(&thread->rate.bytes, __ATOMIC_RELAXED);
+        rate->busy_ns = __atomic_load_n(&thread->rate.busy_ns, __ATOMIC_RELAXED);
+    }
+}
+
 priskv_threadpool *priskv_threadpool_create(const char *prefix, int niothread, int nbgthread, int flags)
 {
     return priskv_threadpool_create_with_hooks(prefix, niothread, nbgthread, flags, NULL);
@@ -285,6 +326,7 @@ priskv_threadpool *priskv_threadpool_create_with_hooks(const char *prefix, int n
     }
 
     pthread_barrier_wait(&pool->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &pool->load_ts);
 
     return pool;
 }
@@ -319,6 +361,11 @@ priskv_thread *priskv_threadpool_get_iothread(priskv_threadpool *pool, int index
     return pool->iothreads + index;
 }
 
+int priskv_threadpool_get_niothread(priskv_threadpool *pool)
+{
+    return pool->niothread;
+}
+
 priskv_thread *priskv_threadpool_get_bgthread(priskv_threadpool *pool, int index)
 {
     if (index < 0 || index >= pool->nbgthread) {
@@ -343,18 +390,77 @@ int priskv_threadpool_for_each_iothread(priskv_threadpool *pool, priskv_threadpo
     return ret;
 }
 
+/* calculate the load rate of iothreads since the last call, called by a single thread */
+void priskv_threadpool_update_load(priskv_threadpool *pool)
+{
+    struct timespec now;
+    uint64_t elapsed_ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ns = (now.tv_sec - pool->load_ts.tv_sec) * 1000000000UL + now.tv_nsec -
+                 pool->load_ts.tv_nsec;
+    if (!elapsed_ns) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < pool->niothread; i++) {
+        priskv_thread *thd = pool->iothreads + i;
+        priskv_thread_load load;
+
+        priskv_thread_get_load(thd, &load, NULL);
+        __atomic_store_n(&thd->rate.ops, (load.ops - thd->last.ops) * 1000000000UL / elapsed_ns,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&thd->rate.bytes,
+                         (load.bytes - thd->last.bytes) * 1000000000UL / elapsed_ns,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&thd->rate.busy_ns,
+                         (load.busy_ns - thd->last.busy_ns) * 1000000000UL / elapsed_ns,
+                         __ATOMIC_RELAXED);
+        thd->last = load;
+    }
+
+    pool->load_ts = now;
+}
+
+/* the load score of an iothread: recent busy time per second, plus a weight of event handlers */
+uint64_t priskv_thread_load_score(priskv_thread *thread)
+{
+    uint64_t busy_ns = __atomic_load_n(&thread->rate.busy_ns, __ATOMIC_RELAXED);
+
+    return busy_ns + (uint64_t)priskv_atomic_get(&thread->nevent) * PRISKV_THREAD_EVENT_BUSY_NS;
+}
+
 /* find the idlest iothread */
 priskv_thread *priskv_threadpool_find_iothread(priskv_threadpool *pool)
 {
-    int min_event = INT_MAX;
+    uint64_t min_score = UINT64_MAX;
     priskv_thread *thread = NULL;
 
     for (uint8_t i = 0; i < pool->niothread; i++) {
         priskv_thread *thd = pool->iothreads + i;
 
-        int thd_nevent = priskv_atomic_get(&thd->nevent);
-        if (thd_nevent < min_event) {
-            min_event = thd_nevent;
+        uint64_t score = priskv_thread_load_score(thd);
+        if (score < min_score) {
+            min_score = score;
+            thread = thd;
+        }
+    }
+
+    return thread;
+}
+
+/* find the busiest iothread */
+priskv_thread *priskv_threadpool_find_busiest_iothread(priskv_threadpool *pool)
+{
+    uint64_t max_score = 0;
+    priskv_thread *thread = pool->iothreads;
+
+    for (uint8_t i = 0; i < pool->niothread; i++) {
+        priskv_thread *thd = pool->iothreads + i;
+
+        uint64_t score = priskv_thread_load_score(thd);
+        if (score > max_score) {
+            max_score = score;
             thread = thd;
         }
     }
@@ -66,6 +66,14 @@ class PriskvClient:
             timeout: int = client.PRISKV_KEY_MAX_TIMEOUT) -> int:
         return client.set(self.conn, key, sgl, nsgl, timeout)
 
+    def setnx(self,
+              key: str,
+              sgl: client.SGL,
+              value_len: int,
+              nsgl: int = 1,
+              timeout: int = client.PRISKV_KEY_MAX_TIMEOUT) -> int:
+        return client.setnx(self.conn, key, sgl, nsgl, timeout, value_len)
+
     def setstr(self,
                key: str,
                value: str,
@@ -79,6 +87,14 @@ class PriskvClient:
             nsgl: int = 1) -> int:
         return client.get(self.conn, key, sgl, nsgl, value_len)
 
+    def get_range(self,
+                  key: str,
+                  sgl: client.SGL,
+                  offset: int,
+                  value_len: int,
+                  nsgl: int = 1) -> int:
+        return client.get_range(self.conn, key, sgl, nsgl, offset, value_len)
+
     def getstr(self, key: str) -> Optional[str]:
         val = client.getstr(self.conn, key)
         return val if len(val) > 0 else None
@@ -74,6 +74,19 @@ int priskv_set_wrapper(uintptr_t client, std::string key,
     return priskvClusterSet((priskvClusterClient *)client, key.c_str(), &sgl, nsgl, timeout);
 }
 
+int priskv_setnx_wrapper(uintptr_t client, std::string key,
+                       priskv_sgl_wrapper *sgl_wrapper, uint16_t nsgl, uint64_t timeout,
+                       uint32_t *valuelen)
+{
+    priskvClusterSGL sgl;
+
+    sgl.iova = sgl_wrapper->iova;
+    sgl.length = sgl_wrapper->length;
+    sgl.mem = (priskvClusterMemory *)sgl_wrapper->mem;
+    return priskvClusterSetNX((priskvClusterClient *)client, key.c_str(), &sgl, nsgl, timeout,
+                              valuelen);
+}
+
 int priskv_setstr_wrapper(uintptr_t client, std::string key, std::string value, uint64_t timeout)
 {
     int ret;
@@ -128,6 +141,19 @@ int priskv_get_wrapper(uintptr_t client, std::string key,
     return priskvClusterGet((priskvClusterClient *)client, key.c_str(), &sgl, nsgl, valuelen);
 }
 
+int priskv_get_range_wrapper(uintptr_t client, std::string key,
+                           priskv_sgl_wrapper *sgl_wrapper, uint16_t nsgl, uint64_t offset,
+                           uint32_t *valuelen)
+{
+    priskvClusterSGL sgl;
+
+    sgl.iova = sgl_wrapper->iova;
+    sgl.length = sgl_wrapper->length;
+    sgl.mem = (priskvClusterMemory *)sgl_wrapper->mem;
+    return priskvClusterGetRange((priskvClusterClient *)client, key.c_str(), &sgl, nsgl, offset,
+                                 valuelen);
+}
+
 std::string priskv_getstr_wrapper(uintptr_t client, std::string key)
 {
     priskvClusterSGL sgl;
@@ -261,9 +287,11 @@ PYBIND11_MODULE(_priskv_client, m)
     m.def("reg_memory", &priskv_reg_memory_wrapper, "A function to register memory.");
     m.def("dereg_memory", &priskv_dereg_memory_wrapper, "A function to dereg memory.");
     m.def("set", &priskv_set_wrapper, "A function to set key-val.");
+    m.def("setnx", &priskv_setnx_wrapper, "A function to set key-val if key is absent.");
     m.def("setstr", &priskv_setstr_wrapper, "A function to set key-strval.");
     m.def("getstr", &priskv_getstr_wrapper, "A function to get key-strval.");
     m.def("get", &priskv_get_wrapper, "A function to get key-val.");
+    m.def("get_range", &priskv_get_range_wrapper, "A function to get a range of key-val.");
     m.def("exists", &priskv_test_wrapper, "A function to exists key-val.");
     m.def("delete", &priskv_delete_wrapper, "A function to delete key-val.");
     m.def("mset", &priskv_mset_wrapper, "A function to mset key-val.");
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
+#include <errno.h>
 
 #include "list.h"
 #include "backend.h"
@@ -416,6 +417,52 @@ void priskv_backend_test(priskv_backend_device *bdev, const char *key, priskv_ba
 /* Backend lifecycle management */
 char *tiering_backend_address = NULL;
 bool tiering_enabled = false;
+priskv_tiering_write_mode tiering_write_mode = PRISKV_TIERING_WRITE_THROUGH;
+
+static const char *priskv_tiering_write_modes[PRISKV_TIERING_WRITE_MAX] = {
+    [PRISKV_TIERING_WRITE_AROUND] = "around",
+    [PRISKV_TIERING_WRITE_THROUGH] = "through",
+    [PRISKV_TIERING_WRITE_BACK] = "back",
+    [PRISKV_TIERING_WRITE_DEMOTE] = "demote",
+};
+
+static struct {
+    uint8_t *base;
+    uint64_t size;
+    uint32_t block_size;
+} priskv_backend_value_region;
+
+void priskv_backend_set_value_region(uint8_t *base, uint64_t size, uint32_t block_size)
+{
+    priskv_backend_value_region.base = base;
+    priskv_backend_value_region.size = size;
+    priskv_backend_value_region.block_size = block_size;
+}
+
+bool priskv_backend_get_value_region(uint8_t **base, uint64_t *size, uint32_t *block_size)
+{
+    if (!priskv_backend_value_region.base) {
+        return false;
+    }
+
+    *base = priskv_backend_value_region.base;
+    *size = priskv_backend_value_region.size;
+    *block_size = priskv_backend_value_region.block_size;
+
+    return true;
+}
+
+int priskv_backend_parse_write_mode(const char *name, priskv_tiering_write_mode *mode)
+{
+    for (int i = 0; i < PRISKV_TIERING_WRITE_MAX; i++) {
+        if (!strcmp(name, priskv_tiering_write_modes[i])) {
+            *mode = i;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
 
 
 static void priskv_thread_backend_init_hook(priskv_thread *thd, void *arg)
@@ -122,4 +122,30 @@ static inline bool priskv_backend_tiering_enabled(void)
     return tiering_enabled;
 }
 
+typedef enum priskv_tiering_write_mode {
+    PRISKV_TIERING_WRITE_AROUND,  /* drop the value from memory once backend acknowledges */
+    PRISKV_TIERING_WRITE_THROUGH, /* keep the value in memory once backend acknowledges */
+    PRISKV_TIERING_WRITE_BACK,    /* acknowledge after RDMA READ, write backend asynchronously */
+    PRISKV_TIERING_WRITE_DEMOTE,  /* keep the value in memory only, write backend on eviction */
+    PRISKV_TIERING_WRITE_MAX,
+} priskv_tiering_write_mode;
+
+extern priskv_tiering_write_mode tiering_write_mode;
+
+static inline priskv_tiering_write_mode priskv_backend_tiering_write_mode(void)
+{
+    return tiering_write_mode;
+}
+
+/* return -EINVAL on unknown @name: around, through, back or demote */
+int priskv_backend_parse_write_mode(const char *name, priskv_tiering_write_mode *mode);
+
+/*
+ * The value region of the KV, set before the backend devices are opened. A buffer inside the
+ * region passed to GET/SET is a buddy extent: @block_size aligned and rounded up to @block_size.
+ */
+void priskv_backend_set_value_region(uint8_t *base, uint64_t size, uint32_t block_size);
+/* return false if no value region is set */
+bool priskv_backend_get_value_region(uint8_t **base, uint64_t *size, uint32_t *block_size);
+
 #endif /* __PRISKV_BACKEND_H__ */
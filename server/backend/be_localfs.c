@@ -24,6 +24,15 @@
  *   Enhua Zhou <zhouenhua@bytedance.com>
  */
 
+/*
+ * Local filesystem backend, one file per key.
+ *
+ * Several directories (e.g. one per NVMe drive) may be listed in the address. A key has a home
+ * device, picked by hash or by free space, whose LRU policy tracks it. A value larger than the
+ * stripe size is cut into equal stripes, stripe i is stored under the key name on device
+ * (home + i) % ndevices. Each device has its own io_uring and queue depth in every IO thread.
+ */
+
 #define _DEFAULT_SOURCE
 #include <stdlib.h>
 #include <string.h>
@@ -43,32 +52,93 @@
 #include "priskv-utils.h"
 #include "policy.h"
 #include "list.h"
+#include "uthash.h"
+#include "../crc.h"
 
 #define DEFAULT_MAX_DEPTH 1023
+#define LOCALFS_DEPTH_BATCH 32 /* queue depth moved between a thread and the device budget */
+#define LOCALFS_MAX_DEVICES 16
+#define LOCALFS_MIN_STRIPE_SIZE 4096
 
-typedef struct localfs_shared_context {
+/* durability of a SET once acknowledged */
+typedef enum {
+    LOCALFS_SYNC_NONE,  /* page cache only */
+    LOCALFS_SYNC_GROUP, /* fdatasync batched over the writes completed in one event pass */
+    LOCALFS_SYNC_WRITE, /* O_SYNC on every write */
+} localfs_sync_mode;
+
+/* home device of a new key */
+typedef enum {
+    LOCALFS_PLACE_HASH, /* crc32 of the key */
+    LOCALFS_PLACE_FREE, /* the device with the most free space */
+} localfs_place_mode;
+
+typedef struct localfs_device {
     char *path;
     uint64_t total_size;
+    uint64_t free_size;
 
     // Only effective when SSD is used as cache device, otherwise policy is ineffective.
+    // Tracks the keys homed on this device.
     priskv_policy *policy;
-    uint64_t free_size;
-    int ref_count;
-    pthread_spinlock_t lock;
 
-    // queue depth control
+    // queue depth budget, handed out to the IO threads in batches and given back lazily
     pthread_spinlock_t queue_lock;
-    uint32_t inflight_count;
     uint32_t max_depth;
-    struct list_head pending_queue;
+    uint32_t free_depth;
+} localfs_device;
+
+/* home and stripes of a key, only kept with several devices */
+typedef struct localfs_key {
+    char *key;
+    uint32_t home;
+    uint32_t nstripes;
+    uint64_t len;
+    UT_hash_handle hh;
+} localfs_key;
+
+typedef struct localfs_shared_context {
+    localfs_device devices[LOCALFS_MAX_DEVICES];
+    uint32_t ndevices;
+    localfs_place_mode place;
+    uint64_t stripe_size; /* 0 if values are not striped */
+    localfs_sync_mode sync_mode;
+
+    localfs_key *keys;
+    int ref_count;
+    pthread_spinlock_t lock; /* free sizes, policies and keys */
 } localfs_shared_context;
 
-typedef struct localfs_thread_context {
-    priskv_backend_device *bdev;
+typedef struct localfs_thread_context localfs_thread_context;
+
+/* a device as seen by an IO thread */
+typedef struct localfs_thread_device {
+    localfs_thread_context *ctx;
+    localfs_device *dev;
     struct io_uring ring;
 
+    /* SETs written and waiting for the group commit of this event pass */
+    struct list_head sync_queue;
+
+    /* queue depth taken from the device budget, only touched by the owner thread */
+    uint32_t depth;
+    uint32_t inflight;
+    struct list_head pending_queue;
+
+    /* one io_uring_submit for all the SQEs prepared in an event pass */
+    priskv_event_deferred flush;
+} localfs_thread_device;
+
+struct localfs_thread_context {
+    priskv_backend_device *bdev;
+    localfs_thread_device devs[LOCALFS_MAX_DEVICES];
+    uint32_t ndevs; /* devices with an initialized ring */
+
+    /* the device is_cacheable() found short of space, evict() frees it up */
+    uint32_t evict_dev;
+
     struct localfs_shared_context *shared_ctx;
-} localfs_thread_context;
+};
 
 static localfs_shared_context *localfs_shared_ctx = NULL;
 static pthread_mutex_t localfs_shared_ctx_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -116,17 +186,58 @@ typedef enum {
     LOCALFS_OP_SET,
     LOCALFS_OP_DEL,
     LOCALFS_OP_TEST,
+    LOCALFS_OP_EVICT,
 } localfs_op_type;
 
-typedef struct localfs_request {
+/* SQEs of a request, each CQE carries the slot it completes */
+typedef enum {
+    LOCALFS_SQE_STATX,
+    LOCALFS_SQE_OPEN,
+    LOCALFS_SQE_UNLINK,
+    LOCALFS_SQE_RW,
+    LOCALFS_SQE_SYNC,
+    LOCALFS_SQE_MAX,
+} localfs_sqe_type;
+
+/* a request is submitted as at most two linked SQEs at a time */
+#define LOCALFS_MAX_LINKED 2
+
+typedef struct localfs_request localfs_request;
+
+typedef struct localfs_sqe_data {
+    localfs_request *req;
+    int res;
+} localfs_sqe_data;
+
+/* an operation on a striped value, each stripe is a request of its own */
+typedef struct localfs_stripe {
+    localfs_thread_context *ctx;
+    char *key;
+    localfs_op_type op_type;
+    uint32_t home;
+    uint32_t nstripes; /* stripes of the value once the operation succeeds */
+    uint32_t nfiles;   /* stripe files the key may have on disk while the operation runs */
+    uint32_t pending;  /* stripe requests not finished yet, plus one while submitting */
+    bool cleanup;      /* deleting every stripe of a failed SET */
+    uint64_t valuelen; /* sum of the stripe lengths */
+    priskv_backend_status status;
+    bool policy_ref;
+    priskv_backend_driver_cb cb;
+    void *cbarg;
+} localfs_stripe;
+
+struct localfs_request {
     localfs_thread_context *ctx;
+    localfs_thread_device *tdev;
+    localfs_stripe *stripe; /* NULL if the request covers the whole value */
+    uint32_t home;
     struct list_node node;
 
     const char *key;
     uint8_t *val;
     uint64_t valuelen; // Will be updated to actual read/write length after SET and GET operations
                        // complete
-    uint64_t old_valuelen; // Size of old value being overwritten (for SET)
+    uint64_t old_valuelen; // Size of old value being overwritten (for SET) or removed (for DEL)
     uint64_t timeout;
     priskv_backend_driver_cb cb;
     void *cbarg;
@@ -135,100 +246,76 @@ typedef struct localfs_request {
     localfs_op_type op_type;
     priskv_backend_status status;
     bool queued_once;
-} localfs_request;
+    bool policy_ref;
+
+    struct statx stx;
+    localfs_sqe_data sqes[LOCALFS_SQE_MAX];
+    int pending; /* CQEs still expected for the current stage */
+    bool io_submitted;
+    bool sync_submitted;
+};
 
 static void localfs_complete_request(localfs_request *req);
 static bool submit_io_request(localfs_request *req);
+static bool localfs_advance_request(localfs_request *req);
+static size_t localfs_group_commit(localfs_thread_device *tdev);
+static void localfs_put_depth(localfs_thread_device *tdev);
 
 static void handle_io_uring_events(int fd, void *opaque, uint32_t events)
 {
-    localfs_thread_context *ctx = opaque;
-    localfs_shared_context *shared_ctx = ctx->shared_ctx;
+    localfs_thread_device *tdev = opaque;
     struct io_uring_cqe *cqe;
     size_t completed_reqs = 0;
 
-    while (io_uring_peek_cqe(&ctx->ring, &cqe) == 0) {
-        localfs_request *req = (localfs_request *)io_uring_cqe_get_data(cqe);
+    while (io_uring_peek_cqe(&tdev->ring, &cqe) == 0) {
+        localfs_sqe_data *data = (localfs_sqe_data *)io_uring_cqe_get_data(cqe);
         int res = cqe->res;
-        io_uring_cqe_seen(&ctx->ring, cqe);
+        io_uring_cqe_seen(&tdev->ring, cqe);
         cqe = NULL;
 
-        if (res < 0) { // res is errno returned by read/write, just log it
-            priskv_log_error("BE_LOCALFS: async operation failed: %s\n", strerror(-res));
-            req->status = PRISKV_BACKEND_STATUS_ERROR;
-
-            if (req->op_type == LOCALFS_OP_GET && shared_ctx->policy) {
-                pthread_spin_lock(&shared_ctx->lock);
-                priskv_policy_unref_key(shared_ctx->policy, req->key);
-                pthread_spin_unlock(&shared_ctx->lock);
+        if (!data) { // detached close
+            if (res < 0) {
+                priskv_log_warn("BE_LOCALFS: async close failed: %s\n", strerror(-res));
             }
-
-            localfs_complete_request(req);
             continue;
         }
 
-        pthread_spin_lock(&shared_ctx->lock);
-
-        if (req->op_type == LOCALFS_OP_SET) {
-            if (res != req->valuelen) {
-                priskv_log_error("BE_LOCALFS: incomplete write: %d, expect: %d\n", res,
-                                 req->valuelen);
-                req->status = PRISKV_BACKEND_STATUS_ERROR;
-                pthread_spin_unlock(&shared_ctx->lock);
-                localfs_complete_request(req);
-                continue;
-            }
-
-            int64_t delta = (int64_t)req->valuelen - (int64_t)req->old_valuelen;
-            if (delta > 0) {
-                shared_ctx->free_size -= delta;
-            } else {
-                shared_ctx->free_size += (-delta);
-            }
-
-            if (shared_ctx->policy) {
-                priskv_policy_access(shared_ctx->policy, req->key);
-            }
-        } else if (req->op_type == LOCALFS_OP_GET) {
-            if (shared_ctx->policy) {
-                priskv_policy_unref_key(shared_ctx->policy, req->key);
-            }
+        localfs_request *req = data->req;
+        data->res = res;
+        if (--req->pending > 0) {
+            continue;
         }
 
-        pthread_spin_unlock(&shared_ctx->lock);
-
-        req->valuelen = res;
-        req->status = PRISKV_BACKEND_STATUS_OK;
-        localfs_complete_request(req);
-
-        completed_reqs++;
+        if (localfs_advance_request(req)) {
+            completed_reqs++;
+        }
     }
 
+    completed_reqs += localfs_group_commit(tdev);
+
     if (completed_reqs == 0) {
         return;
     }
 
-    pthread_spin_lock(&shared_ctx->queue_lock);
-    if (shared_ctx->inflight_count < completed_reqs) {
+    if (tdev->inflight < completed_reqs) {
         priskv_log_warn("BE_LOCALFS: inflight underflow: inflight=%u completed=%zu\n",
-                        shared_ctx->inflight_count, completed_reqs);
-        shared_ctx->inflight_count = 0;
+                        tdev->inflight, completed_reqs);
+        tdev->inflight = 0;
     } else {
-        shared_ctx->inflight_count -= completed_reqs;
+        tdev->inflight -= completed_reqs;
     }
 
-    while (shared_ctx->inflight_count < shared_ctx->max_depth) {
-        localfs_request *pending = list_pop(&shared_ctx->pending_queue, localfs_request, node);
+    while (1) {
+        localfs_request *pending = list_pop(&tdev->pending_queue, localfs_request, node);
 
-        if (!pending) {
+        if (!pending || !submit_io_request(pending)) {
             break;
         }
+    }
 
-        if (!submit_io_request(pending)) {
-            break;
-        }
+    if (list_empty(&tdev->pending_queue)) {
+        localfs_put_depth(tdev);
     }
-    pthread_spin_unlock(&shared_ctx->queue_lock);
 }
 
 static int check_or_create_dir(const char *path)
@@ -280,17 +367,6 @@ static int64_t get_dir_used_size(const char *path)
     return used_size;
 }
 
-static uint64_t get_file_size(const char *path)
-{
-    struct stat st;
-
-    if (stat(path, &st) == 0) {
-        return (uint64_t)st.st_size;
-    }
-
-    return 0;
-}
-
 static int64_t get_filesystem_available_size(const char *path)
 {
     struct statvfs vfs;
@@ -309,157 +385,279 @@ static int64_t get_filesystem_available_size(const char *path)
     return (int64_t)available_size;
 }
 
-/* ADDRESS: /a/b/c/&size=4GB */
-static int localfs_parse_address(const char *address, char **path, uint64_t *size)
+static int localfs_parse_sync_mode(const char *str, localfs_sync_mode *mode)
 {
-    char *p = strchr(address, '&');
-    int64_t fs_size;
-
-    if (!p) {
-        *path = strdup(address);
-        goto get_fs_size;
-    }
-
-    *path = strndup(address, p - address);
-
-    p = strstr(p, "size=");
-    if (!p) {
-        goto get_fs_size;
+    if (!strcmp(str, "none")) {
+        *mode = LOCALFS_SYNC_NONE;
+    } else if (!strcmp(str, "group")) {
+        *mode = LOCALFS_SYNC_GROUP;
+    } else if (!strcmp(str, "write")) {
+        *mode = LOCALFS_SYNC_WRITE;
+    } else {
+        priskv_log_error("BE_LOCALFS: invalid sync mode: %s\n", str);
+        return -1;
     }
 
-    return priskv_str2num(p + 5, (int64_t *)size);
+    return 0;
+}
 
-get_fs_size:
-    fs_size = get_filesystem_available_size(*path);
-    if (fs_size < 0) {
-        free(*path);
-        *path = NULL;
+static int localfs_parse_place_mode(const char *str, localfs_place_mode *mode)
+{
+    if (!strcmp(str, "hash")) {
+        *mode = LOCALFS_PLACE_HASH;
+    } else if (!strcmp(str, "free")) {
+        *mode = LOCALFS_PLACE_FREE;
+    } else {
+        priskv_log_error("BE_LOCALFS: invalid place mode: %s\n", str);
         return -1;
     }
-    *size = (uint64_t)fs_size;
+
     return 0;
 }
 
-static localfs_shared_context *localfs_shared_context_create(const char *address)
+/* Split the comma separated directory list into the devices */
+static int localfs_parse_paths(localfs_shared_context *ctx, const char *paths)
 {
-    localfs_shared_context *ctx = calloc(1, sizeof(*ctx));
-    bool lock_initialized = false;
-    bool queue_lock_initialized = false;
+    char *dup = strdup(paths);
+    char *path, *saveptr = NULL;
+    int ret = 0;
+
+    for (path = strtok_r(dup, ",", &saveptr); path; path = strtok_r(NULL, ",", &saveptr)) {
+        if (ctx->ndevices == LOCALFS_MAX_DEVICES) {
+            priskv_log_error("BE_LOCALFS: too many directories, at most %d\n",
+                             LOCALFS_MAX_DEVICES);
+            ret = -1;
+            break;
+        }
+        ctx->devices[ctx->ndevices++].path = strdup(path);
+    }
+    free(dup);
 
-    if (!ctx) {
-        priskv_log_error("BE_LOCALFS: failed to allocate shared context\n");
-        return NULL;
+    if (!ret && !ctx->ndevices) {
+        priskv_log_error("BE_LOCALFS: no directory in address\n");
+        ret = -1;
     }
 
-    if (pthread_spin_init(&ctx->lock, 0)) {
-        priskv_log_error("BE_LOCALFS: failed to initialize shared context lock\n");
-        goto err;
+    return ret;
+}
+
+/*
+ * ADDRESS: /a/b/c/&size=4GB&sync=none|group|write
+ *          /nvme0/kv,/nvme1/kv&size=4GB&place=hash|free&stripe=4MB
+ * size caps every directory, by default each takes the available space of its filesystem.
+ */
+static int localfs_parse_address(localfs_shared_context *ctx, const char *address)
+{
+    char *p = strchr(address, '&');
+    char *paths, *opts, *opt, *saveptr = NULL;
+    bool has_size = false;
+    int64_t num, fs_size;
+    uint64_t size = 0;
+    int ret = 0;
+
+    ctx->sync_mode = LOCALFS_SYNC_WRITE;
+    ctx->place = LOCALFS_PLACE_HASH;
+
+    paths = p ? strndup(address, p - address) : strdup(address);
+    ret = localfs_parse_paths(ctx, paths);
+    free(paths);
+    if (ret || !p) {
+        goto get_size;
+    }
+
+    opts = strdup(p + 1);
+    for (opt = strtok_r(opts, "&", &saveptr); opt; opt = strtok_r(NULL, "&", &saveptr)) {
+        if (!strncmp(opt, "size=", 5)) {
+            ret = priskv_str2num(opt + 5, (int64_t *)&size);
+            has_size = true;
+        } else if (!strncmp(opt, "sync=", 5)) {
+            ret = localfs_parse_sync_mode(opt + 5, &ctx->sync_mode);
+        } else if (!strncmp(opt, "place=", 6)) {
+            ret = localfs_parse_place_mode(opt + 6, &ctx->place);
+        } else if (!strncmp(opt, "stripe=", 7)) {
+            ret = priskv_str2num(opt + 7, &num);
+            if (!ret && num && num < LOCALFS_MIN_STRIPE_SIZE) {
+                priskv_log_error("BE_LOCALFS: stripe size %ld is less than %d\n", num,
+                                 LOCALFS_MIN_STRIPE_SIZE);
+                ret = -1;
+            }
+            ctx->stripe_size = num;
+        }
+
+        if (ret) {
+            break;
+        }
     }
-    lock_initialized = true;
+    free(opts);
 
-    if (pthread_spin_init(&ctx->queue_lock, 0)) {
-        priskv_log_error("BE_LOCALFS: failed to initialize queue lock\n");
-        goto err;
+get_size:
+    if (ret) {
+        return ret;
     }
-    queue_lock_initialized = true;
 
-    list_head_init(&ctx->pending_queue);
-    ctx->inflight_count = 0;
-    ctx->max_depth = DEFAULT_MAX_DEPTH;
+    for (uint32_t i = 0; i < ctx->ndevices; i++) {
+        if (has_size) {
+            ctx->devices[i].total_size = size;
+            continue;
+        }
 
-    if (localfs_parse_address(address, &ctx->path, &ctx->total_size)) {
-        priskv_log_error("BE_LOCALFS: failed to parse address\n");
-        goto err;
+        fs_size = get_filesystem_available_size(ctx->devices[i].path);
+        if (fs_size < 0) {
+            return -1;
+        }
+        ctx->devices[i].total_size = (uint64_t)fs_size;
     }
 
-    if (strlen(ctx->path) + NAME_MAX + 1 > PATH_MAX) {
+    return 0;
+}
+
+static int localfs_device_init(localfs_device *dev)
+{
+    if (strlen(dev->path) + NAME_MAX + 1 > PATH_MAX) {
         priskv_log_error("BE_LOCALFS: path too long\n");
-        goto err;
+        return -1;
     }
 
-    if (check_or_create_dir(ctx->path) != 0) {
-        goto err;
+    if (check_or_create_dir(dev->path) != 0) {
+        return -1;
     }
 
-    int64_t used_size = get_dir_used_size(ctx->path);
+    int64_t used_size = get_dir_used_size(dev->path);
     if (used_size < 0) {
         priskv_log_error("BE_LOCALFS: failed to get directory used size\n");
-        goto err;
+        return -1;
     }
 
-    if ((uint64_t)used_size > ctx->total_size) {
+    if ((uint64_t)used_size > dev->total_size) {
         priskv_log_error(
-            "BE_LOCALFS: directory used size (%lu) exceeds configured capacity (%lu)\n",
-            (uint64_t)used_size, ctx->total_size);
-        goto err;
+            "BE_LOCALFS: directory %s used size (%lu) exceeds configured capacity (%lu)\n",
+            dev->path, (uint64_t)used_size, dev->total_size);
+        return -1;
     }
 
-    ctx->free_size = ctx->total_size - (uint64_t)used_size;
+    dev->free_size = dev->total_size - (uint64_t)used_size;
 
-    ctx->policy = priskv_policy_create("lru");
-    if (ctx->policy == NULL) {
+    dev->policy = priskv_policy_create("lru");
+    if (dev->policy == NULL) {
         priskv_log_error("BE_LOCALFS: failed to create LRU policy\n");
-        goto err;
+        return -1;
     }
 
-    ctx->ref_count = 1;
+    dev->max_depth = DEFAULT_MAX_DEPTH;
+    dev->free_depth = dev->max_depth;
 
-    return ctx;
+    return 0;
+}
 
-err:
-    if (ctx->policy) {
-        priskv_policy_destroy(ctx->policy);
-        ctx->policy = NULL;
+static localfs_shared_context *localfs_shared_context_create(const char *address)
+{
+    localfs_shared_context *ctx = calloc(1, sizeof(*ctx));
+
+    if (!ctx) {
+        priskv_log_error("BE_LOCALFS: failed to allocate shared context\n");
+        return NULL;
+    }
+
+    if (pthread_spin_init(&ctx->lock, 0)) {
+        priskv_log_error("BE_LOCALFS: failed to initialize shared context lock\n");
+        free(ctx);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < LOCALFS_MAX_DEVICES; i++) {
+        pthread_spin_init(&ctx->devices[i].queue_lock, 0);
     }
-    if (ctx->path) {
-        free(ctx->path);
-        ctx->path = NULL;
+
+    if (localfs_parse_address(ctx, address)) {
+        priskv_log_error("BE_LOCALFS: failed to parse address\n");
+        goto err;
     }
-    if (queue_lock_initialized) {
-        pthread_spin_destroy(&ctx->queue_lock);
+
+    for (uint32_t i = 0; i < ctx->ndevices; i++) {
+        if (localfs_device_init(&ctx->devices[i])) {
+            goto err;
+        }
     }
-    if (lock_initialized) {
-        pthread_spin_destroy(&ctx->lock);
+
+    if (ctx->ndevices > 1) {
+        priskv_log_info("BE_LOCALFS: %u directories, %s placement, stripe size %lu\n",
+                        ctx->ndevices, ctx->place == LOCALFS_PLACE_HASH ? "hash" : "free",
+                        ctx->stripe_size);
     }
-    free(ctx);
+
+    ctx->ref_count = 1;
+
+    return ctx;
+
+err:
+    localfs_shared_context_destroy(ctx);
     return NULL;
 }
 
-// TODO: wait for all in-flight requests to complete
 static void localfs_shared_context_destroy(localfs_shared_context *ctx)
 {
+    localfs_key *k, *tmp;
+
     if (!ctx) {
         return;
     }
 
-    while (1) {
-        localfs_request *req;
+    HASH_ITER(hh, ctx->keys, k, tmp)
+    {
+        HASH_DEL(ctx->keys, k);
+        free(k->key);
+        free(k);
+    }
 
-        pthread_spin_lock(&ctx->queue_lock);
-        req = list_pop(&ctx->pending_queue, localfs_request, node);
-        if (!req) {
-            pthread_spin_unlock(&ctx->queue_lock);
-            break;
-        }
-        pthread_spin_unlock(&ctx->queue_lock);
+    for (uint32_t i = 0; i < LOCALFS_MAX_DEVICES; i++) {
+        localfs_device *dev = &ctx->devices[i];
 
-        req->status = PRISKV_BACKEND_STATUS_ERROR;
-        localfs_complete_request(req);
+        if (dev->policy) {
+            priskv_policy_destroy(dev->policy);
+        }
+        if (dev->path) {
+            free(dev->path);
+        }
+        pthread_spin_destroy(&dev->queue_lock);
     }
 
-    pthread_spin_destroy(&ctx->queue_lock);
     pthread_spin_destroy(&ctx->lock);
 
-    if (ctx->policy) {
-        priskv_policy_destroy(ctx->policy);
-    }
-    if (ctx->path) {
-        free(ctx->path);
-    }
-
     free(ctx);
 }
 
+static void localfs_flush(void *opaque)
+{
+    localfs_thread_device *tdev = opaque;
+
+    io_uring_submit(&tdev->ring);
+}
+
+static void localfs_close_devices(localfs_thread_context *ctx)
+{
+    for (uint32_t i = 0; i < ctx->ndevs; i++) {
+        localfs_thread_device *tdev = &ctx->devs[i];
+        localfs_device *dev = tdev->dev;
+        localfs_request *req;
+
+        // TODO: wait for all in-flight requests to complete
+        while ((req = list_pop(&tdev->pending_queue, localfs_request, node))) {
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            localfs_complete_request(req);
+        }
+
+        pthread_spin_lock(&dev->queue_lock);
+        dev->free_depth += tdev->depth;
+        pthread_spin_unlock(&dev->queue_lock);
+
+        priskv_events_cancel(&tdev->flush);
+        io_uring_submit(&tdev->ring);
+        priskv_del_event(ctx->bdev->epollfd, tdev->ring.ring_fd);
+        io_uring_queue_exit(&tdev->ring);
+    }
+    ctx->ndevs = 0;
+}
+
 static int localfs_open(priskv_backend_device *bdev)
 {
     localfs_shared_context *shared_ctx = NULL;
@@ -495,22 +693,36 @@ static int localfs_open(priskv_backend_device *bdev)
     ctx->bdev = bdev;
     ctx->shared_ctx = shared_ctx;
 
-    struct io_uring_params ring_params = {0};
-    ring_params.cq_entries = DEFAULT_MAX_DEPTH;
+    for (uint32_t i = 0; i < shared_ctx->ndevices; i++) {
+        localfs_thread_device *tdev = &ctx->devs[i];
 
-    if (io_uring_queue_init_params(128, &ctx->ring, &ring_params) < 0) {
-        priskv_log_error("BE_LOCALFS: failed to initialize io_uring\n");
-        goto err_free_ctx;
-    }
+        tdev->ctx = ctx;
+        tdev->dev = &shared_ctx->devices[i];
+        list_head_init(&tdev->sync_queue);
+        list_head_init(&tdev->pending_queue);
+        tdev->flush.fn = localfs_flush;
+        tdev->flush.opaque = tdev;
+
+        struct io_uring_params ring_params = {0};
+        ring_params.cq_entries = DEFAULT_MAX_DEPTH;
 
-    priskv_set_fd_handler(ctx->ring.ring_fd, handle_io_uring_events, NULL, ctx);
-    priskv_add_event_fd(bdev->epollfd, ctx->ring.ring_fd);
+        if (io_uring_queue_init_params(128, &tdev->ring, &ring_params) < 0) {
+            priskv_log_error("BE_LOCALFS: failed to initialize io_uring for %s\n",
+                             tdev->dev->path);
+            goto err_close_devices;
+        }
+
+        priskv_set_fd_handler(tdev->ring.ring_fd, handle_io_uring_events, NULL, tdev);
+        priskv_add_event_fd(bdev->epollfd, tdev->ring.ring_fd);
+        ctx->ndevs++;
+    }
 
     bdev->private_data = ctx;
 
     return 0;
 
-err_free_ctx:
+err_close_devices:
+    localfs_close_devices(ctx);
     free(ctx);
 err_put_shared_ctx:
     localfs_shared_context_put(shared_ctx);
@@ -532,8 +744,7 @@ static int localfs_close(priskv_backend_device *bdev)
     localfs_shared_context *shared_ctx = ctx->shared_ctx;
     assert(shared_ctx);
 
-    priskv_del_event(bdev->epollfd, ctx->ring.ring_fd);
-    io_uring_queue_exit(&ctx->ring);
+    localfs_close_devices(ctx);
     free(ctx);
     bdev->private_data = NULL;
 
@@ -542,28 +753,164 @@ static int localfs_close(priskv_backend_device *bdev)
     return 0;
 }
 
+/* Number of stripes a value of @valuelen is cut into */
+static uint32_t localfs_nstripes(localfs_shared_context *shared_ctx, uint64_t valuelen)
+{
+    if (!shared_ctx->stripe_size || valuelen <= shared_ctx->stripe_size) {
+        return 1;
+    }
+
+    return priskv_min_u64(shared_ctx->ndevices, DIV_ROUND_UP(valuelen, shared_ctx->stripe_size));
+}
+
+/*
+ * The device that lacks space for a value of @valuelen, or -1 if the value fits. A striped
+ * value or a hashed key may land on any device, so the fullest one decides.
+ * Called with shared_ctx->lock held.
+ */
+static int localfs_short_device(localfs_shared_context *shared_ctx, uint64_t valuelen)
+{
+    uint32_t nstripes = localfs_nstripes(shared_ctx, valuelen);
+    uint64_t need = DIV_ROUND_UP(valuelen, nstripes);
+    bool most_free = shared_ctx->place == LOCALFS_PLACE_FREE && nstripes == 1;
+    uint32_t pick = 0;
+
+    for (uint32_t i = 1; i < shared_ctx->ndevices; i++) {
+        uint64_t free_size = shared_ctx->devices[i].free_size;
+
+        if (most_free ? free_size > shared_ctx->devices[pick].free_size
+                      : free_size < shared_ctx->devices[pick].free_size) {
+            pick = i;
+        }
+    }
+
+    return need <= shared_ctx->devices[pick].free_size ? -1 : (int)pick;
+}
+
 static bool localfs_is_cacheable(priskv_backend_device *bdev, uint64_t valuelen)
 {
-    bool res;
+    int dev;
 
     localfs_thread_context *ctx = (localfs_thread_context *)bdev->private_data;
     localfs_shared_context *shared_ctx = ctx->shared_ctx;
     assert(shared_ctx);
 
     pthread_spin_lock(&shared_ctx->lock);
-    res = valuelen <= shared_ctx->free_size;
+    dev = localfs_short_device(shared_ctx, valuelen);
     pthread_spin_unlock(&shared_ctx->lock);
 
-    return res;
+    if (dev >= 0) {
+        ctx->evict_dev = dev;
+    }
+
+    return dev < 0;
+}
+
+/* Home of a new key, called with shared_ctx->lock held */
+static uint32_t localfs_place_key(localfs_shared_context *shared_ctx, const char *key)
+{
+    uint32_t pick = 0;
+
+    if (shared_ctx->place == LOCALFS_PLACE_HASH) {
+        return priskv_crc32((uint8_t *)key, strlen(key)) % shared_ctx->ndevices;
+    }
+
+    for (uint32_t i = 1; i < shared_ctx->ndevices; i++) {
+        if (shared_ctx->devices[i].free_size > shared_ctx->devices[pick].free_size) {
+            pick = i;
+        }
+    }
+
+    return pick;
+}
+
+/* Record the home and stripes of @key, called with shared_ctx->lock held */
+static void localfs_key_update(localfs_shared_context *shared_ctx, const char *key,
+                               uint32_t home, uint32_t nstripes, uint64_t len)
+{
+    localfs_key *k;
+
+    HASH_FIND_STR(shared_ctx->keys, key, k);
+    if (!k) {
+        k = calloc(1, sizeof(*k));
+        if (!k) {
+            priskv_log_error("BE_LOCALFS: failed to allocate key %s\n", key);
+            return;
+        }
+        k->key = strdup(key);
+        HASH_ADD_KEYPTR(hh, shared_ctx->keys, k->key, strlen(k->key), k);
+    }
+
+    k->home = home;
+    k->nstripes = nstripes;
+    k->len = len;
+}
+
+static void localfs_key_del(localfs_shared_context *shared_ctx, const char *key)
+{
+    localfs_key *k;
+
+    HASH_FIND_STR(shared_ctx->keys, key, k);
+    if (k) {
+        HASH_DEL(shared_ctx->keys, k);
+        free(k->key);
+        free(k);
+    }
+}
+
+/*
+ * Key level accounting of a finished operation, on the policy of the home device and the key
+ * index. Called with shared_ctx->lock held.
+ */
+static void localfs_account_key(localfs_shared_context *shared_ctx, localfs_op_type op_type,
+                                const char *key, uint32_t home, uint32_t nstripes, uint64_t len,
+                                bool ok, bool policy_ref)
+{
+    priskv_policy *policy = shared_ctx->devices[home].policy;
+    bool indexed = shared_ctx->ndevices > 1;
+
+    switch (op_type) {
+    case LOCALFS_OP_SET:
+        if (ok) {
+            if (policy) {
+                priskv_policy_access(policy, key);
+            }
+            if (indexed) {
+                localfs_key_update(shared_ctx, key, home, nstripes, len);
+            }
+        }
+        break;
+    case LOCALFS_OP_DEL:
+        if (ok) {
+            if (policy) {
+                priskv_policy_del_key(policy, key);
+            }
+            if (indexed) {
+                localfs_key_del(shared_ctx, key);
+            }
+        }
+        break;
+    case LOCALFS_OP_EVICT:
+        if (ok && indexed) {
+            localfs_key_del(shared_ctx, key);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (policy_ref && policy) {
+        priskv_policy_unref_key(policy, key);
+    }
 }
 
-static localfs_request *localfs_make_request(localfs_thread_context *ctx, const char *key,
-                                             uint8_t *val, uint64_t valuelen,
+static localfs_request *localfs_make_request(localfs_thread_context *ctx, uint32_t dev,
+                                             uint32_t home, localfs_stripe *stripe,
+                                             const char *key, uint8_t *val, uint64_t valuelen,
                                              localfs_op_type op_type, priskv_backend_driver_cb cb,
                                              void *cbarg)
 {
-    localfs_request *req = malloc(sizeof(localfs_request));
-    localfs_shared_context *shared_ctx = ctx->shared_ctx;
+    localfs_request *req = calloc(1, sizeof(localfs_request));
     if (req == NULL) {
         priskv_log_error("BE_LOCALFS: failed to allocate localfs request\n");
         if (cb) {
@@ -574,6 +921,9 @@ static localfs_request *localfs_make_request(localfs_thread_context *ctx, const
 
     req->fd = -1;
     req->ctx = ctx;
+    req->tdev = &ctx->devs[dev];
+    req->stripe = stripe;
+    req->home = home;
     req->key = strdup(key);
     req->val = val;
     req->valuelen = valuelen;
@@ -583,40 +933,53 @@ static localfs_request *localfs_make_request(localfs_thread_context *ctx, const
     req->op_type = op_type;
     list_node_init(&req->node);
     req->queued_once = false;
+    for (int i = 0; i < LOCALFS_SQE_MAX; i++) {
+        req->sqes[i].req = req;
+    }
 
-    if (snprintf(req->path, sizeof(req->path), "%s/%s", shared_ctx->path, key) >=
+    if (snprintf(req->path, sizeof(req->path), "%s/%s", req->tdev->dev->path, key) >=
         sizeof(req->path)) {
         priskv_log_error("BE_LOCALFS: path too long\n");
         req->status = PRISKV_BACKEND_STATUS_ERROR;
+        req->valuelen = 0;
         localfs_complete_request(req);
         return NULL;
     }
 
-    int flags = O_RDONLY;
-    uint32_t file_size = get_file_size(req->path);
-    if (op_type == LOCALFS_OP_SET) {
-        req->old_valuelen = file_size;
-        flags = O_CREAT | O_WRONLY | O_TRUNC | O_SYNC;
-    } else if (op_type == LOCALFS_OP_GET) {
-        if (file_size > valuelen) {
-            priskv_log_error("BE_LOCALFS: file size %lu exceeds buffer size %lu for key %s\n",
-                             file_size, valuelen, key);
-            req->status = PRISKV_BACKEND_STATUS_VALUE_TOO_BIG;
-            localfs_complete_request(req);
-            return NULL;
-        }
-    }
+    return req;
+}
 
-    req->fd = open(req->path, flags, 0644);
-    if (req->fd < 0) {
-        priskv_log_error("BE_LOCALFS: failed to open file(%s) when %s: %s\n", req->path,
-                         op_type == LOCALFS_OP_SET ? "set" : "get", strerror(errno));
-        req->status = PRISKV_BACKEND_STATUS_ERROR;
-        localfs_complete_request(req);
-        return NULL;
+/* Submit the SQEs prepared so far at the end of this event pass */
+static void localfs_kick(localfs_thread_device *tdev)
+{
+    priskv_events_defer(&tdev->flush);
+}
+
+/* Make sure @n SQEs can be taken in a row, flushing the SQ ring if needed */
+static bool localfs_reserve_sqes(localfs_thread_device *tdev, unsigned n)
+{
+    if (io_uring_sq_space_left(&tdev->ring) < n) {
+        io_uring_submit(&tdev->ring);
     }
 
-    return req;
+    return io_uring_sq_space_left(&tdev->ring) >= n;
+}
+
+/* Close @fd through the ring without waiting for it, the CQE carries no request */
+static void localfs_close_fd(localfs_thread_device *tdev, int fd)
+{
+    struct io_uring_sqe *sqe;
+
+    if (!localfs_reserve_sqes(tdev, 1)) {
+        close(fd);
+        return;
+    }
+
+    sqe = io_uring_get_sqe(&tdev->ring);
+
+    io_uring_prep_close(sqe, fd);
+    io_uring_sqe_set_data(sqe, NULL);
+    localfs_kick(tdev);
 }
 
 static void localfs_free_request(localfs_request *req)
@@ -626,14 +989,49 @@ static void localfs_free_request(localfs_request *req)
     }
 
     if (req->fd >= 0) {
-        close(req->fd);
+        localfs_close_fd(req->tdev, req->fd);
     }
     free((char *)req->key);
     free(req);
 }
 
+/* Settle space and policy accounting for a finished request, then call back */
 static void localfs_complete_request(localfs_request *req)
 {
+    localfs_shared_context *shared_ctx = req->ctx->shared_ctx;
+    localfs_device *dev = req->tdev->dev;
+    bool ok = req->status == PRISKV_BACKEND_STATUS_OK;
+
+    pthread_spin_lock(&shared_ctx->lock);
+    switch (req->op_type) {
+    case LOCALFS_OP_SET:
+        if (ok) {
+            dev->free_size += req->old_valuelen;
+            dev->free_size -= req->valuelen;
+        }
+        break;
+    case LOCALFS_OP_DEL:
+    case LOCALFS_OP_EVICT:
+        if (ok) {
+            dev->free_size += req->old_valuelen;
+        }
+        break;
+    default:
+        break;
+    }
+
+    /* a striped value is accounted once all its stripes finish */
+    if (!req->stripe) {
+        localfs_account_key(shared_ctx, req->op_type, req->key, req->home, 1, req->valuelen, ok,
+                            req->policy_ref);
+    }
+    pthread_spin_unlock(&shared_ctx->lock);
+
+    if (req->op_type == LOCALFS_OP_EVICT && ok) {
+        priskv_log_debug("BE_LOCALFS: evicted key %s from %s, freed %lu bytes\n", req->key,
+                         dev->path, req->old_valuelen);
+    }
+
     if (req->cb) {
         req->cb(req->status, req->valuelen, req->cbarg);
     }
@@ -641,175 +1039,624 @@ static void localfs_complete_request(localfs_request *req)
     localfs_free_request(req);
 }
 
-static bool submit_io_request(localfs_request *req)
+static void localfs_prep_sqe(localfs_request *req, struct io_uring_sqe *sqe, localfs_sqe_type type,
+                             unsigned flags)
 {
-    localfs_thread_context *ctx = req->ctx;
-    localfs_shared_context *shared_ctx = ctx->shared_ctx;
-    struct io_uring_sqe *sqe = NULL;
+    io_uring_sqe_set_flags(sqe, flags);
+    io_uring_sqe_set_data(sqe, &req->sqes[type]);
+    req->sqes[type].res = 0;
+    req->pending++;
+}
 
-    pthread_spin_lock(&shared_ctx->queue_lock);
-    if (shared_ctx->inflight_count >= shared_ctx->max_depth) {
-        if (req->queued_once) {
-            list_add(&shared_ctx->pending_queue, &req->node);
-        } else {
-            list_add_tail(&shared_ctx->pending_queue, &req->node);
-            req->queued_once = true;
+static int localfs_set_flags(localfs_request *req)
+{
+    int flags = O_CREAT | O_WRONLY | O_TRUNC;
+
+    if (req->ctx->shared_ctx->sync_mode == LOCALFS_SYNC_WRITE) {
+        flags |= O_SYNC;
+    }
+
+    return flags;
+}
+
+/* A group committed SET keeps its fd open until the fdatasync */
+static bool localfs_group_sync(localfs_request *req)
+{
+    return req->op_type == LOCALFS_OP_SET &&
+           req->ctx->shared_ctx->sync_mode == LOCALFS_SYNC_GROUP;
+}
+
+/*
+ * First stage, resolve the file by path:
+ *   GET:       statx -> openat(O_RDONLY), a missing file cancels the open
+ *   SET:       statx => openat(O_CREAT|O_TRUNC), the open runs even for a new file
+ *   DEL/EVICT: statx => unlinkat
+ *   TEST:      statx
+ */
+static void localfs_prep_lookup(localfs_request *req)
+{
+    struct io_uring *ring = &req->tdev->ring;
+    struct io_uring_sqe *sqes[LOCALFS_MAX_LINKED];
+
+    sqes[0] = io_uring_get_sqe(ring);
+    io_uring_prep_statx(sqes[0], AT_FDCWD, req->path, 0, STATX_SIZE, &req->stx);
+    if (req->op_type != LOCALFS_OP_TEST) {
+        sqes[1] = io_uring_get_sqe(ring);
+    }
+
+    switch (req->op_type) {
+    case LOCALFS_OP_GET:
+        localfs_prep_sqe(req, sqes[0], LOCALFS_SQE_STATX, IOSQE_IO_LINK);
+        io_uring_prep_openat(sqes[1], AT_FDCWD, req->path, O_RDONLY, 0);
+        localfs_prep_sqe(req, sqes[1], LOCALFS_SQE_OPEN, 0);
+        break;
+    case LOCALFS_OP_SET:
+        localfs_prep_sqe(req, sqes[0], LOCALFS_SQE_STATX, IOSQE_IO_HARDLINK);
+        io_uring_prep_openat(sqes[1], AT_FDCWD, req->path, localfs_set_flags(req), 0644);
+        localfs_prep_sqe(req, sqes[1], LOCALFS_SQE_OPEN, 0);
+        break;
+    case LOCALFS_OP_DEL:
+    case LOCALFS_OP_EVICT:
+        localfs_prep_sqe(req, sqes[0], LOCALFS_SQE_STATX, IOSQE_IO_HARDLINK);
+        io_uring_prep_unlinkat(sqes[1], AT_FDCWD, req->path, 0);
+        localfs_prep_sqe(req, sqes[1], LOCALFS_SQE_UNLINK, 0);
+        break;
+    case LOCALFS_OP_TEST:
+        localfs_prep_sqe(req, sqes[0], LOCALFS_SQE_STATX, 0);
+        break;
+    }
+}
+
+/*
+ * Second stage: read => close or write => close, the close is hard linked so it always runs.
+ * A group committed write leaves the close to the group commit.
+ */
+static bool localfs_submit_rw(localfs_request *req)
+{
+    localfs_thread_device *tdev = req->tdev;
+    struct io_uring_sqe *sqe, *close_sqe;
+    bool linked_close = !localfs_group_sync(req);
+
+    if (!localfs_reserve_sqes(tdev, LOCALFS_MAX_LINKED)) {
+        priskv_log_error("BE_LOCALFS: no SQE available for %s\n", req->path);
+        return false;
+    }
+
+    sqe = io_uring_get_sqe(&tdev->ring);
+    if (req->op_type == LOCALFS_OP_GET) {
+        io_uring_prep_read(sqe, req->fd, req->val, req->valuelen, 0);
+    } else {
+        io_uring_prep_write(sqe, req->fd, req->val, req->valuelen, 0);
+    }
+    localfs_prep_sqe(req, sqe, LOCALFS_SQE_RW, linked_close ? IOSQE_IO_HARDLINK : 0);
+
+    if (linked_close) {
+        close_sqe = io_uring_get_sqe(&tdev->ring);
+        io_uring_prep_close(close_sqe, req->fd);
+        io_uring_sqe_set_data(close_sqe, NULL);
+
+        /* the fd belongs to the chain from now on */
+        req->fd = -1;
+    }
+    req->io_submitted = true;
+    localfs_kick(tdev);
+
+    return true;
+}
+
+static priskv_backend_status localfs_statx_status(localfs_request *req)
+{
+    int res = req->sqes[LOCALFS_SQE_STATX].res;
+
+    if (res == -ENOENT) {
+        return PRISKV_BACKEND_STATUS_NOT_FOUND;
+    } else if (res < 0) {
+        priskv_log_error("BE_LOCALFS: failed to stat file(%s): %s\n", req->path, strerror(-res));
+        return PRISKV_BACKEND_STATUS_ERROR;
+    }
+
+    return PRISKV_BACKEND_STATUS_OK;
+}
+
+/*
+ * All CQEs of the current stage arrived: move on to the next stage or finish.
+ * Return true if the request is finished.
+ */
+static bool localfs_advance_request(localfs_request *req)
+{
+    int res;
+
+    if (req->sync_submitted) {
+        res = req->sqes[LOCALFS_SQE_SYNC].res;
+        if (res < 0) {
+            priskv_log_error("BE_LOCALFS: failed to sync file(%s): %s\n", req->path,
+                             strerror(-res));
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            req->valuelen = 0;
         }
-        goto can_not_submit;
+        goto complete;
     }
 
-    sqe = io_uring_get_sqe(&ctx->ring);
-    if (!sqe) { // rarely
-        if (req->queued_once) {
-            list_add(&shared_ctx->pending_queue, &req->node);
+    if (req->io_submitted) {
+        res = req->sqes[LOCALFS_SQE_RW].res;
+        if (res < 0) { // res is errno returned by read/write, just log it
+            priskv_log_error("BE_LOCALFS: async operation failed: %s\n", strerror(-res));
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            req->valuelen = 0;
+        } else if (req->op_type == LOCALFS_OP_SET && res != req->valuelen) {
+            priskv_log_error("BE_LOCALFS: incomplete write: %d, expect: %lu\n", res,
+                             req->valuelen);
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            req->valuelen = 0;
         } else {
-            list_add_tail(&shared_ctx->pending_queue, &req->node);
-            req->queued_once = true;
+            req->status = PRISKV_BACKEND_STATUS_OK;
+            req->valuelen = res;
         }
-        goto can_not_submit;
-    }
 
-    shared_ctx->inflight_count++;
-    pthread_spin_unlock(&shared_ctx->queue_lock);
+        if (req->status == PRISKV_BACKEND_STATUS_OK && localfs_group_sync(req)) {
+            list_add_tail(&req->tdev->sync_queue, &req->node);
+            return false;
+        }
+        goto complete;
+    }
 
     switch (req->op_type) {
     case LOCALFS_OP_GET:
-        if (shared_ctx->policy) {
-            bool ref_acquired;
-            pthread_spin_lock(&shared_ctx->lock);
-            ref_acquired = priskv_policy_try_ref_key(shared_ctx->policy, req->key);
-            pthread_spin_unlock(&shared_ctx->lock);
-
-            if (!ref_acquired) {
-                priskv_log_debug("BE_LOCALFS: key %s not found in policy during submit\n",
-                                 req->key);
-                pthread_spin_lock(&shared_ctx->queue_lock);
-                if (shared_ctx->inflight_count > 0) {
-                    shared_ctx->inflight_count--;
-                }
-                pthread_spin_unlock(&shared_ctx->queue_lock);
-                req->status = PRISKV_BACKEND_STATUS_NOT_FOUND;
-                localfs_complete_request(req);
-                return false;
-            }
+        res = req->sqes[LOCALFS_SQE_OPEN].res;
+        if (res >= 0) {
+            req->fd = res;
         }
-        io_uring_prep_read(sqe, req->fd, req->val, req->valuelen, 0);
+
+        req->status = localfs_statx_status(req);
+        if (req->status != PRISKV_BACKEND_STATUS_OK) {
+            break;
+        }
+
+        if (req->stx.stx_size > req->valuelen) {
+            priskv_log_error("BE_LOCALFS: file size %llu exceeds buffer size %lu for key %s\n",
+                             req->stx.stx_size, req->valuelen, req->key);
+            req->status = PRISKV_BACKEND_STATUS_VALUE_TOO_BIG;
+            break;
+        }
+
+        if (res < 0) {
+            priskv_log_error("BE_LOCALFS: failed to open file(%s) when get: %s\n", req->path,
+                             strerror(-res));
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            break;
+        }
+
+        if (localfs_submit_rw(req)) {
+            return false;
+        }
+        req->status = PRISKV_BACKEND_STATUS_ERROR;
         break;
+
     case LOCALFS_OP_SET:
-        io_uring_prep_write(sqe, req->fd, req->val, req->valuelen, 0);
-        break;
-    default:
-        pthread_spin_lock(&shared_ctx->queue_lock);
-        if (shared_ctx->inflight_count > 0) {
-            shared_ctx->inflight_count--;
+        res = req->sqes[LOCALFS_SQE_OPEN].res;
+        if (req->sqes[LOCALFS_SQE_STATX].res == 0) {
+            req->old_valuelen = req->stx.stx_size;
+        }
+
+        if (res < 0) {
+            priskv_log_error("BE_LOCALFS: failed to open file(%s) when set: %s\n", req->path,
+                             strerror(-res));
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            break;
+        }
+        req->fd = res;
+
+        if (localfs_submit_rw(req)) {
+            return false;
         }
-        pthread_spin_unlock(&shared_ctx->queue_lock);
-        priskv_log_error("BE_LOCALFS: invalid op type\n");
         req->status = PRISKV_BACKEND_STATUS_ERROR;
-        localfs_complete_request(req);
-        return false;
+        break;
+
+    case LOCALFS_OP_DEL:
+    case LOCALFS_OP_EVICT:
+        res = req->sqes[LOCALFS_SQE_UNLINK].res;
+        if (req->sqes[LOCALFS_SQE_STATX].res == 0) {
+            req->old_valuelen = req->stx.stx_size;
+        }
+
+        req->valuelen = req->old_valuelen;
+        if (res < 0 && res != -ENOENT) {
+            priskv_log_error("BE_LOCALFS: failed to delete file %s: %s\n", req->path,
+                             strerror(-res));
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+        } else {
+            req->status = PRISKV_BACKEND_STATUS_OK;
+        }
+        goto complete;
+
+    case LOCALFS_OP_TEST:
+        req->status = localfs_statx_status(req);
+        req->valuelen = req->stx.stx_size;
+        if (req->status == PRISKV_BACKEND_STATUS_OK && req->valuelen == 0) {
+            req->status = PRISKV_BACKEND_STATUS_NOT_FOUND;
+        }
+        break;
     }
 
-    io_uring_sqe_set_data(sqe, req);
-    io_uring_submit(&ctx->ring);
+    if (req->status != PRISKV_BACKEND_STATUS_OK) {
+        req->valuelen = 0;
+    }
 
+complete:
+    localfs_complete_request(req);
     return true;
-
-can_not_submit:
-    pthread_spin_unlock(&shared_ctx->queue_lock);
-    return false;
 }
 
-static void localfs_get(priskv_backend_device *bdev, const char *key, uint8_t *val,
-                        uint64_t valuelen, priskv_backend_driver_cb cb, void *cbarg)
+/*
+ * Group commit: issue fdatasync => close for every SET written in this event pass within a
+ * single submission, the filesystem journal folds them into one commit. The SETs are
+ * acknowledged once their sync completes.
+ * Return the number of requests finished here because no SQE was left.
+ */
+static size_t localfs_group_commit(localfs_thread_device *tdev)
 {
-    if (bdev == NULL || bdev->private_data == NULL) {
-        priskv_log_error("BE_LOCALFS: invalid device or context\n");
-        if (cb) {
-            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+    localfs_request *req;
+    struct io_uring_sqe *sqe;
+    size_t failed = 0;
+    bool queued = false;
+
+    while ((req = list_pop(&tdev->sync_queue, localfs_request, node))) {
+        if (!localfs_reserve_sqes(tdev, LOCALFS_MAX_LINKED)) {
+            priskv_log_error("BE_LOCALFS: no SQE available to sync %s\n", req->path);
+            req->status = PRISKV_BACKEND_STATUS_ERROR;
+            req->valuelen = 0;
+            localfs_complete_request(req);
+            failed++;
+            continue;
         }
-        return;
+
+        sqe = io_uring_get_sqe(&tdev->ring);
+        io_uring_prep_fsync(sqe, req->fd, IORING_FSYNC_DATASYNC);
+        localfs_prep_sqe(req, sqe, LOCALFS_SQE_SYNC, IOSQE_IO_HARDLINK);
+
+        sqe = io_uring_get_sqe(&tdev->ring);
+        io_uring_prep_close(sqe, req->fd);
+        io_uring_sqe_set_data(sqe, NULL);
+
+        req->fd = -1;
+        req->sync_submitted = true;
+        queued = true;
     }
 
-    localfs_thread_context *ctx = bdev->private_data;
+    if (queued) {
+        localfs_kick(tdev);
+    }
 
-    localfs_request *req = localfs_make_request(ctx, key, val, valuelen, LOCALFS_OP_GET, cb, cbarg);
-    if (req == NULL) {
+    return failed;
+}
+
+/* Take a batch of queue depth from the device budget, return false if it is exhausted */
+static bool localfs_get_depth(localfs_thread_device *tdev)
+{
+    localfs_device *dev = tdev->dev;
+    uint32_t n;
+
+    pthread_spin_lock(&dev->queue_lock);
+    n = priskv_min_u32(dev->free_depth, LOCALFS_DEPTH_BATCH);
+    dev->free_depth -= n;
+    pthread_spin_unlock(&dev->queue_lock);
+
+    tdev->depth += n;
+
+    return n > 0;
+}
+
+/*
+ * Keep one idle batch for the next burst, give the rest back to the device budget. An idle
+ * thread gives back everything, so other threads aren't starved by depth it no longer uses.
+ */
+static void localfs_put_depth(localfs_thread_device *tdev)
+{
+    localfs_device *dev = tdev->dev;
+    uint32_t n;
+
+    if (!tdev->inflight && list_empty(&tdev->pending_queue)) {
+        n = tdev->depth;
+    } else if (tdev->inflight + 2 * LOCALFS_DEPTH_BATCH >= tdev->depth) {
         return;
+    } else {
+        n = tdev->depth - tdev->inflight - LOCALFS_DEPTH_BATCH;
     }
 
-    submit_io_request(req);
+    if (!n) {
+        return;
+    }
+    tdev->depth -= n;
+
+    pthread_spin_lock(&dev->queue_lock);
+    dev->free_depth += n;
+    pthread_spin_unlock(&dev->queue_lock);
 }
 
-static void localfs_set(priskv_backend_device *bdev, const char *key, uint8_t *val,
-                        uint64_t valuelen, uint64_t timeout, priskv_backend_driver_cb cb,
-                        void *cbarg)
+/* Give back the queue slot taken by a request that fails before reaching the ring */
+static void localfs_abort_submit(localfs_request *req, priskv_backend_status status)
 {
-    if (bdev == NULL || bdev->private_data == NULL) {
-        priskv_log_error("BE_LOCALFS: invalid device or context\n");
-        if (cb) {
-            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+    localfs_thread_device *tdev = req->tdev;
+
+    if (tdev->inflight > 0) {
+        tdev->inflight--;
+    }
+
+    req->status = status;
+    req->valuelen = 0;
+    localfs_complete_request(req);
+}
+
+/*
+ * Prepare the first stage of @req, or queue it if the queue depth of this thread is exhausted.
+ * A thread with nothing in flight always gets one slot, so its pending queue can't stall on
+ * depth idling in other threads. The SQEs are submitted at the end of the event pass.
+ * Return false if the request was queued.
+ */
+static bool submit_io_request(localfs_request *req)
+{
+    localfs_thread_device *tdev = req->tdev;
+    localfs_shared_context *shared_ctx = req->ctx->shared_ctx;
+    priskv_policy *policy = shared_ctx->devices[req->home].policy;
+
+    if (tdev->inflight >= tdev->depth && !localfs_get_depth(tdev) && tdev->inflight > 0) {
+        if (req->queued_once) {
+            list_add(&tdev->pending_queue, &req->node);
+        } else {
+            list_add_tail(&tdev->pending_queue, &req->node);
+            req->queued_once = true;
         }
-        return;
+        return false;
     }
 
-    localfs_thread_context *ctx = bdev->private_data;
+    tdev->inflight++;
 
-    localfs_request *req = localfs_make_request(ctx, key, val, valuelen, LOCALFS_OP_SET, cb, cbarg);
-    if (req == NULL) {
+    /* a striped value holds the policy reference for all its stripes */
+    if ((req->op_type == LOCALFS_OP_GET || req->op_type == LOCALFS_OP_TEST) && !req->stripe &&
+        policy) {
+        pthread_spin_lock(&shared_ctx->lock);
+        req->policy_ref = priskv_policy_try_ref_key(policy, req->key);
+        pthread_spin_unlock(&shared_ctx->lock);
+
+        if (!req->policy_ref) {
+            priskv_log_debug("BE_LOCALFS: key %s not found in policy during submit\n", req->key);
+            localfs_abort_submit(req, PRISKV_BACKEND_STATUS_NOT_FOUND);
+            return true;
+        }
+    }
+
+    if (!localfs_reserve_sqes(tdev, LOCALFS_MAX_LINKED)) { // rarely
+        priskv_log_error("BE_LOCALFS: no SQE available for %s\n", req->path);
+        localfs_abort_submit(req, PRISKV_BACKEND_STATUS_ERROR);
+        return true;
+    }
+
+    localfs_prep_lookup(req);
+    localfs_kick(tdev);
+
+    return true;
+}
+
+static void localfs_stripe_cleanup(localfs_stripe *stripe);
+
+static void localfs_stripe_put(localfs_stripe *stripe)
+{
+    localfs_shared_context *shared_ctx = stripe->ctx->shared_ctx;
+    bool ok = stripe->status == PRISKV_BACKEND_STATUS_OK;
+
+    if (--stripe->pending) {
         return;
     }
 
-    submit_io_request(req);
+    if (stripe->op_type == LOCALFS_OP_SET && !ok && !stripe->cleanup) {
+        localfs_stripe_cleanup(stripe);
+        return;
+    }
+
+    pthread_spin_lock(&shared_ctx->lock);
+    if (stripe->cleanup) {
+        /* the key is gone from every device, forget it like a DEL does */
+        localfs_account_key(shared_ctx, LOCALFS_OP_DEL, stripe->key, stripe->home, 0, 0, true,
+                            stripe->policy_ref);
+    } else {
+        localfs_account_key(shared_ctx, stripe->op_type, stripe->key, stripe->home,
+                            stripe->nstripes, stripe->valuelen, ok, stripe->policy_ref);
+    }
+    pthread_spin_unlock(&shared_ctx->lock);
+
+    if (stripe->cb) {
+        stripe->cb(stripe->status, ok ? stripe->valuelen : 0, stripe->cbarg);
+    }
+
+    free(stripe->key);
+    free(stripe);
 }
 
-static void localfs_del(priskv_backend_device *bdev, const char *key, priskv_backend_driver_cb cb,
-                        void *cbarg)
+static void localfs_stripe_cb(priskv_backend_status status, uint32_t length, void *arg)
 {
-    if (bdev == NULL || bdev->private_data == NULL) {
-        priskv_log_error("BE_LOCALFS: invalid device or context\n");
+    localfs_stripe *stripe = arg;
+
+    if (status != PRISKV_BACKEND_STATUS_OK) {
+        if (stripe->status == PRISKV_BACKEND_STATUS_OK) {
+            stripe->status = status;
+        }
+    } else {
+        stripe->valuelen += length;
+    }
+
+    localfs_stripe_put(stripe);
+}
+
+/* a stale stripe left by a value with more stripes, failing to delete it only leaks space */
+static void localfs_stripe_cleanup_cb(priskv_backend_status status, uint32_t length, void *arg)
+{
+    localfs_stripe *stripe = arg;
+
+    if (status != PRISKV_BACKEND_STATUS_OK && status != PRISKV_BACKEND_STATUS_NOT_FOUND) {
+        priskv_log_warn("BE_LOCALFS: failed to delete stale stripe of key %s\n", stripe->key);
+    }
+
+    localfs_stripe_put(stripe);
+}
+
+/*
+ * A failed SET may have overwritten some stripes of the old value and not others, so neither
+ * value can be read back. Delete every stripe the key may have, then fail the SET.
+ */
+static void localfs_stripe_cleanup(localfs_stripe *stripe)
+{
+    localfs_shared_context *shared_ctx = stripe->ctx->shared_ctx;
+
+    priskv_log_warn("BE_LOCALFS: SET of striped key %s failed, deleting all its stripes\n",
+                    stripe->key);
+
+    stripe->cleanup = true;
+    stripe->pending = 1 + stripe->nfiles;
+    for (uint32_t i = 0; i < stripe->nfiles; i++) {
+        uint32_t dev = (stripe->home + i) % shared_ctx->ndevices;
+        localfs_request *req;
+
+        req = localfs_make_request(stripe->ctx, dev, stripe->home, stripe, stripe->key, NULL, 0,
+                                   LOCALFS_OP_DEL, localfs_stripe_cleanup_cb, stripe);
+        if (req) {
+            submit_io_request(req);
+        }
+    }
+
+    localfs_stripe_put(stripe);
+}
+
+/*
+ * Run an operation on a value of @nstripes stripes, stripe i covers [i * size, (i + 1) * size)
+ * of the @len bytes with size = DIV_ROUND_UP(@len, @nstripes) and lives on device
+ * (home + i) % ndevices. A SET also deletes the stripes beyond @nstripes the old value had, and
+ * all the stripes of the key if it fails.
+ */
+static void localfs_submit_stripes(localfs_thread_context *ctx, const char *key, uint8_t *val,
+                                   uint64_t valuelen, localfs_op_type op_type, uint32_t home,
+                                   uint32_t nstripes, uint32_t old_nstripes, uint64_t len,
+                                   priskv_backend_driver_cb cb, void *cbarg)
+{
+    localfs_shared_context *shared_ctx = ctx->shared_ctx;
+    priskv_policy *policy = shared_ctx->devices[home].policy;
+    uint64_t size = DIV_ROUND_UP(len, nstripes);
+    uint32_t nreqs = op_type == LOCALFS_OP_SET ? priskv_max_u32(nstripes, old_nstripes) : nstripes;
+    localfs_stripe *stripe = calloc(1, sizeof(*stripe));
+
+    if (!stripe) {
+        priskv_log_error("BE_LOCALFS: failed to allocate stripe request\n");
         if (cb) {
             cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
         }
         return;
     }
 
-    priskv_backend_status status = PRISKV_BACKEND_STATUS_OK;
+    stripe->ctx = ctx;
+    stripe->key = strdup(key);
+    stripe->op_type = op_type;
+    stripe->home = home;
+    stripe->nstripes = nstripes;
+    stripe->nfiles = nreqs;
+    stripe->status = PRISKV_BACKEND_STATUS_OK;
+    stripe->cb = cb;
+    stripe->cbarg = cbarg;
+    stripe->pending = 1;
 
-    localfs_thread_context *ctx = (localfs_thread_context *)bdev->private_data;
-    localfs_shared_context *shared_ctx = ctx->shared_ctx;
-    assert(shared_ctx);
+    if ((op_type == LOCALFS_OP_GET || op_type == LOCALFS_OP_TEST) && policy) {
+        pthread_spin_lock(&shared_ctx->lock);
+        stripe->policy_ref = priskv_policy_try_ref_key(policy, key);
+        pthread_spin_unlock(&shared_ctx->lock);
 
-    char path[PATH_MAX];
+        if (!stripe->policy_ref) {
+            stripe->status = PRISKV_BACKEND_STATUS_NOT_FOUND;
+            goto out;
+        }
+    }
 
-    if (snprintf(path, sizeof(path), "%s/%s", shared_ctx->path, key) >= sizeof(path)) {
-        priskv_log_error("BE_LOCALFS: path too long\n");
-        status = PRISKV_BACKEND_STATUS_ERROR;
+    if (op_type == LOCALFS_OP_GET && len > valuelen) {
+        priskv_log_error("BE_LOCALFS: value size %lu exceeds buffer size %lu for key %s\n", len,
+                         valuelen, key);
+        stripe->status = PRISKV_BACKEND_STATUS_VALUE_TOO_BIG;
         goto out;
     }
 
-    uint64_t valuelen = get_file_size(path);
+    stripe->pending += nreqs;
+    for (uint32_t i = 0; i < nreqs; i++) {
+        uint32_t dev = (home + i) % shared_ctx->ndevices;
+        uint64_t offset = i * size;
+        localfs_request *req;
 
-    if (unlink(path) && errno != ENOENT) {
-        priskv_log_error("BE_LOCALFS: failed to delete file: %s\n", strerror(errno));
-        status = PRISKV_BACKEND_STATUS_ERROR;
-    } else {
-        pthread_spin_lock(&shared_ctx->lock);
-        shared_ctx->free_size += valuelen;
+        if (i >= nstripes) {
+            req = localfs_make_request(ctx, dev, home, stripe, key, NULL, 0, LOCALFS_OP_DEL,
+                                       localfs_stripe_cleanup_cb, stripe);
+        } else if (op_type == LOCALFS_OP_GET || op_type == LOCALFS_OP_SET) {
+            req = localfs_make_request(ctx, dev, home, stripe, key, val + offset,
+                                       priskv_min_u64(size, len - offset), op_type,
+                                       localfs_stripe_cb, stripe);
+        } else {
+            req = localfs_make_request(ctx, dev, home, stripe, key, NULL, 0, op_type,
+                                       localfs_stripe_cb, stripe);
+        }
 
-        if (shared_ctx->policy) {
-            priskv_policy_del_key(shared_ctx->policy, key);
+        if (req) {
+            submit_io_request(req);
         }
-        pthread_spin_unlock(&shared_ctx->lock);
     }
 
 out:
-    if (cb) {
-        cb(status, valuelen, cbarg);
+    localfs_stripe_put(stripe);
+}
+
+/* Find the home and stripes of @key, then submit the operation on it */
+static void localfs_submit_key(localfs_thread_context *ctx, const char *key, uint8_t *val,
+                               uint64_t valuelen, localfs_op_type op_type,
+                               priskv_backend_driver_cb cb, void *cbarg)
+{
+    localfs_shared_context *shared_ctx = ctx->shared_ctx;
+    uint32_t home = 0, nstripes = 1, old_nstripes = 1;
+    uint64_t len = valuelen;
+    localfs_request *req;
+    localfs_key *k;
+
+    if (shared_ctx->ndevices > 1) {
+        pthread_spin_lock(&shared_ctx->lock);
+        HASH_FIND_STR(shared_ctx->keys, key, k);
+        if (k) {
+            home = k->home;
+            old_nstripes = k->nstripes;
+            len = k->len;
+        } else if (op_type == LOCALFS_OP_SET) {
+            home = localfs_place_key(shared_ctx, key);
+        } else {
+            /* a key unknown to the index, e.g. left by a previous run */
+            home = priskv_crc32((uint8_t *)key, strlen(key)) % shared_ctx->ndevices;
+        }
+        pthread_spin_unlock(&shared_ctx->lock);
+
+        if (op_type == LOCALFS_OP_SET) {
+            nstripes = localfs_nstripes(shared_ctx, valuelen);
+            len = valuelen;
+        } else {
+            nstripes = old_nstripes;
+        }
     }
+
+    if (nstripes > 1 || old_nstripes > 1) {
+        localfs_submit_stripes(ctx, key, val, valuelen, op_type, home, nstripes, old_nstripes, len,
+                               cb, cbarg);
+        return;
+    }
+
+    req = localfs_make_request(ctx, home, home, NULL, key, val, valuelen, op_type, cb, cbarg);
+    if (req == NULL) {
+        return;
+    }
+
+    submit_io_request(req);
 }
 
-static void localfs_evict(priskv_backend_device *bdev, priskv_backend_driver_cb cb, void *cbarg)
+static void localfs_get(priskv_backend_device *bdev, const char *key, uint8_t *val,
+                        uint64_t valuelen, priskv_backend_driver_cb cb, void *cbarg)
 {
     if (bdev == NULL || bdev->private_data == NULL) {
         priskv_log_error("BE_LOCALFS: invalid device or context\n");
@@ -819,76 +1666,82 @@ static void localfs_evict(priskv_backend_device *bdev, priskv_backend_driver_cb
         return;
     }
 
-    localfs_thread_context *ctx = bdev->private_data;
-    localfs_shared_context *shared_ctx = ctx->shared_ctx;
-    assert(shared_ctx);
+    localfs_submit_key(bdev->private_data, key, val, valuelen, LOCALFS_OP_GET, cb, cbarg);
+}
 
-    pthread_spin_lock(&shared_ctx->lock);
-    if (!shared_ctx->policy) {
-        pthread_spin_unlock(&shared_ctx->lock);
-        priskv_log_error("BE_LOCALFS: no policy configured for eviction\n");
+static void localfs_set(priskv_backend_device *bdev, const char *key, uint8_t *val,
+                        uint64_t valuelen, uint64_t timeout, priskv_backend_driver_cb cb,
+                        void *cbarg)
+{
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_LOCALFS: invalid device or context\n");
         if (cb) {
             cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
         }
         return;
     }
 
-    const char *key = priskv_policy_evict(shared_ctx->policy);
-    if (!key) {
-        pthread_spin_unlock(&shared_ctx->lock);
-        priskv_log_debug("BE_LOCALFS: no key available for eviction\n");
+    localfs_submit_key(bdev->private_data, key, val, valuelen, LOCALFS_OP_SET, cb, cbarg);
+}
+
+static void localfs_del(priskv_backend_device *bdev, const char *key, priskv_backend_driver_cb cb,
+                        void *cbarg)
+{
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_LOCALFS: invalid device or context\n");
         if (cb) {
-            cb(PRISKV_BACKEND_STATUS_NO_SPACE, 0, cbarg);
+            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
         }
         return;
     }
-    pthread_spin_unlock(&shared_ctx->lock);
 
-    char path[PATH_MAX];
-    if (snprintf(path, sizeof(path), "%s/%s", shared_ctx->path, key) >= sizeof(path)) {
-        priskv_log_error("BE_LOCALFS: path too long for key: %s\n", key);
-        free((char *)key);
+    localfs_submit_key(bdev->private_data, key, NULL, 0, LOCALFS_OP_DEL, cb, cbarg);
+}
+
+/* Evict the LRU key of the device is_cacheable() found short of space */
+static void localfs_evict(priskv_backend_device *bdev, priskv_backend_driver_cb cb, void *cbarg)
+{
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_LOCALFS: invalid device or context\n");
         if (cb) {
             cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
         }
         return;
     }
 
-    uint64_t valuelen = get_file_size(path);
+    localfs_thread_context *ctx = bdev->private_data;
+    localfs_shared_context *shared_ctx = ctx->shared_ctx;
+    assert(shared_ctx);
+    localfs_device *dev = &shared_ctx->devices[ctx->evict_dev % shared_ctx->ndevices];
 
-    if (unlink(path) && errno != ENOENT) {
-        priskv_log_error("BE_LOCALFS: failed to delete file %s: %s\n", path, strerror(errno));
-        free((char *)key);
+    pthread_spin_lock(&shared_ctx->lock);
+    if (!dev->policy) {
+        pthread_spin_unlock(&shared_ctx->lock);
+        priskv_log_error("BE_LOCALFS: no policy configured for eviction\n");
         if (cb) {
-            cb(PRISKV_BACKEND_STATUS_ERROR, valuelen, cbarg);
+            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
         }
         return;
     }
 
-    pthread_spin_lock(&shared_ctx->lock);
-    shared_ctx->free_size += valuelen;
+    const char *key = priskv_policy_evict(dev->policy);
+    if (!key) {
+        pthread_spin_unlock(&shared_ctx->lock);
+        priskv_log_debug("BE_LOCALFS: no key available for eviction on %s\n", dev->path);
+        if (cb) {
+            cb(PRISKV_BACKEND_STATUS_NO_SPACE, 0, cbarg);
+        }
+        return;
+    }
     pthread_spin_unlock(&shared_ctx->lock);
 
-    priskv_log_debug("BE_LOCALFS: evicted key %s, freed %lu bytes\n", key, valuelen);
+    localfs_submit_key(ctx, key, NULL, 0, LOCALFS_OP_EVICT, cb, cbarg);
     free((char *)key);
-
-    if (cb) {
-        cb(PRISKV_BACKEND_STATUS_OK, valuelen, cbarg);
-    }
 }
 
-static int localfs_clearup(priskv_backend_device *bdev)
+static int localfs_clearup_device(localfs_device *dev)
 {
-    if (bdev == NULL || bdev->private_data == NULL) {
-        priskv_log_error("BE_LOCALFS: invalid device or context\n");
-        return -1;
-    }
-
-    localfs_thread_context *ctx = bdev->private_data;
-    localfs_shared_context *shared_ctx = ctx->shared_ctx;
-    assert(shared_ctx);
-
-    DIR *dir = opendir(shared_ctx->path);
+    DIR *dir = opendir(dev->path);
     if (!dir) {
         priskv_log_error("BE_LOCALFS: failed to open directory: %s\n", strerror(errno));
         return -1;
@@ -899,7 +1752,7 @@ static int localfs_clearup(priskv_backend_device *bdev)
 
     while ((entry = readdir(dir)) != NULL) {
         if (entry->d_type == DT_REG) {
-            snprintf(full_path, sizeof(full_path), "%s/%s", shared_ctx->path, entry->d_name);
+            snprintf(full_path, sizeof(full_path), "%s/%s", dev->path, entry->d_name);
             if (unlink(full_path) && errno != ENOENT) {
                 priskv_log_error("BE_LOCALFS: failed to delete file: %s\n", strerror(errno));
                 closedir(dir);
@@ -908,72 +1761,56 @@ static int localfs_clearup(priskv_backend_device *bdev)
         }
     }
 
-    pthread_spin_lock(&shared_ctx->lock);
-    shared_ctx->free_size = shared_ctx->total_size;
-    pthread_spin_unlock(&shared_ctx->lock);
-
     closedir(dir);
 
     return 0;
 }
 
-static void localfs_test(priskv_backend_device *bdev, const char *key, priskv_backend_driver_cb cb,
-                         void *cbarg)
+static int localfs_clearup(priskv_backend_device *bdev)
 {
     if (bdev == NULL || bdev->private_data == NULL) {
         priskv_log_error("BE_LOCALFS: invalid device or context\n");
-        if (cb) {
-            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
-        }
-        return;
+        return -1;
     }
 
-    priskv_backend_status status = PRISKV_BACKEND_STATUS_NOT_FOUND;
-    bool ref_acquired = false;
-    uint32_t valuelen = 0;
-
-    localfs_thread_context *ctx = (localfs_thread_context *)bdev->private_data;
+    localfs_thread_context *ctx = bdev->private_data;
     localfs_shared_context *shared_ctx = ctx->shared_ctx;
+    localfs_key *k, *tmp;
     assert(shared_ctx);
 
-    if (shared_ctx->policy) {
-        pthread_spin_lock(&shared_ctx->lock);
-        ref_acquired = priskv_policy_try_ref_key(shared_ctx->policy, key);
-        pthread_spin_unlock(&shared_ctx->lock);
-
-        if (!ref_acquired) {
-            priskv_log_debug("BE_LOCALFS: key %s not found in policy\n", key);
-            goto out;
+    for (uint32_t i = 0; i < shared_ctx->ndevices; i++) {
+        if (localfs_clearup_device(&shared_ctx->devices[i])) {
+            return -1;
         }
     }
 
-    char path[PATH_MAX];
-
-    if (snprintf(path, sizeof(path), "%s/%s", shared_ctx->path, key) >= sizeof(path)) {
-        priskv_log_error("BE_LOCALFS: path too long\n");
-        status = PRISKV_BACKEND_STATUS_ERROR;
-        goto out_unref;
+    pthread_spin_lock(&shared_ctx->lock);
+    for (uint32_t i = 0; i < shared_ctx->ndevices; i++) {
+        shared_ctx->devices[i].free_size = shared_ctx->devices[i].total_size;
     }
-
-    valuelen = get_file_size(path);
-    if (valuelen > 0) {
-        status = PRISKV_BACKEND_STATUS_OK;
-    } else if (errno != ENOENT) {
-        priskv_log_error("BE_LOCALFS: failed to get file size: %s\n", strerror(errno));
-        status = PRISKV_BACKEND_STATUS_ERROR;
+    HASH_ITER(hh, shared_ctx->keys, k, tmp)
+    {
+        HASH_DEL(shared_ctx->keys, k);
+        free(k->key);
+        free(k);
     }
+    pthread_spin_unlock(&shared_ctx->lock);
 
-out_unref:
-    if (ref_acquired && shared_ctx->policy) {
-        pthread_spin_lock(&shared_ctx->lock);
-        priskv_policy_unref_key(shared_ctx->policy, key);
-        pthread_spin_unlock(&shared_ctx->lock);
-    }
+    return 0;
+}
 
-out:
-    if (cb) {
-        cb(status, valuelen, cbarg);
+static void localfs_test(priskv_backend_device *bdev, const char *key, priskv_backend_driver_cb cb,
+                         void *cbarg)
+{
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_LOCALFS: invalid device or context\n");
+        if (cb) {
+            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+        }
+        return;
     }
+
+    localfs_submit_key(bdev->private_data, key, NULL, 0, LOCALFS_OP_TEST, cb, cbarg);
 }
 
 static priskv_backend_driver localfs_driver = {
@@ -0,0 +1,1632 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+/*
+ * segfs: log-structured segment store.
+ *
+ * Values are appended to a fixed set of preallocated segment files, an in-memory index maps
+ * each key to (segment, offset, length). Overwritten, deleted and evicted values leave dead
+ * bytes behind, a GC thread relocates the live values of the emptiest segment and recycles it.
+ * The index is checkpointed on a clean shutdown and loaded on startup, there is no directory
+ * scan. Without a checkpoint (e.g. after a crash) the store starts empty.
+ *
+ * The index is sharded by key hash, each shard has its own lock and LRU. Segment allocation
+ * and the GC take the shared lock, live bytes and pins of a segment are updated atomically.
+ *
+ * With direct=1 the segments are also opened with O_DIRECT: a value in the KV value region goes
+ * straight between its buddy extent and the device, through READ_FIXED/WRITE_FIXED once the
+ * region is registered to the ring. Appends are then aligned to SEGFS_DIRECT_ALIGN, a buffer
+ * outside the region (e.g. a write-back copy) still goes through the page cache.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <liburing.h>
+#include <pthread.h>
+
+#include "backend.h"
+#include "priskv-log.h"
+#include "priskv-event.h"
+#include "priskv-utils.h"
+#include "list.h"
+#include "uthash.h"
+
+#define SEGFS_DEFAULT_SEGMENT_SIZE (256UL << 20)
+#define SEGFS_MIN_SEGMENTS 4
+#define SEGFS_DEFAULT_GC_RATIO 50 /* collect a segment once live bytes drop below this percent */
+#define SEGFS_GC_RESERVE 1        /* free segments only the GC may append to */
+#define SEGFS_GC_LOW_WATERMARK 2  /* wake up the GC below this many free segments */
+#define SEGFS_GC_INTERVAL_MS 1000
+#define SEGFS_GC_WAIT_PASSES 3    /* GC passes a SET waits for space before NO_SPACE */
+#define SEGFS_RING_DEPTH 128
+#define SEGFS_DIRECT_ALIGN 4096
+#define SEGFS_FIXED_BUF_MAX (1UL << 30) /* kernel limit of a registered buffer */
+#define SEGFS_SQPOLL_IDLE_MS 1000
+#define SEGFS_INDEX_SHARDS 64
+
+#define SEGFS_INDEX_FILE "index"
+#define SEGFS_INDEX_MAGIC 0x47534b50 /* "PKSG" */
+#define SEGFS_INDEX_VERSION 1
+
+typedef enum {
+    SEGFS_SEGMENT_FREE,
+    SEGFS_SEGMENT_OPEN,   /* taking appends */
+    SEGFS_SEGMENT_SEALED, /* full, read only */
+    SEGFS_SEGMENT_GC,     /* live values being relocated */
+} segfs_segment_state;
+
+typedef struct segfs_segment {
+    int fd;
+    int dfd; /* O_DIRECT, -1 if direct I/O is off */
+    segfs_segment_state state;
+    uint64_t tail; /* next append offset */
+
+    /* entries and live change under this lock, live and refs are read without it */
+    pthread_spinlock_t lock;
+    uint64_t live; /* bytes still referenced by the index */
+    int refs;      /* in-flight reads and writes */
+    struct list_head entries;
+} segfs_segment;
+
+typedef struct segfs_entry {
+    char *key;
+    uint32_t seg;
+    uint32_t len;
+    uint64_t offset;
+    uint64_t atime;       /* access_seq of the last SET or GET */
+    struct list_node lru; /* head of the shard LRU is the most recently used */
+    struct list_node seg_node;
+    UT_hash_handle hh;
+} segfs_entry;
+
+/* a slice of the index by key hash, with its own lock and LRU */
+typedef struct segfs_index_shard {
+    pthread_mutex_t lock;
+    segfs_entry *index;
+    struct list_head lru;
+} segfs_index_shard;
+
+typedef struct segfs_shared_context {
+    char *path;
+    uint64_t total_size;
+    uint64_t segment_size;
+    uint32_t nsegments;
+    uint32_t gc_ratio;
+    bool direct;
+    bool sqpoll;
+
+    /* the KV value region, only used with direct I/O */
+    uint8_t *region_base;
+    uint64_t region_size;
+
+    /* segment allocation and states, GC progress and the thread list */
+    pthread_mutex_t lock;
+    pthread_cond_t gc_cond;
+    pthread_t gc_thread;
+    bool stopping;
+    uint64_t gc_seq;          /* GC passes started */
+    uint64_t gc_done;         /* GC passes finished */
+    bool gc_kick;             /* a SET waits for space, run another pass right away */
+    struct list_head threads; /* thread contexts to wake up once the GC frees space */
+
+    segfs_segment *segments;
+    uint32_t nfree;
+    int active;    /* segment taking appends, -1 if none */
+    int gc_active; /* segment taking relocated values, -1 if none */
+    uint64_t live;
+    segfs_index_shard shards[SEGFS_INDEX_SHARDS];
+    uint64_t access_seq; /* stamps the entries, orders the LRUs of the shards */
+
+    int ref_count;
+} segfs_shared_context;
+
+typedef struct segfs_thread_context {
+    priskv_backend_device *bdev;
+    struct io_uring ring;
+    bool fixed; /* the value region is registered to the ring */
+
+    /* SETs waiting for the GC to free a segment, in arrival order */
+    struct list_head space_waiters;
+    int space_fd;
+    bool waiting; /* space_waiters is not empty, under shared_ctx->lock */
+    struct list_node node;
+
+    segfs_shared_context *shared_ctx;
+} segfs_thread_context;
+
+typedef enum {
+    SEGFS_OP_GET,
+    SEGFS_OP_SET,
+} segfs_op_type;
+
+typedef struct segfs_request {
+    segfs_thread_context *ctx;
+    char *key;
+    uint8_t *val;
+    uint32_t len;
+    uint32_t iolen; /* len aligned up for direct I/O */
+    uint32_t seg;
+    uint64_t offset;
+    segfs_op_type op_type;
+    priskv_backend_driver_cb cb;
+    void *cbarg;
+
+    /* a SET waiting for space retries once GC pass gc_seq finished */
+    struct list_node node;
+    uint64_t gc_seq;
+    uint32_t gc_waits;
+} segfs_request;
+
+typedef struct segfs_index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t segment_size;
+    uint32_t nsegments;
+    uint32_t reserved;
+    uint64_t nentries;
+} segfs_index_header;
+
+typedef struct segfs_index_record {
+    uint32_t seg;
+    uint32_t len;
+    uint64_t offset;
+    uint32_t keylen;
+    uint32_t reserved;
+} segfs_index_record;
+
+static segfs_shared_context *segfs_shared_ctx = NULL;
+static pthread_mutex_t segfs_shared_ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Space taken by a value of @len, direct I/O needs every value to start aligned */
+static uint64_t segfs_reserve_len(segfs_shared_context *ctx, uint64_t len)
+{
+    return ctx->direct ? ALIGN_UP(len, SEGFS_DIRECT_ALIGN) : len;
+}
+
+/* FNV-1a, independent of the uthash bucket hash so a shard still spreads over its buckets */
+static segfs_index_shard *segfs_shard(segfs_shared_context *ctx, const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    for (const char *c = key; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+
+    return &ctx->shards[hash % SEGFS_INDEX_SHARDS];
+}
+
+/* the following helpers are called with the lock of the entry's shard held */
+
+static void segfs_entry_attach(segfs_shared_context *ctx, segfs_entry *entry, uint32_t seg,
+                               uint64_t offset, uint32_t len)
+{
+    segfs_segment *segment = &ctx->segments[seg];
+    /* count the alignment padding as live, it is reclaimed only with the value */
+    uint64_t rlen = segfs_reserve_len(ctx, len);
+
+    entry->seg = seg;
+    entry->offset = offset;
+    entry->len = len;
+
+    pthread_spin_lock(&segment->lock);
+    list_add_tail(&segment->entries, &entry->seg_node);
+    __atomic_add_fetch(&segment->live, rlen, __ATOMIC_RELAXED);
+    pthread_spin_unlock(&segment->lock);
+    __atomic_add_fetch(&ctx->live, rlen, __ATOMIC_RELAXED);
+}
+
+static void segfs_entry_detach(segfs_shared_context *ctx, segfs_entry *entry)
+{
+    segfs_segment *segment = &ctx->segments[entry->seg];
+    uint64_t rlen = segfs_reserve_len(ctx, entry->len);
+
+    pthread_spin_lock(&segment->lock);
+    list_del(&entry->seg_node);
+    __atomic_sub_fetch(&segment->live, rlen, __ATOMIC_RELAXED);
+    pthread_spin_unlock(&segment->lock);
+    __atomic_sub_fetch(&ctx->live, rlen, __ATOMIC_RELAXED);
+}
+
+static void segfs_index_del(segfs_shared_context *ctx, segfs_index_shard *shard,
+                            segfs_entry *entry)
+{
+    segfs_entry_detach(ctx, entry);
+    list_del(&entry->lru);
+    HASH_DEL(shard->index, entry);
+    free(entry->key);
+    free(entry);
+}
+
+/* Point @key at its new location, takes the shard lock */
+static void segfs_index_update(segfs_shared_context *ctx, const char *key, uint32_t seg,
+                               uint64_t offset, uint32_t len)
+{
+    segfs_index_shard *shard = segfs_shard(ctx, key);
+    segfs_entry *entry;
+
+    pthread_mutex_lock(&shard->lock);
+    HASH_FIND_STR(shard->index, key, entry);
+    if (entry) {
+        segfs_entry_detach(ctx, entry);
+        list_del(&entry->lru);
+    } else {
+        entry = calloc(1, sizeof(segfs_entry));
+        entry->key = strdup(key);
+        HASH_ADD_KEYPTR(hh, shard->index, entry->key, strlen(entry->key), entry);
+    }
+
+    segfs_entry_attach(ctx, entry, seg, offset, len);
+    entry->atime = __atomic_add_fetch(&ctx->access_seq, 1, __ATOMIC_RELAXED);
+    list_add(&shard->lru, &entry->lru);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/* Drop every key and free every segment, takes the shard locks and shared_ctx->lock */
+static void segfs_index_reset(segfs_shared_context *ctx)
+{
+    segfs_entry *entry, *tmp;
+
+    for (int i = 0; i < SEGFS_INDEX_SHARDS; i++) {
+        segfs_index_shard *shard = &ctx->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        HASH_ITER(hh, shard->index, entry, tmp) {
+            segfs_index_del(ctx, shard, entry);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        ctx->segments[i].state = SEGFS_SEGMENT_FREE;
+        ctx->segments[i].tail = 0;
+        ctx->segments[i].live = 0;
+    }
+    ctx->nfree = ctx->nsegments;
+    ctx->active = -1;
+    ctx->gc_active = -1;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/* the following helpers are called with shared_ctx->lock held */
+
+static int segfs_take_free_segment(segfs_shared_context *ctx, bool gc)
+{
+    if (ctx->nfree <= (gc ? 0 : SEGFS_GC_RESERVE)) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        segfs_segment *seg = &ctx->segments[i];
+
+        if (seg->state == SEGFS_SEGMENT_FREE) {
+            seg->state = SEGFS_SEGMENT_OPEN;
+            seg->tail = 0;
+            seg->live = 0;
+            ctx->nfree--;
+            if (ctx->nfree < SEGFS_GC_LOW_WATERMARK) {
+                pthread_cond_signal(&ctx->gc_cond);
+            }
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Whether the GC can turn the dead bytes of a sealed segment into a free one */
+static bool segfs_gc_reclaimable(segfs_shared_context *ctx)
+{
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        segfs_segment *seg = &ctx->segments[i];
+
+        if ((seg->state == SEGFS_SEGMENT_SEALED || seg->state == SEGFS_SEGMENT_GC) &&
+            __atomic_load_n(&seg->live, __ATOMIC_RELAXED) < seg->tail) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Whether a value of @len can be appended now, or once the GC recycles a segment */
+static bool segfs_has_room(segfs_shared_context *ctx, uint64_t len)
+{
+    if (ctx->active >= 0 &&
+        ctx->segments[ctx->active].tail + segfs_reserve_len(ctx, len) <= ctx->segment_size) {
+        return true;
+    }
+
+    return ctx->nfree > SEGFS_GC_RESERVE || segfs_gc_reclaimable(ctx);
+}
+
+/* Run a GC pass as soon as the current one, if any, is over */
+static void segfs_gc_kick(segfs_shared_context *ctx)
+{
+    ctx->gc_kick = true;
+    pthread_cond_signal(&ctx->gc_cond);
+}
+
+/* Let the threads with SETs waiting for space retry them */
+static void segfs_wake_waiters(segfs_shared_context *ctx)
+{
+    segfs_thread_context *tctx;
+    uint64_t val = 1;
+
+    list_for_each(&ctx->threads, tctx, node) {
+        if (tctx->waiting && write(tctx->space_fd, &val, sizeof(val)) != sizeof(val)) {
+            priskv_log_error("BE_SEGFS: failed to wake up thread: %s\n", strerror(errno));
+        }
+    }
+}
+
+/*
+ * Reserve @len bytes at the tail of the active segment (or the GC one), the segment is pinned
+ * until the write completes. Return the segment, -1 if no space is left.
+ */
+static int segfs_append(segfs_shared_context *ctx, uint32_t len, bool gc, uint64_t *offset)
+{
+    int *active = gc ? &ctx->gc_active : &ctx->active;
+    segfs_segment *seg;
+
+    if (*active >= 0 &&
+        ctx->segments[*active].tail + segfs_reserve_len(ctx, len) > ctx->segment_size) {
+        ctx->segments[*active].state = SEGFS_SEGMENT_SEALED;
+        *active = -1;
+    }
+
+    if (*active < 0) {
+        *active = segfs_take_free_segment(ctx, gc);
+        if (*active < 0) {
+            pthread_cond_signal(&ctx->gc_cond);
+            return -1;
+        }
+    }
+
+    seg = &ctx->segments[*active];
+    *offset = seg->tail;
+    seg->tail += segfs_reserve_len(ctx, len);
+    __atomic_add_fetch(&seg->refs, 1, __ATOMIC_RELAXED);
+
+    return *active;
+}
+
+/* ADDRESS: /a/b/c/&size=100GB&segment=256MB&gc=50&direct=1&sqpoll=1 */
+static int segfs_parse_address(segfs_shared_context *ctx, const char *address)
+{
+    char *p = strchr(address, '&');
+    char *opts, *opt, *saveptr = NULL;
+    bool has_size = false;
+    int64_t num;
+    int ret = 0;
+
+    ctx->segment_size = SEGFS_DEFAULT_SEGMENT_SIZE;
+    ctx->gc_ratio = SEGFS_DEFAULT_GC_RATIO;
+
+    if (!p) {
+        ctx->path = strdup(address);
+    } else {
+        ctx->path = strndup(address, p - address);
+
+        opts = strdup(p + 1);
+        for (opt = strtok_r(opts, "&", &saveptr); opt && !ret;
+             opt = strtok_r(NULL, "&", &saveptr)) {
+            if (!strncmp(opt, "size=", 5)) {
+                ret = priskv_str2num(opt + 5, &num);
+                ctx->total_size = num;
+                has_size = true;
+            } else if (!strncmp(opt, "segment=", 8)) {
+                ret = priskv_str2num(opt + 8, &num);
+                if (!ret && (num <= 0 || num > UINT32_MAX)) {
+                    priskv_log_error("BE_SEGFS: invalid segment size %s\n", opt + 8);
+                    ret = -1;
+                }
+                ctx->segment_size = num;
+            } else if (!strncmp(opt, "gc=", 3)) {
+                ret = priskv_str2num(opt + 3, &num);
+                if (!ret && (num <= 0 || num > 100)) {
+                    priskv_log_error("BE_SEGFS: invalid gc ratio %s\n", opt + 3);
+                    ret = -1;
+                }
+                ctx->gc_ratio = num;
+            } else if (!strncmp(opt, "direct=", 7)) {
+                ret = priskv_str2num(opt + 7, &num);
+                ctx->direct = num;
+            } else if (!strncmp(opt, "sqpoll=", 7)) {
+                ret = priskv_str2num(opt + 7, &num);
+                ctx->sqpoll = num;
+            }
+        }
+        free(opts);
+
+        if (ret) {
+            return ret;
+        }
+    }
+
+    if (!has_size) {
+        struct statvfs vfs;
+
+        if (statvfs(ctx->path, &vfs) != 0) {
+            priskv_log_error("BE_SEGFS: failed to get filesystem info for %s: %s\n", ctx->path,
+                             strerror(errno));
+            return -1;
+        }
+        ctx->total_size = (uint64_t)vfs.f_bavail * vfs.f_frsize;
+    }
+
+    if (ctx->direct && ctx->segment_size % SEGFS_DIRECT_ALIGN) {
+        priskv_log_error("BE_SEGFS: segment size %lu is not aligned to %d for direct I/O\n",
+                         ctx->segment_size, SEGFS_DIRECT_ALIGN);
+        return -1;
+    }
+
+    ctx->nsegments = ctx->total_size / ctx->segment_size;
+    if (ctx->nsegments < SEGFS_MIN_SEGMENTS) {
+        priskv_log_error("BE_SEGFS: size %lu holds less than %d segments of %lu\n",
+                         ctx->total_size, SEGFS_MIN_SEGMENTS, ctx->segment_size);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int segfs_open_segments(segfs_shared_context *ctx)
+{
+    char path[PATH_MAX];
+
+    ctx->segments = calloc(ctx->nsegments, sizeof(segfs_segment));
+    if (!ctx->segments) {
+        priskv_log_error("BE_SEGFS: failed to allocate segments\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        segfs_segment *seg = &ctx->segments[i];
+
+        list_head_init(&seg->entries);
+        pthread_spin_init(&seg->lock, PTHREAD_PROCESS_PRIVATE);
+        seg->fd = -1;
+        seg->dfd = -1;
+    }
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        segfs_segment *seg = &ctx->segments[i];
+
+        snprintf(path, sizeof(path), "%s/seg-%05u", ctx->path, i);
+        seg->fd = open(path, O_CREAT | O_RDWR, 0644);
+        if (seg->fd < 0) {
+            priskv_log_error("BE_SEGFS: failed to open segment %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+
+        if (fallocate(seg->fd, 0, 0, ctx->segment_size) &&
+            (errno != EOPNOTSUPP || ftruncate(seg->fd, ctx->segment_size))) {
+            priskv_log_error("BE_SEGFS: failed to preallocate segment %s: %s\n", path,
+                             strerror(errno));
+            return -1;
+        }
+
+        if (ctx->direct) {
+            seg->dfd = open(path, O_RDWR | O_DIRECT);
+            if (seg->dfd < 0) {
+                priskv_log_error("BE_SEGFS: failed to open segment %s with O_DIRECT: %s\n",
+                                 path, strerror(errno));
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void segfs_index_path(segfs_shared_context *ctx, char *path, size_t size, bool tmp)
+{
+    snprintf(path, size, "%s/%s%s", ctx->path, SEGFS_INDEX_FILE, tmp ? ".tmp" : "");
+}
+
+/* Load the index written by the last clean shutdown, then drop it: it is stale from now on */
+static int segfs_checkpoint_load(segfs_shared_context *ctx)
+{
+    segfs_index_header header;
+    segfs_index_record record;
+    char path[PATH_MAX];
+    char key[PATH_MAX];
+    uint64_t *tails = NULL;
+    FILE *fp;
+    int ret = -1;
+
+    segfs_index_path(ctx, path, sizeof(path), false);
+    fp = fopen(path, "r");
+    if (!fp) {
+        if (errno != ENOENT) {
+            priskv_log_warn("BE_SEGFS: failed to open index %s: %s\n", path, strerror(errno));
+        }
+        return 0;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != SEGFS_INDEX_MAGIC ||
+        header.version != SEGFS_INDEX_VERSION || header.segment_size != ctx->segment_size ||
+        header.nsegments != ctx->nsegments) {
+        priskv_log_warn("BE_SEGFS: index %s does not match the layout, start empty\n", path);
+        goto out;
+    }
+
+    tails = calloc(ctx->nsegments, sizeof(uint64_t));
+    if (fread(tails, sizeof(uint64_t), ctx->nsegments, fp) != ctx->nsegments) {
+        goto out;
+    }
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        if (tails[i] > ctx->segment_size) {
+            goto out;
+        }
+
+        ctx->segments[i].tail = tails[i];
+        if (tails[i]) {
+            ctx->segments[i].state = SEGFS_SEGMENT_SEALED;
+            ctx->nfree--;
+        }
+    }
+
+    for (uint64_t i = 0; i < header.nentries; i++) {
+        segfs_index_shard *shard;
+        segfs_entry *entry;
+
+        if (fread(&record, sizeof(record), 1, fp) != 1 || record.keylen >= sizeof(key) ||
+            record.seg >= ctx->nsegments ||
+            record.offset + record.len > ctx->segments[record.seg].tail ||
+            fread(key, 1, record.keylen, fp) != record.keylen) {
+            goto out;
+        }
+        key[record.keylen] = '\0';
+
+        shard = segfs_shard(ctx, key);
+        HASH_FIND_STR(shard->index, key, entry);
+        if (entry) {
+            goto out;
+        }
+
+        entry = calloc(1, sizeof(segfs_entry));
+        entry->key = strdup(key);
+        HASH_ADD_KEYPTR(hh, shard->index, entry->key, record.keylen, entry);
+        segfs_entry_attach(ctx, entry, record.seg, record.offset, record.len);
+        entry->atime = header.nentries - i;
+        list_add_tail(&shard->lru, &entry->lru);
+    }
+
+    ctx->access_seq = header.nentries;
+    priskv_log_info("BE_SEGFS: loaded %lu keys, %lu bytes from index\n", header.nentries,
+                    ctx->live);
+    ret = 0;
+
+out:
+    if (ret) {
+        priskv_log_warn("BE_SEGFS: index %s is corrupted, start empty\n", path);
+        segfs_index_reset(ctx);
+    }
+
+    free(tails);
+    fclose(fp);
+    unlink(path);
+    return 0;
+}
+
+/* Sync the segments and write the index, the rename publishes a complete index only */
+static int segfs_checkpoint_save(segfs_shared_context *ctx)
+{
+    segfs_index_header header = {0};
+    segfs_index_record record = {0};
+    char path[PATH_MAX], tmppath[PATH_MAX];
+    segfs_entry *entry;
+    FILE *fp;
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        if (ctx->segments[i].tail && fdatasync(ctx->segments[i].fd)) {
+            priskv_log_error("BE_SEGFS: failed to sync segment %u: %s\n", i, strerror(errno));
+            return -1;
+        }
+    }
+
+    segfs_index_path(ctx, tmppath, sizeof(tmppath), true);
+    segfs_index_path(ctx, path, sizeof(path), false);
+    fp = fopen(tmppath, "w");
+    if (!fp) {
+        priskv_log_error("BE_SEGFS: failed to create index %s: %s\n", tmppath, strerror(errno));
+        return -1;
+    }
+
+    header.magic = SEGFS_INDEX_MAGIC;
+    header.version = SEGFS_INDEX_VERSION;
+    header.segment_size = ctx->segment_size;
+    header.nsegments = ctx->nsegments;
+    for (int i = 0; i < SEGFS_INDEX_SHARDS; i++) {
+        header.nentries += HASH_COUNT(ctx->shards[i].index);
+    }
+    fwrite(&header, sizeof(header), 1, fp);
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        uint64_t tail = ctx->segments[i].state == SEGFS_SEGMENT_FREE ? 0 : ctx->segments[i].tail;
+
+        fwrite(&tail, sizeof(tail), 1, fp);
+    }
+
+    /* most recently used first, the load keeps the order within a shard */
+    for (int i = 0; i < SEGFS_INDEX_SHARDS; i++) {
+        list_for_each(&ctx->shards[i].lru, entry, lru) {
+            record.seg = entry->seg;
+            record.len = entry->len;
+            record.offset = entry->offset;
+            record.keylen = strlen(entry->key);
+            fwrite(&record, sizeof(record), 1, fp);
+            fwrite(entry->key, 1, record.keylen, fp);
+        }
+    }
+
+    if (fflush(fp) || ferror(fp) || fsync(fileno(fp))) {
+        priskv_log_error("BE_SEGFS: failed to write index %s\n", tmppath);
+        fclose(fp);
+        unlink(tmppath);
+        return -1;
+    }
+    fclose(fp);
+
+    if (rename(tmppath, path)) {
+        priskv_log_error("BE_SEGFS: failed to publish index %s: %s\n", path, strerror(errno));
+        unlink(tmppath);
+        return -1;
+    }
+
+    priskv_log_info("BE_SEGFS: saved %lu keys to index\n", header.nentries);
+    return 0;
+}
+
+/* Pick the sealed segment with the lowest live ratio worth collecting, -1 if none */
+static int segfs_gc_pick(segfs_shared_context *ctx)
+{
+    bool urgent = ctx->nfree < SEGFS_GC_LOW_WATERMARK;
+    int victim = -1;
+
+    uint64_t victim_live = 0;
+
+    for (uint32_t i = 0; i < ctx->nsegments; i++) {
+        segfs_segment *seg = &ctx->segments[i];
+        uint64_t live = __atomic_load_n(&seg->live, __ATOMIC_RELAXED);
+
+        if (seg->state != SEGFS_SEGMENT_SEALED || __atomic_load_n(&seg->refs, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        if (victim < 0 || live * ctx->segments[victim].tail < victim_live * seg->tail) {
+            victim = i;
+            victim_live = live;
+        }
+    }
+
+    if (victim < 0) {
+        return -1;
+    }
+
+    /* under space pressure anything but a full segment is worth collecting */
+    segfs_segment *seg = &ctx->segments[victim];
+    if (victim_live * 100 <= seg->tail * ctx->gc_ratio || (urgent && victim_live < seg->tail)) {
+        return victim;
+    }
+
+    return -1;
+}
+
+/*
+ * Move the live values of @victim to the GC segment, then recycle it. Called with
+ * shared_ctx->lock held, which is dropped while moving.
+ */
+static int segfs_gc_collect(segfs_shared_context *ctx, uint32_t victim)
+{
+    segfs_segment *vseg = &ctx->segments[victim];
+    segfs_index_record *moves = NULL;
+    char **keys = NULL;
+    segfs_entry *entry;
+    uint32_t nmoves = 0, i;
+    int ret = 0;
+
+    vseg->state = SEGFS_SEGMENT_GC;
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* no value is appended to the victim any more, its entries only go away from now on */
+    pthread_spin_lock(&vseg->lock);
+    list_for_each(&vseg->entries, entry, seg_node) {
+        nmoves++;
+    }
+
+    if (nmoves) {
+        moves = calloc(nmoves, sizeof(*moves));
+        keys = calloc(nmoves, sizeof(char *));
+        i = 0;
+        list_for_each(&vseg->entries, entry, seg_node) {
+            moves[i].len = entry->len;
+            moves[i].offset = entry->offset;
+            keys[i++] = strdup(entry->key);
+        }
+    }
+    pthread_spin_unlock(&vseg->lock);
+
+    for (i = 0; i < nmoves && !ret; i++) {
+        uint8_t *buf = malloc(moves[i].len);
+        uint64_t offset;
+        int dst;
+
+        if (pread(vseg->fd, buf, moves[i].len, moves[i].offset) != moves[i].len) {
+            priskv_log_error("BE_SEGFS: GC failed to read segment %u\n", victim);
+            free(buf);
+            ret = -1;
+            break;
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        dst = segfs_append(ctx, moves[i].len, true, &offset);
+        pthread_mutex_unlock(&ctx->lock);
+        if (dst < 0) {
+            priskv_log_warn("BE_SEGFS: GC has no space to relocate segment %u\n", victim);
+            free(buf);
+            ret = -1;
+            break;
+        }
+
+        if (pwrite(ctx->segments[dst].fd, buf, moves[i].len, offset) != moves[i].len) {
+            priskv_log_error("BE_SEGFS: GC failed to write segment %d\n", dst);
+            ret = -1;
+        }
+        free(buf);
+
+        segfs_index_shard *shard = segfs_shard(ctx, keys[i]);
+        pthread_mutex_lock(&shard->lock);
+        HASH_FIND_STR(shard->index, keys[i], entry);
+        /* skip a value overwritten or deleted in the meantime */
+        if (!ret && entry && entry->seg == victim && entry->offset == moves[i].offset) {
+            segfs_entry_detach(ctx, entry);
+            segfs_entry_attach(ctx, entry, dst, offset, moves[i].len);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        __atomic_sub_fetch(&ctx->segments[dst].refs, 1, __ATOMIC_RELEASE);
+    }
+
+    for (i = 0; i < nmoves; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    free(moves);
+
+    pthread_mutex_lock(&ctx->lock);
+
+    /* GETs started before the relocation still read from the victim */
+    while (__atomic_load_n(&vseg->refs, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&ctx->lock);
+        usleep(100);
+        pthread_mutex_lock(&ctx->lock);
+    }
+
+    if (ret || __atomic_load_n(&vseg->live, __ATOMIC_RELAXED)) {
+        vseg->state = SEGFS_SEGMENT_SEALED;
+        return -1;
+    }
+
+    vseg->state = SEGFS_SEGMENT_FREE;
+    vseg->tail = 0;
+    ctx->nfree++;
+    segfs_wake_waiters(ctx);
+    priskv_log_debug("BE_SEGFS: GC recycled segment %u, relocated %u values\n", victim, nmoves);
+
+    return 0;
+}
+
+static void *segfs_gc_routine(void *arg)
+{
+    segfs_shared_context *ctx = arg;
+    struct timespec ts;
+    int victim;
+
+    pthread_mutex_lock(&ctx->lock);
+    while (!ctx->stopping) {
+        ctx->gc_kick = false;
+        ctx->gc_seq++;
+        while (!ctx->stopping && (victim = segfs_gc_pick(ctx)) >= 0) {
+            if (segfs_gc_collect(ctx, victim)) {
+                break;
+            }
+        }
+        ctx->gc_done = ctx->gc_seq;
+        segfs_wake_waiters(ctx);
+
+        if (ctx->gc_kick) {
+            continue;
+        }
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += SEGFS_GC_INTERVAL_MS / 1000;
+        ts.tv_nsec += (SEGFS_GC_INTERVAL_MS % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&ctx->gc_cond, &ctx->lock, &ts);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    return NULL;
+}
+
+static void segfs_shared_context_destroy(segfs_shared_context *ctx, bool checkpoint)
+{
+    if (ctx->segments) {
+        if (checkpoint) {
+            segfs_checkpoint_save(ctx);
+        }
+
+        segfs_index_reset(ctx);
+        for (uint32_t i = 0; i < ctx->nsegments; i++) {
+            if (ctx->segments[i].fd >= 0) {
+                close(ctx->segments[i].fd);
+            }
+            if (ctx->segments[i].dfd >= 0) {
+                close(ctx->segments[i].dfd);
+            }
+            pthread_spin_destroy(&ctx->segments[i].lock);
+        }
+        free(ctx->segments);
+    }
+
+    for (int i = 0; i < SEGFS_INDEX_SHARDS; i++) {
+        pthread_mutex_destroy(&ctx->shards[i].lock);
+    }
+    pthread_cond_destroy(&ctx->gc_cond);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx->path);
+    free(ctx);
+}
+
+static segfs_shared_context *segfs_shared_context_create(const char *address)
+{
+    segfs_shared_context *ctx = calloc(1, sizeof(*ctx));
+
+    if (!ctx) {
+        priskv_log_error("BE_SEGFS: failed to allocate shared context\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->gc_cond, NULL);
+    for (int i = 0; i < SEGFS_INDEX_SHARDS; i++) {
+        pthread_mutex_init(&ctx->shards[i].lock, NULL);
+        list_head_init(&ctx->shards[i].lru);
+    }
+    list_head_init(&ctx->threads);
+    ctx->active = -1;
+    ctx->gc_active = -1;
+
+    if (segfs_parse_address(ctx, address)) {
+        priskv_log_error("BE_SEGFS: failed to parse address\n");
+        goto err;
+    }
+
+    if (strlen(ctx->path) + NAME_MAX + 1 > PATH_MAX) {
+        priskv_log_error("BE_SEGFS: path too long\n");
+        goto err;
+    }
+
+    if (mkdir(ctx->path, 0755) && errno != EEXIST) {
+        priskv_log_error("BE_SEGFS: failed to create directory: %s\n", strerror(errno));
+        goto err;
+    }
+
+    if (ctx->direct) {
+        uint32_t block_size;
+
+        if (!priskv_backend_get_value_region(&ctx->region_base, &ctx->region_size,
+                                             &block_size) ||
+            (uintptr_t)ctx->region_base % SEGFS_DIRECT_ALIGN ||
+            block_size % SEGFS_DIRECT_ALIGN) {
+            priskv_log_error("BE_SEGFS: direct I/O needs a value region aligned to %d\n",
+                             SEGFS_DIRECT_ALIGN);
+            goto err;
+        }
+    }
+
+    if (segfs_open_segments(ctx)) {
+        goto err;
+    }
+    ctx->nfree = ctx->nsegments;
+
+    segfs_checkpoint_load(ctx);
+
+    if (pthread_create(&ctx->gc_thread, NULL, segfs_gc_routine, ctx)) {
+        priskv_log_error("BE_SEGFS: failed to create GC thread\n");
+        goto err;
+    }
+    pthread_setname_np(ctx->gc_thread, "segfs-gc");
+
+    ctx->ref_count = 1;
+    priskv_log_info("BE_SEGFS: %s, %u segments of %lu bytes%s%s\n", ctx->path, ctx->nsegments,
+                    ctx->segment_size, ctx->direct ? ", direct" : "",
+                    ctx->sqpoll ? ", sqpoll" : "");
+
+    return ctx;
+
+err:
+    segfs_shared_context_destroy(ctx, false);
+    return NULL;
+}
+
+static segfs_shared_context *segfs_shared_context_get(const char *address)
+{
+    segfs_shared_context *ctx;
+
+    pthread_mutex_lock(&segfs_shared_ctx_lock);
+    if (segfs_shared_ctx) {
+        segfs_shared_ctx->ref_count++;
+    } else {
+        segfs_shared_ctx = segfs_shared_context_create(address);
+    }
+    ctx = segfs_shared_ctx;
+    pthread_mutex_unlock(&segfs_shared_ctx_lock);
+
+    return ctx;
+}
+
+static void segfs_shared_context_put(segfs_shared_context *ctx)
+{
+    bool should_free = false;
+
+    pthread_mutex_lock(&segfs_shared_ctx_lock);
+    if (--ctx->ref_count == 0) {
+        should_free = true;
+        segfs_shared_ctx = NULL;
+    }
+    pthread_mutex_unlock(&segfs_shared_ctx_lock);
+
+    if (!should_free) {
+        return;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->stopping = true;
+    pthread_cond_signal(&ctx->gc_cond);
+    pthread_mutex_unlock(&ctx->lock);
+    pthread_join(ctx->gc_thread, NULL);
+
+    segfs_shared_context_destroy(ctx, true);
+}
+
+static void segfs_complete_request(segfs_request *req, priskv_backend_status status,
+                                   uint32_t len)
+{
+    if (req->cb) {
+        req->cb(status, len, req->cbarg);
+    }
+
+    free(req->key);
+    free(req);
+}
+
+static void handle_io_uring_events(int fd, void *opaque, uint32_t events)
+{
+    segfs_thread_context *ctx = opaque;
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    struct io_uring_cqe *cqe;
+
+    while (io_uring_peek_cqe(&ctx->ring, &cqe) == 0) {
+        segfs_request *req = (segfs_request *)io_uring_cqe_get_data(cqe);
+        priskv_backend_status status = PRISKV_BACKEND_STATUS_OK;
+        int res = cqe->res;
+        io_uring_cqe_seen(&ctx->ring, cqe);
+
+        if (res < 0) {
+            priskv_log_error("BE_SEGFS: async operation failed: %s\n", strerror(-res));
+            status = PRISKV_BACKEND_STATUS_ERROR;
+        } else if (res != req->iolen) {
+            priskv_log_error("BE_SEGFS: incomplete %s: %d, expect: %u\n",
+                             req->op_type == SEGFS_OP_SET ? "write" : "read", res, req->iolen);
+            status = PRISKV_BACKEND_STATUS_ERROR;
+        }
+
+        /* index the value before unpinning, so the GC can't miss it */
+        if (req->op_type == SEGFS_OP_SET && status == PRISKV_BACKEND_STATUS_OK) {
+            segfs_index_update(shared_ctx, req->key, req->seg, req->offset, req->len);
+        }
+        __atomic_sub_fetch(&shared_ctx->segments[req->seg].refs, 1, __ATOMIC_RELEASE);
+
+        segfs_complete_request(req, status, status == PRISKV_BACKEND_STATUS_OK ? req->len : 0);
+    }
+}
+
+static bool segfs_submit(segfs_request *req);
+
+/* Write a SET to the space reserved at @seg */
+static void segfs_submit_set(segfs_request *req, int seg)
+{
+    segfs_shared_context *shared_ctx = req->ctx->shared_ctx;
+
+    req->seg = seg;
+    if (!segfs_submit(req)) {
+        __atomic_sub_fetch(&shared_ctx->segments[req->seg].refs, 1, __ATOMIC_RELEASE);
+        segfs_complete_request(req, PRISKV_BACKEND_STATUS_ERROR, 0);
+    }
+}
+
+/* Park a SET until the next GC pass, called with shared_ctx->lock held */
+static void segfs_wait_space(segfs_request *req)
+{
+    segfs_thread_context *ctx = req->ctx;
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+
+    req->gc_seq = shared_ctx->gc_seq + 1;
+    list_add_tail(&ctx->space_waiters, &req->node);
+    ctx->waiting = true;
+    segfs_gc_kick(shared_ctx);
+}
+
+/*
+ * Retry the SETs waiting for space in arrival order. A SET gives up with NO_SPACE once
+ * SEGFS_GC_WAIT_PASSES GC passes didn't make room for it, or nothing is left to reclaim.
+ */
+static void segfs_retry_waiters(segfs_thread_context *ctx)
+{
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    segfs_request *req;
+    int seg;
+
+    while ((req = list_top(&ctx->space_waiters, segfs_request, node))) {
+        pthread_mutex_lock(&shared_ctx->lock);
+        seg = segfs_append(shared_ctx, req->len, false, &req->offset);
+        if (seg < 0) {
+            if (shared_ctx->gc_done < req->gc_seq) {
+                pthread_mutex_unlock(&shared_ctx->lock);
+                return;
+            }
+            if (++req->gc_waits < SEGFS_GC_WAIT_PASSES && segfs_gc_reclaimable(shared_ctx)) {
+                req->gc_seq = shared_ctx->gc_seq + 1;
+                segfs_gc_kick(shared_ctx);
+                pthread_mutex_unlock(&shared_ctx->lock);
+                return;
+            }
+        }
+        list_del(&req->node);
+        ctx->waiting = !list_empty(&ctx->space_waiters);
+        pthread_mutex_unlock(&shared_ctx->lock);
+
+        if (seg < 0) {
+            priskv_log_debug("BE_SEGFS: no free segment for key %s\n", req->key);
+            segfs_complete_request(req, PRISKV_BACKEND_STATUS_NO_SPACE, 0);
+        } else {
+            segfs_submit_set(req, seg);
+        }
+    }
+}
+
+static void handle_space_event(int fd, void *opaque, uint32_t events)
+{
+    uint64_t val;
+
+    if (read(fd, &val, sizeof(val)) < 0 && errno != EAGAIN) {
+        priskv_log_error("BE_SEGFS: failed to read space eventfd: %s\n", strerror(errno));
+    }
+
+    segfs_retry_waiters(opaque);
+}
+
+/* Register the value region to the ring in chunks, direct I/O still works without it */
+static void segfs_register_region(segfs_thread_context *ctx)
+{
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    uint64_t nbufs = ALIGN_UP(shared_ctx->region_size, SEGFS_FIXED_BUF_MAX) / SEGFS_FIXED_BUF_MAX;
+    struct iovec *iovs = calloc(nbufs, sizeof(struct iovec));
+    int ret;
+
+    for (uint64_t i = 0; i < nbufs; i++) {
+        uint64_t off = i * SEGFS_FIXED_BUF_MAX;
+
+        iovs[i].iov_base = shared_ctx->region_base + off;
+        iovs[i].iov_len = priskv_min_u64(SEGFS_FIXED_BUF_MAX, shared_ctx->region_size - off);
+    }
+
+    ret = io_uring_register_buffers(&ctx->ring, iovs, nbufs);
+    if (ret) {
+        priskv_log_warn("BE_SEGFS: failed to register value region, no fixed buffers: %s\n",
+                        strerror(-ret));
+    }
+    ctx->fixed = !ret;
+
+    free(iovs);
+}
+
+static int segfs_open(priskv_backend_device *bdev)
+{
+    segfs_shared_context *shared_ctx = segfs_shared_context_get(bdev->link.address);
+    segfs_thread_context *ctx;
+
+    if (!shared_ctx) {
+        goto err;
+    }
+
+    ctx = calloc(1, sizeof(segfs_thread_context));
+    if (!ctx) {
+        priskv_log_error("BE_SEGFS: failed to allocate context\n");
+        goto err_put_shared_ctx;
+    }
+
+    ctx->bdev = bdev;
+    ctx->shared_ctx = shared_ctx;
+    list_head_init(&ctx->space_waiters);
+
+    ctx->space_fd = eventfd(0, EFD_NONBLOCK);
+    if (ctx->space_fd < 0) {
+        priskv_log_error("BE_SEGFS: failed to create eventfd: %s\n", strerror(errno));
+        free(ctx);
+        goto err_put_shared_ctx;
+    }
+
+    struct io_uring_params ring_params = {0};
+    if (shared_ctx->sqpoll) {
+        ring_params.flags |= IORING_SETUP_SQPOLL;
+        ring_params.sq_thread_idle = SEGFS_SQPOLL_IDLE_MS;
+    }
+
+    if (io_uring_queue_init_params(SEGFS_RING_DEPTH, &ctx->ring, &ring_params) < 0) {
+        priskv_log_error("BE_SEGFS: failed to initialize io_uring\n");
+        close(ctx->space_fd);
+        free(ctx);
+        goto err_put_shared_ctx;
+    }
+
+    if (shared_ctx->direct) {
+        segfs_register_region(ctx);
+    }
+
+    priskv_set_fd_handler(ctx->ring.ring_fd, handle_io_uring_events, NULL, ctx);
+    priskv_add_event_fd(bdev->epollfd, ctx->ring.ring_fd);
+    priskv_set_fd_handler(ctx->space_fd, handle_space_event, NULL, ctx);
+    priskv_add_event_fd(bdev->epollfd, ctx->space_fd);
+
+    pthread_mutex_lock(&shared_ctx->lock);
+    list_add_tail(&shared_ctx->threads, &ctx->node);
+    pthread_mutex_unlock(&shared_ctx->lock);
+
+    bdev->private_data = ctx;
+
+    return 0;
+
+err_put_shared_ctx:
+    segfs_shared_context_put(shared_ctx);
+err:
+    priskv_log_error("BE_SEGFS: failed to open device\n");
+    return -1;
+}
+
+static int segfs_close(priskv_backend_device *bdev)
+{
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_SEGFS: invalid device or context\n");
+        return -1;
+    }
+
+    segfs_thread_context *ctx = bdev->private_data;
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    segfs_request *req;
+
+    pthread_mutex_lock(&shared_ctx->lock);
+    list_del(&ctx->node);
+    pthread_mutex_unlock(&shared_ctx->lock);
+
+    while ((req = list_pop(&ctx->space_waiters, segfs_request, node))) {
+        segfs_complete_request(req, PRISKV_BACKEND_STATUS_ERROR, 0);
+    }
+    priskv_del_event(bdev->epollfd, ctx->space_fd);
+    close(ctx->space_fd);
+
+    priskv_del_event(bdev->epollfd, ctx->ring.ring_fd);
+    if (ctx->fixed) {
+        io_uring_unregister_buffers(&ctx->ring);
+    }
+    io_uring_queue_exit(&ctx->ring);
+    free(ctx);
+    bdev->private_data = NULL;
+
+    segfs_shared_context_put(shared_ctx);
+
+    return 0;
+}
+
+static bool segfs_is_cacheable(priskv_backend_device *bdev, uint64_t valuelen)
+{
+    segfs_thread_context *ctx = bdev->private_data;
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    uint64_t usable, live = __atomic_load_n(&shared_ctx->live, __ATOMIC_RELAXED);
+    bool res;
+
+    /* leave the GC reserve and one segment of dead bytes as headroom */
+    usable = (shared_ctx->nsegments - SEGFS_GC_RESERVE - 1) * shared_ctx->segment_size;
+    if (live + segfs_reserve_len(shared_ctx, valuelen) > usable) {
+        return false;
+    }
+
+    /* a segment is free or the GC has dead bytes to make one */
+    pthread_mutex_lock(&shared_ctx->lock);
+    res = segfs_has_room(shared_ctx, valuelen);
+    pthread_mutex_unlock(&shared_ctx->lock);
+
+    return res;
+}
+
+/* Go direct if @req moves a buddy extent from/to an aligned offset, otherwise via page cache */
+static void segfs_prep_rw(segfs_request *req, struct io_uring_sqe *sqe)
+{
+    segfs_thread_context *ctx = req->ctx;
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    segfs_segment *seg = &shared_ctx->segments[req->seg];
+    bool get = req->op_type == SEGFS_OP_GET;
+    uint64_t region_off = req->val - shared_ctx->region_base;
+    int fd = seg->fd;
+
+    req->iolen = req->len;
+    if (seg->dfd >= 0 && req->val >= shared_ctx->region_base &&
+        region_off + ALIGN_UP(req->len, SEGFS_DIRECT_ALIGN) <= shared_ctx->region_size &&
+        region_off % SEGFS_DIRECT_ALIGN == 0 && req->offset % SEGFS_DIRECT_ALIGN == 0) {
+        fd = seg->dfd;
+        req->iolen = ALIGN_UP(req->len, SEGFS_DIRECT_ALIGN);
+
+        /* a registered buffer must hold the whole I/O */
+        if (ctx->fixed && region_off % SEGFS_FIXED_BUF_MAX + req->iolen <= SEGFS_FIXED_BUF_MAX) {
+            int buf_index = region_off / SEGFS_FIXED_BUF_MAX;
+
+            if (get) {
+                io_uring_prep_read_fixed(sqe, fd, req->val, req->iolen, req->offset, buf_index);
+            } else {
+                io_uring_prep_write_fixed(sqe, fd, req->val, req->iolen, req->offset, buf_index);
+            }
+            return;
+        }
+    }
+
+    if (get) {
+        io_uring_prep_read(sqe, fd, req->val, req->iolen, req->offset);
+    } else {
+        io_uring_prep_write(sqe, fd, req->val, req->iolen, req->offset);
+    }
+}
+
+static bool segfs_submit(segfs_request *req)
+{
+    struct io_uring *ring = &req->ctx->ring;
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+
+    if (!sqe) { // rarely
+        io_uring_submit(ring);
+        sqe = io_uring_get_sqe(ring);
+        if (!sqe) {
+            return false;
+        }
+    }
+
+    segfs_prep_rw(req, sqe);
+    io_uring_sqe_set_data(sqe, req);
+    io_uring_submit(ring);
+
+    return true;
+}
+
+static segfs_request *segfs_make_request(priskv_backend_device *bdev, const char *key,
+                                         uint8_t *val, segfs_op_type op_type,
+                                         priskv_backend_driver_cb cb, void *cbarg)
+{
+    segfs_request *req;
+
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_SEGFS: invalid device or context\n");
+        goto err;
+    }
+
+    req = calloc(1, sizeof(segfs_request));
+    if (!req) {
+        priskv_log_error("BE_SEGFS: failed to allocate request\n");
+        goto err;
+    }
+
+    req->ctx = bdev->private_data;
+    req->key = strdup(key);
+    req->val = val;
+    req->op_type = op_type;
+    req->cb = cb;
+    req->cbarg = cbarg;
+
+    return req;
+
+err:
+    if (cb) {
+        cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+    }
+    return NULL;
+}
+
+static void segfs_get(priskv_backend_device *bdev, const char *key, uint8_t *val,
+                      uint64_t valuelen, priskv_backend_driver_cb cb, void *cbarg)
+{
+    segfs_request *req = segfs_make_request(bdev, key, val, SEGFS_OP_GET, cb, cbarg);
+    segfs_shared_context *shared_ctx;
+    segfs_index_shard *shard;
+    priskv_backend_status status;
+    segfs_entry *entry;
+
+    if (!req) {
+        return;
+    }
+
+    shared_ctx = req->ctx->shared_ctx;
+    shard = segfs_shard(shared_ctx, key);
+    pthread_mutex_lock(&shard->lock);
+    HASH_FIND_STR(shard->index, key, entry);
+    if (!entry) {
+        status = PRISKV_BACKEND_STATUS_NOT_FOUND;
+        goto err_unlock;
+    }
+
+    if (entry->len > valuelen) {
+        priskv_log_error("BE_SEGFS: value size %u exceeds buffer size %lu for key %s\n",
+                         entry->len, valuelen, key);
+        status = PRISKV_BACKEND_STATUS_VALUE_TOO_BIG;
+        goto err_unlock;
+    }
+
+    /* pinned while the entry can't move, the GC waits for the read before recycling */
+    req->seg = entry->seg;
+    req->offset = entry->offset;
+    req->len = entry->len;
+    __atomic_add_fetch(&shared_ctx->segments[req->seg].refs, 1, __ATOMIC_ACQUIRE);
+    entry->atime = __atomic_add_fetch(&shared_ctx->access_seq, 1, __ATOMIC_RELAXED);
+    list_del(&entry->lru);
+    list_add(&shard->lru, &entry->lru);
+    pthread_mutex_unlock(&shard->lock);
+
+    if (!segfs_submit(req)) {
+        __atomic_sub_fetch(&shared_ctx->segments[req->seg].refs, 1, __ATOMIC_RELEASE);
+        segfs_complete_request(req, PRISKV_BACKEND_STATUS_ERROR, 0);
+    }
+    return;
+
+err_unlock:
+    pthread_mutex_unlock(&shard->lock);
+    segfs_complete_request(req, status, 0);
+}
+
+static void segfs_set(priskv_backend_device *bdev, const char *key, uint8_t *val,
+                      uint64_t valuelen, uint64_t timeout, priskv_backend_driver_cb cb,
+                      void *cbarg)
+{
+    segfs_request *req = segfs_make_request(bdev, key, val, SEGFS_OP_SET, cb, cbarg);
+    segfs_shared_context *shared_ctx;
+    int seg;
+
+    if (!req) {
+        return;
+    }
+
+    shared_ctx = req->ctx->shared_ctx;
+    if (segfs_reserve_len(shared_ctx, valuelen) > shared_ctx->segment_size) {
+        priskv_log_error("BE_SEGFS: value size %lu exceeds segment size %lu for key %s\n",
+                         valuelen, shared_ctx->segment_size, key);
+        segfs_complete_request(req, PRISKV_BACKEND_STATUS_VALUE_TOO_BIG, 0);
+        return;
+    }
+
+    req->len = valuelen;
+    pthread_mutex_lock(&shared_ctx->lock);
+    /* queue behind the SETs already waiting, a later SET of a key must not overtake */
+    if (!list_empty(&req->ctx->space_waiters)) {
+        segfs_wait_space(req);
+        pthread_mutex_unlock(&shared_ctx->lock);
+        return;
+    }
+
+    seg = segfs_append(shared_ctx, req->len, false, &req->offset);
+    if (seg < 0 && segfs_gc_reclaimable(shared_ctx)) {
+        segfs_wait_space(req);
+        pthread_mutex_unlock(&shared_ctx->lock);
+        return;
+    }
+    pthread_mutex_unlock(&shared_ctx->lock);
+
+    if (seg < 0) {
+        priskv_log_debug("BE_SEGFS: no free segment for key %s\n", key);
+        segfs_complete_request(req, PRISKV_BACKEND_STATUS_NO_SPACE, 0);
+        return;
+    }
+
+    segfs_submit_set(req, seg);
+}
+
+/* DEL, TEST and EVICT only touch the in-memory index */
+static void segfs_del(priskv_backend_device *bdev, const char *key, priskv_backend_driver_cb cb,
+                      void *cbarg)
+{
+    segfs_thread_context *ctx = bdev ? bdev->private_data : NULL;
+    segfs_index_shard *shard;
+    segfs_entry *entry;
+    uint32_t len = 0;
+
+    if (!ctx) {
+        priskv_log_error("BE_SEGFS: invalid device or context\n");
+        if (cb) {
+            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+        }
+        return;
+    }
+
+    shard = segfs_shard(ctx->shared_ctx, key);
+    pthread_mutex_lock(&shard->lock);
+    HASH_FIND_STR(shard->index, key, entry);
+    if (entry) {
+        len = entry->len;
+        segfs_index_del(ctx->shared_ctx, shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (cb) {
+        cb(PRISKV_BACKEND_STATUS_OK, len, cbarg);
+    }
+}
+
+static void segfs_test(priskv_backend_device *bdev, const char *key, priskv_backend_driver_cb cb,
+                       void *cbarg)
+{
+    segfs_thread_context *ctx = bdev ? bdev->private_data : NULL;
+    segfs_index_shard *shard;
+    segfs_entry *entry;
+    uint32_t len = 0;
+
+    if (!ctx) {
+        priskv_log_error("BE_SEGFS: invalid device or context\n");
+        if (cb) {
+            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+        }
+        return;
+    }
+
+    shard = segfs_shard(ctx->shared_ctx, key);
+    pthread_mutex_lock(&shard->lock);
+    HASH_FIND_STR(shard->index, key, entry);
+    if (entry) {
+        len = entry->len;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (cb) {
+        cb(entry ? PRISKV_BACKEND_STATUS_OK : PRISKV_BACKEND_STATUS_NOT_FOUND, len, cbarg);
+    }
+}
+
+static void segfs_evict(priskv_backend_device *bdev, priskv_backend_driver_cb cb, void *cbarg)
+{
+    segfs_thread_context *ctx = bdev ? bdev->private_data : NULL;
+    segfs_index_shard *shard, *victim;
+    segfs_entry *entry;
+    uint32_t len = 0;
+
+    if (!ctx) {
+        priskv_log_error("BE_SEGFS: invalid device or context\n");
+        if (cb) {
+            cb(PRISKV_BACKEND_STATUS_ERROR, 0, cbarg);
+        }
+        return;
+    }
+
+    /* the oldest of the shard LRU tails, one shard lock at a time */
+    do {
+        uint64_t oldest = UINT64_MAX;
+
+        victim = NULL;
+        for (int i = 0; i < SEGFS_INDEX_SHARDS; i++) {
+            shard = &ctx->shared_ctx->shards[i];
+
+            pthread_mutex_lock(&shard->lock);
+            entry = list_tail(&shard->lru, segfs_entry, lru);
+            if (entry && entry->atime < oldest) {
+                oldest = entry->atime;
+                victim = shard;
+            }
+            pthread_mutex_unlock(&shard->lock);
+        }
+
+        if (!victim) {
+            break;
+        }
+
+        /* the tail may have been touched or deleted meanwhile, look again then */
+        pthread_mutex_lock(&victim->lock);
+        entry = list_tail(&victim->lru, segfs_entry, lru);
+        if (entry && entry->atime == oldest) {
+            len = entry->len;
+            priskv_log_debug("BE_SEGFS: evicted key %s, freed %u bytes\n", entry->key, len);
+            segfs_index_del(ctx->shared_ctx, victim, entry);
+        } else {
+            entry = NULL;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    } while (!entry);
+
+    if (cb) {
+        cb(entry ? PRISKV_BACKEND_STATUS_OK : PRISKV_BACKEND_STATUS_NO_SPACE, len, cbarg);
+    }
+}
+
+static int segfs_clearup(priskv_backend_device *bdev)
+{
+    if (bdev == NULL || bdev->private_data == NULL) {
+        priskv_log_error("BE_SEGFS: invalid device or context\n");
+        return -1;
+    }
+
+    segfs_thread_context *ctx = bdev->private_data;
+    segfs_shared_context *shared_ctx = ctx->shared_ctx;
+    char path[PATH_MAX];
+
+    segfs_index_reset(shared_ctx);
+
+    segfs_index_path(shared_ctx, path, sizeof(path), false);
+    if (unlink(path) && errno != ENOENT) {
+        priskv_log_error("BE_SEGFS: failed to delete index: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static priskv_backend_driver segfs_driver = {
+    .name = "segfs",
+    .open = segfs_open,
+    .close = segfs_close,
+    .is_cacheable = segfs_is_cacheable,
+    .get = segfs_get,
+    .set = segfs_set,
+    .del = segfs_del,
+    .test = segfs_test,
+    .evict = segfs_evict,
+    .clearup = segfs_clearup,
+};
+
+static void priskv_backend_init_segfs()
+{
+    priskv_backend_register(&segfs_driver);
+}
+
+backend_init(priskv_backend_init_segfs);
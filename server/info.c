@@ -40,6 +40,9 @@
 #include "memory.h"
 #include "kv.h"
 #include "rdma.h"
+#include "priskv-threads.h"
+
+extern priskv_threadpool *g_threadpool;
 
 void priskv_info_get_acl(void *data)
 {
@@ -111,6 +114,12 @@ void priskv_info_get_connection(void *data)
             client_info->stats.test_ops = client->stats[PRISKV_COMMAND_TEST].ops;
             client_info->stats.expire_ops = client->stats[PRISKV_COMMAND_EXPIRE].ops;
             client_info->stats.resps = client->resps;
+            client_info->resp_slots.total = client->resp_slots.total;
+            client_info->resp_slots.inuse = client->resp_slots.inuse;
+            client_info->resp_slots.peak = client->resp_slots.peak;
+            client_info->resp_slots.exhausted = client->resp_slots.exhausted;
+            client_info->thread = client->thread;
+            client_info->migrations = client->migrations;
         }
     }
 
@@ -192,6 +201,36 @@ void priskv_info_get_cpu(void *data)
     info->clock_ticks = (uint64_t)clock_ticks;
 }
 
+void priskv_info_get_threads(void *data)
+{
+    priskv_threads_info *info = (priskv_threads_info *)data;
+
+    info->niothreads = priskv_threadpool_get_niothread(g_threadpool);
+    info->iothreads = calloc(info->niothreads, sizeof(priskv_thread_info));
+
+    for (int i = 0; i < info->niothreads; i++) {
+        priskv_thread *thread = priskv_threadpool_get_iothread(g_threadpool, i);
+        priskv_thread_info *thread_info = &info->iothreads[i];
+        priskv_thread_load load, rate;
+
+        priskv_thread_get_load(thread, &load, &rate);
+        thread_info->index = i;
+        thread_info->ops = load.ops;
+        thread_info->bytes = load.bytes;
+        thread_info->busy_ns = load.busy_ns;
+        thread_info->ops_per_sec = rate.ops;
+        thread_info->bytes_per_sec = rate.bytes;
+        thread_info->busy_ns_per_sec = rate.busy_ns;
+    }
+}
+
+void priskv_info_free_threads(void *data)
+{
+    priskv_threads_info *info = (priskv_threads_info *)data;
+
+    free(info->iothreads);
+}
+
 typedef struct priskv_info_drv {
     const char *name;
     priskv_object *object;
@@ -207,6 +246,8 @@ static priskv_info_drv g_info_drv[] = {
     {"connection", &priskv_connection_info_obj, sizeof(priskv_connection_info),
      priskv_info_get_connection, priskv_info_free_connection},
     {"cpu", &priskv_cpu_info_obj, sizeof(priskv_cpu_info), priskv_info_get_cpu, NULL},
+    {"threads", &priskv_threads_info_obj, sizeof(priskv_threads_info), priskv_info_get_threads,
+     priskv_info_free_threads},
 };
 
 static void priskv_info_items_get_all(const char **items, int *nitems)
@@ -89,6 +89,18 @@ PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_stats_info, "resps", resps, pr
                              forced)
 PRISKV_DECL_OBJECT_END(priskv_conn_client_stats_info, priskv_conn_client_stats_info)
 
+/* define for priskv_conn_client_slots_info_obj */
+PRISKV_DECL_OBJECT_BEGIN(priskv_conn_client_slots_info)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_slots_info, "total", total, priskv_uint64, required,
+                             forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_slots_info, "inuse", inuse, priskv_uint64, required,
+                             forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_slots_info, "peak", peak, priskv_uint64, required,
+                             forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_slots_info, "exhausted", exhausted, priskv_uint64,
+                             required, forced)
+PRISKV_DECL_OBJECT_END(priskv_conn_client_slots_info, priskv_conn_client_slots_info)
+
 /* define for priskv_conn_client_info_obj */
 PRISKV_DECL_OBJECT_BEGIN(priskv_conn_client_info)
 PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_info, "address", address, priskv_string, required,
@@ -97,6 +109,11 @@ PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_info, "dying", closing, priskv
                              forced)
 PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_info, "stats", stats, priskv_conn_client_stats_info,
                              required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_info, "resp_slots", resp_slots,
+                             priskv_conn_client_slots_info, required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_info, "thread", thread, priskv_int, required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_conn_client_info, "migrations", migrations, priskv_uint64,
+                             required, forced)
 PRISKV_DECL_OBJECT_END(priskv_conn_client_info, priskv_conn_client_info)
 
 /* define for priskv_conn_listener_info_obj */
@@ -129,3 +146,24 @@ PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_cpu_info, "used_cpu_user_ticks", used_cpu_
 PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_cpu_info, "clock_ticks", clock_ticks, priskv_uint64, required,
                              forced)
 PRISKV_DECL_OBJECT_END(priskv_cpu_info, priskv_cpu_info)
+
+/* define for priskv_thread_info_obj */
+PRISKV_DECL_OBJECT_BEGIN(priskv_thread_info)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "index", index, priskv_int, required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "ops", ops, priskv_uint64, required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "bytes", bytes, priskv_uint64, required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "busy_ns", busy_ns, priskv_uint64, required,
+                             forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "ops_per_sec", ops_per_sec, priskv_uint64,
+                             required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "bytes_per_sec", bytes_per_sec, priskv_uint64,
+                             required, forced)
+PRISKV_DECL_OBJECT_VALUE_FIELD(priskv_thread_info, "busy_ns_per_sec", busy_ns_per_sec,
+                             priskv_uint64, required, forced)
+PRISKV_DECL_OBJECT_END(priskv_thread_info, priskv_thread_info)
+
+/* define for priskv_threads_info_obj */
+PRISKV_DECL_OBJECT_BEGIN(priskv_threads_info)
+PRISKV_DECL_OBJECT_ARRAY_FIELD(priskv_threads_info, "iothreads", iothreads, niothreads,
+                             priskv_thread_info, required, forced)
+PRISKV_DECL_OBJECT_END(priskv_threads_info, priskv_threads_info)
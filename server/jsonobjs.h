@@ -78,10 +78,20 @@ typedef struct priskv_conn_client_stats_info {
     uint64_t resps;
 } priskv_conn_client_stats_info;
 
+typedef struct priskv_conn_client_slots_info {
+    uint64_t total;
+    uint64_t inuse;
+    uint64_t peak;
+    uint64_t exhausted;
+} priskv_conn_client_slots_info;
+
 typedef struct priskv_conn_client_info {
     char *address;
     bool closing;
     priskv_conn_client_stats_info stats;
+    priskv_conn_client_slots_info resp_slots;
+    int thread;
+    uint64_t migrations;
 } priskv_conn_client_info;
 
 typedef struct priskv_conn_listener_info {
@@ -114,4 +124,21 @@ typedef struct priskv_cpu_info {
 
 extern priskv_object priskv_cpu_info_obj;
 
+typedef struct priskv_thread_info {
+    int index;
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t busy_ns;
+    uint64_t ops_per_sec;
+    uint64_t bytes_per_sec;
+    uint64_t busy_ns_per_sec;
+} priskv_thread_info;
+
+typedef struct priskv_threads_info {
+    priskv_thread_info *iothreads;
+    int niothreads;
+} priskv_threads_info;
+
+extern priskv_object priskv_threads_info_obj;
+
 #endif /* __PRISKV_OBJECTS_H__ */
@@ -43,9 +43,12 @@
 #include "priskv-threads.h"
 #include "priskv-event.h"
 #include "priskv-log.h"
+#include "priskv-protocol-helper.h"
 #include "list.h"
 
 #define MAX_EVICT_RETRIES 128
+/* a SET starts demoting a dirty key once the free value memory is below the watermark */
+#define PRISKV_KV_DEMOTE_WATERMARK_PERCENT 10
 
 /*
  * biggest prime under 2^n:
@@ -62,15 +65,25 @@ typedef struct priskv_hash_head {
 } priskv_hash_head;
 
 /**
- * when a request try lock fails, it is added to the pending queue corresponding to its crc hash
- * value. once the lock holder completes, the request can be re-initiated.
+ * the executing tiering requests of a bucket, one per key at most. A request of the same key waits
+ * on the executing one, and gets re-initiated once the executing one completes.
  */
 typedef struct priskv_tiering_wait_head {
-    struct list_head pending_reqs;
-    bool has_inflight_req;
+    struct list_head inflight_reqs;
     pthread_spinlock_t lock;
 } priskv_tiering_wait_head;
 
+/*
+ * GETs parked on the keys in process of a shard of buckets, in the order of deadline. The end of SET
+ * walks the shard of its key only, and only if some GET has parked on the key.
+ */
+#define PRISKV_KV_PARKED_SHARDS 64
+typedef struct priskv_parked_head {
+    struct list_head pgets;
+    uint32_t nparked; /* read without lock by the expire routine */
+    pthread_spinlock_t lock;
+} priskv_parked_head;
+
 /* statics for expire routine */
 typedef struct priskv_expire_routine_statics {
     uint64_t expire_routine_times; /* expire routine executed times */
@@ -81,9 +94,12 @@ typedef struct priskv_expire_routine_statics {
 typedef struct priskv_kv {
     priskv_hash_head *hash_heads;
     priskv_tiering_wait_head *tiering_wait_heads;
+    priskv_parked_head parked_heads[PRISKV_KV_PARKED_SHARDS];
 
     // lru head
     struct list_head lru_head;
+    struct list_head dirty_head;    /* dirty keys, off @lru_head till written to backend */
+    struct list_head demoting_head; /* dirty keys being demoted, see priskv_tiering_demote */
     pthread_spinlock_t lru_lock;
 
     uint32_t bucket_count;
@@ -96,37 +112,97 @@ typedef struct priskv_kv {
     uint8_t *value_base;              /* buddy memory base address */
     uint32_t expire_routine_interval; /* interval to run expire routine */
     priskv_expire_routine_statics expire_routine_statics;
+
+    priskv_index_entry *index; /* exported for one-sided GET, NULL if disabled */
+    uint32_t index_entries;
 } priskv_kv;
 
+/* a key stays on one of the LRU lists till deleted, called with lru_lock held */
+static inline bool priskv_lru_linked(priskv_key *keynode)
+{
+    return keynode->lru_entry.next != &keynode->lru_entry;
+}
+
 static void priskv_lru_access(priskv_key *keynode, bool is_in_list)
 {
     priskv_kv *kv = keynode->kv;
 
     pthread_spin_lock(&kv->lru_lock);
     if (is_in_list) {
+        /* deleted meanwhile, or stays on demoting_head till demoted */
+        if (!priskv_lru_linked(keynode) || keynode->demoting) {
+            pthread_spin_unlock(&kv->lru_lock);
+            return;
+        }
         list_del(&keynode->lru_entry);
     }
-    list_add(&kv->lru_head, &keynode->lru_entry);
+    list_add(keynode->dirty ? &kv->dirty_head : &kv->lru_head, &keynode->lru_entry);
     pthread_spin_unlock(&kv->lru_lock);
 }
 
+static void priskv_keynode_ref(priskv_key *keynode);
+
+/* move the least recently used dirty key to demoting_head, called with lru_lock held */
+static priskv_key *priskv_lru_pick_demote(priskv_kv *kv)
+{
+    priskv_key *demote = list_tail(&kv->dirty_head, priskv_key, lru_entry);
+
+    if (demote) {
+        list_del(&demote->lru_entry);
+        list_add(&kv->demoting_head, &demote->lru_entry);
+        demote->demoting = true;
+        priskv_keynode_ref(demote);
+    }
+
+    return demote;
+}
+
+/*
+ * the least recently used clean key. The dirty keys are never on the evictable LRU, the least
+ * recently used one gets demoted to backend meanwhile, and becomes evictable once written.
+ */
 static priskv_key *priskv_lru_evict(priskv_kv *kv)
 {
-    priskv_key *keynode = NULL;
+    priskv_key *keynode, *demote;
 
     pthread_spin_lock(&kv->lru_lock);
     keynode = list_tail(&kv->lru_head, priskv_key, lru_entry);
+    demote = priskv_lru_pick_demote(kv);
     pthread_spin_unlock(&kv->lru_lock);
 
+    if (demote) {
+        priskv_tiering_demote(kv, demote);
+    }
+
     return keynode;
 }
 
+/* demote ahead of eviction, so that a SET finds a clean key to evict rather than none */
+static void priskv_lru_demote_watermark(priskv_kv *kv)
+{
+    uint64_t blocks = priskv_buddy_nmemb(kv->value_buddy);
+    uint64_t inuse = priskv_buddy_inuse(kv->value_buddy);
+    priskv_key *demote;
+
+    if (inuse * 100 < blocks * (100 - PRISKV_KV_DEMOTE_WATERMARK_PERCENT)) {
+        return;
+    }
+
+    pthread_spin_lock(&kv->lru_lock);
+    demote = priskv_lru_pick_demote(kv);
+    pthread_spin_unlock(&kv->lru_lock);
+
+    if (demote) {
+        priskv_tiering_demote(kv, demote);
+    }
+}
+
 static void priskv_lru_del_key(priskv_key *keynode)
 {
     priskv_kv *kv = keynode->kv;
 
     pthread_spin_lock(&kv->lru_lock);
-    list_del(&keynode->lru_entry);
+    list_del_init(&keynode->lru_entry);
     pthread_spin_unlock(&kv->lru_lock);
 }
 
@@ -182,13 +258,19 @@ void *priskv_new_kv(uint8_t *key_base, uint8_t *value_base, uint32_t max_keys,
     assert(kv->tiering_wait_heads);
     for (uint32_t i = 0; i < bucket_count; i++) {
         priskv_tiering_wait_head *tiering_wait_head = &kv->tiering_wait_heads[i];
-        list_head_init(&tiering_wait_head->pending_reqs);
-        tiering_wait_head->has_inflight_req = false;
+        list_head_init(&tiering_wait_head->inflight_reqs);
         pthread_spin_init(&tiering_wait_head->lock, 0);
     }
 
+    for (uint32_t i = 0; i < PRISKV_KV_PARKED_SHARDS; i++) {
+        list_head_init(&kv->parked_heads[i].pgets);
+        pthread_spin_init(&kv->parked_heads[i].lock, 0);
+    }
+
     /* step 3: init lru head */
     list_head_init(&kv->lru_head);
+    list_head_init(&kv->dirty_head);
+    list_head_init(&kv->demoting_head);
     pthread_spin_init(&kv->lru_lock, 0);
 
     /* step 4: create slab for keys */
@@ -216,6 +298,9 @@ void priskv_destroy_kv(void *_kv)
 {
     priskv_kv *kv = _kv;
 
+    if (kv->index) {
+        priskv_mem_free(kv->index, kv->index_entries * sizeof(priskv_index_entry), true);
+    }
     priskv_buddy_destroy(kv->value_buddy);
     priskv_slab_destroy(kv->key_slab);
     priskv_mem_free(kv->hash_heads, kv->bucket_count * sizeof(priskv_hash_head), true);
@@ -350,8 +435,84 @@ static priskv_key *priskv_find_key(priskv_kv *kv, uint8_t *key, uint16_t keylen,
     return NULL;
 }
 
+/* lock an index entry by bumping @version to odd, return the entry with the locked version */
+static priskv_index_entry *priskv_index_lock(priskv_kv *kv, uint64_t keyhash, uint64_t *version)
+{
+    priskv_index_entry *entry = &kv->index[keyhash % kv->index_entries];
+
+    for (;;) {
+        uint64_t old = __atomic_load_n(&entry->version, __ATOMIC_RELAXED);
+        uint64_t v = be64toh(old);
+
+        if ((v & 1) == 0 && __atomic_compare_exchange_n(&entry->version, &old, htobe64(v + 1), false,
+                                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            *version = v + 1;
+            return entry;
+        }
+    }
+}
+
+static void priskv_index_unlock(priskv_index_entry *entry, uint64_t version)
+{
+    __atomic_store_n(&entry->version, htobe64(version + 1), __ATOMIC_RELEASE);
+}
+
+/*
+ * publish a readable key into the index. Hold the hash list lock, a key popped from hash list
+ * never gets published, and a published key gets unpublished by __priskv_del_key.
+ */
+static void priskv_index_publish(priskv_kv *kv, priskv_key *keynode)
+{
+    uint32_t crc = priskv_crc32(keynode->key, keynode->keylen);
+    priskv_hash_head *hash_head = &kv->hash_heads[crc % kv->bucket_count];
+    uint64_t keyhash, version;
+    priskv_index_entry *ientry;
+    priskv_key *node;
+
+    /* the client could not check the expire time */
+    if (!kv->index || keynode->expire_time.tv_sec >= 0) {
+        return;
+    }
+
+    keyhash = priskv_index_keyhash(keynode->key, keynode->keylen);
+    pthread_spin_lock(&hash_head->lock);
+    list_for_each (&hash_head->head, node, entry) {
+        if (node == keynode) {
+            ientry = priskv_index_lock(kv, keyhash, &version);
+            ientry->keyhash = htobe64(keyhash);
+            ientry->value_off = htobe64(keynode->value_off);
+            ientry->valuelen = htobe32(keynode->valuelen);
+            ientry->keylen = htobe16(keynode->keylen);
+            priskv_index_unlock(ientry, version);
+            break;
+        }
+    }
+    pthread_spin_unlock(&hash_head->lock);
+}
+
+static void priskv_index_unpublish(priskv_kv *kv, priskv_key *keynode)
+{
+    uint64_t keyhash, version;
+    priskv_index_entry *entry;
+
+    if (!kv->index) {
+        return;
+    }
+
+    keyhash = priskv_index_keyhash(keynode->key, keynode->keylen);
+    entry = priskv_index_lock(kv, keyhash, &version);
+    if (be64toh(entry->keyhash) == keyhash && be64toh(entry->value_off) == keynode->value_off) {
+        entry->keyhash = 0;
+        entry->value_off = 0;
+        entry->valuelen = 0;
+        entry->keylen = 0;
+    }
+    priskv_index_unlock(entry, version);
+}
+
 static void __priskv_del_key(priskv_kv *kv, priskv_key *keynode)
 {
+    priskv_index_unpublish(kv, keynode);
     priskv_keynode_deref(keynode);
 }
 
@@ -402,28 +563,127 @@ void priskv_get_key_end(void *arg)
     priskv_keynode_deref(keynode);
 }
 
-static inline void priskv_insert_keynode(priskv_kv *kv, priskv_key *keynode)
+/* a live key in the way of a SET with @cond, the one being set counts as well */
+static inline bool priskv_key_in_way(priskv_key *keynode, uint8_t cond, uint32_t version,
+                                     struct timeval now)
+{
+    if (!cond || priskv_key_timeout(keynode, now)) {
+        return false;
+    }
+
+    if (cond & PRISKV_REQUEST_FLAG_NX) {
+        return true;
+    }
+
+    return keynode->version >= version;
+}
+
+/* pop the key replaced by a SET with @cond, or report the one in the way by @existlen */
+static priskv_key *priskv_pop_key_cond(priskv_kv *kv, uint8_t *key, uint16_t keylen, uint8_t cond,
+                                       uint32_t version, bool *exists, uint32_t *existlen)
+{
+    uint32_t crc = priskv_crc32(key, keylen);
+    priskv_hash_head *hash_head = &kv->hash_heads[crc % kv->bucket_count];
+    priskv_key *keynode;
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    pthread_spin_lock(&hash_head->lock);
+    list_for_each (&hash_head->head, keynode, entry) {
+        if ((keynode->keylen != keylen) || memcmp(keynode->key, key, keylen)) {
+            continue;
+        }
+
+        if (priskv_key_in_way(keynode, cond, version, now)) {
+            *exists = true;
+            *existlen = keynode->valuelen;
+            keynode = NULL;
+        } else {
+            /* pop anyway, don't check expired time */
+            list_del(&keynode->entry);
+        }
+
+        pthread_spin_unlock(&hash_head->lock);
+        return keynode;
+    }
+    pthread_spin_unlock(&hash_head->lock);
+
+    return NULL;
+}
+
+/*
+ * inster key into hash list, fails if another SET of the key got in the way since popped. A
+ * conditional SET also replaces the node of the key another SET inserted meanwhile, but not in the
+ * way(e.g. of a lower version), the key never has two nodes.
+ */
+static inline bool priskv_insert_keynode(priskv_kv *kv, priskv_key *keynode, uint8_t cond,
+                                         uint32_t *existlen)
 {
-    /* inster key into hash list */
     uint32_t crc = priskv_crc32(keynode->key, keynode->keylen);
     priskv_hash_head *hash_head = &kv->hash_heads[crc % kv->bucket_count];
+    priskv_key *node, *tmp;
+    struct list_head replaced;
+    struct timeval now;
 
+    list_head_init(&replaced);
+    gettimeofday(&now, NULL);
     pthread_spin_lock(&hash_head->lock);
+    if (cond) {
+        list_for_each (&hash_head->head, node, entry) {
+            if ((node->keylen == keynode->keylen) &&
+                !memcmp(node->key, keynode->key, keynode->keylen) &&
+                priskv_key_in_way(node, cond, keynode->version, now)) {
+                *existlen = node->valuelen;
+                pthread_spin_unlock(&hash_head->lock);
+                return false;
+            }
+        }
+
+        list_for_each_safe (&hash_head->head, node, tmp, entry) {
+            if ((node->keylen == keynode->keylen) &&
+                !memcmp(node->key, keynode->key, keynode->keylen)) {
+                list_del(&node->entry);
+                list_add_tail(&replaced, &node->entry);
+            }
+        }
+    }
     list_add_tail(&hash_head->head, &keynode->entry);
     pthread_spin_unlock(&hash_head->lock);
+
+    list_for_each_safe (&replaced, node, tmp, entry) {
+        list_del(&node->entry);
+        priskv_lru_del_key(node);
+        __priskv_del_key(kv, node);
+    }
+
+    return true;
 }
 
-// TODO: fix race condition
 int priskv_set_key(void *_kv, uint8_t *key, uint16_t keylen, uint8_t **val, uint32_t valuelen,
                  uint64_t timeout, void **_keynode)
+{
+    return priskv_set_key_cond(_kv, key, keylen, val, valuelen, timeout, 0, 0, NULL, _keynode);
+}
+
+// TODO: fix race condition
+int priskv_set_key_cond(void *_kv, uint8_t *key, uint16_t keylen, uint8_t **val, uint32_t valuelen,
+                        uint64_t timeout, uint8_t cond, uint32_t version, uint32_t *existlen,
+                        void **_keynode)
 {
     priskv_kv *kv = _kv;
     priskv_key *keynode = NULL, *old_keynode;
     uint8_t *vaddr = NULL;
+    bool exists = false;
     int retries = 0;
 
-    /* check parameters */
-    old_keynode = priskv_find_key(kv, key, keylen, PRISKV_KEY_MAX_TIMEOUT, true, NULL);
+    /* check the conditions before any allocation */
+    cond &= PRISKV_REQUEST_FLAG_NX | PRISKV_REQUEST_FLAG_VERSION;
+    old_keynode = priskv_pop_key_cond(kv, key, keylen, cond, version, &exists, existlen);
+    if (exists) {
+        *_keynode = NULL;
+        return PRISKV_RESP_STATUS_KEY_EXISTS;
+    }
+
     if (old_keynode) {
         /* free the old one */
         priskv_lru_del_key(old_keynode);
@@ -480,13 +740,25 @@ int priskv_set_key(void *_kv, uint8_t *key, uint16_t keylen, uint8_t **val, uint
     keynode->keylen = keylen;
     keynode->value_off = priskv_pointer_to_value(kv, vaddr);
     keynode->valuelen = valuelen;
+    keynode->version = (cond & PRISKV_REQUEST_FLAG_VERSION) ? version : 0;
+    keynode->dirty = false;
+    keynode->demoting = false;
+    keynode->parked = false;
     memcpy(keynode->key, key, keylen);
     keynode->refcnt = 0;
     pthread_spin_init(&keynode->lock, 0);
     priskv_keynode_ref(keynode);
 
+    /* never visible to others on failure */
+    if (!priskv_insert_keynode(kv, keynode, cond, existlen)) {
+        priskv_buddy_free(kv->value_buddy, vaddr);
+        memset(keynode, 0x00, priskv_slab_size(kv->key_slab));
+        priskv_slab_free(kv->key_slab, keynode);
+        *_keynode = NULL;
+        return PRISKV_RESP_STATUS_KEY_EXISTS;
+    }
     priskv_lru_access(keynode, false);
-    priskv_insert_keynode(kv, keynode);
+    priskv_lru_demote_watermark(kv);
 
     *val = vaddr;
     *_keynode = keynode;
@@ -502,6 +774,124 @@ out:
     return PRISKV_RESP_STATUS_NO_MEM;
 }
 
+static priskv_parked_head *priskv_parked_head_of(priskv_kv *kv, priskv_key *keynode)
+{
+    uint32_t crc = priskv_crc32(keynode->key, keynode->keylen);
+
+    return &kv->parked_heads[crc % kv->bucket_count % PRISKV_KV_PARKED_SHARDS];
+}
+
+/* wake the GETs parked on @keynode, called after @keynode ends its process */
+static void priskv_wake_parked_gets(priskv_kv *kv, priskv_key *keynode)
+{
+    priskv_parked_head *head;
+    priskv_parked_get *pget, *tmp;
+    struct list_head woken;
+
+    /* pairs with priskv_park_get, either it sees the key done or we see it parked */
+    if (!__atomic_load_n(&keynode->parked, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    list_head_init(&woken);
+    head = priskv_parked_head_of(kv, keynode);
+    pthread_spin_lock(&head->lock);
+    keynode->parked = false;
+    list_for_each_safe (&head->pgets, pget, tmp, node) {
+        if (pget->keynode == keynode) {
+            list_del(&pget->node);
+            list_add_tail(&woken, &pget->node);
+            pget->parked = false;
+            __atomic_sub_fetch(&head->nparked, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_spin_unlock(&head->lock);
+
+    list_for_each_safe (&woken, pget, tmp, node) {
+        list_del(&pget->node);
+        pget->wake(pget);
+    }
+}
+
+bool priskv_park_get(void *_kv, void *_keynode, priskv_parked_get *pget)
+{
+    priskv_kv *kv = _kv;
+    priskv_key *keynode = _keynode;
+    priskv_parked_head *head = priskv_parked_head_of(kv, keynode);
+
+    pthread_spin_lock(&head->lock);
+    __atomic_store_n(&keynode->parked, true, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&keynode->inprocess, __ATOMIC_SEQ_CST)) {
+        pthread_spin_unlock(&head->lock);
+        return false;
+    }
+
+    pget->keynode = keynode;
+    pget->parked = true;
+    pget->timedout = false;
+    gettimeofday(&pget->deadline, NULL);
+    priskv_time_add_ms(&pget->deadline, PRISKV_KV_PARKED_GET_TIMEOUT_MS);
+    list_add_tail(&head->pgets, &pget->node);
+    __atomic_add_fetch(&head->nparked, 1, __ATOMIC_RELAXED);
+    pthread_spin_unlock(&head->lock);
+
+    return true;
+}
+
+bool priskv_unpark_get(void *_kv, priskv_parked_get *pget)
+{
+    priskv_kv *kv = _kv;
+    priskv_parked_head *head = priskv_parked_head_of(kv, pget->keynode);
+    bool parked;
+
+    pthread_spin_lock(&head->lock);
+    parked = pget->parked;
+    if (parked) {
+        list_del(&pget->node);
+        pget->parked = false;
+        __atomic_sub_fetch(&head->nparked, 1, __ATOMIC_RELAXED);
+    }
+    pthread_spin_unlock(&head->lock);
+
+    return parked;
+}
+
+void priskv_expire_parked_gets(void *_kv)
+{
+    priskv_kv *kv = _kv;
+    priskv_parked_head *head;
+    priskv_parked_get *pget;
+    struct list_head woken;
+    struct timeval now;
+
+    list_head_init(&woken);
+    gettimeofday(&now, NULL);
+    for (uint32_t i = 0; i < PRISKV_KV_PARKED_SHARDS; i++) {
+        head = &kv->parked_heads[i];
+        if (!__atomic_load_n(&head->nparked, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        pthread_spin_lock(&head->lock);
+        while ((pget = list_top(&head->pgets, priskv_parked_get, node))) {
+            if (timercmp(&pget->deadline, &now, >)) {
+                break;
+            }
+
+            list_del(&pget->node);
+            list_add_tail(&woken, &pget->node);
+            pget->parked = false;
+            pget->timedout = true;
+            __atomic_sub_fetch(&head->nparked, 1, __ATOMIC_RELAXED);
+        }
+        pthread_spin_unlock(&head->lock);
+    }
+
+    while ((pget = list_pop(&woken, priskv_parked_get, node))) {
+        pget->wake(pget);
+    }
+}
+
 void priskv_set_key_end(void *arg)
 {
     priskv_key *keynode = arg;
@@ -510,7 +900,137 @@ void priskv_set_key_end(void *arg)
         return;
     }
 
-    keynode->inprocess = false;
+    __atomic_store_n(&keynode->inprocess, false, __ATOMIC_SEQ_CST);
+    priskv_index_publish(keynode->kv, keynode);
+    priskv_wake_parked_gets(keynode->kv, keynode);
+}
+
+void priskv_set_key_dirty(void *arg, bool dirty)
+{
+    priskv_key *keynode = arg;
+    priskv_kv *kv = keynode->kv;
+
+    pthread_spin_lock(&kv->lru_lock);
+    if ((keynode->dirty != dirty) && priskv_lru_linked(keynode) && !keynode->demoting) {
+        list_del(&keynode->lru_entry);
+        list_add(dirty ? &kv->dirty_head : &kv->lru_head, &keynode->lru_entry);
+    }
+    keynode->dirty = dirty;
+    pthread_spin_unlock(&kv->lru_lock);
+}
+
+void priskv_get_key_info(void *arg, uint8_t **key, uint16_t *keylen, uint8_t **val,
+                         uint32_t *valuelen, uint64_t *timeout)
+{
+    priskv_key *keynode = arg;
+    struct timeval now;
+    long remain;
+
+    *key = keynode->key;
+    *keylen = keynode->keylen;
+    *val = priskv_value_to_pointer(keynode->kv, keynode);
+    *valuelen = keynode->valuelen;
+    *timeout = PRISKV_KEY_MAX_TIMEOUT;
+    if (keynode->expire_time.tv_sec >= 0 && keynode->expire_time.tv_usec >= 0) {
+        gettimeofday(&now, NULL);
+        remain = priskv_time_elapsed_ms(now, keynode->expire_time);
+        *timeout = remain > 0 ? remain : 1;
+    }
+}
+
+void priskv_demote_key_end(void *arg, priskv_demote_result result)
+{
+    priskv_key *keynode = arg;
+    priskv_kv *kv = keynode->kv;
+
+    pthread_spin_lock(&kv->lru_lock);
+    if (result == PRISKV_DEMOTE_CLEAN) {
+        keynode->dirty = false;
+    }
+    keynode->demoting = false;
+
+    /* demoted ahead of eviction, takes a turn on the LRU. A failed one retries after the others */
+    if (priskv_lru_linked(keynode)) {
+        list_del(&keynode->lru_entry);
+        if (!keynode->dirty) {
+            list_add(&kv->lru_head, &keynode->lru_entry);
+        } else if (result == PRISKV_DEMOTE_SKIPPED) {
+            list_add_tail(&kv->dirty_head, &keynode->lru_entry);
+        } else {
+            list_add(&kv->dirty_head, &keynode->lru_entry);
+        }
+    }
+    pthread_spin_unlock(&kv->lru_lock);
+
+    priskv_keynode_deref(keynode);
+}
+
+/* hold @keynode from priskv_set_key while the client writes the value by itself */
+void priskv_reserve_key(void *arg)
+{
+    priskv_key *keynode = arg;
+
+    priskv_keynode_ref(keynode);
+}
+
+/* unlink @keynode from hash list if it is still there, return false if it has been popped */
+static bool priskv_unlink_keynode(priskv_kv *kv, priskv_key *keynode)
+{
+    uint32_t crc = priskv_crc32(keynode->key, keynode->keylen);
+    priskv_hash_head *hash_head = &kv->hash_heads[crc % kv->bucket_count];
+    priskv_key *node;
+
+    pthread_spin_lock(&hash_head->lock);
+    list_for_each (&hash_head->head, node, entry) {
+        if (node == keynode) {
+            list_del(&keynode->entry);
+            pthread_spin_unlock(&hash_head->lock);
+            return true;
+        }
+    }
+    pthread_spin_unlock(&hash_head->lock);
+
+    return false;
+}
+
+/*
+ * end the reservation of priskv_reserve_key. On commit, the key becomes readable, otherwise the
+ * half-written key gets deleted. The value buffer is kept till now even if the key has been
+ * deleted or replaced during the reservation.
+ */
+void priskv_reserve_key_end(void *arg, bool commit)
+{
+    priskv_key *keynode = arg;
+    priskv_kv *kv = keynode->kv;
+
+    if (commit) {
+        __atomic_store_n(&keynode->inprocess, false, __ATOMIC_SEQ_CST);
+        priskv_index_publish(kv, keynode);
+    } else if (priskv_unlink_keynode(kv, keynode)) {
+        priskv_lru_del_key(keynode);
+        __priskv_del_key(kv, keynode);
+    }
+
+    /* on abort, the parked GETs retry and miss the key */
+    priskv_wake_parked_gets(kv, keynode);
+    priskv_keynode_deref(keynode);
+}
+
+/* drop the key of priskv_set_key without making it readable, a newer SET of the key is kept */
+void priskv_set_key_abort(void *arg)
+{
+    priskv_key *keynode = arg;
+    priskv_kv *kv = keynode->kv;
+
+    priskv_keynode_ref(keynode);
+    if (priskv_unlink_keynode(kv, keynode)) {
+        priskv_lru_del_key(keynode);
+        __priskv_del_key(kv, keynode);
+    }
+
+    /* the parked GETs retry and miss the key */
+    priskv_wake_parked_gets(kv, keynode);
+    priskv_keynode_deref(keynode);
 }
 
 int priskv_delete_key(void *_kv, uint8_t *key, uint16_t keylen)
@@ -544,6 +1064,10 @@ int priskv_expire_key(void *_kv, uint8_t *key, uint16_t keylen, uint64_t timeout
         return PRISKV_RESP_STATUS_NO_SUCH_KEY;
     }
 
+    /* a key with expire time is served by two-sided GET only */
+    if (timeout < PRISKV_KEY_MAX_TIMEOUT) {
+        priskv_index_unpublish(kv, keynode);
+    }
     priskv_keynode_deref(keynode);
 
     return PRISKV_RESP_STATUS_OK;
@@ -554,46 +1078,149 @@ void priskv_resume_tiering_req(priskv_tiering_req *treq)
     priskv_thread_submit_function(treq->thread, priskv_backend_req_resubmit, treq);
 }
 
+static inline bool priskv_tiering_req_same_key(priskv_tiering_req *a, priskv_tiering_req *b)
+{
+    return (a->keylen == b->keylen) && !memcmp(a->key, b->key, a->keylen);
+}
+
+bool priskv_key_serialize_try_enter(struct priskv_tiering_req *treq)
+{
+    priskv_kv *kv = (priskv_kv *)treq->kv;
+    priskv_tiering_wait_head *wait_head = &kv->tiering_wait_heads[treq->hash_head_index];
+    priskv_tiering_req *inflight;
+
+    pthread_spin_lock(&wait_head->lock);
+
+    list_for_each (&wait_head->inflight_reqs, inflight, node) {
+        if (priskv_tiering_req_same_key(inflight, treq)) {
+            pthread_spin_unlock(&wait_head->lock);
+            return false;
+        }
+    }
+
+    list_head_init(&treq->waiters);
+    list_add_tail(&wait_head->inflight_reqs, &treq->node);
+    pthread_spin_unlock(&wait_head->lock);
+
+    return true;
+}
+
 bool priskv_key_serialize_enter(struct priskv_tiering_req *treq)
 {
     priskv_kv *kv = (priskv_kv *)treq->kv;
     priskv_tiering_wait_head *wait_head = &kv->tiering_wait_heads[treq->hash_head_index];
+    priskv_tiering_req *inflight;
 
     pthread_spin_lock(&wait_head->lock);
 
-    if (wait_head->has_inflight_req) {
-        list_add_tail(&wait_head->pending_reqs, &treq->node);
-        pthread_spin_unlock(&wait_head->lock);
-        return false;
+    list_for_each (&wait_head->inflight_reqs, inflight, node) {
+        if (priskv_tiering_req_same_key(inflight, treq)) {
+            /* the value in memory is complete, see priskv_key_serialize_handover */
+            if (inflight->readable && (treq->cmd == PRISKV_COMMAND_GET) && !treq->unshared) {
+                treq->shared = true;
+                pthread_spin_unlock(&wait_head->lock);
+                return false;
+            }
+
+            list_add_tail(&inflight->waiters, &treq->node);
+            pthread_spin_unlock(&wait_head->lock);
+            return false;
+        }
     }
 
-    wait_head->has_inflight_req = true;
+    list_head_init(&treq->waiters);
+    list_add_tail(&wait_head->inflight_reqs, &treq->node);
     pthread_spin_unlock(&wait_head->lock);
 
     return true;
 }
 
+/* move the leading GET waiters of @treq to @gets */
+static void priskv_key_serialize_pop_gets(priskv_tiering_req *treq, struct list_head *gets)
+{
+    priskv_tiering_req *waiter;
+
+    while ((waiter = list_top(&treq->waiters, priskv_tiering_req, node))) {
+        if (waiter->cmd != PRISKV_COMMAND_GET) {
+            break;
+        }
+
+        list_del(&waiter->node);
+        list_add_tail(gets, &waiter->node);
+    }
+}
+
+static void priskv_key_serialize_resume_gets(struct list_head *gets)
+{
+    priskv_tiering_req *waiter;
+
+    while ((waiter = list_pop(gets, priskv_tiering_req, node))) {
+        waiter->shared = true;
+        priskv_resume_tiering_req(waiter);
+    }
+}
+
+/*
+ * @new_req takes the key over from @old_req with the waiters, and the value in memory is readable
+ * meanwhile: the GETs waiting or coming read the memory rather than waiting on @new_req.
+ */
+void priskv_key_serialize_handover(struct priskv_tiering_req *old_req,
+                                   struct priskv_tiering_req *new_req)
+{
+    priskv_kv *kv = (priskv_kv *)old_req->kv;
+    priskv_tiering_wait_head *wait_head = &kv->tiering_wait_heads[old_req->hash_head_index];
+    struct list_head shared_reqs;
+
+    list_head_init(&shared_reqs);
+    pthread_spin_lock(&wait_head->lock);
+
+    list_del(&old_req->node);
+    list_head_init(&new_req->waiters);
+    list_append_list(&new_req->waiters, &old_req->waiters);
+    priskv_key_serialize_pop_gets(new_req, &shared_reqs);
+    new_req->readable = true;
+    list_add_tail(&wait_head->inflight_reqs, &new_req->node);
+
+    pthread_spin_unlock(&wait_head->lock);
+
+    priskv_key_serialize_resume_gets(&shared_reqs);
+}
+
+/*
+ * hand the key over to the next waiter. The GETs waiting on a GET share its fetch from backend:
+ * the leading GET waiters are all resumed to read the memory, rather than fetching one by one.
+ */
 void priskv_key_serialize_exit(struct priskv_tiering_req *completed_req)
 {
     priskv_kv *kv = (priskv_kv *)completed_req->kv;
     priskv_tiering_wait_head *wait_head = &kv->tiering_wait_heads[completed_req->hash_head_index];
     struct priskv_tiering_req *next_req = NULL;
+    struct list_head shared_reqs;
 
+    list_head_init(&shared_reqs);
     pthread_spin_lock(&wait_head->lock);
 
-    if (list_empty(&wait_head->pending_reqs)) {
-        wait_head->has_inflight_req = false;
-        pthread_spin_unlock(&wait_head->lock);
-        return;
+    list_del(&completed_req->node);
+    if (completed_req->cmd == PRISKV_COMMAND_GET) {
+        priskv_key_serialize_pop_gets(completed_req, &shared_reqs);
     }
 
-    next_req = list_pop(&wait_head->pending_reqs, struct priskv_tiering_req, node);
+    next_req = list_pop(&completed_req->waiters, struct priskv_tiering_req, node);
+    if (next_req) {
+        /* the remaining waiters wait on the next one */
+        list_head_init(&next_req->waiters);
+        list_append_list(&next_req->waiters, &completed_req->waiters);
+        list_add_tail(&wait_head->inflight_reqs, &next_req->node);
+    }
 
-    // keep has_inflight_req = true
     pthread_spin_unlock(&wait_head->lock);
 
-    next_req->execute = true;
-    priskv_resume_tiering_req(next_req);
+    priskv_key_serialize_resume_gets(&shared_reqs);
+
+    if (next_req) {
+        next_req->execute = true;
+        priskv_resume_tiering_req(next_req);
+    }
 }
 
 int priskv_get_keys(void *_kv, uint8_t *regex, uint16_t regexlen, uint8_t *keysbuf, uint32_t keyslen,
@@ -740,12 +1367,32 @@ void priskv_clear_expired_kv(int fd, void *opaque, uint32_t events)
     kv->expire_routine_statics.expire_routine_times++;
 }
 
+static void priskv_parked_get_routine(int fd, void *opaque, uint32_t events)
+{
+    uint64_t n;
+
+    read(fd, &n, sizeof(n));
+    priskv_expire_parked_gets(opaque);
+}
+
 void priskv_expire_routine(priskv_thread *bgthread, void *_kv)
 {
     struct itimerspec timerspec;
     int interval, timerfd;
     priskv_kv *kv = _kv;
 
+    /* the parked GETs give up after PRISKV_KV_PARKED_GET_TIMEOUT_MS */
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    assert(timerfd >= 0);
+
+    memset(&timerspec, 0, sizeof(struct itimerspec));
+    timerspec.it_value.tv_nsec = PRISKV_KV_PARKED_GET_ROUTINE_MS * 1000000;
+    timerspec.it_interval.tv_nsec = PRISKV_KV_PARKED_GET_ROUTINE_MS * 1000000;
+    timerfd_settime(timerfd, 0, &timerspec, NULL);
+    priskv_set_fd_handler(timerfd, priskv_parked_get_routine, NULL, kv);
+
+    priskv_thread_add_event_handler(bgthread, timerfd);
+
     interval = priskv_get_expire_routine_interval(kv);
     timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
     assert(timerfd >= 0);
@@ -773,6 +1420,30 @@ uint32_t priskv_get_bucket_count(void *_kv)
     return kv->bucket_count;
 }
 
+int priskv_enable_index(void *_kv, uint32_t nentries)
+{
+    priskv_kv *kv = _kv;
+
+    kv->index = priskv_mem_malloc(nentries * sizeof(priskv_index_entry), true);
+    if (!kv->index) {
+        return -ENOMEM;
+    }
+
+    memset(kv->index, 0x00, nentries * sizeof(priskv_index_entry));
+    kv->index_entries = nentries;
+    priskv_log_notice("KV: one-sided GET index entries %d\n", nentries);
+
+    return 0;
+}
+
+priskv_index_entry *priskv_get_index(void *_kv, uint32_t *nentries)
+{
+    priskv_kv *kv = _kv;
+
+    *nentries = kv->index_entries;
+    return kv->index;
+}
+
 uint32_t priskv_get_max_keys(void *_kv)
 {
     priskv_kv *kv = _kv;
@@ -859,9 +1530,11 @@ int priskv_recover(void *_kv)
 
         assert(keynode->valuelen);
         keynode->kv = _kv;
+        keynode->demoting = false;
+        keynode->parked = false;
         list_node_init(&keynode->entry);
         assert(priskv_slab_reserve(kv->key_slab, i) == keynode);
-        priskv_insert_keynode(kv, keynode);
+        priskv_insert_keynode(kv, keynode, 0, NULL);
         priskv_lru_access(keynode, false);
         priskv_log_info("KV: recover key [%s] (%d bytes) with value %ld bytes\n", safekey,
                       keynode->keylen, keynode->valuelen);
@@ -32,7 +32,9 @@ extern "C"
 {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <sys/time.h>
 
 #include "priskv-threads.h"
 #include "priskv-protocol.h"
@@ -42,6 +44,8 @@ typedef struct priskv_rdma_conn priskv_rdma_conn;
 struct priskv_rdma_rw_work;
 
 #define PRISKV_KV_DEFAULT_EXPIRE_ROUTINE_INTERVAL 600
+#define PRISKV_KV_PARKED_GET_TIMEOUT_MS 100
+#define PRISKV_KV_PARKED_GET_ROUTINE_MS 10
 
 void *priskv_new_kv(uint8_t *key_base, uint8_t *value_base, uint32_t max_keys,
                   uint16_t max_key_length, uint32_t value_block_size, uint64_t value_blocks);
@@ -66,7 +70,55 @@ void priskv_get_key_end(void *arg);
 
 int priskv_set_key(void *_kv, uint8_t *key, uint16_t keylen, uint8_t **val, uint32_t valuelen,
                  uint64_t timeout, void **_keynode);
+/* SET only if @cond(PRISKV_REQUEST_FLAG_NX and/or PRISKV_REQUEST_FLAG_VERSION) holds, checked before
+ * allocation. A key in the way returns PRISKV_RESP_STATUS_KEY_EXISTS with its length in @existlen.
+ */
+int priskv_set_key_cond(void *_kv, uint8_t *key, uint16_t keylen, uint8_t **val, uint32_t valuelen,
+                        uint64_t timeout, uint8_t cond, uint32_t version, uint32_t *existlen,
+                        void **_keynode);
 void priskv_set_key_end(void *arg);
+/* instead of priskv_set_key_end, on a SET failed before the value is written */
+void priskv_set_key_abort(void *arg);
+
+/* a dirty key is demoted to backend rather than evicted, see PRISKV_TIERING_WRITE_DEMOTE */
+void priskv_set_key_dirty(void *arg, bool dirty);
+/* the key-value of a key held by the caller, @timeout is the remaining time in ms */
+void priskv_get_key_info(void *arg, uint8_t **key, uint16_t *keylen, uint8_t **val,
+                         uint32_t *valuelen, uint64_t *timeout);
+/*
+ * end the demotion of priskv_tiering_demote. A clean key is evictable since now, a skipped one is
+ * still the first to demote, and a failed one retries after the other dirty keys.
+ */
+typedef enum priskv_demote_result {
+    PRISKV_DEMOTE_CLEAN,
+    PRISKV_DEMOTE_SKIPPED,
+    PRISKV_DEMOTE_FAILED,
+} priskv_demote_result;
+void priskv_demote_key_end(void *arg, priskv_demote_result result);
+
+void priskv_reserve_key(void *arg);
+void priskv_reserve_key_end(void *arg, bool commit);
+
+/*
+ * a GET hitting a key in process waits for the end of SET/RESERVE instead of failing with
+ * PRISKV_RESP_STATUS_KEY_UPDATING. @wake is called from any thread once the key ends, or with
+ * @timedout after PRISKV_KV_PARKED_GET_TIMEOUT_MS.
+ */
+typedef struct priskv_parked_get {
+    struct list_node node;
+    void *keynode; /* held by priskv_get_key */
+    struct timeval deadline;
+    bool parked;
+    bool timedout;
+    void (*wake)(struct priskv_parked_get *pget);
+} priskv_parked_get;
+
+/* return false if @keynode is not in process any more, the GET should retry at once */
+bool priskv_park_get(void *kv, void *keynode, priskv_parked_get *pget);
+/* return false if @pget has been woken already */
+bool priskv_unpark_get(void *kv, priskv_parked_get *pget);
+/* wake the parked GETs over the deadline */
+void priskv_expire_parked_gets(void *kv);
 
 int priskv_delete_key(void *kv, uint8_t *key, uint16_t keylen);
 
@@ -83,6 +135,11 @@ uint32_t priskv_get_keys_inuse(void *_kv);
 
 uint32_t priskv_get_max_keys(void *_kv);
 
+/* export the index for one-sided GET, not supported in tiering mode */
+int priskv_enable_index(void *_kv, uint32_t nentries);
+
+priskv_index_entry *priskv_get_index(void *_kv, uint32_t *nentries);
+
 uint16_t priskv_get_max_key_length(void *_kv);
 
 uint32_t priskv_get_bucket_count(void *_kv);
@@ -100,7 +157,7 @@ uint64_t priskv_get_expire_kv_bytes(void *_kv);
 uint64_t priskv_get_expire_routine_times(void *_kv);
 
 // save pending requests context when:
-// 1. For the same key, a request has already been sent to the backend;
+// 1. For the same key(not the bucket), a request has already been sent to the backend;
 // 2. The number of current concurrent requests exceeds the backend queue depth.
 typedef struct priskv_tiering_req {
     priskv_rdma_conn *conn;
@@ -116,26 +173,44 @@ typedef struct priskv_tiering_req {
     uint8_t *value;
     uint32_t valuelen;
     uint32_t remote_valuelen;
+    uint32_t fetch_valuelen; /* the whole value a range GET loads from backend */
     void *keynode;
     uint64_t timeout;
 
     priskv_req_command cmd;
 
     bool execute;
+    bool shared;   /* a GET woken by the fetch of another GET, try the memory first */
+    bool unshared; /* a shared GET missed the memory, wait for the key */
+    bool readable; /* the value in memory is complete while @execute */
     struct list_node node;
+    struct list_head waiters; /* the requests of the same key, while @execute */
     uint32_t hash_head_index;
     
     priskv_backend_status backend_status;
 
     bool recv_reposted;
     struct priskv_rdma_rw_work *rdma_work;
+
+    struct list_node space_node; /* a SET out of memory, waiting for the demotions in flight */
+    uint8_t space_waits;
+
+    uint8_t keybuf[]; /* storage of @key, max_key_length + 1 bytes */
 } priskv_tiering_req;
 
 int priskv_backend_req_resubmit(void *req);
+/* the demotions in flight of an iothread, an eviction skips the demotion over it */
+#define PRISKV_TIERING_MAX_DEMOTIONS 32
+/* write the dirty @keynode to backend without blocking, referenced by the caller */
+void priskv_tiering_demote(void *kv, void *keynode);
 
 // tiering concurrency control
 bool priskv_key_serialize_enter(struct priskv_tiering_req *treq);
+/* enter only if no request of the key in flight, never wait */
+bool priskv_key_serialize_try_enter(struct priskv_tiering_req *treq);
 void priskv_key_serialize_exit(struct priskv_tiering_req *completed_req);
+void priskv_key_serialize_handover(struct priskv_tiering_req *old_req,
+                                   struct priskv_tiering_req *new_req);
 
 #if defined(__cplusplus)
 }
@@ -45,9 +45,12 @@ typedef struct priskv_key {
     pthread_spinlock_t lock;
     uint32_t refcnt;
     bool inprocess;
-    bool reserved[3];
+    bool dirty;    /* not in backend yet, demoted to backend rather than evicted */
+    bool demoting; /* the demotion of a dirty key in flight */
+    bool parked;   /* some GET has parked on the key in process, see priskv_park_get */
     uint16_t keylen;
     uint32_t valuelen;
+    uint32_t version;   /* PRISKV_REQUEST_FLAG_VERSION, in the padding of the old layout */
     uint64_t value_off; /* offset from value blocks. [0, blocks * block size) */
     uint8_t key[0];     /* pointer to a slab element */
 } priskv_key;
@@ -0,0 +1,210 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qos.h"
+
+void priskv_qos_init(priskv_qos *qos, const priskv_qos_conf *conf)
+{
+    memset(qos, 0x00, sizeof(priskv_qos));
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        qos->classes[i].conf = conf[i];
+        if (!qos->classes[i].conf.weight) {
+            qos->classes[i].conf.weight = 1;
+        }
+        list_head_init(&qos->classes[i].active);
+    }
+}
+
+int priskv_qos_queue_init(priskv_qos_queue *queue, void *owner, uint32_t depth)
+{
+    memset(queue, 0x00, sizeof(priskv_qos_queue));
+    queue->owner = owner;
+    queue->depth = depth;
+
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        priskv_qos_fifo *fifo = &queue->fifos[i];
+
+        fifo->queue = queue;
+        fifo->items = calloc(depth, sizeof(priskv_qos_item));
+        if (!fifo->items) {
+            priskv_qos_queue_deinit(queue);
+            return -ENOMEM;
+        }
+        list_node_init(&fifo->node);
+    }
+
+    return 0;
+}
+
+void priskv_qos_queue_deinit(priskv_qos_queue *queue)
+{
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        free(queue->fifos[i].items);
+        queue->fifos[i].items = NULL;
+    }
+}
+
+bool priskv_qos_queue_empty(priskv_qos_queue *queue)
+{
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        if (queue->fifos[i].count) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t priskv_qos_queue_len(priskv_qos_queue *queue)
+{
+    uint32_t len = 0;
+
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        len += queue->fifos[i].count;
+    }
+
+    return len;
+}
+
+void priskv_qos_queue_detach(priskv_qos *qos, priskv_qos_queue *queue)
+{
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        priskv_qos_fifo *fifo = &queue->fifos[i];
+
+        if (fifo->active) {
+            list_del_from(&qos->classes[i].active, &fifo->node);
+            fifo->active = false;
+        }
+        fifo->head = 0;
+        fifo->count = 0;
+    }
+}
+
+int priskv_qos_enqueue(priskv_qos *qos, priskv_qos_queue *queue, priskv_qos_class cls,
+                       const priskv_qos_item *item)
+{
+    priskv_qos_fifo *fifo = &queue->fifos[cls];
+
+    if (fifo->count == queue->depth) {
+        return -ENOSPC;
+    }
+
+    fifo->items[(fifo->head + fifo->count) % queue->depth] = *item;
+    fifo->count++;
+    if (!fifo->active) {
+        list_add_tail(&qos->classes[cls].active, &fifo->node);
+        fifo->active = true;
+    }
+
+    return 0;
+}
+
+static inline bool priskv_qos_class_ready(priskv_qos *qos, uint32_t cls)
+{
+    uint64_t budget = qos->classes[cls].conf.budget;
+
+    if (list_empty(&qos->classes[cls].active)) {
+        return false;
+    }
+
+    return !budget || __atomic_load_n(&qos->classes[cls].inflight, __ATOMIC_RELAXED) < budget;
+}
+
+void *priskv_qos_dequeue(priskv_qos *qos, priskv_qos_class *cls, priskv_qos_item *item)
+{
+    for (;;) {
+        uint64_t rounds = UINT64_MAX;
+
+        for (uint32_t i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+            uint32_t c = (qos->cur + i) % PRISKV_QOS_CLASS_MAX;
+            priskv_qos_fifo *fifo;
+
+            if (!priskv_qos_class_ready(qos, c)) {
+                /* an idle class does not save deficit */
+                if (list_empty(&qos->classes[c].active)) {
+                    qos->classes[c].deficit = 0;
+                }
+                continue;
+            }
+
+            fifo = list_top(&qos->classes[c].active, priskv_qos_fifo, node);
+            priskv_qos_item *head = &fifo->items[fifo->head];
+            if (qos->classes[c].deficit < head->cost) {
+                uint64_t quantum = (uint64_t)qos->classes[c].conf.weight * PRISKV_QOS_QUANTUM;
+                uint64_t need = (head->cost - qos->classes[c].deficit + quantum - 1) / quantum;
+
+                rounds = need < rounds ? need : rounds;
+                continue;
+            }
+
+            *item = *head;
+            *cls = c;
+            qos->classes[c].deficit -= head->cost;
+            qos->classes[c].dispatched++;
+            qos->cur = c;
+
+            fifo->head = (fifo->head + 1) % fifo->queue->depth;
+            fifo->count--;
+            list_del_from(&qos->classes[c].active, &fifo->node);
+            if (fifo->count) {
+                /* round robin among connections */
+                list_add_tail(&qos->classes[c].active, &fifo->node);
+            } else {
+                fifo->active = false;
+            }
+
+            return fifo->queue->owner;
+        }
+
+        if (rounds == UINT64_MAX) {
+            return NULL;
+        }
+
+        /* skip the rounds which dequeue nothing */
+        for (uint32_t c = 0; c < PRISKV_QOS_CLASS_MAX; c++) {
+            if (priskv_qos_class_ready(qos, c)) {
+                qos->classes[c].deficit +=
+                    rounds * qos->classes[c].conf.weight * PRISKV_QOS_QUANTUM;
+            }
+        }
+        qos->cur = (qos->cur + 1) % PRISKV_QOS_CLASS_MAX;
+    }
+}
+
+void priskv_qos_charge(priskv_qos *qos, priskv_qos_class cls, uint64_t bytes)
+{
+    __atomic_fetch_add(&qos->classes[cls].inflight, bytes, __ATOMIC_RELAXED);
+}
+
+void priskv_qos_uncharge(priskv_qos *qos, priskv_qos_class cls, uint64_t bytes)
+{
+    __atomic_fetch_sub(&qos->classes[cls].inflight, bytes, __ATOMIC_RELAXED);
+}
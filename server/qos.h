@@ -0,0 +1,120 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#ifndef __PRISKV_SERVER_QOS__
+#define __PRISKV_SERVER_QOS__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "list.h"
+
+/*
+ * QoS of requests on a worker thread.
+ *
+ * Each connection queues its requests by class, a worker thread dequeues them by Deficit Round
+ * Robin: a class earns @weight * PRISKV_QOS_QUANTUM bytes per round, and the connections of a class
+ * are served in round robin. A class stops dequeuing while the bytes in flight(RDMA READ/WRITE
+ * posted but not completed) exceed its @budget, the completions kick the dequeuing again.
+ */
+#define PRISKV_QOS_QUANTUM (64 * 1024)
+#define PRISKV_QOS_MIN_COST 4096 /* the cost of a request without value */
+
+typedef enum priskv_qos_class {
+    PRISKV_QOS_CLASS_HIGH,
+    PRISKV_QOS_CLASS_NORMAL,
+    PRISKV_QOS_CLASS_LOW,
+
+    PRISKV_QOS_CLASS_MAX
+} priskv_qos_class;
+
+typedef struct priskv_qos_conf {
+    uint32_t weight;
+    uint64_t budget; /* bytes in flight, 0 means unlimited */
+} priskv_qos_conf;
+
+typedef struct priskv_qos_item {
+    void *arg;
+    uint32_t len;
+    uint32_t cost;
+} priskv_qos_item;
+
+/* the requests of a class from a connection */
+typedef struct priskv_qos_fifo {
+    struct priskv_qos_queue *queue;
+    priskv_qos_item *items;
+    uint32_t head;
+    uint32_t count;
+    bool active;
+    struct list_node node; /* in active list of the class */
+} priskv_qos_fifo;
+
+/* the requests from a connection */
+typedef struct priskv_qos_queue {
+    void *owner;
+    uint32_t depth;
+    priskv_qos_fifo fifos[PRISKV_QOS_CLASS_MAX];
+} priskv_qos_queue;
+
+/* the scheduler of a worker thread */
+typedef struct priskv_qos {
+    struct {
+        priskv_qos_conf conf;
+        int64_t deficit;
+        uint64_t inflight; /* atomic, completions may be accounted by another thread */
+        uint64_t dispatched;
+        struct list_head active;
+    } classes[PRISKV_QOS_CLASS_MAX];
+    uint32_t cur;
+} priskv_qos;
+
+void priskv_qos_init(priskv_qos *qos, const priskv_qos_conf *conf);
+
+int priskv_qos_queue_init(priskv_qos_queue *queue, void *owner, uint32_t depth);
+void priskv_qos_queue_deinit(priskv_qos_queue *queue);
+bool priskv_qos_queue_empty(priskv_qos_queue *queue);
+uint32_t priskv_qos_queue_len(priskv_qos_queue *queue);
+/* remove @queue from @qos, the queued requests are dropped */
+void priskv_qos_queue_detach(priskv_qos *qos, priskv_qos_queue *queue);
+
+int priskv_qos_enqueue(priskv_qos *qos, priskv_qos_queue *queue, priskv_qos_class cls,
+                       const priskv_qos_item *item);
+/* return the owner of the dequeued request, NULL if nothing could be dequeued */
+void *priskv_qos_dequeue(priskv_qos *qos, priskv_qos_class *cls, priskv_qos_item *item);
+
+void priskv_qos_charge(priskv_qos *qos, priskv_qos_class cls, uint64_t bytes);
+void priskv_qos_uncharge(priskv_qos *qos, priskv_qos_class cls, uint64_t bytes);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __PRISKV_SERVER_QOS__ */
@@ -42,23 +42,50 @@
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
 #include "priskv-protocol.h"
 #include "priskv-protocol-helper.h"
 #include "priskv-log.h"
 #include "priskv-utils.h"
+#include "priskv-slots.h"
 #include "acl.h"
 #include "kv.h"
 #include "rdma.h"
+#include "transport.h"
 #include "priskv-event.h"
 #include "priskv-threads.h"
 #include "list.h"
 #include "memory.h"
 #include "crc.h"
 #include "backend/backend.h"
+#include "qos.h"
 
 priskv_threadpool *g_threadpool;
 uint32_t g_slow_query_threshold_latency_us = SLOW_QUERY_THRESHOLD_LATENCY_US;
+uint32_t g_rebalance_interval_ms = PRISKV_RDMA_DEFAULT_REBALANCE_INTERVAL_MS;
+priskv_qos_conf g_qos_conf[PRISKV_QOS_CLASS_MAX] = {
+    [PRISKV_QOS_CLASS_HIGH] = {.weight = PRISKV_RDMA_DEFAULT_QOS_WEIGHT_HIGH, .budget = 0},
+    [PRISKV_QOS_CLASS_NORMAL] = {.weight = PRISKV_RDMA_DEFAULT_QOS_WEIGHT_NORMAL, .budget = 0},
+    [PRISKV_QOS_CLASS_LOW] = {.weight = PRISKV_RDMA_DEFAULT_QOS_WEIGHT_LOW,
+                              .budget = PRISKV_RDMA_DEFAULT_QOS_BUDGET_LOW},
+};
+
+/* grant less credits if the value memory is used more than the threshold */
+#define PRISKV_RDMA_CREDIT_MEM_PERCENT 90
+#define PRISKV_RDMA_MIN_CREDITS 1
+
+/* rebalance iothreads only if the busiest one is busy enough, and much busier than the idlest */
+#define PRISKV_RDMA_REBALANCE_MIN_BUSY_NS (200UL * 1000 * 1000)
+#define PRISKV_RDMA_REBALANCE_SKEW_PERCENT 25
+
+/* check the reservations of PRISKV_COMMAND_RESERVE not committed in time */
+#define PRISKV_RDMA_RESERVE_EXPIRE_INTERVAL_MS 1000
+
+/* closing a client waits for its woken GETs to resume in the thread */
+#define PRISKV_RDMA_UNPARK_RETRY_US 1000
+#define PRISKV_RDMA_UNPARK_WARN_RETRIES 1000
 
 #define PRISKV_RDMA_DEF_ADDR(id)                                                                     \
     char local_addr[PRISKV_ADDR_LEN] = {0};                                                          \
@@ -66,6 +93,11 @@ uint32_t g_slow_query_threshold_latency_us = SLOW_QUERY_THRESHOLD_LATENCY_US;
     priskv_inet_ntop(rdma_get_local_addr(id), local_addr);                                           \
     priskv_inet_ntop(rdma_get_peer_addr(id), peer_addr);
 
+/* the addresses of a client, resolved once on connecting */
+#define PRISKV_RDMA_CONN_ADDR(conn)                                                                  \
+    const char *local_addr = (conn)->c.local_addr;                                                   \
+    const char *peer_addr = (conn)->c.peer_addr;
+
 typedef struct priskv_rdma_mem {
 #define PRISKV_RDMA_MEM_NAME_LEN 32
     char name[PRISKV_RDMA_MEM_NAME_LEN];
@@ -82,7 +114,42 @@ typedef enum priskv_rdma_mem_type {
     PRISKV_RDMA_MEM_MAX
 } priskv_rdma_mem_type;
 
+/*
+ * the value region is registered as several MRs of @seg_size bytes(the last one may be smaller),
+ * because a single MR is limited by max_mr_size of IB device.
+ */
+typedef struct priskv_rdma_value_mrs {
+    uint8_t *base;
+    uint64_t size;
+    uint64_t seg_size;
+    uint32_t nmrs;
+    uint32_t max_sge; /* SGEs of a RDMA READ/WRITE, a local range may cross MRs */
+    bool mw;          /* type 2 memory windows are supported, PRISKV_COMMAND_RESERVE needs them */
+    struct ibv_mr **mrs;
+} priskv_rdma_value_mrs;
+
+/*
+ * a value reserved by PRISKV_COMMAND_RESERVE, waiting for PRISKV_COMMAND_COMMIT.
+ * The client writes the value through memory windows bound to the reserved range only, the
+ * windows are invalidated by COMMIT or expiry before the value is ended.
+ */
+typedef struct priskv_rdma_reservation {
+    void *keynode;
+    uint32_t valuelen;
+    uint32_t keycrc;
+    uint32_t gen;
+    uint16_t nmw;       /* windows bound to the value */
+    bool invalidating;  /* ended by the completion of IBV_WR_LOCAL_INV */
+    bool ok;            /* the value is committed, otherwise dropped */
+    bool respond;       /* respond the COMMIT of @request_id once invalidated */
+    uint64_t request_id; /* be64 type */
+    uint64_t deadline_ns; /* CLOCK_MONOTONIC */
+    struct ibv_mw *mws[PRISKV_RESERVE_MAX_SGL]; /* allocated on demand, reused by the slot */
+} priskv_rdma_reservation;
+
 typedef struct priskv_rdma_conn {
+    const priskv_transport_ops *ops;
+    void *transport; /* the connection of the stream transports, NULL for verbs */
     struct rdma_cm_id *cm_id;
     struct ibv_comp_channel *comp_channel;
     struct ibv_cq *cq;
@@ -93,40 +160,81 @@ typedef struct priskv_rdma_conn {
         struct {
             struct list_head head;
             uint32_t nclients;
+            priskv_index_header *index_hdr; /* exported for one-sided GET, NULL if disabled */
+            struct ibv_mr *index_hdr_mr;
+            struct ibv_mr *index_mr;
         } s; /* for listener */
         struct {
             struct priskv_rdma_conn *listener;
             struct list_node node;
+            char local_addr[PRISKV_ADDR_LEN];
+            char peer_addr[PRISKV_ADDR_LEN];
             priskv_thread *thread;
             bool closing;
             priskv_rdma_stats stats[PRISKV_COMMAND_MAX];
             uint64_t resps;
+            /* load of the client, accounted into the thread by priskv_rdma_handle_cq */
+            uint64_t busy_ns; /* atomic */
+            uint64_t accounted_ops;
+            uint64_t accounted_bytes;
+            uint64_t last_busy_ns; /* snapshot of @busy_ns on rebalance */
+            uint64_t busy_rate;    /* busy ns per second between the last two rebalances */
+            uint64_t migrations;
+            priskv_qos_queue qos_queue; /* received requests waiting for the QoS of thread */
+            uint32_t backlog; /* priskv_rdma_waiting at the end of the last priskv_rdma_handle_cq */
+            uint64_t qos_charged[PRISKV_QOS_CLASS_MAX]; /* bytes of the inflight RDMA READ/WRITE */
         } c; /* for client */
     };
 
     void *kv;
     uint8_t *value_base;
-    struct ibv_mr *value_mr;
+    priskv_rdma_value_mrs *value_mrs; /* owned by listener, shared by clients */
+    uint32_t max_inline_data; /* IBV_SEND_INLINE capability of QP */
 
     priskv_rdma_mem rmem[PRISKV_RDMA_MEM_MAX];
+    priskv_slots resp_slots; /* free responses of PRISKV_RDMA_MEM_RESP */
+    priskv_pool work_pool;   /* priskv_rdma_rw_work */
+    priskv_pool treq_pool;   /* priskv_tiering_req with inline key */
+    priskv_pool pget_pool;   /* priskv_rdma_parked_get */
+    priskv_rdma_reservation *resvs;
+    priskv_slots resv_slots;
+    uint32_t resv_gen;
 } priskv_rdma_conn;
 
 typedef struct priskv_rdma_rw_work {
     priskv_rdma_conn *conn;
     uint64_t request_id; /* be64 type */
     priskv_request *req;
-    struct ibv_mr *mr;
+    priskv_rdma_mem *rmem; /* the buffer of KEYS, NULL for the value region */
     uint32_t valuelen;
     uint16_t nsgl;
     uint16_t completed;
     bool defer_resp;
+    bool responded; /* by priskv_rdma_conn_rw_respond ahead of the value */
+    priskv_response *inline_resp; /* response carrying the value of PRISKV_REQUEST_FLAG_INLINE GET */
     void (*cb)(void *);
+    void (*abort)(void *); /* instead of @cb if the value of SET never arrives */
     void *cbarg;
+    priskv_qos_class qos_class;
+    uint32_t qos_bytes; /* charged to the QoS of thread until completion */
 } priskv_rdma_rw_work;
 
+/* a GET parked on a key in process, holds the request buffer till resumed in the thread */
+typedef struct priskv_rdma_parked_get {
+    priskv_parked_get pget;
+    priskv_rdma_conn *conn;
+    priskv_thread *thread;
+    priskv_request *req;
+    uint8_t *key; /* in @req */
+    uint16_t keylen;
+    bool inuse;
+} priskv_rdma_parked_get;
+
 typedef struct priskv_rdma_server {
     int epollfd;
     void *kv;
+    struct timespec rebalance_ts;
+    priskv_qos *qos; /* per iothread */
     int nlisteners;
     priskv_rdma_conn listeners[PRISKV_RDMA_MAX_BIND_ADDR];
 } priskv_rdma_server;
@@ -137,7 +245,232 @@ static priskv_rdma_server g_server = {
 
 static uint32_t priskv_rdma_max_rw_size = 1024 * 1024 * 1024;
 
+/* the QoS of the thread which the client belongs to */
+static inline priskv_qos *priskv_rdma_qos(priskv_rdma_conn *conn)
+{
+    return &g_server.qos[priskv_thread_get_index(conn->c.thread)];
+}
+
+#define PRISKV_RDMA_VALUE_MR_SIZE (1UL << 30)
+#define PRISKV_RDMA_VALUE_MR_REG_THREADS 8
+#define PRISKV_RDMA_MAX_VALUE_SGE 4
+
+typedef struct priskv_rdma_value_reg_arg {
+    priskv_rdma_value_mrs *vmrs;
+    struct ibv_pd *pd;
+    uint32_t start;
+    uint32_t step;
+    int ret;
+} priskv_rdma_value_reg_arg;
+
+static void *priskv_rdma_value_reg_thread(void *arg)
+{
+    priskv_rdma_value_reg_arg *reg = arg;
+    priskv_rdma_value_mrs *vmrs = reg->vmrs;
+    /* the remote write access is granted by a memory window of PRISKV_COMMAND_RESERVE only */
+    uint32_t access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ;
+
+    if (vmrs->mw) {
+        access |= IBV_ACCESS_MW_BIND;
+    }
+
+    for (uint32_t i = reg->start; i < vmrs->nmrs; i += reg->step) {
+        uint64_t offset = i * vmrs->seg_size;
+        uint64_t size = priskv_min_u64(vmrs->seg_size, vmrs->size - offset);
+
+        vmrs->mrs[i] = ibv_reg_mr(reg->pd, vmrs->base + offset, size, access);
+        if (!vmrs->mrs[i]) {
+            reg->ret = -errno;
+            priskv_log_error("RDMA: failed to reg MR for value segment %d: %m [%p, %p]\n", i,
+                             vmrs->base + offset, vmrs->base + offset + size);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void priskv_rdma_value_dereg(priskv_rdma_value_mrs *vmrs)
+{
+    for (uint32_t i = 0; i < vmrs->nmrs; i++) {
+        if (vmrs->mrs[i]) {
+            ibv_dereg_mr(vmrs->mrs[i]);
+        }
+    }
+
+    free(vmrs->mrs);
+    free(vmrs);
+}
+
+/* split the value region into MR segments, and register them in parallel */
+static priskv_rdma_value_mrs *priskv_rdma_value_reg(struct rdma_cm_id *cm_id, uint8_t *base,
+                                                    uint64_t size, uint32_t block_size)
+{
+    priskv_rdma_value_reg_arg args[PRISKV_RDMA_VALUE_MR_REG_THREADS] = {0};
+    pthread_t threads[PRISKV_RDMA_VALUE_MR_REG_THREADS];
+    struct ibv_device_attr attr;
+    priskv_rdma_value_mrs *vmrs;
+    uint32_t nthreads, started;
+    int ret = 0;
+
+    vmrs = calloc(1, sizeof(priskv_rdma_value_mrs));
+    if (!vmrs) {
+        return NULL;
+    }
+
+    vmrs->base = base;
+    vmrs->size = size;
+    vmrs->seg_size = PRISKV_RDMA_VALUE_MR_SIZE;
+    vmrs->max_sge = PRISKV_RDMA_MAX_VALUE_SGE;
+    if (!ibv_query_device(cm_id->verbs, &attr)) {
+        vmrs->seg_size = priskv_min_u64(vmrs->seg_size, attr.max_mr_size);
+        vmrs->max_sge = priskv_min_u32(vmrs->max_sge, attr.max_sge);
+        vmrs->mw = !!(attr.device_cap_flags &
+                      (IBV_DEVICE_MEM_WINDOW_TYPE_2A | IBV_DEVICE_MEM_WINDOW_TYPE_2B));
+    }
+
+    /* keep value blocks in a single MR */
+    vmrs->seg_size -= vmrs->seg_size % block_size;
+    if (!vmrs->seg_size) {
+        vmrs->seg_size = block_size;
+    }
+
+    vmrs->nmrs = (size + vmrs->seg_size - 1) / vmrs->seg_size;
+    vmrs->mrs = calloc(vmrs->nmrs, sizeof(struct ibv_mr *));
+    if (!vmrs->mrs) {
+        free(vmrs);
+        return NULL;
+    }
+
+    nthreads = priskv_min_u32(vmrs->nmrs, PRISKV_RDMA_VALUE_MR_REG_THREADS);
+    for (uint32_t i = 0; i < nthreads; i++) {
+        args[i].vmrs = vmrs;
+        args[i].pd = cm_id->pd;
+        args[i].start = i;
+        args[i].step = nthreads;
+    }
+
+    for (started = 0; started < nthreads; started++) {
+        if (pthread_create(&threads[started], NULL, priskv_rdma_value_reg_thread,
+                           &args[started])) {
+            break;
+        }
+    }
+
+    /* the segments of the threads failed to start are registered in the current thread */
+    for (uint32_t i = started; i < nthreads; i++) {
+        priskv_rdma_value_reg_thread(&args[i]);
+    }
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (uint32_t i = 0; i < PRISKV_RDMA_VALUE_MR_REG_THREADS; i++) {
+        ret = ret ? ret : args[i].ret;
+    }
+
+    if (ret) {
+        priskv_rdma_value_dereg(vmrs);
+        errno = -ret;
+        return NULL;
+    }
+
+    priskv_log_info("RDMA: Value buffer registered as %d MRs, segment size %ld, max sge %d, "
+                    "memory window %s\n",
+                    vmrs->nmrs, vmrs->seg_size, vmrs->max_sge, vmrs->mw ? "yes" : "no");
+    return vmrs;
+}
+
+/* export the index of kv and the value MRs to clients, the client reads them by RDMA READ */
+static int priskv_rdma_index_export(priskv_rdma_conn *listener)
+{
+    priskv_rdma_value_mrs *vmrs = listener->value_mrs;
+    priskv_index_header *hdr;
+    priskv_index_entry *index;
+    uint32_t nentries, hdr_size;
+
+    index = priskv_get_index(listener->kv, &nentries);
+    if (!index) {
+        return 0;
+    }
+
+    listener->s.index_mr = ibv_reg_mr(listener->cm_id->pd, index,
+                                      nentries * sizeof(priskv_index_entry), IBV_ACCESS_REMOTE_READ);
+    if (!listener->s.index_mr) {
+        priskv_log_error("RDMA: failed to reg MR for index: %m\n");
+        return -EIO;
+    }
+
+    hdr_size = sizeof(priskv_index_header) + vmrs->nmrs * sizeof(uint32_t);
+    hdr = calloc(1, hdr_size);
+    if (!hdr) {
+        ibv_dereg_mr(listener->s.index_mr);
+        return -ENOMEM;
+    }
+
+    hdr->entries_addr = htobe64((uint64_t)index);
+    hdr->entries_rkey = htobe32(listener->s.index_mr->rkey);
+    hdr->nentries = htobe32(nentries);
+    hdr->value_base = htobe64((uint64_t)vmrs->base);
+    hdr->seg_size = htobe64(vmrs->seg_size);
+    hdr->nsegs = htobe32(vmrs->nmrs);
+    for (uint32_t i = 0; i < vmrs->nmrs; i++) {
+        hdr->seg_rkeys[i] = htobe32(vmrs->mrs[i]->rkey);
+    }
+
+    listener->s.index_hdr_mr = ibv_reg_mr(listener->cm_id->pd, hdr, hdr_size, IBV_ACCESS_REMOTE_READ);
+    if (!listener->s.index_hdr_mr) {
+        priskv_log_error("RDMA: failed to reg MR for index header: %m\n");
+        ibv_dereg_mr(listener->s.index_mr);
+        free(hdr);
+        return -EIO;
+    }
+
+    listener->s.index_hdr = hdr;
+    priskv_log_info("RDMA: index exported, entries %d, value segments %d\n", nentries, vmrs->nmrs);
+
+    return 0;
+}
+
+/*
+ * fill SGEs of local range [@val, @val + @length), @mr is NULL for the value region.
+ * return the length covered by the SGEs, which may be shorter than @length if the range crosses
+ * more MR segments than @max_sge.
+ */
+static uint32_t priskv_rdma_fill_sges(priskv_rdma_conn *conn, struct ibv_mr *mr, uint8_t *val,
+                                      uint32_t length, struct ibv_sge *sges, int *nsge)
+{
+    priskv_rdma_value_mrs *vmrs = conn->value_mrs;
+    uint32_t filled = 0;
+
+    if (mr) {
+        sges[0].addr = (uint64_t)val;
+        sges[0].length = length;
+        sges[0].lkey = mr->lkey;
+        *nsge = 1;
+        return length;
+    }
+
+    *nsge = 0;
+    while (filled < length && *nsge < vmrs->max_sge) {
+        uint64_t offset = val + filled - vmrs->base;
+        uint32_t seg = offset / vmrs->seg_size;
+        uint64_t seg_left = (seg + 1) * vmrs->seg_size - offset;
+
+        assert(seg < vmrs->nmrs);
+        sges[*nsge].addr = (uint64_t)(val + filled);
+        sges[*nsge].length = priskv_min_u64(length - filled, seg_left);
+        sges[*nsge].lkey = vmrs->mrs[seg]->lkey;
+        filled += sges[*nsge].length;
+        (*nsge)++;
+    }
+
+    return filled;
+}
+
 static void priskv_rdma_handle_cm(int fd, void *opaque, uint32_t events);
+static int priskv_rdma_timers_start(void);
 
 static int priskv_rdma_mem_new(priskv_rdma_conn *conn, priskv_rdma_mem *rmem, const char *name,
                              uint32_t size)
@@ -154,8 +487,9 @@ static int priskv_rdma_mem_new(priskv_rdma_conn *conn, priskv_rdma_mem *rmem, co
         goto error;
     }
 
-    rmem->mr = ibv_reg_mr(conn->cm_id->pd, buf, size, flags);
-    if (!rmem->mr) {
+    /* the stream transports copy from/to the buffer by CPU */
+    rmem->mr = conn->cm_id ? ibv_reg_mr(conn->cm_id->pd, buf, size, flags) : NULL;
+    if (conn->cm_id && !rmem->mr) {
         priskv_log_error("RDMA: failed to reg MR for %s buffer: %m\n", name);
         ret = -errno;
         goto free_mem;
@@ -200,6 +534,33 @@ static inline void priskv_rdma_free_ctrl_buffer(priskv_rdma_conn *conn)
 
         priskv_rdma_mem_free(conn, rmem);
     }
+
+    priskv_slots_deinit(&conn->resp_slots);
+    priskv_pool_deinit(&conn->work_pool);
+    priskv_pool_deinit(&conn->treq_pool);
+    priskv_pool_deinit(&conn->pget_pool);
+
+    /* the client never commits, drop the half-written values. The QP is destroyed already, no
+     * more RDMA WRITE through the windows */
+    for (uint32_t i = 0; conn->resvs && i < conn->conn_cap.max_inflight_command; i++) {
+        priskv_rdma_reservation *resv = &conn->resvs[i];
+
+        for (int j = 0; j < PRISKV_RESERVE_MAX_SGL; j++) {
+            if (resv->mws[j]) {
+                ibv_dealloc_mw(resv->mws[j]);
+            }
+        }
+
+        if (resv->keynode) {
+            priskv_reserve_key_end(resv->keynode, false);
+        }
+    }
+
+    free(conn->resvs);
+    conn->resvs = NULL;
+    priskv_slots_deinit(&conn->resv_slots);
+
+    priskv_qos_queue_deinit(&conn->c.qos_queue);
 }
 
 static int priskv_rdma_listen_one(char *addr, int port, void *kv, priskv_rdma_conn_cap *cap)
@@ -257,14 +618,13 @@ static int priskv_rdma_listen_one(char *addr, int port, void *kv, priskv_rdma_co
         goto error;
     }
 
-    /* TODO split into several MRs, because of max_mr_size of IB device */
     uint8_t *value_base = priskv_get_value_base(kv);
     assert(value_base);
     uint64_t size = priskv_get_value_blocks(kv) * priskv_get_value_block_size(kv);
     assert(size);
-    uint32_t access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ;
-    struct ibv_mr *value_mr = ibv_reg_mr(listen_cmid->pd, value_base, size, access);
-    if (!value_mr) {
+    priskv_rdma_value_mrs *value_mrs =
+        priskv_rdma_value_reg(listen_cmid, value_base, size, priskv_get_value_block_size(kv));
+    if (!value_mrs) {
         ret = -errno;
         priskv_log_error(
             "RDMA: failed to reg MR for value: %m [%p, %p], value block %ld, value block size %d\n",
@@ -279,12 +639,19 @@ static int priskv_rdma_listen_one(char *addr, int port, void *kv, priskv_rdma_co
     listener->cm_id = listen_cmid;
     listener->value_base = value_base;
     listener->kv = kv;
-    listener->value_mr = value_mr;
+    listener->value_mrs = value_mrs;
     listener->conn_cap = *cap;
     listener->s.nclients = 0;
     list_head_init(&listener->s.head);
     pthread_spin_init(&listener->lock, 0);
 
+    ret = priskv_rdma_index_export(listener);
+    if (ret) {
+        g_server.nlisteners--;
+        priskv_rdma_value_dereg(value_mrs);
+        goto error;
+    }
+
     priskv_log_info("RDMA: <%s:%d> listener starts\n", addr, port);
 
     ret = 0;
@@ -303,6 +670,28 @@ freeaddr:
     return ret;
 }
 
+int priskv_rdma_handler_init(void *kv)
+{
+    int niothread = priskv_threadpool_get_niothread(g_threadpool);
+
+    if (g_server.qos) {
+        return 0;
+    }
+
+    g_server.kv = kv;
+    g_server.qos = calloc(niothread, sizeof(priskv_qos));
+    if (!g_server.qos) {
+        priskv_log_error("RDMA: failed to allocate QoS of %d threads\n", niothread);
+        return -1;
+    }
+
+    for (int i = 0; i < niothread; i++) {
+        priskv_qos_init(&g_server.qos[i], g_qos_conf);
+    }
+
+    return 0;
+}
+
 int priskv_rdma_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_conn_cap *cap)
 {
     priskv_rdma_conn *listener;
@@ -314,7 +703,9 @@ int priskv_rdma_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_c
         }
     }
 
-    g_server.kv = kv;
+    if (priskv_rdma_handler_init(kv)) {
+        return -1;
+    }
 
     g_server.epollfd = epoll_create(g_server.nlisteners);
     if (g_server.epollfd == -1) {
@@ -335,7 +726,7 @@ int priskv_rdma_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_c
         priskv_log_notice("RDMA: <%s> ready\n", local_addr);
     }
 
-    return 0;
+    return priskv_rdma_timers_start();
 }
 
 static void priskv_rdma_get_clients(priskv_rdma_conn *listener, priskv_rdma_client **clients,
@@ -347,13 +738,17 @@ static void priskv_rdma_get_clients(priskv_rdma_conn *listener, priskv_rdma_clie
     pthread_spin_lock(&listener->lock);
     *clients = calloc(listener->s.nclients, sizeof(priskv_rdma_client));
     list_for_each (&listener->s.head, client, c.node) {
-        PRISKV_RDMA_DEF_ADDR(client->cm_id);
-
-        memcpy((*clients)[*nclients].address, peer_addr, strlen(peer_addr) + 1);
+        memcpy((*clients)[*nclients].address, client->c.peer_addr, PRISKV_ADDR_LEN);
         memcpy((*clients)[*nclients].stats, client->c.stats,
                PRISKV_COMMAND_MAX * sizeof(priskv_rdma_stats));
         (*clients)[*nclients].resps = client->c.resps;
         (*clients)[*nclients].closing = client->c.closing;
+        (*clients)[*nclients].resp_slots.total = client->resp_slots.nslots;
+        (*clients)[*nclients].resp_slots.inuse = priskv_slots_inuse(&client->resp_slots);
+        (*clients)[*nclients].resp_slots.peak = client->resp_slots.peak;
+        (*clients)[*nclients].resp_slots.exhausted = client->resp_slots.exhausted;
+        (*clients)[*nclients].thread = client->c.thread ? priskv_thread_get_index(client->c.thread) : -1;
+        (*clients)[*nclients].migrations = client->c.migrations;
         (*nclients)++;
 
         if (*nclients == listener->s.nclients) {
@@ -404,23 +799,32 @@ void *priskv_rdma_get_kv(void)
     return g_server.kv;
 }
 
-/* use 64 bytes aligned request buffer. */
+/* use 64 bytes aligned request buffer, the inline value follows the key, then the trace. */
 static inline unsigned int priskv_request_size_aligend(priskv_rdma_conn *conn)
 {
-    uint16_t s = priskv_request_size(conn->conn_cap.max_sgl, conn->conn_cap.max_key_length);
+    uint32_t s = priskv_request_size(conn->conn_cap.max_sgl, conn->conn_cap.max_key_length);
 
+    s += conn->conn_cap.max_inline_value + sizeof(priskv_request_trace);
     return ALIGN_UP(s, 64);
 }
 
-#define PRISKV_RDMA_RESPONSE_FREE_STATUS 0xffff
-static inline int priskv_rdma_response_free(priskv_response *resp)
+/* the trace of a sampled request is moved to the end of request buffer on receiving */
+static inline priskv_request_trace *priskv_rdma_req_trace(priskv_rdma_conn *conn,
+                                                          priskv_request *req)
 {
-    if (resp->status == PRISKV_RDMA_RESPONSE_FREE_STATUS) {
-        return -EPROTO;
+    if (!(req->flags & PRISKV_REQUEST_FLAG_TRACE)) {
+        return NULL;
     }
 
-    resp->status = PRISKV_RDMA_RESPONSE_FREE_STATUS;
-    return 0;
+    return (priskv_request_trace *)((uint8_t *)req + priskv_request_size_aligend(conn) -
+                                    sizeof(priskv_request_trace));
+}
+
+static inline unsigned int priskv_rdma_response_size(priskv_rdma_conn *conn)
+{
+    uint32_t payload = priskv_max_u32(conn->conn_cap.max_inline_value, sizeof(priskv_reserve_resp));
+
+    return sizeof(priskv_response) + payload;
 }
 
 static inline uint32_t priskv_rdma_wr_size(priskv_rdma_conn *client)
@@ -428,9 +832,24 @@ static inline uint32_t priskv_rdma_wr_size(priskv_rdma_conn *client)
     return client->conn_cap.max_inflight_command * (2 + client->conn_cap.max_sgl);
 }
 
+#define PRISKV_RDMA_RESPONSE_FREE_STATUS 0xffff
+static inline int priskv_rdma_response_free(priskv_rdma_conn *conn, priskv_response *resp)
+{
+    priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
+
+    if (resp->status == PRISKV_RDMA_RESPONSE_FREE_STATUS) {
+        return -EPROTO;
+    }
+
+    resp->status = PRISKV_RDMA_RESPONSE_FREE_STATUS;
+    priskv_slots_put(&conn->resp_slots,
+                     ((uint8_t *)resp - rmem->buf) / priskv_rdma_response_size(conn));
+    return 0;
+}
+
 static int priskv_rdma_new_ctrl_buffer(priskv_rdma_conn *conn)
 {
-    uint16_t size;
+    uint32_t size;
     uint32_t buf_size;
 
     /* #step 1, prepare buffer & MR for request from client */
@@ -441,15 +860,50 @@ static int priskv_rdma_new_ctrl_buffer(priskv_rdma_conn *conn)
     }
 
     /* #step 2, prepare buffer & MR for response to client */
-    size = sizeof(priskv_response);
+    size = priskv_rdma_response_size(conn);
     buf_size = size * priskv_rdma_wr_size(conn);
     if (priskv_rdma_mem_new(conn, &conn->rmem[PRISKV_RDMA_MEM_RESP], "Response", buf_size)) {
         goto error;
     }
 
-    for (uint16_t i = 0; i < priskv_rdma_wr_size(conn); i++) {
+    if (priskv_slots_init(&conn->resp_slots, priskv_rdma_wr_size(conn))) {
+        goto error;
+    }
+
+    for (uint32_t i = 0; i < priskv_rdma_wr_size(conn); i++) {
         priskv_response *resp = (priskv_response *)(conn->rmem[PRISKV_RDMA_MEM_RESP].buf + i * size);
-        priskv_rdma_response_free(resp);
+        resp->status = PRISKV_RDMA_RESPONSE_FREE_STATUS;
+    }
+
+    /* #step 3, prepare contexts of inflight commands, a command holds one of each at most */
+    if (priskv_pool_init(&conn->work_pool, sizeof(priskv_rdma_rw_work),
+                         conn->conn_cap.max_inflight_command)) {
+        goto error;
+    }
+
+    size = sizeof(priskv_tiering_req) + conn->conn_cap.max_key_length + 1;
+    if (priskv_pool_init(&conn->treq_pool, size, conn->conn_cap.max_inflight_command)) {
+        goto error;
+    }
+
+    if (priskv_pool_init(&conn->pget_pool, sizeof(priskv_rdma_parked_get),
+                         conn->conn_cap.max_inflight_command)) {
+        goto error;
+    }
+
+    /* #step 4, prepare reservations of PRISKV_COMMAND_RESERVE */
+    conn->resvs = calloc(conn->conn_cap.max_inflight_command, sizeof(priskv_rdma_reservation));
+    if (!conn->resvs) {
+        goto error;
+    }
+
+    if (priskv_slots_init(&conn->resv_slots, conn->conn_cap.max_inflight_command)) {
+        goto error;
+    }
+
+    /* #step 5, prepare QoS queue, a posted request buffer is queued once at most */
+    if (priskv_qos_queue_init(&conn->c.qos_queue, conn, priskv_rdma_wr_size(conn))) {
+        goto error;
     }
 
     return 0;
@@ -459,19 +913,87 @@ error:
     return -ENOMEM;
 }
 
-static void priskv_rdma_close_client(priskv_rdma_conn *client)
+static void priskv_rdma_qos_dispatch(priskv_qos *qos);
+static int priskv_tiering_drop_space_waiters(void *arg);
+
+/* called in the thread of client, drop the requests waiting for QoS and the charged bytes */
+static int priskv_rdma_qos_detach(void *arg)
+{
+    priskv_rdma_conn *client = arg;
+    priskv_qos *qos = priskv_rdma_qos(client);
+
+    priskv_qos_queue_detach(qos, &client->c.qos_queue);
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        priskv_qos_uncharge(qos, i, client->c.qos_charged[i]);
+        client->c.qos_charged[i] = 0;
+    }
+
+    /* the classes blocked by the budget may go on */
+    priskv_rdma_qos_dispatch(qos);
+    return 0;
+}
+
+/* called in the thread of client on closing, return the number of GETs waiting to resume */
+static int priskv_rdma_unpark_gets(void *arg)
+{
+    priskv_rdma_conn *client = arg;
+    priskv_pool *pool = &client->pget_pool;
+    priskv_rdma_parked_get *rpget;
+
+    for (uint32_t i = 0; pool->buf && i < client->conn_cap.max_inflight_command; i++) {
+        rpget = (priskv_rdma_parked_get *)(pool->buf + i * pool->objsize);
+        if (rpget->inuse && priskv_unpark_get(client->kv, &rpget->pget)) {
+            priskv_get_key_end(rpget->pget.keynode);
+            rpget->inuse = false;
+            priskv_pool_put(pool, rpget);
+        }
+    }
+
+    return pool->buf ? priskv_slots_inuse(&pool->slots) : 0;
+}
+
+void priskv_rdma_conn_close(priskv_rdma_conn *client)
 {
-    PRISKV_RDMA_DEF_ADDR(client->cm_id)
+    PRISKV_RDMA_CONN_ADDR(client)
     priskv_log_notice(
-        "RDMA: <%s - %s> close. Requests GET %ld, SET %ld, TEST %ld, DELETE %ld, Responses %ld\n",
-        local_addr, peer_addr, client->c.stats[PRISKV_COMMAND_GET].ops,
+        "%s: <%s - %s> close. Requests GET %ld, SET %ld, TEST %ld, DELETE %ld, Responses %ld\n",
+        client->ops->name, local_addr, peer_addr, client->c.stats[PRISKV_COMMAND_GET].ops,
         client->c.stats[PRISKV_COMMAND_SET].ops, client->c.stats[PRISKV_COMMAND_TEST].ops,
         client->c.stats[PRISKV_COMMAND_DELETE].ops, client->c.resps);
 
+    if (!client->c.thread) {
+        return;
+    }
+
+    priskv_thread_call_function(client->c.thread, priskv_rdma_qos_detach, client);
+    priskv_thread_call_function(client->c.thread, priskv_tiering_drop_space_waiters, client);
+    /* a GET woken meanwhile is resumed in the thread, sleep between the retries to let it run */
+    for (uint32_t retries = 1;
+         priskv_thread_call_function(client->c.thread, priskv_rdma_unpark_gets, client);
+         retries++) {
+        if (retries == PRISKV_RDMA_UNPARK_WARN_RETRIES) {
+            priskv_log_warn("%s: <%s - %s> still waiting for parked GETs to resume\n",
+                            client->ops->name, local_addr, peer_addr);
+        }
+        usleep(PRISKV_RDMA_UNPARK_RETRY_US);
+    }
+    client->c.thread = NULL;
+}
+
+void priskv_rdma_conn_free(priskv_rdma_conn *conn)
+{
+    priskv_rdma_free_ctrl_buffer(conn);
+    free(conn);
+}
+
+static void priskv_rdma_close_client(priskv_rdma_conn *client)
+{
     if ((client->comp_channel) && (client->c.thread != NULL)) {
         priskv_thread_del_event_handler(client->c.thread, client->comp_channel->fd);
+        priskv_rdma_conn_close(client);
         priskv_set_fd_handler(client->comp_channel->fd, NULL, NULL, NULL); /* clear fd handler */
-        client->c.thread = NULL;
+    } else {
+        priskv_rdma_conn_close(client);
     }
 
     if (client->cm_id && client->cm_id->qp) {
@@ -504,7 +1026,7 @@ static void priskv_rdma_close_client(priskv_rdma_conn *client)
 
 static void priskv_rdma_close_client_async(priskv_rdma_conn *client)
 {
-    PRISKV_RDMA_DEF_ADDR(client->cm_id);
+    PRISKV_RDMA_CONN_ADDR(client)
 
     /* avoid re-entry of closing client:
      * - CQ error
@@ -519,7 +1041,18 @@ static void priskv_rdma_close_client_async(priskv_rdma_conn *client)
     client->c.closing = true;
     pthread_spin_unlock(&client->lock);
 
-    priskv_log_notice("RDMA: <%s - %s> async close client\n", local_addr, peer_addr);
+    priskv_log_notice("%s: <%s - %s> async close client\n", client->ops->name, local_addr,
+                      peer_addr);
+
+    /* the main thread of verbs finds the closing clients by itself */
+    if (client->ops->close) {
+        client->ops->close(client);
+    }
+}
+
+void priskv_rdma_conn_close_async(priskv_rdma_conn *conn)
+{
+    priskv_rdma_close_client_async(conn);
 }
 
 static void priskv_rdma_close_disconnected(priskv_rdma_conn *listener)
@@ -545,45 +1078,64 @@ static void priskv_rdma_close_disconnected(priskv_rdma_conn *listener)
 
 static priskv_response *priskv_rdma_unused_response(priskv_rdma_conn *conn)
 {
-    uint16_t resp_buf_size = sizeof(priskv_response);
+    uint32_t resp_buf_size = priskv_rdma_response_size(conn);
     priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
+    int64_t i = priskv_slots_get(&conn->resp_slots);
 
-    for (uint16_t i = 0; i < priskv_rdma_wr_size(conn); i++) {
+    if (i >= 0) {
         priskv_response *resp = (priskv_response *)(rmem->buf + i * resp_buf_size);
-        if (resp->status == PRISKV_RDMA_RESPONSE_FREE_STATUS) {
-            priskv_log_debug("RDMA: use response %d\n", i);
-            resp->status = PRISKV_RESP_STATUS_OK;
-            return resp;
-        }
+        assert(resp->status == PRISKV_RDMA_RESPONSE_FREE_STATUS);
+        priskv_log_debug("RDMA: use response %ld\n", i);
+        resp->status = PRISKV_RESP_STATUS_OK;
+        return resp;
     }
 
-    PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+    PRISKV_RDMA_CONN_ADDR(conn)
     priskv_log_error("RDMA: <%s - %s> inflight response exceeds %d\n", local_addr, peer_addr,
                    priskv_rdma_wr_size(conn));
     return NULL;
 }
 
-static int priskv_rdma_send_response(priskv_rdma_conn *conn, uint64_t request_id,
-                                   priskv_resp_status status, uint32_t length)
+/* requests received but not answered yet, waiting for QoS, tiering backend or a SET in process */
+static uint32_t priskv_rdma_waiting(priskv_rdma_conn *conn)
 {
-    priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
-    struct ibv_send_wr wr = {0}, *bad_wr;
-    struct ibv_sge rsge;
-    priskv_response *resp;
+    return priskv_slots_inuse(&conn->treq_pool.slots) +
+           priskv_slots_inuse(&conn->pget_pool.slots) + priskv_qos_queue_len(&conn->c.qos_queue);
+}
 
-    resp = priskv_rdma_unused_response(conn);
-    if (!resp) {
-        return -EPROTO;
+/*
+ * the credits granted to client. Shrink on the backlog of connection, and scale down linearly once
+ * the value memory is used over the threshold. A burst just received is not backlog, only the
+ * requests still waiting since the previous pass of priskv_rdma_handle_cq count.
+ */
+static uint16_t priskv_rdma_credits(priskv_rdma_conn *conn)
+{
+    uint32_t credits = conn->conn_cap.max_inflight_command;
+    uint32_t backlog;
+    uint64_t blocks, inuse, free_percent;
+
+    blocks = priskv_get_value_blocks(conn->kv);
+    inuse = priskv_get_value_blocks_inuse(conn->kv);
+    if (blocks && (inuse * 100 > blocks * PRISKV_RDMA_CREDIT_MEM_PERCENT)) {
+        free_percent = (blocks - inuse) * 100 / blocks;
+        credits = credits * free_percent / (100 - PRISKV_RDMA_CREDIT_MEM_PERCENT);
     }
 
-    assert(((uint8_t *)resp >= rmem->buf) && ((uint8_t *)resp < rmem->buf + rmem->buf_size));
+    backlog = priskv_min_u32(conn->c.backlog, priskv_rdma_waiting(conn));
+    credits = credits > backlog ? credits - backlog : 0;
 
-    resp->request_id = request_id; /* be64 */
-    resp->status = htobe16(status);
-    resp->length = htobe32(length);
+    return priskv_max_u32(credits, PRISKV_RDMA_MIN_CREDITS);
+}
+
+/* send @len bytes of @resp by IBV_WR_SEND, freed on the completion */
+static int priskv_rdma_verbs_send(priskv_rdma_conn *conn, priskv_response *resp, uint32_t len)
+{
+    priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
+    struct ibv_send_wr wr = {0}, *bad_wr;
+    struct ibv_sge rsge;
 
     rsge.addr = (uint64_t)resp;
-    rsge.length = sizeof(priskv_response);
+    rsge.length = len;
     rsge.lkey = rmem->mr->lkey;
 
     wr.wr_id = (uint64_t)resp;
@@ -591,58 +1143,140 @@ static int priskv_rdma_send_response(priskv_rdma_conn *conn, uint64_t request_id
     wr.num_sge = 1;
     wr.opcode = IBV_WR_SEND;
     wr.send_flags = IBV_SEND_SIGNALED;
+    if (rsge.length <= conn->max_inline_data) {
+        wr.send_flags |= IBV_SEND_INLINE;
+    }
 
     int ret = ibv_post_send(conn->cm_id->qp, &wr, &bad_wr);
     if (ret) {
-        PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+        PRISKV_RDMA_CONN_ADDR(conn)
         priskv_log_error(
             "RDMA: <%s - %s> ibv_post_send response failed: addr 0x%lx, length 0x%x ret %d\n",
             local_addr, peer_addr, rsge.addr, rsge.length, ret);
-    } else {
-        conn->c.resps++;
     }
 
     return ret;
 }
 
-static int priskv_rdma_rw_req(priskv_rdma_conn *conn, priskv_request *req, struct ibv_mr *mr,
-                            uint8_t *val, uint32_t valuelen, bool set, void (*cb)(void *),
-                            void *cbarg, bool defer_resp, priskv_rdma_rw_work **work_out)
+/* post a response got from @priskv_rdma_unused_response, @inline_len bytes value follow it */
+static int priskv_rdma_post_response(priskv_rdma_conn *conn, priskv_response *resp,
+                                   uint64_t request_id, priskv_resp_status status, uint32_t length,
+                                   uint32_t inline_len)
 {
-    priskv_rdma_rw_work *work;
-    uint32_t offset = 0;
-    struct ibv_send_wr wr = {0}, *bad_wr;
-    struct ibv_sge sge;
-    uint16_t nsgl = be16toh(req->nsgl);
-    const char *cmdstr = set ? "READ" : "WRITE";
-
-    if (work_out) {
-        *work_out = NULL;
-    }
+    priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_RESP];
 
-    work = calloc(1, sizeof(priskv_rdma_rw_work));
-    if (!work) {
-        priskv_log_error("RDMA: failed to allocate memory for %s request\n", cmdstr);
-        return -ENOMEM;
-    }
+    assert(((uint8_t *)resp >= rmem->buf) && ((uint8_t *)resp < rmem->buf + rmem->buf_size));
+    assert(inline_len <= priskv_rdma_response_size(conn) - sizeof(priskv_response));
 
-    work->conn = conn;
-    work->req = req;
-    work->mr = mr;
-    work->request_id = req->request_id; /* be64 */
-    work->valuelen = valuelen;
-    work->completed = 0;
-    work->cb = cb;
-    work->cbarg = cbarg;
-    work->defer_resp = defer_resp;
+    resp->request_id = request_id; /* be64 */
+    resp->status = htobe16(status);
+    resp->length = htobe32(length);
+    resp->credits = htobe16(priskv_rdma_credits(conn));
+
+    int ret = conn->ops->send(conn, resp, sizeof(priskv_response) + inline_len);
+    if (!ret) {
+        conn->c.resps++;
+    }
+
+    return ret;
+}
+
+static int priskv_rdma_send_response(priskv_rdma_conn *conn, uint64_t request_id,
+                                   priskv_resp_status status, uint32_t length)
+{
+    priskv_response *resp;
+
+    resp = priskv_rdma_unused_response(conn);
+    if (!resp) {
+        return -EPROTO;
+    }
+
+    return priskv_rdma_post_response(conn, resp, request_id, status, length, 0);
+}
+
+static int priskv_rdma_handle_rw(priskv_rdma_conn *conn, priskv_rdma_rw_work *work);
+
+/* PRISKV_REQUEST_FLAG_INLINE: copy the value within SEND payload, no RDMA READ/WRITE at all */
+static int priskv_rdma_inline_rw(priskv_rdma_conn *conn, priskv_rdma_rw_work *work, uint8_t *val,
+                               bool set)
+{
+    priskv_request *req = work->req;
+
+    if (set) {
+        uint8_t *inline_val = priskv_request_inline_value(req, be16toh(req->nsgl),
+                                                          be16toh(req->key_length));
+        memcpy(val, inline_val, work->valuelen);
+    } else {
+        /* copy value before @work->cb releases the key */
+        work->inline_resp = priskv_rdma_unused_response(conn);
+        if (!work->inline_resp) {
+            return -EPROTO;
+        }
+
+        memcpy(priskv_response_inline_value(work->inline_resp), val, work->valuelen);
+    }
+
+    priskv_log_debug("RDMA: inline %s wr_id 0x%lx, val %p, length 0x%x\n", set ? "READ" : "WRITE",
+                   (uint64_t)work, val, work->valuelen);
+
+    work->nsgl = 1;
+    return 0;
+}
+
+static priskv_qos_class priskv_rdma_qos_class(priskv_request *req)
+{
+    switch (be16toh(req->command)) {
+    case PRISKV_COMMAND_KEYS:
+    case PRISKV_COMMAND_NRKEYS:
+    case PRISKV_COMMAND_FLUSH:
+        /* scan the whole KV, never delay the others */
+        return PRISKV_QOS_CLASS_LOW;
+    }
+
+    switch (req->priority) {
+    case PRISKV_REQUEST_PRIORITY_HIGH:
+        return PRISKV_QOS_CLASS_HIGH;
+    case PRISKV_REQUEST_PRIORITY_LOW:
+        return PRISKV_QOS_CLASS_LOW;
+    default:
+        return PRISKV_QOS_CLASS_NORMAL;
+    }
+}
+
+/* the cost of a request is the bytes of value, the request is not validated yet */
+static uint32_t priskv_rdma_qos_cost(priskv_rdma_conn *conn, priskv_request *req, uint32_t len)
+{
+    uint16_t nsgl = be16toh(req->nsgl);
+    uint32_t bytes = 0;
+
+    if (req->flags & PRISKV_REQUEST_FLAG_INLINE) {
+        bytes = len;
+    } else if ((nsgl <= conn->conn_cap.max_sgl) && (len >= priskv_request_key_off(nsgl))) {
+        bytes = priskv_sgl_size_from_be(req->sgls, nsgl);
+    }
+
+    return priskv_min_u32(bytes, UINT32_MAX - PRISKV_QOS_MIN_COST) + PRISKV_QOS_MIN_COST;
+}
+
+/* post RDMA READ/WRITE of @req, @work completes once all of them complete */
+static int priskv_rdma_verbs_rw(priskv_rdma_conn *conn, priskv_rdma_rw_work *work,
+                                priskv_request *req, uint8_t *val, uint32_t valuelen, bool set)
+{
+    struct ibv_mr *mr = work->rmem ? work->rmem->mr : NULL;
+    uint32_t offset = 0;
+    struct ibv_send_wr wr = {0}, *bad_wr;
+    struct ibv_sge sges[PRISKV_RDMA_MAX_VALUE_SGE];
+    uint32_t length;
+    uint16_t nsgl = be16toh(req->nsgl);
+    const char *cmdstr = set ? "READ" : "WRITE";
 
     wr.wr_id = (uint64_t)work;
     wr.next = NULL;
-    wr.sg_list = &sge;
-    wr.num_sge = 1;
+    wr.sg_list = sges;
     wr.opcode = set ? IBV_WR_RDMA_READ : IBV_WR_RDMA_WRITE;
     wr.send_flags = IBV_SEND_SIGNALED;
 
+    work->nsgl = 0;
     for (uint16_t i = 0; i < nsgl; i++) {
         priskv_keyed_sgl *sgl = &req->sgls[i];
 
@@ -653,25 +1287,24 @@ static int priskv_rdma_rw_req(priskv_rdma_conn *conn, priskv_request *req, struc
         do {
             wr.wr.rdma.remote_addr = be64toh(sgl->addr) + sgl_offset;
 
-            sge.addr = (uint64_t)val + offset + sgl_offset;
-            sge.lkey = mr->lkey;
-            sge.length = priskv_min_u32(sgl_length - sgl_offset, valuelen);
-            sge.length = priskv_min_u32(sge.length, priskv_rdma_max_rw_size);
+            length = priskv_min_u32(sgl_length - sgl_offset, valuelen);
+            length = priskv_min_u32(length, priskv_rdma_max_rw_size);
+            length = priskv_rdma_fill_sges(conn, mr, val + offset + sgl_offset, length, sges,
+                                           &wr.num_sge);
 
             if (ibv_post_send(conn->cm_id->qp, &wr, &bad_wr)) {
-                PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+                PRISKV_RDMA_CONN_ADDR(conn)
                 priskv_log_error("RDMA: <%s - %s> ibv_post_send RDMA failed: %m\n", local_addr,
                                peer_addr);
-                free(work);
                 return -errno;
             }
 
-            priskv_log_debug("RDMA: %s [%d/%d]:[%d/%d] wr_id 0x%lx, val %p, length 0x%x, addr 0x%lx, "
-                           "rkey 0x%x\n",
+            priskv_log_debug("RDMA: %s [%d/%d]:[%d/%d] wr_id 0x%lx, val %p, length 0x%x, nsge %d, "
+                           "addr 0x%lx, rkey 0x%x\n",
                            cmdstr, i, nsgl, sgl_offset, sgl_length, wr.wr_id,
-                           val + offset + sgl_offset, sge.length, wr.wr.rdma.remote_addr,
+                           val + offset + sgl_offset, length, wr.num_sge, wr.wr.rdma.remote_addr,
                            wr.wr.rdma.rkey);
-            sgl_offset += sge.length;
+            sgl_offset += length;
 
             work->nsgl++;
         } while (sgl_offset < priskv_min_u32(sgl_length, valuelen));
@@ -680,15 +1313,86 @@ static int priskv_rdma_rw_req(priskv_rdma_conn *conn, priskv_request *req, struc
         valuelen -= sgl_length;
     }
 
+    return 0;
+}
+
+/*
+ * move the value of @req between [@val, @val + @valuelen) and client, then @cb runs. @abort runs
+ * instead if the connection closes before the value of SET arrives, NULL to run @cb anyway.
+ */
+static int priskv_rdma_rw_req(priskv_rdma_conn *conn, priskv_request *req, priskv_rdma_mem *rmem,
+                            uint8_t *val, uint32_t valuelen, bool set, void (*cb)(void *),
+                            void (*abort)(void *), void *cbarg, bool defer_resp,
+                            priskv_rdma_rw_work **work_out)
+{
+    priskv_rdma_rw_work *work;
+    const char *cmdstr = set ? "READ" : "WRITE";
+
+    if (work_out) {
+        *work_out = NULL;
+    }
+
+    work = priskv_pool_get(&conn->work_pool);
+    if (!work) {
+        PRISKV_RDMA_CONN_ADDR(conn)
+        priskv_log_error("RDMA: <%s - %s> no context for %s request\n", local_addr, peer_addr,
+                         cmdstr);
+        return -ENOMEM;
+    }
+
+    memset(work, 0x00, sizeof(priskv_rdma_rw_work));
+    work->conn = conn;
+    work->req = req;
+    work->rmem = rmem;
+    work->request_id = req->request_id; /* be64 */
+    work->valuelen = valuelen;
+    work->completed = 0;
+    work->cb = cb;
+    work->abort = abort;
+    work->cbarg = cbarg;
+    work->defer_resp = defer_resp;
+
+    /* the work may complete synchronously, @cb may run before returning. The failure of response
+     * is reported later, so do not let the caller clean up @work again */
     if (work_out) {
         *work_out = work;
     }
 
+    if (req->flags & PRISKV_REQUEST_FLAG_INLINE) {
+        if (priskv_rdma_inline_rw(conn, work, val, set)) {
+            priskv_pool_put(&conn->work_pool, work);
+            if (work_out) {
+                *work_out = NULL;
+            }
+            return -EPROTO;
+        }
+
+        priskv_rdma_handle_rw(conn, work);
+        return 0;
+    }
+
+    /* the bytes in flight are limited by the budget of class */
+    work->qos_class = priskv_rdma_qos_class(req);
+    work->qos_bytes = valuelen;
+    conn->c.qos_charged[work->qos_class] += valuelen;
+    priskv_qos_charge(priskv_rdma_qos(conn), work->qos_class, valuelen);
+
+    /* a stream transport completes the work once */
+    work->nsgl = 1;
+    int ret = conn->ops->rw(conn, work, req, val, valuelen, set);
+    if (ret) {
+        conn->c.qos_charged[work->qos_class] -= valuelen;
+        priskv_qos_uncharge(priskv_rdma_qos(conn), work->qos_class, valuelen);
+        priskv_pool_put(&conn->work_pool, work);
+        if (work_out) {
+            *work_out = NULL;
+        }
+        return ret;
+    }
+
     return 0;
 }
 
-static int priskv_rdma_recv_req(priskv_rdma_conn *conn, uint8_t *req);
-
 static int priskv_rdma_complete_rw_work(priskv_rdma_rw_work *work, priskv_resp_status status,
                                    uint32_t length);
 
@@ -703,7 +1407,7 @@ static void priskv_tiering_req_repost_recv(priskv_tiering_req *treq)
         return;
     }
 
-    priskv_rdma_recv_req(treq->conn, (uint8_t *)treq->req);
+    treq->conn->ops->recv(treq->conn, treq->req);
 
     treq->recv_reposted = true;
 }
@@ -714,8 +1418,7 @@ static void priskv_tiering_req_free(priskv_tiering_req *treq)
         return;
     }
 
-    free(treq->key);
-    free(treq);
+    priskv_pool_put(&treq->conn->treq_pool, treq);
 }
 
 static priskv_tiering_req *priskv_tiering_req_new(priskv_rdma_conn *conn, priskv_request *req,
@@ -724,14 +1427,10 @@ static priskv_tiering_req *priskv_tiering_req_new(priskv_rdma_conn *conn, priskv
                                                  priskv_resp_status *resp_status)
 {
     priskv_resp_status status = PRISKV_RESP_STATUS_NO_MEM;
-    priskv_tiering_req *treq = calloc(1, sizeof(priskv_tiering_req));
+    priskv_tiering_req *treq = NULL;
     priskv_thread *thread = NULL;
     priskv_backend_device *backend = NULL;
 
-    if (!treq) {
-        goto error;
-    }
-
     thread = conn->c.thread;
     backend = priskv_get_thread_backend(thread);
     if (!backend) {
@@ -740,10 +1439,14 @@ static priskv_tiering_req *priskv_tiering_req_new(priskv_rdma_conn *conn, priskv
         goto error;
     }
 
-    treq->key = malloc(keylen + 1);
-    if (!treq->key) {
+    /* @keylen is limited by max_key_length already */
+    treq = priskv_pool_get(&conn->treq_pool);
+    if (!treq) {
         goto error;
     }
+
+    memset(treq, 0x00, sizeof(priskv_tiering_req));
+    treq->key = treq->keybuf;
     memcpy(treq->key, key, keylen);
     treq->key[keylen] = '\0';
 
@@ -770,8 +1473,6 @@ static priskv_tiering_req *priskv_tiering_req_new(priskv_rdma_conn *conn, priskv
     return treq;
 
 error:
-    free(treq->key);
-    free(treq);
     if (resp_status) {
         *resp_status = status;
     }
@@ -848,16 +1549,23 @@ static void priskv_tiering_get_backend_cb(priskv_backend_status backend_status,
         // there are value buf and valuelen in treq, here just use priskv_get_key to inc ref of keynode
         priskv_get_key(treq->kv, treq->key, treq->keylen, &val, &cached_length, &keynode);
         assert(keynode == treq->keynode);
-        
+
+        resp_status = priskv_request_range(treq->req, treq->remote_valuelen, &treq->value,
+                                           &treq->valuelen);
+        if (resp_status != PRISKV_RESP_STATUS_OK) {
+            priskv_get_key_end(keynode);
+            priskv_tiering_finish(treq, resp_status, treq->valuelen);
+            return;
+        }
+
         // Relaunch the next request to allow multiple GETs to execute in parallel
         if (treq->execute) {
             priskv_key_serialize_exit(treq);
             treq->execute = false;
         }
 
-        if (priskv_rdma_rw_req(treq->conn, treq->req, treq->conn->value_mr, treq->value,
-                             treq->valuelen, false, priskv_tiering_get_rdma_complete_cb, treq, false,
-                             NULL)) {
+        if (priskv_rdma_rw_req(treq->conn, treq->req, NULL, treq->value, treq->valuelen, false,
+                               priskv_tiering_get_rdma_complete_cb, NULL, treq, false, NULL)) {
             priskv_tiering_finish(treq, PRISKV_RESP_STATUS_SERVER_ERROR, 0);
             return;
         }
@@ -879,53 +1587,86 @@ static void priskv_tiering_get_backend_cb(priskv_backend_status backend_status,
     return;
 }
 
+static void priskv_tiering_range_test_backend_cb(priskv_backend_status status, uint32_t valuelen,
+                                                 void *arg);
+
 void priskv_tiering_get(priskv_tiering_req *treq)
 {
 
     priskv_resp_status status;
     uint8_t *val = NULL;
-    uint32_t valuelen = 0;
+    uint32_t valuelen = 0, fetch_valuelen;
     void *keynode = NULL;
 
     assert(treq);
 
-    if (!treq->execute) {
-        if (!priskv_key_serialize_enter(treq)) {
+    /*
+     * a shared GET reads the value fetched by another GET without serialization. A GET failing to
+     * enter is either shared by priskv_key_serialize_enter, or queued to resume later.
+     */
+    if (!treq->execute && !treq->shared) {
+        treq->execute = priskv_key_serialize_enter(treq);
+        if (!treq->execute && !treq->shared) {
             return;
         }
-        treq->execute = true;
     }
 
     // In tiering mode, priskv_get_key will not return HPKV_RESP_STATUS_KEY_UPDATING
     status = priskv_get_key(treq->kv, treq->key, treq->keylen, &val, &valuelen, &keynode);
     if (status == PRISKV_RESP_STATUS_OK && keynode) {
-        treq->value = val;
-        treq->valuelen = valuelen;
         treq->keynode = keynode;
 
-        if (treq->remote_valuelen < treq->valuelen) {
-            priskv_tiering_finish(treq, PRISKV_RESP_STATUS_VALUE_TOO_BIG, treq->valuelen);
+        status = priskv_request_range(treq->req, treq->remote_valuelen, &val, &valuelen);
+        if (status != PRISKV_RESP_STATUS_OK) {
+            priskv_get_key_end(keynode);
+            priskv_tiering_finish(treq, status, valuelen);
             return;
         }
-        
-        if (priskv_rdma_rw_req(treq->conn, treq->req, treq->conn->value_mr, treq->value,
-                             treq->valuelen, false, priskv_tiering_get_rdma_complete_cb, treq, false,
-                             NULL)) {
+
+        treq->value = val;
+        treq->valuelen = valuelen;
+
+        if (treq->remote_valuelen < treq->valuelen) {
             priskv_get_key_end(keynode);
-            priskv_tiering_finish(treq, PRISKV_RESP_STATUS_SERVER_ERROR, 0);
+            priskv_tiering_finish(treq, PRISKV_RESP_STATUS_VALUE_TOO_BIG, treq->valuelen);
             return;
         }
 
-        // Relaunch the next request to allow multiple GETs to execute in parallel
+        // Relaunch the next request to allow multiple GETs to execute in parallel. Do it before
+        // RDMA WRITE, an inline GET completes (and frees @treq) synchronously.
         if (treq->execute) {
             priskv_key_serialize_exit(treq);
             treq->execute = false;
         }
 
+        if (priskv_rdma_rw_req(treq->conn, treq->req, NULL, treq->value, treq->valuelen, false,
+                               priskv_tiering_get_rdma_complete_cb, NULL, treq, false, NULL)) {
+            priskv_get_key_end(keynode);
+            priskv_tiering_finish(treq, PRISKV_RESP_STATUS_SERVER_ERROR, 0);
+            return;
+        }
+
         return;
     }
 
-    status = priskv_set_key(treq->kv, treq->key, treq->keylen, &val, treq->remote_valuelen, treq->timeout,
+    if (treq->shared) {
+        /* the fetch failed or the value got evicted meanwhile, fetch it by itself */
+        priskv_get_key_end(keynode);
+        treq->shared = false;
+        treq->unshared = true;
+        priskv_tiering_get(treq);
+        return;
+    }
+
+    /* a range is served from the whole value in memory, learn its length from backend first */
+    if ((treq->req->flags & PRISKV_REQUEST_FLAG_RANGE) && !treq->fetch_valuelen) {
+        priskv_backend_test(treq->backend, (const char *)treq->key,
+                            priskv_tiering_range_test_backend_cb, treq);
+        return;
+    }
+    fetch_valuelen = treq->fetch_valuelen ? treq->fetch_valuelen : treq->remote_valuelen;
+
+    status = priskv_set_key(treq->kv, treq->key, treq->keylen, &val, fetch_valuelen, treq->timeout,
                           &keynode);
     
     // no other requests can access this keynode, for simplicity's sake, execute priskv_set_key_end here.
@@ -945,10 +1686,39 @@ void priskv_tiering_get(priskv_tiering_req *treq)
         return;
     }
 
-    priskv_backend_get(treq->backend, (const char *)treq->key, treq->value, treq->remote_valuelen,
+    priskv_backend_get(treq->backend, (const char *)treq->key, treq->value, fetch_valuelen,
                      priskv_tiering_get_backend_cb, treq);
 }
 
+/* a range GET missed the memory, fetch the whole value of the length found in backend */
+static void priskv_tiering_range_test_backend_cb(priskv_backend_status status, uint32_t valuelen,
+                                                 void *arg)
+{
+    priskv_tiering_req *treq = arg;
+    priskv_resp_status resp_status;
+
+    treq->backend_status = status;
+
+    switch (status) {
+    case PRISKV_BACKEND_STATUS_OK:
+        if (valuelen) {
+            treq->fetch_valuelen = valuelen;
+            priskv_tiering_get(treq);
+            return;
+        }
+        resp_status = PRISKV_RESP_STATUS_SERVER_ERROR;
+        break;
+    case PRISKV_BACKEND_STATUS_NOT_FOUND:
+        resp_status = PRISKV_RESP_STATUS_NO_SUCH_KEY;
+        break;
+    default:
+        resp_status = PRISKV_RESP_STATUS_SERVER_ERROR;
+        break;
+    }
+
+    priskv_tiering_finish(treq, resp_status, 0);
+}
+
 static void priskv_tiering_test_backend_cb(priskv_backend_status status, uint32_t valuelen, void *arg)
 {
     priskv_tiering_req *treq = arg;
@@ -1013,9 +1783,12 @@ static void priskv_tiering_set_backend_cb(priskv_backend_status status, uint32_t
     priskv_resp_status resp_status;
     uint32_t length = 0;
 
-    // here delete new key-value
-    priskv_delete_key(treq->kv, treq->key, treq->keylen);
-    
+    // keep the new key-value in memory on write-through, and never on failure
+    if ((status != PRISKV_BACKEND_STATUS_OK) ||
+        (priskv_backend_tiering_write_mode() == PRISKV_TIERING_WRITE_AROUND)) {
+        priskv_delete_key(treq->kv, treq->key, treq->keylen);
+    }
+
     switch (status) {
     case PRISKV_BACKEND_STATUS_OK:
         resp_status = PRISKV_RESP_STATUS_OK;
@@ -1033,6 +1806,58 @@ static void priskv_tiering_set_backend_cb(priskv_backend_status status, uint32_t
     priskv_tiering_finish(treq, resp_status, length);
 }
 
+static void priskv_tiering_flush_backend_cb(priskv_backend_status status, uint32_t valuelen,
+                                            void *arg)
+{
+    priskv_tiering_req *flush = arg;
+
+    if (status != PRISKV_BACKEND_STATUS_OK) {
+        char key_short[128] = {0};
+        priskv_string_shorten((const char *)flush->key, flush->keylen, key_short,
+                              sizeof(key_short));
+        priskv_log_error("RDMA: write back key[%u] = \"%s\" failed, status %d\n", flush->keylen,
+                         key_short, status);
+    }
+
+    /* evictable since now, even if failed. A failed key is lost once evicted */
+    priskv_set_key_dirty(flush->keynode, false);
+    priskv_get_key_end(flush->keynode);
+    priskv_key_serialize_exit(flush);
+    free(flush);
+}
+
+/*
+ * acknowledge the client, and write the dirty value back by a detached copy of @treq. The copy
+ * keeps the key serialized till written, the GETs read the memory meanwhile.
+ */
+static bool priskv_tiering_write_back(priskv_tiering_req *treq)
+{
+    size_t size = sizeof(priskv_tiering_req) + treq->keylen + 1;
+    priskv_tiering_req *flush = malloc(size);
+
+    if (!flush) {
+        return false;
+    }
+
+    memcpy(flush, treq, size);
+    flush->key = flush->keybuf;
+    flush->conn = NULL;
+    flush->req = NULL;
+    flush->rdma_work = NULL;
+    list_node_init(&flush->node);
+
+    priskv_reserve_key(flush->keynode);
+    priskv_set_key_dirty(flush->keynode, true);
+    priskv_key_serialize_handover(treq, flush);
+    treq->execute = false;
+    priskv_tiering_finish(treq, PRISKV_RESP_STATUS_OK, treq->valuelen);
+
+    priskv_backend_set(flush->backend, (const char *)flush->key, flush->value,
+                       flush->remote_valuelen, flush->timeout, priskv_tiering_flush_backend_cb,
+                       flush);
+    return true;
+}
+
 static void priskv_tiering_set_rdma_complete_cb(void *arg)
 {
     priskv_tiering_req *treq = arg;
@@ -1048,11 +1873,174 @@ static void priskv_tiering_set_rdma_complete_cb(void *arg)
         priskv_tiering_finish(treq, PRISKV_RESP_STATUS_SERVER_ERROR, 0);
         return;
     }
-    
+
+    /* written to backend once evicted, see priskv_tiering_demote */
+    if (priskv_backend_tiering_write_mode() == PRISKV_TIERING_WRITE_DEMOTE) {
+        priskv_set_key_dirty(treq->keynode, true);
+        priskv_tiering_finish(treq, PRISKV_RESP_STATUS_OK, treq->valuelen);
+        return;
+    }
+
+    /* fall back to write-through on no memory */
+    if ((priskv_backend_tiering_write_mode() == PRISKV_TIERING_WRITE_BACK) &&
+        priskv_tiering_write_back(treq)) {
+        return;
+    }
+
     priskv_backend_set(treq->backend, (const char *)treq->key, treq->value, treq->remote_valuelen,
                      treq->timeout, priskv_tiering_set_backend_cb, treq);
 }
 
+/* the value never arrives on closing, drop the half-written key */
+static void priskv_tiering_set_abort_cb(void *arg)
+{
+    priskv_tiering_req *treq = arg;
+
+    priskv_set_key_abort(treq->keynode);
+    priskv_tiering_finish(treq, PRISKV_RESP_STATUS_SERVER_ERROR, 0);
+}
+
+void priskv_tiering_set(priskv_tiering_req *treq);
+
+static __thread uint32_t priskv_tiering_demotions;
+/* the SETs of an iothread out of memory, retried once a demotion completes */
+static __thread struct list_head priskv_tiering_space_waiters;
+#define PRISKV_TIERING_SET_SPACE_WAITS 4
+
+static struct list_head *priskv_tiering_space_waiters_head(void)
+{
+    if (!priskv_tiering_space_waiters.n.next) {
+        list_head_init(&priskv_tiering_space_waiters);
+    }
+
+    return &priskv_tiering_space_waiters;
+}
+
+/* return true if the SET waits for the demotions in flight to free some memory */
+static bool priskv_tiering_wait_space(priskv_tiering_req *treq)
+{
+    if ((priskv_backend_tiering_write_mode() != PRISKV_TIERING_WRITE_DEMOTE) ||
+        !priskv_tiering_demotions || (treq->space_waits >= PRISKV_TIERING_SET_SPACE_WAITS)) {
+        return false;
+    }
+
+    treq->space_waits++;
+    list_add_tail(priskv_tiering_space_waiters_head(), &treq->space_node);
+    return true;
+}
+
+/* retry the waiting SETs, a SET still out of memory waits again or fails */
+static void priskv_tiering_retry_space_waiters(void)
+{
+    struct list_head waiters;
+    priskv_tiering_req *treq;
+
+    list_head_init(&waiters);
+    list_append_list(&waiters, priskv_tiering_space_waiters_head());
+    while ((treq = list_pop(&waiters, priskv_tiering_req, space_node))) {
+        priskv_tiering_set(treq);
+    }
+}
+
+/* called in the thread of client on closing, drop its SETs waiting for memory */
+static int priskv_tiering_drop_space_waiters(void *arg)
+{
+    priskv_rdma_conn *client = arg;
+    priskv_tiering_req *treq, *tmp;
+
+    list_for_each_safe (priskv_tiering_space_waiters_head(), treq, tmp, space_node) {
+        if (treq->conn == client) {
+            list_del(&treq->space_node);
+            priskv_key_serialize_exit(treq);
+            priskv_tiering_req_free(treq);
+        }
+    }
+
+    return 0;
+}
+
+static void priskv_tiering_demote_backend_cb(priskv_backend_status status, uint32_t valuelen,
+                                             void *arg)
+{
+    priskv_tiering_req *demote = arg;
+
+    if (status != PRISKV_BACKEND_STATUS_OK) {
+        char key_short[128] = {0};
+        priskv_string_shorten((const char *)demote->key, demote->keylen, key_short,
+                              sizeof(key_short));
+        priskv_log_warn("RDMA: demote key[%u] = \"%s\" failed, status %d\n", demote->keylen,
+                        key_short, status);
+    }
+
+    priskv_demote_key_end(demote->keynode, (status == PRISKV_BACKEND_STATUS_OK)
+                                               ? PRISKV_DEMOTE_CLEAN
+                                               : PRISKV_DEMOTE_FAILED);
+    priskv_key_serialize_exit(demote);
+    priskv_tiering_demotions--;
+    free(demote);
+
+    priskv_tiering_retry_space_waiters();
+}
+
+/* called by the eviction of a SET in the iothread, never blocks it */
+void priskv_tiering_demote(void *kv, void *keynode)
+{
+    priskv_thread *thread = priskv_thread_self();
+    priskv_backend_device *backend = priskv_get_thread_backend(thread);
+    priskv_tiering_req *demote;
+    uint8_t *key, *val;
+    uint16_t keylen;
+    uint32_t valuelen;
+    uint64_t timeout;
+
+    /* a dirty key loaded from memfile without backend, nowhere to demote */
+    if (!backend) {
+        priskv_demote_key_end(keynode, priskv_backend_tiering_enabled() ? PRISKV_DEMOTE_SKIPPED
+                                                                        : PRISKV_DEMOTE_CLEAN);
+        return;
+    }
+
+    if (priskv_tiering_demotions >= PRISKV_TIERING_MAX_DEMOTIONS) {
+        goto skip;
+    }
+
+    priskv_get_key_info(keynode, &key, &keylen, &val, &valuelen, &timeout);
+    demote = calloc(1, sizeof(priskv_tiering_req) + keylen + 1);
+    if (!demote) {
+        goto skip;
+    }
+
+    demote->thread = thread;
+    demote->backend = backend;
+    demote->kv = kv;
+    demote->key = demote->keybuf;
+    memcpy(demote->key, key, keylen);
+    demote->keylen = keylen;
+    demote->value = val;
+    demote->remote_valuelen = valuelen;
+    demote->keynode = keynode;
+    demote->timeout = timeout;
+    demote->cmd = PRISKV_COMMAND_SET;
+    demote->execute = true;
+    demote->readable = true;
+    demote->hash_head_index = priskv_crc32(key, keylen) % priskv_get_bucket_count(kv);
+    list_node_init(&demote->node);
+
+    /* a request of the key in flight, demote it on a later eviction */
+    if (!priskv_key_serialize_try_enter(demote)) {
+        free(demote);
+        goto skip;
+    }
+
+    priskv_tiering_demotions++;
+    priskv_backend_set(backend, (const char *)demote->key, val, valuelen, timeout,
+                       priskv_tiering_demote_backend_cb, demote);
+    return;
+
+skip:
+    priskv_demote_key_end(keynode, PRISKV_DEMOTE_SKIPPED);
+}
+
 void priskv_tiering_set(priskv_tiering_req *treq)
 {
     assert(treq);
@@ -1068,14 +2056,19 @@ void priskv_tiering_set(priskv_tiering_req *treq)
     // delete old key-value here
     status = priskv_set_key(treq->kv, treq->key, treq->keylen, &treq->value, treq->remote_valuelen,
                           treq->timeout, &treq->keynode);
+    if ((status == PRISKV_RESP_STATUS_NO_MEM) && priskv_tiering_wait_space(treq)) {
+        return;
+    }
+
     if (status != PRISKV_RESP_STATUS_OK || !treq->keynode) {
         priskv_set_key_end(treq->keynode);
         priskv_tiering_finish(treq, status, 0);
         return;
     }
 
-    if (priskv_rdma_rw_req(treq->conn, treq->req, treq->conn->value_mr, treq->value, treq->remote_valuelen,
-                         true, priskv_tiering_set_rdma_complete_cb, treq, true, &treq->rdma_work)) {
+    if (priskv_rdma_rw_req(treq->conn, treq->req, NULL, treq->value, treq->remote_valuelen, true,
+                           priskv_tiering_set_rdma_complete_cb, priskv_tiering_set_abort_cb, treq,
+                           true, &treq->rdma_work)) {
         priskv_set_key_end(treq->keynode);
         priskv_delete_key(treq->kv, treq->key, treq->keylen);
         priskv_tiering_finish(treq, PRISKV_RESP_STATUS_NO_MEM, 0);
@@ -1086,11 +2079,11 @@ void priskv_tiering_set(priskv_tiering_req *treq)
 static void priskv_tiering_del_backend_cb(priskv_backend_status status, uint32_t valuelen, void *arg)
 {
     priskv_tiering_req *treq = arg;
-    priskv_resp_status resp_status;
+    priskv_resp_status resp_status, mem_status;
 
     assert(treq);
 
-    priskv_delete_key(treq->kv, treq->key, treq->keylen);
+    mem_status = priskv_delete_key(treq->kv, treq->key, treq->keylen);
 
     treq->backend_status = status;
     switch (status) {
@@ -1098,7 +2091,8 @@ static void priskv_tiering_del_backend_cb(priskv_backend_status status, uint32_t
         resp_status = PRISKV_RESP_STATUS_OK;
         break;
     case PRISKV_BACKEND_STATUS_NOT_FOUND:
-        resp_status = PRISKV_RESP_STATUS_NO_SUCH_KEY;
+        /* a dirty key lives in memory only */
+        resp_status = mem_status;
         break;
     case PRISKV_BACKEND_STATUS_ERROR:
     default:
@@ -1150,62 +2144,56 @@ int priskv_backend_req_resubmit(void *req)
 
 static void priskv_check_and_log_slow_query(priskv_rdma_rw_work *work)
 {
-    struct timeval server_resp_send_time;
     priskv_request *req = (priskv_request *)work->req;
+    priskv_request_trace *trace = priskv_rdma_req_trace(work->conn, req);
     uint16_t command = be16toh(req->command);
     uint16_t nsgl = be16toh(req->nsgl);
     uint8_t *key = priskv_request_key(req, nsgl);
     uint16_t keylen = be16toh(req->key_length);
+    uint64_t client_send, server_recv, rw_kv, data_send, data_recv, resp_send;
     char key_short[128] = {0};
-    priskv_string_shorten((const char *)key, keylen, key_short, sizeof(key_short));
-
-    gettimeofday(&server_resp_send_time, NULL);
-    req->runtime.server_resp_send_time = server_resp_send_time;
-    if (priskv_time_elapsed_us(&req->runtime.client_metadata_send_time,
-                             &req->runtime.server_resp_send_time) >
-        g_slow_query_threshold_latency_us) {
-        priskv_log_notice(
-            "Slow Query Encountered . "
-            "Slow Query threshold latency is %ld us |"
-            "Command %s key[%u] = \"%s\" |"
-            "thread id is %lu |"
-            "Client send metadata: %ld.%06ld us | "
-            "Server recv metadata: %ld.%06ld us | "
-            "Server RW KV: %ld.%06ld us | "
-            "Server send data: %ld.%06ld us | "
-            "Server recv data: %ld.%06ld us | "
-            "Server send resp: %ld.%06ld us | "
-            "Total: %ld us | "
-            "Steps: "
-            "Client->Server metadata: %ld us | "
-            "Server metadata->RW KV: %ld us | "
-            "RW KV->Send data: %ld us | "
-            "Send data->Recv data: %ld us | "
-            "Recv data->Resp send: %ld us \n",
-
-            g_slow_query_threshold_latency_us, priskv_command_str(command), keylen, key_short,
-            pthread_self(), req->runtime.client_metadata_send_time.tv_sec,
-            req->runtime.client_metadata_send_time.tv_usec,
-            req->runtime.server_metadata_recv_time.tv_sec,
-            req->runtime.server_metadata_recv_time.tv_usec, req->runtime.server_rw_kv_time.tv_sec,
-            req->runtime.server_rw_kv_time.tv_usec, req->runtime.server_data_send_time.tv_sec,
-            req->runtime.server_data_send_time.tv_usec, req->runtime.server_data_recv_time.tv_sec,
-            req->runtime.server_data_recv_time.tv_usec, req->runtime.server_resp_send_time.tv_sec,
-            req->runtime.server_resp_send_time.tv_usec,
-
-            priskv_time_elapsed_us(&req->runtime.client_metadata_send_time,
-                                 &req->runtime.server_resp_send_time),
-
-            priskv_time_elapsed_us(&req->runtime.client_metadata_send_time,
-                                 &req->runtime.server_metadata_recv_time),
-            priskv_time_elapsed_us(&req->runtime.server_metadata_recv_time,
-                                 &req->runtime.server_rw_kv_time),
-            priskv_time_elapsed_us(&req->runtime.server_rw_kv_time,
-                                 &req->runtime.server_data_send_time),
-            priskv_time_elapsed_us(&req->runtime.server_data_send_time,
-                                 &req->runtime.server_data_recv_time),
-            priskv_time_elapsed_us(&req->runtime.server_data_recv_time,
-                                 &req->runtime.server_resp_send_time));
+
+    /* only the sampled requests are traced */
+    if (!trace) {
+        return;
+    }
+
+    priskv_request_trace_stamp(&trace->server_resp_send);
+    client_send = be64toh(trace->client_metadata_send);
+    server_recv = be64toh(trace->server_metadata_recv);
+    rw_kv = be64toh(trace->server_rw_kv);
+    data_send = be64toh(trace->server_data_send);
+    data_recv = be64toh(trace->server_data_recv);
+    resp_send = be64toh(trace->server_resp_send);
+    if ((long)(resp_send - client_send) > g_slow_query_threshold_latency_us) {
+        priskv_string_shorten((const char *)key, keylen, key_short, sizeof(key_short));
+        priskv_log_notice("Slow Query Encountered . "
+                          "Slow Query threshold latency is %ld us |"
+                          "Command %s key[%u] = \"%s\" |"
+                          "thread id is %lu |"
+                          "Client send metadata: %ld us | "
+                          "Server recv metadata: %ld us | "
+                          "Server RW KV: %ld us | "
+                          "Server send data: %ld us | "
+                          "Server recv data: %ld us | "
+                          "Server send resp: %ld us | "
+                          "Total: %ld us | "
+                          "Steps: "
+                          "Client->Server metadata: %ld us | "
+                          "Server metadata->RW KV: %ld us | "
+                          "RW KV->Send data: %ld us | "
+                          "Send data->Recv data: %ld us | "
+                          "Recv data->Resp send: %ld us \n",
+
+                          g_slow_query_threshold_latency_us, priskv_command_str(command), keylen,
+                          key_short, pthread_self(), client_send, server_recv, rw_kv, data_send,
+                          data_recv, resp_send,
+
+                          (long)(resp_send - client_send),
+
+                          (long)(server_recv - client_send), (long)(rw_kv - server_recv),
+                          (long)(data_send - rw_kv), (long)(data_recv - data_send),
+                          (long)(resp_send - data_recv));
     }
 }
 
@@ -1218,25 +2206,41 @@ static int priskv_rdma_complete_rw_work(priskv_rdma_rw_work *work, priskv_resp_s
     }
 
     priskv_rdma_conn *conn = work->conn;
+    int ret;
 
-    int ret = priskv_rdma_send_response(conn, work->request_id, status, length);
+    if (work->responded) {
+        ret = 0;
+    } else if (work->inline_resp) {
+        uint32_t inline_len = (status == PRISKV_RESP_STATUS_OK) ? work->valuelen : 0;
+        ret = priskv_rdma_post_response(conn, work->inline_resp, work->request_id, status, length,
+                                        inline_len);
+    } else {
+        ret = priskv_rdma_send_response(conn, work->request_id, status, length);
+    }
 
-    if (work->mr != conn->value_mr) {
-        priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_KEYS];
-        assert(work->mr == rmem->mr);
+    if (work->rmem) {
+        assert(work->rmem == &conn->rmem[PRISKV_RDMA_MEM_KEYS]);
 
-        priskv_rdma_mem_free(conn, rmem);
+        priskv_rdma_mem_free(conn, work->rmem);
         priskv_log_debug("RDMA: KEYS done");
     }
 
+    /* the charged bytes are dropped at once by priskv_rdma_qos_detach on closing */
+    if (work->qos_bytes && !conn->c.closing) {
+        conn->c.qos_charged[work->qos_class] -= work->qos_bytes;
+        priskv_qos_uncharge(priskv_rdma_qos(conn), work->qos_class, work->qos_bytes);
+    }
+
     priskv_check_and_log_slow_query(work);
 
-    free(work);
+    priskv_pool_put(&conn->work_pool, work);
     return ret;
 }
 
 static int priskv_rdma_handle_rw(priskv_rdma_conn *conn, priskv_rdma_rw_work *work)
 {
+    bool defer_resp = work->defer_resp;
+
     work->completed++;
     assert(work->completed <= work->nsgl);
 
@@ -1244,11 +2248,12 @@ static int priskv_rdma_handle_rw(priskv_rdma_conn *conn, priskv_rdma_rw_work *wo
         return 0;
     }
 
+    /* @work may be completed by @cb on deferred response */
     if (work->cb) {
         work->cb(work->cbarg);
     }
 
-    if (work->defer_resp) {
+    if (defer_resp) {
         return 0;
     }
 
@@ -1257,7 +2262,48 @@ static int priskv_rdma_handle_rw(priskv_rdma_conn *conn, priskv_rdma_rw_work *wo
 
 static inline int priskv_rdma_handle_send(priskv_rdma_conn *conn, priskv_response *resp, uint32_t len)
 {
-    return priskv_rdma_response_free(resp);
+    return priskv_rdma_response_free(conn, resp);
+}
+
+void priskv_rdma_conn_send_done(priskv_rdma_conn *conn, priskv_response *resp)
+{
+    priskv_rdma_response_free(conn, resp);
+}
+
+void priskv_rdma_conn_rw_done(priskv_rdma_conn *conn, priskv_rdma_rw_work *work)
+{
+    priskv_request_trace *trace = priskv_rdma_req_trace(conn, work->req);
+
+    if (trace) {
+        priskv_request_trace_stamp(&trace->server_data_recv);
+    }
+
+    if (priskv_rdma_handle_rw(conn, work)) {
+        priskv_rdma_close_client_async(conn);
+    }
+}
+
+int priskv_rdma_conn_rw_respond(priskv_rdma_conn *conn, priskv_rdma_rw_work *work)
+{
+    work->responded = true;
+    return priskv_rdma_send_response(conn, work->request_id, PRISKV_RESP_STATUS_OK,
+                                     work->valuelen);
+}
+
+void priskv_rdma_conn_rw_abort(priskv_rdma_conn *conn, priskv_rdma_rw_work *work)
+{
+    bool defer_resp = work->defer_resp;
+
+    if (!work->abort) {
+        priskv_rdma_handle_rw(conn, work);
+        return;
+    }
+
+    /* @work may be completed by @abort on deferred response */
+    work->abort(work->cbarg);
+    if (!defer_resp) {
+        priskv_rdma_complete_rw_work(work, PRISKV_RESP_STATUS_SERVER_ERROR, 0);
+    }
 }
 
 /* return negative number on failure, return received buffer size on success */
@@ -1270,25 +2316,392 @@ static int priskv_rdma_recv_req(priskv_rdma_conn *conn, uint8_t *req)
     uint16_t req_buf_size = priskv_request_size_aligend(conn);
     int ret;
 
-    assert((req >= rmem->buf) && (req < rmem->buf + rmem->buf_size));
-    sge.addr = (uint64_t)req;
-    sge.length = req_buf_size;
-    sge.lkey = lkey;
+    assert((req >= rmem->buf) && (req < rmem->buf + rmem->buf_size));
+    sge.addr = (uint64_t)req;
+    sge.length = req_buf_size;
+    sge.lkey = lkey;
+
+    recv_wr.wr_id = (uint64_t)req;
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    recv_wr.next = NULL;
+
+    priskv_log_debug("RDMA: ibv_post_recv addr %p, length %d\n", req, req_buf_size);
+    ret = ibv_post_recv(conn->cm_id->qp, &recv_wr, &bad_wr);
+    if (ret) {
+        PRISKV_RDMA_CONN_ADDR(conn)
+        priskv_log_error("RDMA: <%s - %s> ibv_post_recv failed: %m\n", local_addr, peer_addr);
+        return -errno;
+    }
+
+    return req_buf_size;
+}
+
+static int priskv_rdma_verbs_recv(priskv_rdma_conn *conn, priskv_request *req)
+{
+    int ret = priskv_rdma_recv_req(conn, (uint8_t *)req);
+
+    return ret < 0 ? ret : 0;
+}
+
+static const priskv_transport_ops priskv_rdma_verbs_ops = {
+    .name = "RDMA",
+    .recv = priskv_rdma_verbs_recv,
+    .send = priskv_rdma_verbs_send,
+    .rw = priskv_rdma_verbs_rw,
+};
+
+static inline uint64_t priskv_rdma_monotonic_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+/* allocate the windows of a reservation slot once, they are reused by the later reservations */
+static int priskv_rdma_reserve_alloc_mws(priskv_rdma_conn *conn, priskv_rdma_reservation *resv)
+{
+    for (int i = 0; i < PRISKV_RESERVE_MAX_SGL; i++) {
+        if (resv->mws[i]) {
+            continue;
+        }
+
+        resv->mws[i] = ibv_alloc_mw(conn->cm_id->pd, IBV_MW_TYPE_2);
+        if (!resv->mws[i]) {
+            PRISKV_RDMA_CONN_ADDR(conn)
+            priskv_log_error("RDMA: <%s - %s> ibv_alloc_mw failed: %m\n", local_addr, peer_addr);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * bind a window with remote write access to each SGL of @rresp, and reply the rkeys of windows.
+ * The binds are ordered before the following response on the same QP.
+ */
+static int priskv_rdma_reserve_bind(priskv_rdma_conn *conn, priskv_rdma_reservation *resv,
+                                    priskv_reserve_resp *rresp, uint16_t nsgl)
+{
+    priskv_rdma_value_mrs *vmrs = conn->value_mrs;
+    struct ibv_send_wr wrs[PRISKV_RESERVE_MAX_SGL] = {0}, *bad_wr;
+    int ret;
+
+    for (uint16_t i = 0; i < nsgl; i++) {
+        uint64_t addr = be64toh(rresp->sgls[i].addr);
+        struct ibv_mw *mw = resv->mws[i];
+
+        wrs[i].next = (i + 1 < nsgl) ? &wrs[i + 1] : NULL;
+        wrs[i].opcode = IBV_WR_BIND_MW;
+        wrs[i].bind_mw.mw = mw;
+        wrs[i].bind_mw.rkey = ibv_inc_rkey(mw->rkey);
+        wrs[i].bind_mw.bind_info.mr = vmrs->mrs[(addr - (uint64_t)vmrs->base) / vmrs->seg_size];
+        wrs[i].bind_mw.bind_info.addr = addr;
+        wrs[i].bind_mw.bind_info.length = be32toh(rresp->sgls[i].length);
+        wrs[i].bind_mw.bind_info.mw_access_flags = IBV_ACCESS_REMOTE_WRITE;
+        rresp->sgls[i].key = htobe32(wrs[i].bind_mw.rkey);
+    }
+
+    ret = ibv_post_send(conn->cm_id->qp, wrs, &bad_wr);
+    if (ret) {
+        PRISKV_RDMA_CONN_ADDR(conn)
+        priskv_log_error("RDMA: <%s - %s> ibv_post_send bind MW failed: ret %d\n", local_addr,
+                         peer_addr, ret);
+        return -ret;
+    }
+
+    /* a type 2 window takes the rkey of the bind */
+    for (uint16_t i = 0; i < nsgl; i++) {
+        resv->mws[i]->rkey = wrs[i].bind_mw.rkey;
+    }
+    resv->nmw = nsgl;
+
+    return 0;
+}
+
+/*
+ * invalidate the windows of @resv, the completion of the last IBV_WR_LOCAL_INV ends the value by
+ * priskv_rdma_reserve_done. A late RDMA WRITE of client fails since then.
+ */
+static int priskv_rdma_reserve_invalidate(priskv_rdma_conn *conn, priskv_rdma_reservation *resv)
+{
+    struct ibv_send_wr wrs[PRISKV_RESERVE_MAX_SGL] = {0}, *bad_wr;
+    int ret;
+
+    assert(resv->nmw);
+    for (uint16_t i = 0; i < resv->nmw; i++) {
+        wrs[i].next = (i + 1 < resv->nmw) ? &wrs[i + 1] : NULL;
+        wrs[i].opcode = IBV_WR_LOCAL_INV;
+        wrs[i].invalidate_rkey = resv->mws[i]->rkey;
+    }
+    wrs[resv->nmw - 1].wr_id = (uint64_t)resv;
+    wrs[resv->nmw - 1].send_flags = IBV_SEND_SIGNALED;
+
+    ret = ibv_post_send(conn->cm_id->qp, wrs, &bad_wr);
+    if (ret) {
+        PRISKV_RDMA_CONN_ADDR(conn)
+        priskv_log_error("RDMA: <%s - %s> ibv_post_send invalidate MW failed: ret %d\n",
+                         local_addr, peer_addr, ret);
+        return -ret;
+    }
+
+    resv->invalidating = true;
+    return 0;
+}
+
+/* the windows of @resv are invalidated, end the value and respond the COMMIT if any */
+static int priskv_rdma_reserve_done(priskv_rdma_conn *conn, priskv_rdma_reservation *resv)
+{
+    priskv_resp_status status = resv->ok ? PRISKV_RESP_STATUS_OK : PRISKV_RESP_STATUS_INVALID_SGL;
+
+    priskv_reserve_key_end(resv->keynode, resv->ok);
+    resv->keynode = NULL;
+    resv->invalidating = false;
+    resv->nmw = 0;
+    priskv_slots_put(&conn->resv_slots, resv - conn->resvs);
+    if (!resv->respond) {
+        return 0;
+    }
+
+    return priskv_rdma_send_response(conn, resv->request_id, status, resv->ok ? resv->valuelen : 0);
+}
+
+/* reserve the value, and reply the token with SGLs for RDMA WRITE from client */
+static int priskv_rdma_reserve(priskv_rdma_conn *conn, priskv_request *req, uint8_t *key,
+                               uint16_t keylen, uint32_t valuelen, uint64_t timeout)
+{
+    priskv_rdma_value_mrs *vmrs = conn->value_mrs;
+    priskv_rdma_reservation *resv;
+    priskv_reserve_resp *rresp;
+    priskv_response *resp;
+    priskv_resp_status status;
+    void *keynode = NULL;
+    uint8_t *val;
+    uint32_t existlen = 0;
+    uint32_t filled = 0;
+    uint16_t nsgl = 0;
+    int64_t idx;
+    int ret;
+
+    resp = priskv_rdma_unused_response(conn);
+    if (!resp) {
+        return -EPROTO;
+    }
+
+    idx = priskv_slots_get(&conn->resv_slots);
+    if (idx < 0) {
+        return priskv_rdma_post_response(conn, resp, req->request_id, PRISKV_RESP_STATUS_NO_MEM, 0,
+                                         0);
+    }
+
+    resv = &conn->resvs[idx];
+    if (priskv_rdma_reserve_alloc_mws(conn, resv)) {
+        priskv_slots_put(&conn->resv_slots, idx);
+        return priskv_rdma_post_response(conn, resp, req->request_id, PRISKV_RESP_STATUS_NO_MEM, 0,
+                                         0);
+    }
+
+    status = priskv_set_key_cond(conn->kv, key, keylen, &val, valuelen, timeout,
+                                 priskv_request_cond(req), priskv_request_version(req), &existlen,
+                                 &keynode);
+    if (status != PRISKV_RESP_STATUS_OK || !keynode) {
+        priskv_set_key_end(keynode);
+        priskv_slots_put(&conn->resv_slots, idx);
+        return priskv_rdma_post_response(conn, resp, req->request_id, status,
+                                         (status == PRISKV_RESP_STATUS_KEY_EXISTS) ? existlen : 0,
+                                         0);
+    }
+
+    rresp = (priskv_reserve_resp *)priskv_response_inline_value(resp);
+    while (filled < valuelen && nsgl < PRISKV_RESERVE_MAX_SGL) {
+        uint64_t offset = val + filled - vmrs->base;
+        uint32_t seg = offset / vmrs->seg_size;
+        uint64_t seg_left = (seg + 1) * vmrs->seg_size - offset;
+        uint32_t length = priskv_min_u64(valuelen - filled, seg_left);
+
+        rresp->sgls[nsgl].addr = htobe64((uint64_t)(val + filled));
+        rresp->sgls[nsgl].length = htobe32(length);
+        filled += length;
+        nsgl++;
+    }
+
+    if (filled < valuelen) {
+        priskv_set_key_abort(keynode);
+        priskv_slots_put(&conn->resv_slots, idx);
+        return priskv_rdma_post_response(conn, resp, req->request_id,
+                                         PRISKV_RESP_STATUS_VALUE_TOO_BIG, 0, 0);
+    }
+
+    priskv_reserve_key(keynode);
+    resv->keynode = keynode;
+    resv->valuelen = valuelen;
+    resv->keycrc = priskv_crc32(key, keylen);
+    resv->gen = ++conn->resv_gen;
+    resv->deadline_ns = priskv_rdma_monotonic_ns() + PRISKV_RESERVE_TIMEOUT_MS * 1000000UL;
+
+    /* a window may be bound partially, the value is dropped on closing after the QP is gone */
+    ret = priskv_rdma_reserve_bind(conn, resv, rresp, nsgl);
+    if (ret) {
+        return ret;
+    }
+
+    rresp->token = htobe64((uint64_t)resv->gen << 32 | idx);
+    rresp->nsgl = htobe16(nsgl);
+    memset(rresp->reserved, 0x00, sizeof(rresp->reserved));
+
+    return priskv_rdma_post_response(conn, resp, req->request_id, PRISKV_RESP_STATUS_OK, valuelen,
+                                     sizeof(priskv_reserve_resp));
+}
+
+/* the client has written the reserved value, make it visible once the windows are invalidated */
+static int priskv_rdma_commit(priskv_rdma_conn *conn, priskv_request *req, uint8_t *key,
+                              uint16_t keylen, uint16_t nsgl, uint64_t *bytes)
+{
+    priskv_rdma_reservation *resv;
+    uint64_t token;
+    uint32_t idx, valuelen;
+
+    if (nsgl != 1) {
+        return priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_INVALID_SGL, 0);
+    }
+
+    token = be64toh(req->sgls[0].addr);
+    valuelen = be32toh(req->sgls[0].length);
+    idx = token & 0xffffffff;
+    if (idx >= conn->resv_slots.nslots) {
+        return priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_INVALID_SGL, 0);
+    }
+
+    /* an expired reservation is invalidating already */
+    resv = &conn->resvs[idx];
+    if (!resv->keynode || resv->invalidating || resv->gen != token >> 32 ||
+        resv->keycrc != priskv_crc32(key, keylen)) {
+        return priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_INVALID_SGL, 0);
+    }
+
+    /* a partial write is not allowed, drop it */
+    resv->ok = (valuelen == resv->valuelen);
+    resv->respond = true;
+    resv->request_id = req->request_id;
+    if (resv->ok) {
+        *bytes = valuelen;
+    }
+
+    return priskv_rdma_reserve_invalidate(conn, resv);
+}
+
+/* drop the reservations not committed in time, called in the thread of client */
+static int priskv_rdma_reserve_expire(void *arg)
+{
+    priskv_rdma_conn *conn = arg;
+    uint64_t now = priskv_rdma_monotonic_ns();
+
+    for (uint32_t i = 0; !conn->c.closing && i < conn->resv_slots.nslots; i++) {
+        priskv_rdma_reservation *resv = &conn->resvs[i];
+
+        if (!resv->keynode || resv->invalidating || now < resv->deadline_ns) {
+            continue;
+        }
+
+        PRISKV_RDMA_CONN_ADDR(conn)
+        priskv_log_warn("RDMA: <%s - %s> reservation %d not committed in %d ms, drop it\n",
+                        local_addr, peer_addr, i, PRISKV_RESERVE_TIMEOUT_MS);
+        resv->ok = false;
+        resv->respond = false;
+        if (priskv_rdma_reserve_invalidate(conn, resv)) {
+            priskv_rdma_close_client_async(conn);
+        }
+    }
+
+    return 0;
+}
+
+static void priskv_rdma_wake_get(priskv_parked_get *pget);
+
+/* park the GET of a key in process, return false if it should retry at once */
+static bool priskv_rdma_park_get(priskv_rdma_conn *conn, priskv_request *req, uint8_t *key,
+                                 uint16_t keylen, void *keynode)
+{
+    priskv_rdma_parked_get *rpget = priskv_pool_get(&conn->pget_pool);
+
+    if (!rpget) {
+        return false;
+    }
+
+    memset(rpget, 0x00, sizeof(priskv_rdma_parked_get));
+    rpget->conn = conn;
+    rpget->thread = conn->c.thread;
+    rpget->req = req;
+    rpget->key = key;
+    rpget->keylen = keylen;
+    rpget->pget.wake = priskv_rdma_wake_get;
+    rpget->inuse = true;
+    if (!priskv_park_get(conn->kv, keynode, &rpget->pget)) {
+        rpget->inuse = false;
+        priskv_pool_put(&conn->pget_pool, rpget);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * GET in memory. A key in process parks the request with @park, @parked tells the caller to keep
+ * the request buffer till priskv_rdma_resume_get.
+ */
+static int priskv_rdma_get(priskv_rdma_conn *conn, priskv_request *req, uint8_t *key,
+                           uint16_t keylen, uint32_t remote_valuelen, bool park, bool *parked,
+                           uint64_t *bytes)
+{
+    priskv_request_trace *trace = priskv_rdma_req_trace(conn, req);
+    priskv_resp_status status;
+    uint32_t valuelen = 0;
+    void *keynode;
+    uint8_t *val;
+
+    *parked = false;
+    status = priskv_get_key(conn->kv, key, keylen, &val, &valuelen, &keynode);
+    if ((status == PRISKV_RESP_STATUS_KEY_UPDATING) && park) {
+        if (priskv_rdma_park_get(conn, req, key, keylen, keynode)) {
+            *parked = true;
+            return 0;
+        }
+
+        /* the SET ends meanwhile, or too many GETs parked */
+        priskv_get_key_end(keynode);
+        status = priskv_get_key(conn->kv, key, keylen, &val, &valuelen, &keynode);
+    }
+
+    if (status != PRISKV_RESP_STATUS_OK || !keynode) {
+        priskv_get_key_end(keynode);
+        return priskv_rdma_send_response(conn, req->request_id, status, 0);
+    }
+
+    if (trace) {
+        priskv_request_trace_stamp(&trace->server_rw_kv);
+    }
+
+    status = priskv_request_range(req, remote_valuelen, &val, &valuelen);
+    if (status != PRISKV_RESP_STATUS_OK) {
+        priskv_get_key_end(keynode);
+        return priskv_rdma_send_response(conn, req->request_id, status, valuelen);
+    }
 
-    recv_wr.wr_id = (uint64_t)req;
-    recv_wr.sg_list = &sge;
-    recv_wr.num_sge = 1;
-    recv_wr.next = NULL;
+    if (remote_valuelen < valuelen) {
+        priskv_get_key_end(keynode);
+        return priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_VALUE_TOO_BIG,
+                                         valuelen);
+    }
 
-    priskv_log_debug("RDMA: ibv_post_recv addr %p, length %d\n", req, req_buf_size);
-    ret = ibv_post_recv(conn->cm_id->qp, &recv_wr, &bad_wr);
-    if (ret) {
-        PRISKV_RDMA_DEF_ADDR(conn->cm_id)
-        priskv_log_error("RDMA: <%s - %s> ibv_post_recv failed: %m\n", local_addr, peer_addr);
-        return -errno;
+    if (trace) {
+        priskv_request_trace_stamp(&trace->server_data_send);
     }
 
-    return req_buf_size;
+    *bytes = valuelen;
+    return priskv_rdma_rw_req(conn, req, NULL, val, valuelen, false, priskv_get_key_end, NULL,
+                              keynode, false, NULL);
 }
 
 static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req, uint32_t len)
@@ -1306,9 +2719,12 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
     void *keynode;
     priskv_resp_status status;
     int ret = 0;
-    bool tiering_inflight = false;
+    bool tiering_inflight = false, parked = false;
+    bool inlined = req->flags & PRISKV_REQUEST_FLAG_INLINE;
+    uint32_t inline_len = 0;
+    priskv_request_trace *trace = priskv_rdma_req_trace(conn, req);
     priskv_rdma_mem *rmem = &conn->rmem[PRISKV_RDMA_MEM_KEYS];
-    PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+    PRISKV_RDMA_CONN_ADDR(conn)
 
     if (len < keyoff) {
         priskv_log_warn("RDMA: <%s - %s> invalid command. recv %d, less than %d, nsgl 0x%x\n",
@@ -1317,7 +2733,19 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
         return -EPROTO;
     }
 
-    keylen = len - keyoff;
+    if (inlined) {
+        keylen = be16toh(req->key_length);
+        if (len < keyoff + keylen) {
+            priskv_log_warn("RDMA: <%s - %s> invalid inline command. recv %d, key %d, nsgl 0x%x\n",
+                          local_addr, peer_addr, len, keylen, nsgl);
+            priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_INVALID_COMMAND, 0);
+            return -EPROTO;
+        }
+        inline_len = len - keyoff - keylen;
+    } else {
+        keylen = len - keyoff;
+    }
+
     if (!keylen) {
         priskv_log_warn("RDMA: <%s - %s> empty key. recv %d, less than %d, nsgl 0x%x\n", local_addr,
                       peer_addr, len, keyoff, nsgl);
@@ -1340,6 +2768,29 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
         return -EPROTO;
     }
 
+    if (inlined) {
+        uint32_t inline_valuelen = inline_len;
+
+        if (command == PRISKV_COMMAND_GET) {
+            inline_valuelen = priskv_sgl_size_from_be(req->sgls, nsgl);
+        }
+
+        if (((command != PRISKV_COMMAND_GET) || inline_len) &&
+            ((command != PRISKV_COMMAND_SET) || nsgl)) {
+            priskv_log_warn("RDMA: <%s - %s> invalid inline %s, nsgl %d, inline value %d\n",
+                          local_addr, peer_addr, priskv_command_str(command), nsgl, inline_len);
+            priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_INVALID_COMMAND, 0);
+            return -EPROTO;
+        }
+
+        if (inline_valuelen > conn->conn_cap.max_inline_value) {
+            priskv_log_warn("RDMA: <%s - %s> inline value(%d) exceeds max_inline_value(%d)\n",
+                          local_addr, peer_addr, inline_valuelen, conn->conn_cap.max_inline_value);
+            priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_VALUE_TOO_BIG, 0);
+            return -EPROTO;
+        }
+    }
+
     key = priskv_request_key(req, nsgl);
 
     if (priskv_get_log_level() >= priskv_log_debug) {
@@ -1351,34 +2802,10 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
 
     switch (command) {
     case PRISKV_COMMAND_GET: {
-        struct timeval server_rw_kv_time, server_data_send_time;
         remote_valuelen = priskv_sgl_size_from_be(req->sgls, nsgl);
 
         if (!priskv_backend_tiering_enabled()) {
-            status = priskv_get_key(conn->kv, key, keylen, &val, &valuelen, &keynode);
-            if (status != PRISKV_RESP_STATUS_OK || !keynode) {
-                ret = priskv_rdma_send_response(conn, req->request_id, status, 0);
-                priskv_get_key_end(keynode);
-                break;
-            }
-
-            gettimeofday(&server_rw_kv_time, NULL);
-            req->runtime.server_rw_kv_time = server_rw_kv_time;
-
-            if (remote_valuelen < valuelen) {
-                ret = priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_VALUE_TOO_BIG,
-                                              valuelen);
-                priskv_get_key_end(keynode);
-                break;
-            }
-
-            ret = priskv_rdma_rw_req(conn, req, conn->value_mr, val, valuelen, false,
-                                   priskv_get_key_end, keynode, false, NULL);
-
-            gettimeofday(&server_data_send_time, NULL);
-            req->runtime.server_data_send_time = server_data_send_time;
-
-            bytes = valuelen;
+            ret = priskv_rdma_get(conn, req, key, keylen, remote_valuelen, true, &parked, &bytes);
         } else {
             priskv_resp_status alloc_status = PRISKV_RESP_STATUS_OK;
             priskv_tiering_req *treq = priskv_tiering_req_new(conn, req, key, keylen, PRISKV_KEY_MAX_TIMEOUT,
@@ -1395,32 +2822,37 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
         break;
     }
     case PRISKV_COMMAND_SET: {
-        struct timeval server_rw_kv_time, server_data_send_time;
-
-        remote_valuelen = priskv_sgl_size_from_be(req->sgls, nsgl);
+        remote_valuelen = inlined ? inline_len : priskv_sgl_size_from_be(req->sgls, nsgl);
         if (!remote_valuelen) {
             ret = priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_VALUE_EMPTY, 0);
             break;
         }
 
         if (!priskv_backend_tiering_enabled()) {
-            status = priskv_set_key(conn->kv, key, keylen, &val, remote_valuelen, timeout, &keynode);
+            status = priskv_set_key_cond(conn->kv, key, keylen, &val, remote_valuelen, timeout,
+                                         priskv_request_cond(req), priskv_request_version(req),
+                                         &valuelen, &keynode);
             if (status != PRISKV_RESP_STATUS_OK || !keynode) {
-                ret = priskv_rdma_send_response(conn, req->request_id, status, 0);
+                ret = priskv_rdma_send_response(
+                    conn, req->request_id, status,
+                    (status == PRISKV_RESP_STATUS_KEY_EXISTS) ? valuelen : 0);
                 priskv_set_key_end(keynode);
                 break;
             }
 
-            gettimeofday(&server_rw_kv_time, NULL);
-            req->runtime.server_rw_kv_time = server_rw_kv_time;
-
-            ret = priskv_rdma_rw_req(conn, req, conn->value_mr, val, remote_valuelen, true,
-                                   priskv_set_key_end, keynode, false, NULL);
-
-            gettimeofday(&server_data_send_time, NULL);
-            req->runtime.server_data_send_time = server_data_send_time;
+            if (trace) {
+                priskv_request_trace_stamp(&trace->server_rw_kv);
+                trace->server_data_send = trace->server_rw_kv;
+            }
+            ret = priskv_rdma_rw_req(conn, req, NULL, val, remote_valuelen, true,
+                                     priskv_set_key_end, priskv_set_key_abort, keynode, false,
+                                     NULL);
 
             bytes = remote_valuelen;
+        } else if (priskv_request_cond(req)) {
+            /* the key may be absent from memory but present in backend */
+            ret = priskv_rdma_send_response(conn, req->request_id,
+                                            PRISKV_RESP_STATUS_INVALID_COMMAND, 0);
         } else {
             priskv_resp_status alloc_status = PRISKV_RESP_STATUS_OK;
             priskv_tiering_req *treq = priskv_tiering_req_new(conn, req, key, keylen, timeout,
@@ -1484,29 +2916,37 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
         break;
 
     case PRISKV_COMMAND_KEYS:
-        if (rmem->mr) {
+        if (rmem->buf) {
             /* a single KEYS command is allowed inflight with a connection */
             priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_NO_MEM, 0);
             ret = 0;
             break;
         }
 
+        /* size the buffer by the matched keys, not by the buffer the client offers */
         remote_valuelen = priskv_sgl_size_from_be(req->sgls, nsgl);
-        if (priskv_rdma_mem_new(conn, rmem, "Keys", remote_valuelen)) {
+        status = priskv_get_keys(conn->kv, key, keylen, NULL, 0, &valuelen, &nkeys);
+        if ((status != PRISKV_RESP_STATUS_VALUE_TOO_BIG) || (valuelen > remote_valuelen)) {
+            ret = priskv_rdma_send_response(conn, req->request_id, status, valuelen);
+            break;
+        }
+
+        if (priskv_rdma_mem_new(conn, rmem, "Keys", valuelen)) {
             ret = priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_NO_MEM, valuelen);
             break;
         }
 
-        status =
-            priskv_get_keys(conn->kv, key, keylen, rmem->buf, remote_valuelen, &valuelen, &nkeys);
+        /* more keys may match meanwhile, the client retries with the new length */
+        status = priskv_get_keys(conn->kv, key, keylen, rmem->buf, rmem->buf_size, &valuelen,
+                                 &nkeys);
         if ((status != PRISKV_RESP_STATUS_OK) || !valuelen) {
             priskv_rdma_mem_free(conn, rmem);
             ret = priskv_rdma_send_response(conn, req->request_id, status, valuelen);
             break;
         }
 
-        ret = priskv_rdma_rw_req(conn, req, rmem->mr, rmem->buf, valuelen, false, NULL, NULL, false,
-                               NULL);
+        ret = priskv_rdma_rw_req(conn, req, rmem, rmem->buf, valuelen, false, NULL, NULL, NULL,
+                                 false, NULL);
         if (ret) {
             priskv_rdma_mem_free(conn, rmem);
             ret = priskv_rdma_send_response(conn, req->request_id, status, valuelen);
@@ -1528,16 +2968,41 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
         ret = priskv_rdma_send_response(conn, req->request_id, status, nkeys);
         break;
 
+    case PRISKV_COMMAND_RESERVE:
+        /*
+         * the tiering mode writes through to backend, and a stream transport has no value MRs to
+         * write by the client, neither does a device without memory windows. client falls back
+         * to SET
+         */
+        if (priskv_backend_tiering_enabled() || !conn->value_mrs || !conn->value_mrs->mw) {
+            ret = priskv_rdma_send_response(conn, req->request_id,
+                                          PRISKV_RESP_STATUS_NO_SUCH_COMMAND, 0);
+            break;
+        }
+
+        remote_valuelen = priskv_sgl_size_from_be(req->sgls, nsgl);
+        if (!remote_valuelen) {
+            ret = priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_VALUE_EMPTY, 0);
+            break;
+        }
+
+        ret = priskv_rdma_reserve(conn, req, key, keylen, remote_valuelen, timeout);
+        break;
+
+    case PRISKV_COMMAND_COMMIT:
+        ret = priskv_rdma_commit(conn, req, key, keylen, nsgl, &bytes);
+        break;
+
     default:
         priskv_log_warn("RDMA: <%s - %s> unknown command %d\n", local_addr, peer_addr, command);
         priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_NO_SUCH_COMMAND, 0);
         ret = -EPROTO;
     }
 
-    if (!tiering_inflight) {
+    if (!tiering_inflight && !parked) {
         conn->c.stats[command].ops++;
         if (!ret) {
-            priskv_rdma_recv_req(conn, (uint8_t *)req);
+            conn->ops->recv(conn, req);
             conn->c.stats[command].bytes += bytes;
         }
     }
@@ -1545,7 +3010,77 @@ static int priskv_rdma_handle_recv(priskv_rdma_conn *conn, priskv_request *req,
     return ret;
 }
 
-static void priskv_rdma_handle_cq(int fd, void *opaque, uint32_t events)
+/* resume a parked GET in the thread of client */
+static int priskv_rdma_resume_get(void *arg)
+{
+    priskv_rdma_parked_get *rpget = arg;
+    priskv_rdma_conn *conn = rpget->conn;
+    priskv_request *req = rpget->req;
+    uint8_t *key = rpget->key;
+    uint16_t keylen = rpget->keylen;
+    bool timedout = rpget->pget.timedout;
+    uint32_t remote_valuelen = priskv_sgl_size_from_be(req->sgls, be16toh(req->nsgl));
+    uint64_t bytes = 0;
+    bool parked = false;
+    int ret;
+
+    priskv_get_key_end(rpget->pget.keynode);
+    rpget->inuse = false;
+    priskv_pool_put(&conn->pget_pool, rpget);
+
+    /* the request buffer is gone with the QP */
+    if (conn->c.closing) {
+        return 0;
+    }
+
+    if (timedout) {
+        ret = priskv_rdma_send_response(conn, req->request_id, PRISKV_RESP_STATUS_KEY_UPDATING, 0);
+    } else {
+        /* park once at most, the wait is bounded by a single SET */
+        ret = priskv_rdma_get(conn, req, key, keylen, remote_valuelen, false, &parked, &bytes);
+    }
+
+    conn->c.stats[PRISKV_COMMAND_GET].ops++;
+    if (!ret) {
+        conn->ops->recv(conn, req);
+        conn->c.stats[PRISKV_COMMAND_GET].bytes += bytes;
+    } else {
+        priskv_rdma_close_client_async(conn);
+    }
+
+    return 0;
+}
+
+static void priskv_rdma_wake_get(priskv_parked_get *pget)
+{
+    priskv_rdma_parked_get *rpget = container_of(pget, priskv_rdma_parked_get, pget);
+
+    priskv_thread_submit_function(rpget->thread, priskv_rdma_resume_get, rpget);
+}
+
+int priskv_rdma_conn_recv(priskv_rdma_conn *conn, priskv_request *req, uint32_t len)
+{
+    priskv_request_trace *trace;
+
+    /* strip the trace off the message, a short one is rejected by priskv_rdma_handle_recv */
+    if ((req->flags & PRISKV_REQUEST_FLAG_TRACE) && (len < sizeof(priskv_request_trace))) {
+        req->flags &= ~PRISKV_REQUEST_FLAG_TRACE;
+    }
+
+    trace = priskv_rdma_req_trace(conn, req);
+    if (trace) {
+        len -= sizeof(priskv_request_trace);
+        memmove(trace, (uint8_t *)req + len, sizeof(priskv_request_trace));
+        priskv_request_trace_stamp(&trace->server_metadata_recv);
+    }
+
+    /* handled by priskv_rdma_qos_dispatch in the order of QoS */
+    priskv_qos_item item = {.arg = req, .len = len, .cost = priskv_rdma_qos_cost(conn, req, len)};
+    return priskv_qos_enqueue(priskv_rdma_qos(conn), &conn->c.qos_queue,
+                              priskv_rdma_qos_class(req), &item);
+}
+
+static void __priskv_rdma_handle_cq(int fd, void *opaque, uint32_t events)
 {
     priskv_rdma_conn *conn = opaque;
     struct ibv_cq *ev_cq = NULL;
@@ -1583,7 +3118,7 @@ poll_cq:
                    ibv_wc_status_str(wc.status), wc.status, (void *)wc.wr_id, wc.opcode,
                    wc.byte_len);
     if (wc.status != IBV_WC_SUCCESS) {
-        PRISKV_RDMA_DEF_ADDR(conn->cm_id)
+        PRISKV_RDMA_CONN_ADDR(conn)
         priskv_log_error("RDMA: <%s - %s> CQ error status: wr_id 0x%lx, %s[0x%x], opcode : 0x%x, "
                        "byte_len : %ld\n",
                        local_addr, peer_addr, wc.wr_id, ibv_wc_status_str(wc.status), wc.status,
@@ -1595,29 +3130,23 @@ poll_cq:
     }
 
     switch (wc.opcode) {
-    case IBV_WC_RECV: {
-        struct timeval server_metadata_recv_time;
-
-        req = (priskv_request *)wc.wr_id;
-
-        gettimeofday(&server_metadata_recv_time, NULL);
-        req->runtime.server_metadata_recv_time = server_metadata_recv_time;
-
-        if (priskv_rdma_handle_recv(conn, req, wc.byte_len)) {
+    case IBV_WC_RECV:
+        if (priskv_rdma_conn_recv(conn, (priskv_request *)wc.wr_id, wc.byte_len)) {
             goto error_close;
         }
         break;
-    }
 
     case IBV_WC_RDMA_READ:
     case IBV_WC_RDMA_WRITE: {
-        struct timeval server_data_recv_time;
+        priskv_request_trace *trace;
 
         work = (priskv_rdma_rw_work *)wc.wr_id;
         req = (priskv_request *)work->req;
 
-        gettimeofday(&server_data_recv_time, NULL);
-        req->runtime.server_data_recv_time = server_data_recv_time;
+        trace = priskv_rdma_req_trace(conn, req);
+        if (trace) {
+            priskv_request_trace_stamp(&trace->server_data_recv);
+        }
 
         if (priskv_rdma_handle_rw(conn, work)) {
             goto error_close;
@@ -1632,6 +3161,12 @@ poll_cq:
         break;
     }
 
+    case IBV_WC_LOCAL_INV:
+        if (priskv_rdma_reserve_done(conn, (priskv_rdma_reservation *)wc.wr_id)) {
+            goto error_close;
+        }
+        break;
+
     default:
         priskv_log_error("unexpected opcode 0x%x", wc.opcode);
         goto error_close;
@@ -1643,6 +3178,116 @@ error_close:
     priskv_rdma_close_client_async(conn);
 }
 
+static inline uint64_t priskv_rdma_elapsed_ns(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000000UL + end->tv_nsec - start->tv_nsec;
+}
+
+/* account the load of client into its thread */
+static void priskv_rdma_account(priskv_rdma_conn *conn, uint64_t busy_ns)
+{
+    uint64_t ops = 0, bytes = 0;
+
+    for (int i = 0; i < PRISKV_COMMAND_MAX; i++) {
+        ops += conn->c.stats[i].ops;
+        bytes += conn->c.stats[i].bytes;
+    }
+
+    priskv_thread_account(conn->c.thread, ops - conn->c.accounted_ops,
+                          bytes - conn->c.accounted_bytes, busy_ns);
+    conn->c.accounted_ops = ops;
+    conn->c.accounted_bytes = bytes;
+    __atomic_fetch_add(&conn->c.busy_ns, busy_ns, __ATOMIC_RELAXED);
+}
+
+/* handle the received requests of the thread in the order of QoS, called in the thread */
+static void priskv_rdma_qos_dispatch(priskv_qos *qos)
+{
+    priskv_rdma_conn *conn;
+    priskv_qos_class cls;
+    priskv_qos_item item;
+    struct timespec start, end;
+
+    while ((conn = priskv_qos_dequeue(qos, &cls, &item))) {
+        /* the queue is detached on closing, drop the remaining requests */
+        if (conn->c.closing) {
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (priskv_rdma_handle_recv(conn, item.arg, item.len)) {
+            priskv_rdma_close_client_async(conn);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        priskv_rdma_account(conn, priskv_rdma_elapsed_ns(&start, &end));
+    }
+}
+
+void priskv_rdma_conn_dispatch(priskv_rdma_conn *conn)
+{
+    priskv_rdma_qos_dispatch(priskv_rdma_qos(conn));
+    conn->c.backlog = priskv_rdma_waiting(conn);
+}
+
+static void priskv_rdma_handle_cq(int fd, void *opaque, uint32_t events)
+{
+    priskv_rdma_conn *conn = opaque;
+    struct timespec start, end;
+
+    /* the client has been migrated to another thread, see priskv_rdma_migrate_client */
+    if (conn->c.thread != priskv_thread_self()) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    __priskv_rdma_handle_cq(fd, opaque, events);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    priskv_rdma_account(conn, priskv_rdma_elapsed_ns(&start, &end));
+
+    priskv_rdma_conn_dispatch(conn);
+}
+
+priskv_rdma_conn *priskv_rdma_conn_new(const priskv_transport_ops *ops, void *transport, void *kv,
+                                       priskv_rdma_conn_cap *cap, const char *local_addr,
+                                       const char *peer_addr, priskv_thread *thread)
+{
+    priskv_rdma_conn *conn = calloc(1, sizeof(priskv_rdma_conn));
+
+    if (!conn) {
+        return NULL;
+    }
+
+    conn->ops = ops;
+    conn->transport = transport;
+    conn->kv = kv;
+    conn->conn_cap = *cap;
+    conn->c.thread = thread;
+    snprintf(conn->c.local_addr, PRISKV_ADDR_LEN, "%s", local_addr);
+    snprintf(conn->c.peer_addr, PRISKV_ADDR_LEN, "%s", peer_addr);
+    list_node_init(&conn->c.node);
+    pthread_spin_init(&conn->lock, 0);
+
+    if (priskv_rdma_new_ctrl_buffer(conn)) {
+        free(conn);
+        return NULL;
+    }
+
+    return conn;
+}
+
+void *priskv_rdma_conn_transport(priskv_rdma_conn *conn)
+{
+    return conn->transport;
+}
+
+uint8_t *priskv_rdma_conn_requests(priskv_rdma_conn *conn, uint32_t *size, uint32_t *nreqs)
+{
+    *size = priskv_request_size_aligend(conn);
+    *nreqs = priskv_rdma_wr_size(conn);
+    return conn->rmem[PRISKV_RDMA_MEM_REQ].buf;
+}
+
 static void priskv_rdma_reject(struct rdma_cm_id *cm_id, uint16_t status, uint64_t val)
 {
     priskv_rdma_cm_rej rej = {0};
@@ -1665,25 +3310,39 @@ static int priskv_rdma_resp(priskv_rdma_conn *client, struct rdma_cm_id *cm_id)
     rep.max_key_length = htobe16(client->conn_cap.max_key_length);
     rep.max_inflight_command = htobe16(client->conn_cap.max_inflight_command);
     rep.capacity = htobe64(capacity);
+    rep.max_inline_value = htobe16(client->conn_cap.max_inline_value);
+    if (client->c.listener->s.index_hdr) {
+        rep.index_addr = htobe64((uint64_t)client->c.listener->s.index_hdr);
+        rep.index_rkey = htobe32(client->c.listener->s.index_hdr_mr->rkey);
+    }
 
     struct rdma_conn_param resp_param = {0};
     resp_param.responder_resources = 1;
     resp_param.initiator_depth = 1;
+    /* one-sided GET issues RDMA READs from client, allow more of them in flight */
+    if (rep.index_addr) {
+        struct ibv_device_attr attr;
+
+        if (!ibv_query_device(cm_id->verbs, &attr)) {
+            resp_param.responder_resources = priskv_min_u32(attr.max_qp_rd_atom, UINT8_MAX);
+            resp_param.initiator_depth = priskv_min_u32(attr.max_qp_init_rd_atom, UINT8_MAX);
+        }
+    }
     resp_param.retry_count = 5;
     resp_param.private_data = &rep;
     resp_param.private_data_len = sizeof(rep);
 
     int ret = rdma_accept(cm_id, &resp_param);
     if (ret) {
-        PRISKV_RDMA_DEF_ADDR(client->cm_id)
+        PRISKV_RDMA_CONN_ADDR(client)
         priskv_log_error("RDMA: <%s - %s> rdma_accept failed: %m\n", local_addr, peer_addr);
     }
 
     return ret;
 }
 
-static int priskv_rdma_verify_conn_cap(priskv_rdma_conn_cap *client, priskv_rdma_conn_cap *listener,
-                                     uint64_t *val)
+int priskv_rdma_verify_conn_cap(priskv_rdma_conn_cap *client, priskv_rdma_conn_cap *listener,
+                              uint64_t *val)
 {
     if (!client->max_sgl) {
         client->max_sgl = listener->max_sgl;
@@ -1706,6 +3365,14 @@ static int priskv_rdma_verify_conn_cap(priskv_rdma_conn_cap *client, priskv_rdma
         return PRISKV_RDMA_CM_REJ_STATUS_INVALID_INFLIGHT_COMMAND;
     }
 
+    /*
+     * inline value is an optimization, clamp it rather than reject. It grows every request and
+     * response slot, so 0 leaves it off for a client that doesn't ask for it.
+     */
+    if (client->max_inline_value > listener->max_inline_value) {
+        client->max_inline_value = listener->max_inline_value;
+    }
+
     return 0;
 }
 
@@ -1724,8 +3391,11 @@ static void priskv_rdma_handle_connect_request(struct rdma_cm_event *ev, priskv_
     client = calloc(1, sizeof(priskv_rdma_conn));
     assert(client);
     id->context = client;
+    client->ops = &priskv_rdma_verbs_ops;
     client->cm_id = id;
     client->c.listener = listener;
+    memcpy(client->c.local_addr, local_addr, PRISKV_ADDR_LEN);
+    memcpy(client->c.peer_addr, peer_addr, PRISKV_ADDR_LEN);
     client->c.thread = NULL;
     client->c.closing = false;
     list_node_init(&client->c.node);
@@ -1764,10 +3434,12 @@ static void priskv_rdma_handle_connect_request(struct rdma_cm_event *ev, priskv_
     client->conn_cap.max_sgl = be16toh(req->max_sgl);
     client->conn_cap.max_key_length = be16toh(req->max_key_length);
     client->conn_cap.max_inflight_command = be16toh(req->max_inflight_command);
+    client->conn_cap.max_inline_value = be16toh(req->max_inline_value);
     priskv_log_info("RDMA: <%s - %s> incoming connect request - version %d, max_sgl %d, "
-                  "max_key_length %d, max_inflight_command %d\n",
+                  "max_key_length %d, max_inflight_command %d, max_inline_value %d\n",
                   local_addr, peer_addr, version, client->conn_cap.max_sgl,
-                  client->conn_cap.max_key_length, client->conn_cap.max_inflight_command);
+                  client->conn_cap.max_key_length, client->conn_cap.max_inflight_command,
+                  client->conn_cap.max_inline_value);
 
     status = priskv_rdma_verify_conn_cap(&client->conn_cap, &listener->conn_cap, &value);
     if (status) {
@@ -1785,7 +3457,9 @@ static void priskv_rdma_handle_connect_request(struct rdma_cm_event *ev, priskv_
 
     priskv_set_nonblock(client->comp_channel->fd);
     uint32_t wr_size = priskv_rdma_wr_size(client);
-    client->cq = ibv_create_cq(id->verbs, wr_size * 2 * 4, NULL, client->comp_channel, 0);
+    /* a reservation completes one IBV_WR_LOCAL_INV at most */
+    client->cq = ibv_create_cq(id->verbs, wr_size * 2 * 4 + client->conn_cap.max_inflight_command,
+                               NULL, client->comp_channel, 0);
     if (!client->cq) {
         priskv_log_error("RDMA: <%s - %s> ibv_create_cq failed: %m\n", local_addr, peer_addr);
         status = PRISKV_RDMA_CM_REJ_STATUS_SERVER_ERROR;
@@ -1794,18 +3468,28 @@ static void priskv_rdma_handle_connect_request(struct rdma_cm_event *ev, priskv_
 
     ibv_req_notify_cq(client->cq, 0);
 
-    init_attr.cap.max_send_wr = wr_size * 4;
+    /* and the binds and invalidations of windows of PRISKV_COMMAND_RESERVE */
+    init_attr.cap.max_send_wr =
+        wr_size * 4 + client->conn_cap.max_inflight_command * PRISKV_RESERVE_MAX_SGL * 2;
     init_attr.cap.max_recv_wr = wr_size * 4;
-    init_attr.cap.max_send_sge = 1;
+    init_attr.cap.max_send_sge = listener->value_mrs->max_sge;
     init_attr.cap.max_recv_sge = 1;
+    init_attr.cap.max_inline_data = priskv_rdma_response_size(client);
     init_attr.qp_type = IBV_QPT_RC;
     init_attr.send_cq = client->cq;
     init_attr.recv_cq = client->cq;
     if (rdma_create_qp(id, NULL, &init_attr)) {
-        priskv_log_error("RDMA: <%s - %s> rdma_create_qp failed: %m\n", local_addr, peer_addr);
-        status = PRISKV_RDMA_CM_REJ_STATUS_SERVER_ERROR;
-        goto rej;
+        /* the device may not support such inline data, IBV_SEND_INLINE is optional */
+        priskv_log_info("RDMA: <%s - %s> rdma_create_qp with inline data %d failed, retry\n",
+                      local_addr, peer_addr, init_attr.cap.max_inline_data);
+        init_attr.cap.max_inline_data = 0;
+        if (rdma_create_qp(id, NULL, &init_attr)) {
+            priskv_log_error("RDMA: <%s - %s> rdma_create_qp failed: %m\n", local_addr, peer_addr);
+            status = PRISKV_RDMA_CM_REJ_STATUS_SERVER_ERROR;
+            goto rej;
+        }
     }
+    client->max_inline_data = init_attr.cap.max_inline_data;
 
     /* #step3, create QP and related resources */
     if (priskv_rdma_new_ctrl_buffer(client)) {
@@ -1831,9 +3515,11 @@ static void priskv_rdma_handle_connect_request(struct rdma_cm_event *ev, priskv_
     }
 
     priskv_log_info("RDMA: <%s - %s>  accept connect request - version %d, max_sgl %d, "
-                  "max_key_length %d, max_inflight_command %d\n",
+                  "max_key_length %d, max_inflight_command %d, max_inline_value %d, "
+                  "max_inline_data %d\n",
                   local_addr, peer_addr, version, client->conn_cap.max_sgl,
-                  client->conn_cap.max_key_length, client->conn_cap.max_inflight_command);
+                  client->conn_cap.max_key_length, client->conn_cap.max_inflight_command,
+                  client->conn_cap.max_inline_value, client->max_inline_data);
     return;
 
 rej:
@@ -1850,12 +3536,12 @@ static void priskv_rdma_handle_established(struct rdma_cm_event *ev, priskv_rdma
     struct rdma_cm_id *id = ev->id;
     priskv_rdma_conn *client = id->context;
 
-    PRISKV_RDMA_DEF_ADDR(id);
+    PRISKV_RDMA_CONN_ADDR(client)
 
     /* initialize KV of client */
     client->value_base = listener->value_base;
     client->kv = listener->kv;
-    client->value_mr = listener->value_mr;
+    client->value_mrs = listener->value_mrs;
 
     /* use the idlest worker thread handle CQ event(CM event is still handled by main thread) */
     priskv_set_fd_handler(client->comp_channel->fd, priskv_rdma_handle_cq, NULL, client);
@@ -1919,6 +3605,217 @@ again:
     goto again;
 }
 
+typedef struct priskv_rdma_migration {
+    priskv_rdma_conn *client;
+    priskv_thread *thread;
+} priskv_rdma_migration;
+
+/* called in the current thread of client, the CQ fd has been removed from this thread already */
+static int priskv_rdma_client_quiesce(void *arg)
+{
+    priskv_rdma_migration *migration = arg;
+    priskv_rdma_conn *client = migration->client;
+    priskv_qos *old = priskv_rdma_qos(client), *new;
+
+    /* tiering requests and parked GETs complete in the current thread, the queued requests wait
+     * for its QoS */
+    if (priskv_slots_inuse(&client->treq_pool.slots) ||
+        priskv_slots_inuse(&client->pget_pool.slots) ||
+        !priskv_qos_queue_empty(&client->c.qos_queue)) {
+        return -EBUSY;
+    }
+
+    /* a pending CQ event of this thread is ignored since now */
+    client->c.thread = migration->thread;
+
+    /* the inflight RDMA READ/WRITE complete in the new thread */
+    new = priskv_rdma_qos(client);
+    for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+        priskv_qos_uncharge(old, i, client->c.qos_charged[i]);
+        priskv_qos_charge(new, i, client->c.qos_charged[i]);
+    }
+    priskv_rdma_qos_dispatch(old);
+
+    return 0;
+}
+
+/* move the CQ of @client to @thread, called by main thread */
+static int priskv_rdma_migrate_client(priskv_rdma_conn *client, priskv_thread *thread)
+{
+    priskv_thread *old = client->c.thread;
+    priskv_rdma_migration migration = {.client = client, .thread = thread};
+    int fd = client->comp_channel->fd;
+    int ret;
+
+    PRISKV_RDMA_CONN_ADDR(client)
+
+    priskv_thread_del_event_handler(old, fd);
+    ret = priskv_thread_call_function(old, priskv_rdma_client_quiesce, &migration);
+    if (ret) {
+        priskv_thread_add_event_handler(old, fd);
+        priskv_log_debug("RDMA: <%s - %s> not quiescent, skip migration\n", local_addr, peer_addr);
+        return ret;
+    }
+
+    /* the CQ event arrived meanwhile is reported by EPOLL_CTL_ADD */
+    priskv_thread_add_event_handler(thread, fd);
+    client->c.migrations++;
+    priskv_log_notice("RDMA: <%s - %s> migrate from thread %d to thread %d\n", local_addr, peer_addr,
+                      priskv_thread_get_index(old), priskv_thread_get_index(thread));
+
+    return 0;
+}
+
+/* update load of clients, return the client to move from @busiest, NULL if none */
+static priskv_rdma_conn *priskv_rdma_rebalance_pick(priskv_thread *busiest, uint64_t gap,
+                                                    uint64_t elapsed_ns)
+{
+    priskv_rdma_conn *listener, *client, *target = NULL;
+    uint64_t best = 0;
+
+    for (int i = 0; i < g_server.nlisteners; i++) {
+        listener = &g_server.listeners[i];
+
+        pthread_spin_lock(&listener->lock);
+        list_for_each (&listener->s.head, client, c.node) {
+            uint64_t busy_ns = __atomic_load_n(&client->c.busy_ns, __ATOMIC_RELAXED);
+
+            client->c.busy_rate = (busy_ns - client->c.last_busy_ns) * 1000000000UL / elapsed_ns;
+            client->c.last_busy_ns = busy_ns;
+            if (client->c.closing || (client->c.thread != busiest) ||
+                (client->c.busy_rate >= gap)) {
+                continue;
+            }
+
+            /* the balance after moving it */
+            uint64_t balance = priskv_min_u64(client->c.busy_rate, gap - client->c.busy_rate);
+            if (balance > best) {
+                best = balance;
+                target = client;
+            }
+        }
+        pthread_spin_unlock(&listener->lock);
+    }
+
+    return target;
+}
+
+/* move a client from the busiest iothread to the idlest one if the load skews */
+static void priskv_rdma_rebalance(void)
+{
+    priskv_thread *busiest, *idlest;
+    priskv_thread_load busiest_rate, idlest_rate;
+    priskv_rdma_conn *client;
+    struct timespec now;
+    uint64_t elapsed_ns, gap;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ns = (now.tv_sec - g_server.rebalance_ts.tv_sec) * 1000000000UL + now.tv_nsec -
+                 g_server.rebalance_ts.tv_nsec;
+    if (!elapsed_ns) {
+        return;
+    }
+
+    g_server.rebalance_ts = now;
+    priskv_threadpool_update_load(g_threadpool);
+
+    busiest = priskv_threadpool_find_busiest_iothread(g_threadpool);
+    idlest = priskv_threadpool_find_iothread(g_threadpool);
+    priskv_thread_get_load(busiest, NULL, &busiest_rate);
+    priskv_thread_get_load(idlest, NULL, &idlest_rate);
+
+    /* always update the load of clients, even if no migration */
+    gap = busiest_rate.busy_ns > idlest_rate.busy_ns ? busiest_rate.busy_ns - idlest_rate.busy_ns : 0;
+    client = priskv_rdma_rebalance_pick(busiest, gap, elapsed_ns);
+    if ((busiest == idlest) || (busiest_rate.busy_ns < PRISKV_RDMA_REBALANCE_MIN_BUSY_NS) ||
+        (gap * 100 < busiest_rate.busy_ns * PRISKV_RDMA_REBALANCE_SKEW_PERCENT) || !client) {
+        return;
+    }
+
+    priskv_rdma_migrate_client(client, idlest);
+}
+
+static void priskv_rdma_handle_rebalance(int fd, void *opaque, uint32_t events)
+{
+    uint64_t n;
+
+    read(fd, &n, sizeof(n));
+    priskv_rdma_rebalance();
+}
+
+/* run @handler every @interval_ms in the CM epoll fd, it fires on the stable connections as well */
+static int priskv_rdma_timer_start(uint32_t interval_ms, priskv_event_handler *handler,
+                                   const char *name)
+{
+    struct itimerspec timerspec = {0};
+    int timerfd;
+
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0) {
+        priskv_log_error("RDMA: failed to create %s timer: %m\n", name);
+        return -1;
+    }
+
+    timerspec.it_value.tv_sec = interval_ms / 1000;
+    timerspec.it_value.tv_nsec = (interval_ms % 1000) * 1000000L;
+    timerspec.it_interval = timerspec.it_value;
+    timerfd_settime(timerfd, 0, &timerspec, NULL);
+
+    priskv_set_fd_handler(timerfd, handler, NULL, NULL);
+    if (priskv_add_event_fd(g_server.epollfd, timerfd)) {
+        priskv_log_error("RDMA: failed to add %s timer into epoll fd %m\n", name);
+        close(timerfd);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int priskv_rdma_rebalance_start(void)
+{
+    if (!g_rebalance_interval_ms) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &g_server.rebalance_ts);
+    return priskv_rdma_timer_start(g_rebalance_interval_ms, priskv_rdma_handle_rebalance,
+                                   "rebalance");
+}
+
+/*
+ * expire the reservations in the threads of clients. A client is closed or migrated by the main
+ * thread by calling a function in its thread, which runs after the submitted one.
+ */
+static void priskv_rdma_handle_reserve_expire(int fd, void *opaque, uint32_t events)
+{
+    priskv_rdma_conn *listener, *client;
+    uint64_t n;
+
+    read(fd, &n, sizeof(n));
+    for (int i = 0; i < g_server.nlisteners; i++) {
+        listener = &g_server.listeners[i];
+
+        pthread_spin_lock(&listener->lock);
+        list_for_each (&listener->s.head, client, c.node) {
+            if (!client->c.closing && client->c.thread) {
+                priskv_thread_submit_function(client->c.thread, priskv_rdma_reserve_expire,
+                                              client);
+            }
+        }
+        pthread_spin_unlock(&listener->lock);
+    }
+}
+
+static int priskv_rdma_timers_start(void)
+{
+    if (priskv_rdma_timer_start(PRISKV_RDMA_RESERVE_EXPIRE_INTERVAL_MS,
+                                priskv_rdma_handle_reserve_expire, "reservation")) {
+        return -1;
+    }
+
+    return priskv_rdma_rebalance_start();
+}
+
 void priskv_rdma_process(void)
 {
     priskv_rdma_conn *listener;
@@ -36,6 +36,7 @@ extern "C"
 #include <stdbool.h>
 
 #include "priskv-protocol.h"
+#include "qos.h"
 
 #define PRISKV_RDMA_MAX_BIND_ADDR 32
 #define PRISKV_RDMA_DEFAULT_PORT ('H' << 8 | 'P')
@@ -48,13 +49,22 @@ extern "C"
 #define PRISKV_RDMA_DEFAULT_KEY (16 * 1024)
 #define PRISKV_RDMA_MAX_KEY_LENGTH 1024
 #define PRISKV_RDMA_DEFAULT_KEY_LENGTH 128
+#define PRISKV_RDMA_MAX_INLINE_VALUE 4096
+#define PRISKV_RDMA_DEFAULT_INLINE_VALUE 1024
 #define PRISKV_RDMA_MAX_VALUE_BLOCK_SIZE (1 << 20)
 #define PRISKV_RDMA_DEFAULT_VALUE_BLOCK_SIZE 4096
 #define PRISKV_RDMA_MAX_VALUE_BLOCK (1UL << 30)
 #define PRISKV_RDMA_DEFAULT_VALUE_BLOCK (1024UL * 1024)
 #define SLOW_QUERY_THRESHOLD_LATENCY_US 1000000 /* 1 second */
+#define PRISKV_RDMA_DEFAULT_REBALANCE_INTERVAL_MS 1000
+#define PRISKV_RDMA_DEFAULT_QOS_WEIGHT_HIGH 8
+#define PRISKV_RDMA_DEFAULT_QOS_WEIGHT_NORMAL 4
+#define PRISKV_RDMA_DEFAULT_QOS_WEIGHT_LOW 1
+#define PRISKV_RDMA_DEFAULT_QOS_BUDGET_LOW (256UL * 1024 * 1024)
 
 extern uint32_t g_slow_query_threshold_latency_us;
+extern uint32_t g_rebalance_interval_ms;
+extern priskv_qos_conf g_qos_conf[PRISKV_QOS_CLASS_MAX];
 
 typedef struct priskv_rdma_stats {
     uint64_t ops;
@@ -65,12 +75,23 @@ typedef struct priskv_rdma_conn_cap {
     uint16_t max_sgl;
     uint16_t max_key_length;
     uint16_t max_inflight_command;
+    uint16_t max_inline_value;
 } priskv_rdma_conn_cap;
 
+typedef struct priskv_rdma_slot_stats {
+    uint32_t total;
+    uint32_t inuse;
+    uint32_t peak;
+    uint64_t exhausted;
+} priskv_rdma_slot_stats;
+
 typedef struct priskv_rdma_client {
     char address[PRISKV_ADDR_LEN];
     priskv_rdma_stats stats[PRISKV_COMMAND_MAX];
     uint64_t resps;
+    priskv_rdma_slot_stats resp_slots;
+    int thread; /* index of iothread, -1 if detached */
+    uint64_t migrations;
     bool closing;
 } priskv_rdma_client;
 
@@ -86,6 +107,10 @@ void priskv_rdma_process(void);
 
 void *priskv_rdma_get_kv(void);
 
+/* negotiate the capability of a client against the listener, shared by the transports */
+int priskv_rdma_verify_conn_cap(priskv_rdma_conn_cap *client, priskv_rdma_conn_cap *listener,
+                              uint64_t *val);
+
 priskv_rdma_listener *priskv_rdma_get_listeners(int *nlisteners);
 void priskv_rdma_free_listeners(priskv_rdma_listener *listeners, int nlisteners);
 
@@ -34,8 +34,11 @@
 #include "priskv-utils.h"
 #include "priskv-log.h"
 #include "priskv-logo.h"
+#include "priskv-shm.h"
 
 #include "rdma.h"
+#include "transport.h"
+#include "tcp.h"
 #include "memory.h"
 #include "kv.h"
 #include "priskv-threads.h"
@@ -53,13 +56,17 @@ static uint64_t value_block = PRISKV_RDMA_DEFAULT_VALUE_BLOCK;
 static uint8_t threads = 1;
 static uint32_t thread_flags;
 static uint32_t expire_routine_interval = PRISKV_KV_DEFAULT_EXPIRE_ROUTINE_INTERVAL;
+static uint32_t read_index;
+static priskv_transport_driver *transports[3];
+static int ntransports;
 static const char *memfile;
 static priskv_log_level log_level = priskv_log_notice;
 static const char *g_log_file = NULL;
 static priskv_logger *g_logger = NULL;
 static priskv_rdma_conn_cap conn_cap = {.max_sgl = PRISKV_RDMA_DEFAULT_SGL,
                                       .max_key_length = PRISKV_RDMA_DEFAULT_KEY_LENGTH,
-                                      .max_inflight_command = PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND};
+                                      .max_inflight_command = PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND,
+                                      .max_inline_value = PRISKV_RDMA_DEFAULT_INLINE_VALUE};
 
 static priskv_http_config http_config = {
     .addr = NULL,
@@ -86,6 +93,11 @@ static void priskv_showhelp(void)
            PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND, PRISKV_RDMA_MAX_INFLIGHT_COMMAND);
     printf("  -s/--max-sgl SGLS\n\tthe maxium count of scatter gather list, default %d, max %d\n",
            PRISKV_RDMA_DEFAULT_SGL, PRISKV_RDMA_MAX_SGL);
+    printf("  --max-inline-value BYTES\n\tthe maxium bytes of a value carried by SEND payload, 0 to "
+           "disable, default %d, max %d\n",
+           PRISKV_RDMA_DEFAULT_INLINE_VALUE, PRISKV_RDMA_MAX_INLINE_VALUE);
+    printf("  --read-index ENTRIES\n\texport an index of ENTRIES for one-sided GET by client RDMA "
+           "READ, 0 to disable, default 0\n");
     printf("  -k/--max-keys KEYS\n\tthe maxium count of KV, default %d, max %d\n",
            PRISKV_RDMA_DEFAULT_KEY, PRISKV_RDMA_MAX_KEY);
     printf("  -K/--max-key-length BYTES\n\tthe maxium bytes of a key, default %d, max %d\n",
@@ -109,11 +121,32 @@ static void priskv_showhelp(void)
     printf("  --http-ca PATH\n\tthe path of the CA file\n");
     printf(
         "  --http-verify-client [off/optional/on]\n\tthe client certificate verification mode\n");
-    printf("  -u/--slow-query-threshold-latency-us\n\tthe slow query threshold latency us, "
-           "default %d, max %d\n",
+    printf("  -u/--slow-query-threshold-latency-us\n\tthe slow query threshold latency us of the "
+           "requests traced by client, default %d, max %d\n",
            SLOW_QUERY_THRESHOLD_LATENCY_US, UINT32_MAX / 2);
+    printf("  --rebalance-interval MS\n\tthe interval to migrate connections from the busiest worker "
+           "thread to the idlest one, 0 to disable, default %d\n",
+           PRISKV_RDMA_DEFAULT_REBALANCE_INTERVAL_MS);
+    printf("  --qos-weights HIGH:NORMAL:LOW\n\tthe weights of request priorities sharing a worker "
+           "thread, default %d:%d:%d\n",
+           PRISKV_RDMA_DEFAULT_QOS_WEIGHT_HIGH, PRISKV_RDMA_DEFAULT_QOS_WEIGHT_NORMAL,
+           PRISKV_RDMA_DEFAULT_QOS_WEIGHT_LOW);
+    printf("  --qos-budgets HIGH:NORMAL:LOW\n\tthe bytes of RDMA READ/WRITE in flight of request "
+           "priorities per worker thread, 0 means unlimited, default 0:0:%ld\n",
+           PRISKV_RDMA_DEFAULT_QOS_BUDGET_LOW);
+    printf("  --transport rdma[,tcp][,shm]\n\tthe transports listening to ADDR:PORT, shm listens "
+           "to a unix socket in the shm dir for the clients on the same host, default rdma\n");
+    printf("  --shm-dir DIR\n\tthe directory of the unix socket of shm transport, default %s\n",
+           PRISKV_SHM_DEFAULT_DIR);
+    printf("  --shm-allow-uid UID[,UID]\n\tthe users besides the server's own allowed to "
+           "connect by shm, at most %d, default none\n",
+           PRISKV_SHM_MAX_ALLOW_UIDS);
     printf("  --backend ADDRESS\n\tbackend storage address (e.g., "
            "localfs:/data/priskv&size=100GB;s3:bucket1)\n");
+    printf("  --backend-write-mode around/through/back/demote\n\tkeep a SET value in memory after "
+           "backend acknowledges(through), drop it(around), acknowledge the client before "
+           "writing backend asynchronously(back), or write backend once evicted from "
+           "memory(demote), default through\n");
     exit(0);
 }
 
@@ -124,6 +157,15 @@ typedef enum priskv_short_arg {
     OPTARG_VERIFY_CLIENT,
     OPTARG_ACL,
     OPTARG_BACKEND,
+    OPTARG_MAX_INLINE_VALUE,
+    OPTARG_READ_INDEX,
+    OPTARG_REBALANCE_INTERVAL,
+    OPTARG_QOS_WEIGHTS,
+    OPTARG_QOS_BUDGETS,
+    OPTARG_TRANSPORT,
+    OPTARG_SHM_DIR,
+    OPTARG_SHM_ALLOW_UID,
+    OPTARG_BACKEND_WRITE_MODE,
 } priskv_short_arg;
 
 static const char *priskv_short_opts = "a:p:A:P:f:c:s:K:k:v:b:t:Bl:L:e:u:h";
@@ -138,9 +180,18 @@ static struct option priskv_long_opts[] = {
     {"http-verify-client", required_argument, 0, OPTARG_VERIFY_CLIENT},
     {"acl", required_argument, 0, OPTARG_ACL},
     {"backend", required_argument, 0, OPTARG_BACKEND},
+    {"backend-write-mode", required_argument, 0, OPTARG_BACKEND_WRITE_MODE},
     {"file", required_argument, 0, 'f'},
     {"max-inflight-command", required_argument, 0, 'c'},
     {"max-sgls", required_argument, 0, 's'},
+    {"max-inline-value", required_argument, 0, OPTARG_MAX_INLINE_VALUE},
+    {"read-index", required_argument, 0, OPTARG_READ_INDEX},
+    {"rebalance-interval", required_argument, 0, OPTARG_REBALANCE_INTERVAL},
+    {"qos-weights", required_argument, 0, OPTARG_QOS_WEIGHTS},
+    {"qos-budgets", required_argument, 0, OPTARG_QOS_BUDGETS},
+    {"transport", required_argument, 0, OPTARG_TRANSPORT},
+    {"shm-dir", required_argument, 0, OPTARG_SHM_DIR},
+    {"shm-allow-uid", required_argument, 0, OPTARG_SHM_ALLOW_UID},
     {"max-keys", required_argument, 0, 'k'},
     {"max-key-length", required_argument, 0, 'K'},
     {"value-block-size", required_argument, 0, 'v'},
@@ -154,10 +205,81 @@ static struct option priskv_long_opts[] = {
     {"help", no_argument, 0, 'h'},
 };
 
+/* parse "HIGH:NORMAL:LOW" into @values */
+static int priskv_parse_qos(const char *str, int64_t min, int64_t max,
+                            int64_t values[PRISKV_QOS_CLASS_MAX])
+{
+    char *dup = strdup(str), *saveptr = NULL, *token;
+    int i = 0, ret = 0;
+
+    for (token = strtok_r(dup, ":", &saveptr); token; token = strtok_r(NULL, ":", &saveptr)) {
+        if ((i == PRISKV_QOS_CLASS_MAX) || priskv_str2num(token, &values[i]) ||
+            (values[i] < min) || (values[i] > max)) {
+            ret = -1;
+            break;
+        }
+        i++;
+    }
+
+    free(dup);
+    return (i == PRISKV_QOS_CLASS_MAX) ? ret : -1;
+}
+
+/* parse "rdma,tcp" into @transports */
+static int priskv_parse_transports(const char *str)
+{
+    char *dup = strdup(str), *saveptr = NULL, *token;
+    priskv_transport_driver *driver;
+    int ret = 0;
+
+    ntransports = 0;
+    for (token = strtok_r(dup, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        driver = priskv_transport_find(token);
+        if (!driver || (ntransports == sizeof(transports) / sizeof(transports[0]))) {
+            ret = -1;
+            break;
+        }
+
+        for (int i = 0; i < ntransports; i++) {
+            if (transports[i] == driver) {
+                ret = -1;
+            }
+        }
+        transports[ntransports++] = driver;
+    }
+
+    free(dup);
+    return ntransports ? ret : -1;
+}
+
+static int priskv_parse_shm_allow_uids(const char *str)
+{
+    char *dup = strdup(str), *saveptr = NULL, *token;
+    int64_t uid;
+    int ret = 0;
+
+    g_shm_nallow_uids = 0;
+    for (token = strtok_r(dup, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        if (priskv_str2num(token, &uid) || (uid < 0) || (uid >= UINT32_MAX) ||
+            (g_shm_nallow_uids == PRISKV_SHM_MAX_ALLOW_UIDS)) {
+            ret = -1;
+            break;
+        }
+        g_shm_allow_uids[g_shm_nallow_uids++] = uid;
+    }
+
+    free(dup);
+    return g_shm_nallow_uids ? ret : -1;
+}
+
 static void priskv_parsr_arg(int argc, char *argv[])
 {
     int args, ch;
     int64_t max_key_length = 0, _value_block_size = 0, _slow_query_threshold_latency_us = 0;
+    int64_t max_inline_value = 0;
+    int64_t _read_index = 0;
+    int64_t _rebalance_interval = 0;
+    int64_t qos[PRISKV_QOS_CLASS_MAX];
 
     while (1) {
         ch = getopt_long(argc, argv, priskv_short_opts, priskv_long_opts, &args);
@@ -326,6 +448,78 @@ static void priskv_parsr_arg(int argc, char *argv[])
             tiering_enabled = true;
             break;
 
+        case OPTARG_BACKEND_WRITE_MODE:
+            if (priskv_backend_parse_write_mode(optarg, &tiering_write_mode)) {
+                printf("Invalid --backend-write-mode\n");
+                priskv_showhelp();
+            }
+            break;
+
+        case OPTARG_MAX_INLINE_VALUE:
+            if (priskv_str2num(optarg, &max_inline_value) || max_inline_value < 0 ||
+                max_inline_value > PRISKV_RDMA_MAX_INLINE_VALUE) {
+                printf("Invalid --max-inline-value\n");
+                priskv_showhelp();
+            }
+            conn_cap.max_inline_value = (uint16_t)max_inline_value;
+            break;
+
+        case OPTARG_READ_INDEX:
+            if (priskv_str2num(optarg, &_read_index) || _read_index < 0 ||
+                _read_index > PRISKV_RDMA_MAX_KEY) {
+                printf("Invalid --read-index\n");
+                priskv_showhelp();
+            }
+            read_index = (uint32_t)_read_index;
+            break;
+
+        case OPTARG_REBALANCE_INTERVAL:
+            if (priskv_str2num(optarg, &_rebalance_interval) || _rebalance_interval < 0 ||
+                _rebalance_interval > UINT32_MAX) {
+                printf("Invalid --rebalance-interval\n");
+                priskv_showhelp();
+            }
+            g_rebalance_interval_ms = (uint32_t)_rebalance_interval;
+            break;
+
+        case OPTARG_QOS_WEIGHTS:
+            if (priskv_parse_qos(optarg, 1, UINT16_MAX, qos)) {
+                printf("Invalid --qos-weights\n");
+                priskv_showhelp();
+            }
+            for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+                g_qos_conf[i].weight = (uint32_t)qos[i];
+            }
+            break;
+
+        case OPTARG_QOS_BUDGETS:
+            if (priskv_parse_qos(optarg, 0, INT64_MAX, qos)) {
+                printf("Invalid --qos-budgets\n");
+                priskv_showhelp();
+            }
+            for (int i = 0; i < PRISKV_QOS_CLASS_MAX; i++) {
+                g_qos_conf[i].budget = (uint64_t)qos[i];
+            }
+            break;
+
+        case OPTARG_TRANSPORT:
+            if (priskv_parse_transports(optarg)) {
+                printf("Invalid --transport\n");
+                priskv_showhelp();
+            }
+            break;
+
+        case OPTARG_SHM_DIR:
+            g_shm_dir = optarg;
+            break;
+
+        case OPTARG_SHM_ALLOW_UID:
+            if (priskv_parse_shm_allow_uids(optarg)) {
+                printf("Invalid --shm-allow-uid\n");
+                priskv_showhelp();
+            }
+            break;
+
         case 'h':
         default:
             priskv_showhelp();
@@ -370,18 +564,31 @@ static void *priskv_server_create_kv()
     return kv;
 }
 
-static void __priskv_rdma_process(evutil_socket_t fd, short events, void *arg)
+static void __priskv_transport_process(evutil_socket_t fd, short events, void *arg)
 {
-    priskv_rdma_process();
+    priskv_transport_driver *driver = arg;
+
+    driver->process();
 }
 
 static int priskv_server_start(struct event_base *evbase)
 {
     struct event *ev;
+    int j;
     priskv_thread *bgthread;
     struct priskv_thread_hooks *backend_hooks = NULL;
 
+    g_kv = priskv_server_create_kv();
+    if (!g_kv) {
+        return -1;
+    }
+
+    /* the backend devices opened by the IO threads may register the value region */
     if (tiering_enabled && tiering_backend_address) {
+        priskv_backend_set_value_region(priskv_get_value_base(g_kv),
+                                        priskv_get_value_blocks(g_kv) *
+                                            priskv_get_value_block_size(g_kv),
+                                        priskv_get_value_block_size(g_kv));
         backend_hooks = priskv_get_thread_backend_hooks();
     }
     g_threadpool =
@@ -391,22 +598,52 @@ static int priskv_server_start(struct event_base *evbase)
         return -1;
     }
 
-    g_kv = priskv_server_create_kv();
-    if (!g_kv) {
-        return -1;
+    if (read_index) {
+        /* a value loaded from backend is not readable by one-sided GET */
+        if (tiering_enabled) {
+            printf("--read-index is not supported with --backend\n");
+            return -1;
+        }
+
+        if (priskv_enable_index(g_kv, read_index)) {
+            printf("Failed to enable index of %d entries\n", read_index);
+            return -1;
+        }
     }
 
     bgthread = priskv_threadpool_find_bgthread(g_threadpool);
     priskv_set_expire_routine_interval(g_kv, expire_routine_interval);
     priskv_expire_routine(bgthread, g_kv);
 
-    if (priskv_rdma_listen(addresses, naddr, port, g_kv, &conn_cap)) {
-        return -1; /* priskv_rdma_listen should already print enough messages */
+    if (!ntransports) {
+        transports[ntransports++] = priskv_transport_find("rdma");
     }
 
-    ev = event_new(evbase, priskv_rdma_get_fd(), EV_READ | EV_PERSIST, __priskv_rdma_process, NULL);
+    for (int i = 0; i < ntransports; i++) {
+        priskv_transport_driver *driver = transports[i];
 
-    return event_add(ev, NULL);
+        if (driver->listen(addresses, naddr, port, g_kv, &conn_cap)) {
+            return -1; /* the transport should already print enough messages */
+        }
+
+        /* tcp and shm share one epoll fd */
+        for (j = 0; j < i; j++) {
+            if (transports[j]->get_fd() == driver->get_fd()) {
+                break;
+            }
+        }
+        if (j < i) {
+            continue;
+        }
+
+        ev = event_new(evbase, driver->get_fd(), EV_READ | EV_PERSIST, __priskv_transport_process,
+                       driver);
+        if (event_add(ev, NULL)) {
+            return -1;
+        }
+    }
+
+    return 0;
 };
 
 static void priskv_server_log_fn(priskv_log_level level, const char *msg)
@@ -0,0 +1,1521 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <netdb.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "priskv-protocol.h"
+#include "priskv-protocol-helper.h"
+#include "priskv-log.h"
+#include "priskv-utils.h"
+#include "priskv-event.h"
+#include "priskv-threads.h"
+#include "priskv-shm.h"
+#include "priskv-slots.h"
+#include "list.h"
+#include "acl.h"
+#include "kv.h"
+#include "transport.h"
+#include "tcp.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#define PRISKV_TCP_RX_BUF_SIZE (64 * 1024)
+#define PRISKV_TCP_TX_SEG_SIZE (64 * 1024)
+#define PRISKV_TCP_MAX_LISTEN_BACKLOG 128
+/* a closed connection aborts if the client acknowledges nothing within this time */
+#define PRISKV_TCP_CLOSE_USER_TIMEOUT_MS 5000
+/* give up waiting for the completions of MSG_ZEROCOPY on a closed connection */
+#define PRISKV_TCP_CLOSE_DRAIN_MS (4 * PRISKV_TCP_CLOSE_USER_TIMEOUT_MS)
+
+extern priskv_threadpool *g_threadpool;
+
+const char *g_shm_dir = PRISKV_SHM_DEFAULT_DIR;
+uint64_t g_shm_ring_size = PRISKV_SHM_DEFAULT_RING_SIZE;
+uid_t g_shm_allow_uids[PRISKV_SHM_MAX_ALLOW_UIDS];
+int g_shm_nallow_uids;
+
+typedef enum priskv_tcp_state {
+    PRISKV_TCP_STATE_HANDSHAKE,  /* waiting for priskv_rdma_cm_req */
+    PRISKV_TCP_STATE_REQUEST,    /* waiting for a request */
+    PRISKV_TCP_STATE_VALUE_WAIT, /* the SET is being handled, the value waits in the stream */
+    PRISKV_TCP_STATE_VALUE,      /* receiving the value of SET into KV */
+    PRISKV_TCP_STATE_DISCARD,    /* dropping the value of a SET answered without it */
+} priskv_tcp_state;
+
+/* a piece of data to send, either copied into @buf or pointing to the value of GET @work */
+typedef struct priskv_tcp_seg {
+    struct list_node node;
+    uint8_t *data;
+    uint32_t len;
+    uint32_t sent;
+    uint32_t cap;
+    uint32_t zc_seq; /* the last MSG_ZEROCOPY send of this segment */
+    bool zerocopy;
+    bool zc_sent; /* wait for the completion of MSG_ZEROCOPY before releasing */
+    priskv_rdma_rw_work *work;
+    uint8_t buf[0];
+} priskv_tcp_seg;
+
+typedef struct priskv_tcp_listener priskv_tcp_listener;
+
+typedef struct priskv_tcp_conn {
+    int fd;
+    char local_addr[PRISKV_ADDR_LEN];
+    char peer_addr[PRISKV_ADDR_LEN];
+    priskv_tcp_listener *listener;
+    struct list_node node;
+    priskv_thread *thread;
+    bool closing;
+    bool zerocopy;
+    priskv_rdma_conn_cap conn_cap;
+    void *kv;
+    /* served by the request handler of rdma.c since handshake */
+    priskv_rdma_conn *rconn;
+
+    /* RX */
+    priskv_tcp_state state;
+    uint8_t *rx_buf;
+    uint32_t rx_head;
+    uint32_t rx_tail;
+    bool rx_blocked; /* by PRISKV_TCP_MAX_TX_PENDING */
+    bool rx_stalled; /* on the request buffers or the value of SET, see priskv_tcp_wake */
+    priskv_event_deferred rx_resume;
+    uint8_t *reqs; /* the request buffers of @rconn */
+    uint32_t req_size;
+    priskv_slots req_slots;
+    priskv_request *rx_req; /* the SET whose value follows in the stream */
+    priskv_rdma_rw_work *rx_work;
+    uint8_t *val;
+    uint32_t valuelen;
+    uint32_t val_off;
+
+    /* TX */
+    struct list_head tx_segs;
+    struct list_head zc_segs; /* sent by MSG_ZEROCOPY, waiting for the completion */
+    uint64_t tx_pending;
+    uint32_t zc_next; /* the sequence of the next MSG_ZEROCOPY send */
+    uint32_t zc_done; /* the MSG_ZEROCOPY sends before this sequence are completed */
+    priskv_event_deferred tx_flush;
+
+    /* closed, waiting for @zc_segs until @drain_deadline */
+    struct list_node drain_node;
+    uint64_t drain_deadline;
+
+    /* same-host transport, the rings replace the socket after handshake. NULL over TCP */
+    priskv_shm *shm;
+    int doorbell; /* eventfd kicked by client */
+    int kick;     /* eventfd to kick client */
+} priskv_tcp_conn;
+
+struct priskv_tcp_listener {
+    int fd;
+    bool shm; /* unix socket for priskv_shm */
+    char address[PRISKV_ADDR_LEN];
+    priskv_rdma_conn_cap conn_cap;
+    pthread_spinlock_t lock;
+    struct list_head conns;
+    uint32_t nconns;
+};
+
+typedef struct priskv_tcp_server {
+    int epollfd;
+    int eventfd; /* kicked by worker threads on closing connection */
+    void *kv;
+    int nlisteners;
+    priskv_tcp_listener listeners[PRISKV_RDMA_MAX_BIND_ADDR + 1]; /* the last one for shm */
+    struct list_head draining; /* of the main thread only */
+} priskv_tcp_server;
+
+static priskv_tcp_server g_tcp = {
+    .epollfd = -1,
+    .eventfd = -1,
+};
+
+static void priskv_tcp_close_async(priskv_tcp_conn *conn);
+
+static uint64_t priskv_tcp_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* the value of GET is sent, the handler releases the key */
+static void priskv_tcp_seg_free(priskv_tcp_conn *conn, priskv_tcp_seg *seg)
+{
+    if (seg->work) {
+        priskv_rdma_conn_rw_done(conn->rconn, seg->work);
+    }
+    free(seg);
+}
+
+/* copy @data to the tail of TX */
+static void priskv_tcp_append(priskv_tcp_conn *conn, const void *data, uint32_t len)
+{
+    priskv_tcp_seg *seg = list_tail(&conn->tx_segs, priskv_tcp_seg, node);
+    uint32_t copy;
+
+    while (len) {
+        if (!seg || (seg->data != seg->buf) || (seg->len == seg->cap)) {
+            uint32_t cap = priskv_max_u32(len, PRISKV_TCP_TX_SEG_SIZE);
+
+            seg = calloc(1, sizeof(priskv_tcp_seg) + cap);
+            assert(seg);
+            seg->data = seg->buf;
+            seg->cap = cap;
+            list_add_tail(&conn->tx_segs, &seg->node);
+        }
+
+        copy = priskv_min_u32(len, seg->cap - seg->len);
+        memcpy(seg->data + seg->len, data, copy);
+        seg->len += copy;
+        conn->tx_pending += copy;
+        data = (const uint8_t *)data + copy;
+        len -= copy;
+    }
+}
+
+/* send @val without copy, @work pins the value until sent, or completed by the kernel */
+static void priskv_tcp_append_value(priskv_tcp_conn *conn, uint8_t *val, uint32_t len,
+                                    priskv_rdma_rw_work *work)
+{
+    priskv_tcp_seg *seg = calloc(1, sizeof(priskv_tcp_seg));
+
+    assert(seg);
+    seg->data = val;
+    seg->len = len;
+    seg->cap = len;
+    seg->zerocopy = !conn->shm && conn->zerocopy && (len >= PRISKV_TCP_ZEROCOPY_MIN);
+    seg->work = work;
+    list_add_tail(&conn->tx_segs, &seg->node);
+    conn->tx_pending += len;
+}
+
+/* release the segments completed by the kernel, see Documentation/networking/msg_zerocopy.rst */
+static void priskv_tcp_zerocopy_complete(priskv_tcp_conn *conn)
+{
+    char control[128];
+    struct msghdr msg = {0};
+    struct cmsghdr *cm;
+    struct sock_extended_err *serr;
+    priskv_tcp_seg *seg, *tmp;
+
+    while (!list_empty(&conn->zc_segs)) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(conn->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;
+        }
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+
+            serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_errno || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            /* the sends of TCP complete in order, [ee_info, ee_data] */
+            if ((int32_t)(serr->ee_data + 1 - conn->zc_done) > 0) {
+                conn->zc_done = serr->ee_data + 1;
+            }
+            list_for_each_safe (&conn->zc_segs, seg, tmp, node) {
+                if ((int32_t)(seg->zc_seq - serr->ee_data) > 0) {
+                    break;
+                }
+                list_del(&seg->node);
+                priskv_tcp_seg_free(conn, seg);
+            }
+        }
+    }
+}
+
+static void priskv_tcp_shm_kick(priskv_tcp_conn *conn)
+{
+    uint64_t kick = 1;
+
+    if (write(conn->kick, &kick, sizeof(kick)) < 0) {
+        priskv_log_warn("TCP: <%s - %s> failed to kick client: %m\n", conn->local_addr,
+                        conn->peer_addr);
+    }
+}
+
+/* copy the pending data into the response ring, wait for the client on a full ring. Return
+ * -EPROTO if the client corrupts the ring */
+static int priskv_tcp_shm_flush(priskv_tcp_conn *conn)
+{
+    priskv_shm *shm = conn->shm;
+    priskv_tcp_seg *seg;
+    uint64_t space;
+    uint32_t len;
+    bool produced = false;
+
+    while ((seg = list_top(&conn->tx_segs, priskv_tcp_seg, node))) {
+        space = priskv_shm_writable(shm, PRISKV_SHM_RING_RESP);
+        if (!space) {
+            if (priskv_shm_wait_writable(shm, PRISKV_SHM_RING_RESP)) {
+                continue;
+            }
+            break;
+        }
+
+        len = priskv_min_u64(space, seg->len - seg->sent);
+        memcpy(priskv_shm_write_ptr(shm, PRISKV_SHM_RING_RESP), seg->data + seg->sent, len);
+        priskv_shm_produce(shm, PRISKV_SHM_RING_RESP, len);
+        produced = true;
+
+        seg->sent += len;
+        conn->tx_pending -= len;
+        if (seg->sent < seg->len) {
+            continue;
+        }
+
+        list_del(&seg->node);
+        priskv_tcp_seg_free(conn, seg);
+    }
+
+    if (produced && priskv_shm_kick_consumer(shm, PRISKV_SHM_RING_RESP)) {
+        priskv_tcp_shm_kick(conn);
+    }
+
+    if (shm->broken) {
+        priskv_log_warn("TCP: <%s - %s> invalid index of response ring\n", conn->local_addr,
+                        conn->peer_addr);
+        return -EPROTO;
+    }
+
+    return 0;
+}
+
+/* return 0 if all sent or the socket is full, negative error code on failure */
+static int priskv_tcp_flush(priskv_tcp_conn *conn)
+{
+    priskv_tcp_seg *seg;
+    ssize_t n;
+
+    if (conn->shm) {
+        return priskv_tcp_shm_flush(conn);
+    }
+
+    while ((seg = list_top(&conn->tx_segs, priskv_tcp_seg, node))) {
+        int flags = MSG_DONTWAIT | MSG_NOSIGNAL | (seg->zerocopy ? MSG_ZEROCOPY : 0);
+
+        n = send(conn->fd, seg->data + seg->sent, seg->len - seg->sent, flags);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                return 0;
+            } else if ((errno == ENOBUFS) && seg->zerocopy) {
+                /* out of optmem to pin pages, copy this one */
+                seg->zerocopy = false;
+                continue;
+            }
+
+            priskv_log_warn("TCP: <%s - %s> send failed: %m\n", conn->local_addr, conn->peer_addr);
+            return -errno;
+        }
+
+        if (seg->zerocopy) {
+            seg->zc_seq = conn->zc_next++;
+            seg->zc_sent = true;
+        }
+
+        seg->sent += n;
+        conn->tx_pending -= n;
+        if (seg->sent < seg->len) {
+            continue;
+        }
+
+        list_del(&seg->node);
+        if (seg->zc_sent) {
+            list_add_tail(&conn->zc_segs, &seg->node);
+        } else {
+            priskv_tcp_seg_free(conn, seg);
+        }
+    }
+
+    return 0;
+}
+
+/* flush the responses queued by the handlers of an event pass at once */
+static void priskv_tcp_flush_deferred(void *opaque)
+{
+    priskv_tcp_conn *conn = opaque;
+
+    if (!conn->closing && priskv_tcp_flush(conn)) {
+        priskv_tcp_close_async(conn);
+    }
+}
+
+static void priskv_tcp_recv(priskv_tcp_conn *conn);
+static void priskv_tcp_shm_recv(priskv_tcp_conn *conn);
+
+static void priskv_tcp_resume_deferred(void *opaque)
+{
+    priskv_tcp_conn *conn = opaque;
+
+    if (conn->closing) {
+        return;
+    }
+
+    if (conn->shm) {
+        priskv_tcp_shm_recv(conn);
+    } else {
+        priskv_tcp_recv(conn);
+    }
+}
+
+/* a request buffer or the value of SET is ready, resume the stalled receiving after this pass */
+static void priskv_tcp_wake(priskv_tcp_conn *conn)
+{
+    if (conn->rx_stalled && !conn->closing) {
+        conn->rx_stalled = false;
+        priskv_events_defer(&conn->rx_resume);
+    }
+}
+
+static void priskv_tcp_mark_closing(priskv_tcp_conn *conn)
+{
+    uint64_t kick = 1;
+
+    pthread_spin_lock(&conn->listener->lock);
+    if (conn->closing) {
+        pthread_spin_unlock(&conn->listener->lock);
+        return;
+    }
+
+    conn->closing = true;
+    pthread_spin_unlock(&conn->listener->lock);
+
+    /* logged by priskv_rdma_conn_close_async once established */
+    if (!conn->rconn) {
+        priskv_log_notice("TCP: <%s - %s> async close client\n", conn->local_addr,
+                          conn->peer_addr);
+    }
+
+    if (write(g_tcp.eventfd, &kick, sizeof(kick)) < 0) {
+        priskv_log_warn("TCP: failed to kick main thread: %m\n");
+    }
+}
+
+static void priskv_tcp_close_async(priskv_tcp_conn *conn)
+{
+    if (conn->rconn) {
+        priskv_rdma_conn_close_async(conn->rconn);
+    } else {
+        priskv_tcp_mark_closing(conn);
+    }
+}
+
+/* the handler is done with @req, see priskv_tcp_parse_request */
+static int priskv_tcp_ops_recv(priskv_rdma_conn *rconn, priskv_request *req)
+{
+    priskv_tcp_conn *conn = priskv_rdma_conn_transport(rconn);
+
+    /* the SET is answered without taking the value */
+    if (req == conn->rx_req) {
+        conn->rx_req = NULL;
+        if (conn->state == PRISKV_TCP_STATE_VALUE_WAIT) {
+            conn->state = PRISKV_TCP_STATE_DISCARD;
+        }
+    }
+
+    priskv_slots_put(&conn->req_slots, ((uint8_t *)req - conn->reqs) / conn->req_size);
+    priskv_tcp_wake(conn);
+
+    return 0;
+}
+
+static int priskv_tcp_ops_send(priskv_rdma_conn *rconn, priskv_response *resp, uint32_t len)
+{
+    priskv_tcp_conn *conn = priskv_rdma_conn_transport(rconn);
+
+    if (!conn->closing) {
+        priskv_tcp_append(conn, resp, len);
+        priskv_events_defer(&conn->tx_flush);
+    }
+    priskv_rdma_conn_send_done(rconn, resp);
+
+    return 0;
+}
+
+/* the value travels in the stream right after the request of SET, or the response of GET */
+static int priskv_tcp_ops_rw(priskv_rdma_conn *rconn, priskv_rdma_rw_work *work,
+                             priskv_request *req, uint8_t *val, uint32_t len, bool set)
+{
+    priskv_tcp_conn *conn = priskv_rdma_conn_transport(rconn);
+    int ret;
+
+    if (set) {
+        if (conn->closing) {
+            return -EPIPE;
+        }
+
+        if ((req != conn->rx_req) || (conn->state != PRISKV_TCP_STATE_VALUE_WAIT) ||
+            (len != conn->valuelen)) {
+            priskv_log_warn("TCP: <%s - %s> unexpected value of %u bytes\n", conn->local_addr,
+                            conn->peer_addr, len);
+            return -EPROTO;
+        }
+
+        conn->rx_work = work;
+        conn->val = val;
+        conn->state = PRISKV_TCP_STATE_VALUE;
+        priskv_tcp_wake(conn);
+        return 0;
+    }
+
+    ret = priskv_rdma_conn_rw_respond(rconn, work);
+    if (ret) {
+        return ret;
+    }
+
+    /* the rings and MSG_ZEROCOPY send from the value directly, a small one is copied */
+    if (!conn->closing && (conn->shm || (conn->zerocopy && (len >= PRISKV_TCP_ZEROCOPY_MIN)))) {
+        priskv_tcp_append_value(conn, val, len, work);
+        priskv_events_defer(&conn->tx_flush);
+        return 0;
+    }
+
+    if (!conn->closing) {
+        priskv_tcp_append(conn, val, len);
+    }
+    priskv_rdma_conn_rw_done(rconn, work);
+
+    return 0;
+}
+
+static void priskv_tcp_ops_close(priskv_rdma_conn *rconn)
+{
+    priskv_tcp_mark_closing(priskv_rdma_conn_transport(rconn));
+}
+
+static const priskv_transport_ops priskv_tcp_ops = {
+    .name = "TCP",
+    .recv = priskv_tcp_ops_recv,
+    .send = priskv_tcp_ops_send,
+    .rw = priskv_tcp_ops_rw,
+    .close = priskv_tcp_ops_close,
+};
+
+/* create the rings, pass them along with the eventfds to client by SCM_RIGHTS */
+static int priskv_tcp_shm_setup(priskv_tcp_conn *conn, priskv_tcp_cm_reply *reply)
+{
+    int fds[3];
+    char control[CMSG_SPACE(sizeof(fds))] = {0};
+    struct iovec iov = {.iov_base = reply, .iov_len = sizeof(*reply)};
+    struct msghdr msg = {0};
+    struct cmsghdr *cm;
+    priskv_shm *shm;
+    int ret;
+
+    shm = calloc(1, sizeof(priskv_shm));
+    assert(shm);
+    ret = priskv_shm_create(shm, g_shm_ring_size);
+    if (ret) {
+        priskv_log_error("TCP: <%s - %s> failed to create shm: %s\n", conn->local_addr,
+                         conn->peer_addr, strerror(-ret));
+        free(shm);
+        return ret;
+    }
+
+    fds[0] = shm->memfd;
+    fds[1] = conn->doorbell;
+    fds[2] = conn->kick;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    /* the socket buffer of a new connection is empty */
+    if (sendmsg(conn->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(*reply)) {
+        priskv_log_error("TCP: <%s - %s> failed to pass shm: %m\n", conn->local_addr,
+                         conn->peer_addr);
+        priskv_shm_detach(shm);
+        free(shm);
+        return -EIO;
+    }
+
+    conn->shm = shm;
+    priskv_log_info("TCP: <%s - %s> shm rings of %ld bytes\n", conn->local_addr, conn->peer_addr,
+                    shm->ring_size);
+
+    return 0;
+}
+
+static int priskv_tcp_handshake(priskv_tcp_conn *conn, priskv_rdma_cm_req *req)
+{
+    priskv_tcp_cm_reply reply = {0};
+    uint16_t version = be16toh(req->version);
+    uint32_t nreqs;
+    uint64_t value = 0;
+    int status;
+
+    conn->conn_cap.max_sgl = be16toh(req->max_sgl);
+    conn->conn_cap.max_key_length = be16toh(req->max_key_length);
+    conn->conn_cap.max_inflight_command = be16toh(req->max_inflight_command);
+    /* the value always travels in the stream */
+    conn->conn_cap.max_inline_value = 0;
+
+    if (version != PRISKV_RDMA_CM_VERSION) {
+        status = PRISKV_RDMA_CM_REJ_STATUS_INVALID_VERSION;
+        value = PRISKV_RDMA_CM_VERSION;
+    } else {
+        status = priskv_rdma_verify_conn_cap(&conn->conn_cap, &conn->listener->conn_cap, &value);
+        conn->conn_cap.max_inline_value = 0;
+    }
+
+    if (!status) {
+        conn->rconn = priskv_rdma_conn_new(&priskv_tcp_ops, conn, conn->kv, &conn->conn_cap,
+                                           conn->local_addr, conn->peer_addr, conn->thread);
+        if (conn->rconn) {
+            conn->reqs = priskv_rdma_conn_requests(conn->rconn, &conn->req_size, &nreqs);
+            if (priskv_slots_init(&conn->req_slots, nreqs)) {
+                priskv_rdma_conn_close(conn->rconn);
+                priskv_rdma_conn_free(conn->rconn);
+                conn->rconn = NULL;
+            }
+        }
+
+        if (!conn->rconn) {
+            status = PRISKV_RDMA_CM_REJ_STATUS_SERVER_ERROR;
+        }
+    }
+
+    reply.status = htobe16(status);
+    if (status) {
+        priskv_log_error("TCP: <%s - %s> reject, status %d, value %ld\n", conn->local_addr,
+                         conn->peer_addr, status, value);
+        reply.rej.version = htobe16(PRISKV_RDMA_CM_VERSION);
+        reply.rej.status = htobe16(status);
+        reply.rej.value = htobe64(value);
+    } else {
+        reply.rep.version = htobe16(PRISKV_RDMA_CM_VERSION);
+        reply.rep.max_sgl = htobe16(conn->conn_cap.max_sgl);
+        reply.rep.max_key_length = htobe16(conn->conn_cap.max_key_length);
+        reply.rep.max_inflight_command = htobe16(conn->conn_cap.max_inflight_command);
+        reply.rep.capacity =
+            htobe64(priskv_get_value_blocks(conn->kv) * priskv_get_value_block_size(conn->kv));
+        priskv_log_notice("TCP: <%s - %s> established\n", conn->local_addr, conn->peer_addr);
+    }
+
+    if (!status && conn->listener->shm) {
+        return priskv_tcp_shm_setup(conn, &reply);
+    }
+
+    priskv_tcp_append(conn, &reply, sizeof(reply));
+    return status ? -EPROTO : 0;
+}
+
+/* parse a request from RX buffer into a request buffer of the handler, return the consumed bytes,
+ * 0 if incomplete, -EAGAIN if no request buffer, or error code */
+static int priskv_tcp_parse_request(priskv_tcp_conn *conn, uint8_t *buf, uint32_t len)
+{
+    priskv_request *req = (priskv_request *)buf;
+    uint16_t nsgl, keylen;
+    uint32_t size, valuelen = 0;
+    priskv_resp_status status = PRISKV_RESP_STATUS_OK;
+    int64_t slot;
+
+    if (len < sizeof(priskv_request)) {
+        return 0;
+    }
+
+    /* the framing relies on them, the buffer of handler fits the negotiated ones */
+    nsgl = be16toh(req->nsgl);
+    keylen = be16toh(req->key_length);
+    if (!keylen) {
+        status = PRISKV_RESP_STATUS_KEY_EMPTY;
+    } else if (keylen > conn->conn_cap.max_key_length) {
+        status = PRISKV_RESP_STATUS_KEY_TOO_BIG;
+    } else if (nsgl > conn->conn_cap.max_sgl) {
+        status = PRISKV_RESP_STATUS_INVALID_SGL;
+    }
+
+    if (status != PRISKV_RESP_STATUS_OK) {
+        priskv_response resp = {.request_id = req->request_id, .status = htobe16(status)};
+
+        priskv_log_warn("TCP: <%s - %s> invalid request, nsgl %d, key %d\n", conn->local_addr,
+                        conn->peer_addr, nsgl, keylen);
+        priskv_tcp_append(conn, &resp, sizeof(resp));
+        return -EPROTO;
+    }
+
+    size = priskv_request_size(nsgl, keylen) + priskv_request_trace_size(req);
+    if (len < size) {
+        return 0;
+    }
+
+    slot = priskv_slots_get(&conn->req_slots);
+    if (slot < 0) {
+        return -EAGAIN;
+    }
+
+    req = (priskv_request *)(conn->reqs + slot * conn->req_size);
+    memcpy(req, buf, size);
+
+    /* the client may rewrite the shm ring meanwhile, the copy must frame as parsed */
+    if ((be16toh(req->nsgl) != nsgl) || (be16toh(req->key_length) != keylen) ||
+        (priskv_request_size(nsgl, keylen) + priskv_request_trace_size(req) != size)) {
+        priskv_slots_put(&conn->req_slots, slot);
+        return -EPROTO;
+    }
+
+    /* the value follows the request anyway, received or dropped once the SET is handled */
+    if (be16toh(req->command) == PRISKV_COMMAND_SET) {
+        valuelen = priskv_sgl_size_from_be(req->sgls, nsgl);
+    }
+    if (valuelen) {
+        conn->rx_req = req;
+        conn->valuelen = valuelen;
+        conn->val_off = 0;
+        conn->state = PRISKV_TCP_STATE_VALUE_WAIT;
+    }
+
+    if (priskv_rdma_conn_recv(conn->rconn, req, size)) {
+        priskv_log_warn("TCP: <%s - %s> failed to queue request\n", conn->local_addr,
+                        conn->peer_addr);
+        return -EPROTO;
+    }
+
+    return size;
+}
+
+/* the value of SET is received completely, or dropped */
+static void priskv_tcp_value_done(priskv_tcp_conn *conn)
+{
+    priskv_rdma_rw_work *work = conn->rx_work;
+
+    conn->rx_req = NULL;
+    conn->rx_work = NULL;
+    conn->val = NULL;
+    conn->state = PRISKV_TCP_STATE_REQUEST;
+
+    if (work) {
+        priskv_rdma_conn_rw_done(conn->rconn, work);
+    }
+}
+
+/* consume the received data, return the consumed bytes, 0 if more data needed, -EAGAIN if
+ * stalled until priskv_tcp_wake, or error code */
+static int priskv_tcp_consume(priskv_tcp_conn *conn, uint8_t *buf, uint32_t len)
+{
+    uint32_t copy;
+    int ret = 0;
+
+    switch (conn->state) {
+    case PRISKV_TCP_STATE_HANDSHAKE:
+        if (len < sizeof(priskv_rdma_cm_req)) {
+            return 0;
+        }
+
+        ret = priskv_tcp_handshake(conn, (priskv_rdma_cm_req *)buf);
+        if (ret) {
+            return ret;
+        }
+
+        conn->state = PRISKV_TCP_STATE_REQUEST;
+        return sizeof(priskv_rdma_cm_req);
+
+    case PRISKV_TCP_STATE_REQUEST:
+        return priskv_tcp_parse_request(conn, buf, len);
+
+    case PRISKV_TCP_STATE_VALUE_WAIT:
+        /* a SET queued behind the others by QoS */
+        priskv_rdma_conn_dispatch(conn->rconn);
+        if (conn->state == PRISKV_TCP_STATE_VALUE_WAIT) {
+            return -EAGAIN;
+        }
+        return priskv_tcp_consume(conn, buf, len);
+
+    case PRISKV_TCP_STATE_VALUE:
+    case PRISKV_TCP_STATE_DISCARD:
+        copy = priskv_min_u32(len, conn->valuelen - conn->val_off);
+        if (conn->val) {
+            memcpy(conn->val + conn->val_off, buf, copy);
+        }
+        conn->val_off += copy;
+        ret = copy;
+        break;
+    }
+
+    if (conn->val_off == conn->valuelen) {
+        priskv_tcp_value_done(conn);
+    }
+
+    return ret;
+}
+
+/* handle the requests from the ring, called in the thread of connection */
+static void priskv_tcp_shm_recv(priskv_tcp_conn *conn)
+{
+    priskv_shm *shm = conn->shm;
+    uint64_t len;
+    int ret;
+
+    for (;;) {
+        if (conn->tx_pending > PRISKV_TCP_MAX_TX_PENDING) {
+            /* resume on the doorbell of client consuming responses */
+            conn->rx_blocked = true;
+            break;
+        }
+
+        /* the window is within the ring, a frame is parsed only if it fits the window */
+        len = priskv_min_u64(priskv_shm_readable(shm, PRISKV_SHM_RING_REQ), UINT32_MAX);
+        if (shm->broken) {
+            priskv_log_warn("TCP: <%s - %s> invalid index of request ring\n", conn->local_addr,
+                            conn->peer_addr);
+            goto error;
+        }
+
+        ret = priskv_tcp_consume(conn, priskv_shm_read_ptr(shm, PRISKV_SHM_RING_REQ), len);
+        if (ret == -EAGAIN) {
+            conn->rx_stalled = true;
+            break;
+        } else if (ret < 0) {
+            goto error;
+        } else if (ret > 0) {
+            priskv_shm_consume(shm, PRISKV_SHM_RING_REQ, ret);
+            if (priskv_shm_kick_producer(shm, PRISKV_SHM_RING_REQ)) {
+                priskv_tcp_shm_kick(conn);
+            }
+            continue;
+        }
+
+        /* sleep until the client produces more */
+        if (!priskv_shm_wait_readable(shm, PRISKV_SHM_RING_REQ) ||
+            (priskv_shm_readable(shm, PRISKV_SHM_RING_REQ) == len)) {
+            break;
+        }
+    }
+
+    priskv_rdma_conn_dispatch(conn->rconn);
+    if (!shm->broken && !priskv_tcp_shm_flush(conn)) {
+        return;
+    }
+
+error:
+    priskv_tcp_shm_flush(conn);
+    priskv_tcp_close_async(conn);
+}
+
+/* called in the thread of connection */
+static void priskv_tcp_recv(priskv_tcp_conn *conn)
+{
+    ssize_t n;
+    int ret;
+
+    for (;;) {
+        if (conn->tx_pending > PRISKV_TCP_MAX_TX_PENDING) {
+            /* resume on flushing by priskv_tcp_handle_out */
+            conn->rx_blocked = true;
+            break;
+        }
+
+        ret = priskv_tcp_consume(conn, conn->rx_buf + conn->rx_head, conn->rx_tail - conn->rx_head);
+        if (ret == -EAGAIN) {
+            /* the socket stays readable, resumed by priskv_tcp_wake */
+            conn->rx_stalled = true;
+            break;
+        } else if (ret < 0) {
+            goto error;
+        } else if (ret > 0) {
+            conn->rx_head += ret;
+            continue;
+        }
+
+        if (conn->rx_head == conn->rx_tail) {
+            conn->rx_head = conn->rx_tail = 0;
+        } else if (conn->rx_head) {
+            memmove(conn->rx_buf, conn->rx_buf + conn->rx_head, conn->rx_tail - conn->rx_head);
+            conn->rx_tail -= conn->rx_head;
+            conn->rx_head = 0;
+        }
+
+        /* receive a large value into KV directly */
+        if ((conn->state == PRISKV_TCP_STATE_VALUE) && (conn->rx_head == conn->rx_tail) &&
+            (conn->valuelen - conn->val_off >= PRISKV_TCP_RX_BUF_SIZE)) {
+            n = recv(conn->fd, conn->val + conn->val_off, conn->valuelen - conn->val_off,
+                     MSG_DONTWAIT);
+            if (n > 0) {
+                conn->val_off += n;
+                continue;
+            }
+        } else {
+            n = recv(conn->fd, conn->rx_buf + conn->rx_tail, PRISKV_TCP_RX_BUF_SIZE - conn->rx_tail,
+                     MSG_DONTWAIT);
+            if (n > 0) {
+                conn->rx_tail += n;
+                continue;
+            }
+        }
+
+        if (n == 0) {
+            priskv_log_notice("TCP: <%s - %s> closed by peer\n", conn->local_addr, conn->peer_addr);
+            goto error;
+        } else if (errno != EAGAIN) {
+            priskv_log_warn("TCP: <%s - %s> recv failed: %m\n", conn->local_addr, conn->peer_addr);
+            goto error;
+        }
+
+        break;
+    }
+
+    if (conn->rconn) {
+        priskv_rdma_conn_dispatch(conn->rconn);
+    }
+
+    if (priskv_tcp_flush(conn)) {
+        goto error;
+    }
+
+    /* the requests may be in the rings already once the client gets the handshake reply */
+    if (conn->shm) {
+        priskv_tcp_shm_recv(conn);
+    }
+
+    return;
+
+error:
+    priskv_tcp_flush(conn);
+    priskv_tcp_close_async(conn);
+}
+
+/* the socket of an established shm connection only reports the disconnection */
+static void priskv_tcp_shm_sock(priskv_tcp_conn *conn)
+{
+    uint8_t buf[64];
+    ssize_t n;
+
+    n = recv(conn->fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0) {
+        priskv_log_notice("TCP: <%s - %s> closed by peer\n", conn->local_addr, conn->peer_addr);
+    } else if (n > 0) {
+        priskv_log_warn("TCP: <%s - %s> unexpected data on shm socket\n", conn->local_addr,
+                        conn->peer_addr);
+    } else if (errno == EAGAIN) {
+        return;
+    }
+
+    priskv_tcp_close_async(conn);
+}
+
+static void priskv_tcp_handle_in(int fd, void *opaque, uint32_t events)
+{
+    priskv_tcp_conn *conn = opaque;
+
+    if (conn->closing) {
+        return;
+    }
+
+    if (conn->shm) {
+        priskv_tcp_shm_sock(conn);
+        return;
+    }
+
+    priskv_tcp_zerocopy_complete(conn);
+    priskv_tcp_recv(conn);
+}
+
+/* the client produced requests, or consumed responses of a full ring */
+static void priskv_tcp_handle_doorbell(int fd, void *opaque, uint32_t events)
+{
+    priskv_tcp_conn *conn = opaque;
+    uint64_t kick;
+
+    while (read(fd, &kick, sizeof(kick)) > 0) {
+        ;
+    }
+
+    if (conn->closing || !conn->shm) {
+        return;
+    }
+
+    if (priskv_tcp_shm_flush(conn)) {
+        priskv_tcp_close_async(conn);
+        return;
+    }
+
+    if (!conn->rx_blocked || (conn->tx_pending <= PRISKV_TCP_MAX_TX_PENDING / 2)) {
+        conn->rx_blocked = false;
+        priskv_tcp_shm_recv(conn);
+    }
+}
+
+static void priskv_tcp_handle_out(int fd, void *opaque, uint32_t events)
+{
+    priskv_tcp_conn *conn = opaque;
+
+    if (conn->closing) {
+        return;
+    }
+
+    /* the completion of MSG_ZEROCOPY wakes up with EPOLLERR, reported along with EPOLLOUT */
+    priskv_tcp_zerocopy_complete(conn);
+    if (priskv_tcp_flush(conn)) {
+        priskv_tcp_close_async(conn);
+        return;
+    }
+
+    if (conn->rx_blocked && (conn->tx_pending <= PRISKV_TCP_MAX_TX_PENDING / 2)) {
+        conn->rx_blocked = false;
+        priskv_tcp_recv(conn);
+    }
+}
+
+/* called in the thread of connection once it stops receiving */
+static int priskv_tcp_quiesce(void *arg)
+{
+    priskv_tcp_conn *conn = arg;
+    priskv_rdma_rw_work *work = conn->rx_work;
+    priskv_tcp_seg *seg, *tmp;
+
+    priskv_events_cancel(&conn->rx_resume);
+    priskv_events_cancel(&conn->tx_flush);
+
+    /* the client never completes the value, drop it */
+    if (work) {
+        conn->rx_work = NULL;
+        priskv_rdma_conn_rw_abort(conn->rconn, work);
+    }
+
+    /*
+     * the kernel may still send a partly sent MSG_ZEROCOPY segment, wait for it as well. Its
+     * completion may be reported already while it was not in @zc_segs
+     */
+    list_for_each_safe (&conn->tx_segs, seg, tmp, node) {
+        list_del(&seg->node);
+        if (seg->zc_sent && ((int32_t)(seg->zc_seq - conn->zc_done) >= 0)) {
+            list_add_tail(&conn->zc_segs, &seg->node);
+        } else {
+            priskv_tcp_seg_free(conn, seg);
+        }
+    }
+
+    return 0;
+}
+
+/* called in the thread of connection, return the segments still pinned by the kernel */
+static int priskv_tcp_drain(void *arg)
+{
+    priskv_tcp_conn *conn = arg;
+    priskv_tcp_seg *seg;
+    int nsegs = 0;
+
+    priskv_tcp_zerocopy_complete(conn);
+    list_for_each (&conn->zc_segs, seg, node) {
+        nsegs++;
+    }
+
+    return nsegs;
+}
+
+static void priskv_tcp_free_conn(priskv_tcp_conn *conn)
+{
+    close(conn->fd);
+    if (conn->rconn) {
+        priskv_slots_deinit(&conn->req_slots);
+        priskv_rdma_conn_free(conn->rconn);
+    }
+    free(conn->rx_buf);
+    free(conn);
+}
+
+/* called by main thread, the values pinned by @conn are released, or leaked on @expired */
+static void priskv_tcp_drain_done(priskv_tcp_conn *conn, bool expired)
+{
+    priskv_tcp_seg *seg, *tmp;
+
+    if (expired) {
+        priskv_log_warn("TCP: <%s - %s> MSG_ZEROCOPY never completes, leak the pinned values\n",
+                        conn->local_addr, conn->peer_addr);
+        list_for_each_safe (&conn->zc_segs, seg, tmp, node) {
+            list_del(&seg->node);
+            free(seg);
+        }
+    }
+
+    priskv_del_event(g_tcp.epollfd, conn->fd);
+    priskv_set_fd_handler(conn->fd, NULL, NULL, NULL);
+    list_del(&conn->drain_node);
+    priskv_tcp_free_conn(conn);
+}
+
+/* the completions of MSG_ZEROCOPY wake up the closed socket */
+static void priskv_tcp_handle_drain(int fd, void *opaque, uint32_t events)
+{
+    priskv_tcp_conn *conn = opaque;
+
+    if (!priskv_thread_call_function(conn->thread, priskv_tcp_drain, conn)) {
+        priskv_tcp_drain_done(conn, false);
+    }
+}
+
+/* called by main thread */
+static void priskv_tcp_close_conn(priskv_tcp_conn *conn)
+{
+    uint32_t timeout = PRISKV_TCP_CLOSE_USER_TIMEOUT_MS;
+    struct epoll_event event = {0};
+
+    if (conn->thread) {
+        priskv_thread_del_event_handler(conn->thread, conn->fd);
+        if (conn->doorbell >= 0) {
+            priskv_thread_del_event_handler(conn->thread, conn->doorbell);
+        }
+        priskv_thread_call_function(conn->thread, priskv_tcp_quiesce, conn);
+    }
+    priskv_set_fd_handler(conn->fd, NULL, NULL, NULL);
+
+    if (conn->rconn) {
+        priskv_rdma_conn_close(conn->rconn);
+    } else {
+        priskv_log_notice("TCP: <%s - %s> close\n", conn->local_addr, conn->peer_addr);
+    }
+
+    if (conn->doorbell >= 0) {
+        priskv_set_fd_handler(conn->doorbell, NULL, NULL, NULL);
+        close(conn->doorbell);
+        close(conn->kick);
+    }
+
+    if (conn->shm) {
+        priskv_shm_detach(conn->shm);
+        free(conn->shm);
+    }
+
+    if (list_empty(&conn->zc_segs)) {
+        priskv_tcp_free_conn(conn);
+        return;
+    }
+
+    /*
+     * the kernel still holds the values sent by MSG_ZEROCOPY, a reset leaves them unsent but the
+     * completions may never come. Close gracefully instead, and bound the wait by the user timeout
+     */
+    priskv_log_debug("TCP: <%s - %s> wait for MSG_ZEROCOPY\n", conn->local_addr, conn->peer_addr);
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout));
+    shutdown(conn->fd, SHUT_RDWR);
+    conn->drain_deadline = priskv_tcp_now_ms() + PRISKV_TCP_CLOSE_DRAIN_MS;
+    list_add_tail(&g_tcp.draining, &conn->drain_node);
+
+    priskv_set_fd_handler(conn->fd, priskv_tcp_handle_drain, NULL, conn);
+    event.events = EPOLLIN | EPOLLET;
+    event.data.fd = conn->fd;
+    if (epoll_ctl(g_tcp.epollfd, EPOLL_CTL_ADD, conn->fd, &event)) {
+        priskv_log_warn("TCP: <%s - %s> failed to wait for MSG_ZEROCOPY: %m\n", conn->local_addr,
+                        conn->peer_addr);
+        list_del(&conn->drain_node);
+        priskv_set_fd_handler(conn->fd, NULL, NULL, NULL);
+        priskv_tcp_free_conn(conn);
+    }
+}
+
+/* the kernel gives up the closed connections by the user timeout, this is the last resort */
+static void priskv_tcp_check_draining(void)
+{
+    priskv_tcp_conn *conn, *tmp;
+    uint64_t now;
+
+    if (list_empty(&g_tcp.draining)) {
+        return;
+    }
+
+    now = priskv_tcp_now_ms();
+    list_for_each_safe (&g_tcp.draining, conn, tmp, drain_node) {
+        if (now >= conn->drain_deadline) {
+            priskv_tcp_drain_done(conn, !!priskv_thread_call_function(conn->thread,
+                                                                     priskv_tcp_drain, conn));
+        }
+    }
+}
+
+static void priskv_tcp_close_disconnected(priskv_tcp_listener *listener)
+{
+    priskv_tcp_conn *conn, *tmp;
+
+    pthread_spin_lock(&listener->lock);
+    list_for_each_safe (&listener->conns, conn, tmp, node) {
+        if (!conn->closing) {
+            continue;
+        }
+
+        listener->nconns--;
+        list_del(&conn->node);
+        pthread_spin_unlock(&listener->lock);
+
+        priskv_tcp_close_conn(conn);
+
+        pthread_spin_lock(&listener->lock);
+    }
+    pthread_spin_unlock(&listener->lock);
+}
+
+static bool priskv_shm_uid_allowed(uid_t uid)
+{
+    if (uid == geteuid()) {
+        return true;
+    }
+
+    for (int i = 0; i < g_shm_nallow_uids; i++) {
+        if (uid == g_shm_allow_uids[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void priskv_tcp_handle_accept(int fd, void *opaque, uint32_t events)
+{
+    priskv_tcp_listener *listener = opaque;
+    struct sockaddr_storage local, peer;
+    socklen_t local_len = sizeof(local), peer_len = sizeof(peer);
+    struct epoll_event event = {0};
+    priskv_tcp_conn *conn;
+    int one = 1, connfd;
+
+    for (;;) {
+        local_len = sizeof(local);
+        peer_len = sizeof(peer);
+        connfd = accept4(fd, (struct sockaddr *)&peer, &peer_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connfd < 0) {
+            if (errno != EAGAIN) {
+                priskv_log_warn("TCP: <%s> accept failed: %m\n", listener->address);
+            }
+            return;
+        }
+
+        conn = calloc(1, sizeof(priskv_tcp_conn));
+        assert(conn);
+        conn->fd = connfd;
+        conn->listener = listener;
+        conn->kv = g_tcp.kv;
+        conn->state = PRISKV_TCP_STATE_HANDSHAKE;
+        conn->doorbell = conn->kick = -1;
+        list_head_init(&conn->tx_segs);
+        list_head_init(&conn->zc_segs);
+        conn->rx_resume.fn = priskv_tcp_resume_deferred;
+        conn->rx_resume.opaque = conn;
+        conn->tx_flush.fn = priskv_tcp_flush_deferred;
+        conn->tx_flush.opaque = conn;
+        conn->rx_buf = malloc(PRISKV_TCP_RX_BUF_SIZE);
+        assert(conn->rx_buf);
+
+        if (listener->shm) {
+            /* a local process, verified by its uid instead of the address */
+            struct ucred cred;
+            socklen_t cred_len = sizeof(cred);
+
+            snprintf(conn->local_addr, sizeof(conn->local_addr), "%s", listener->address);
+            if (getsockopt(connfd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) ||
+                !priskv_shm_uid_allowed(cred.uid)) {
+                priskv_log_error("TCP: <%s> refuse shm peer of uid %d\n", listener->address,
+                                 cred_len == sizeof(cred) ? (int)cred.uid : -1);
+                close(connfd);
+                free(conn->rx_buf);
+                free(conn);
+                continue;
+            }
+            snprintf(conn->peer_addr, sizeof(conn->peer_addr), "shm-%d", cred.pid);
+            conn->doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            conn->kick = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            assert((conn->doorbell >= 0) && (conn->kick >= 0));
+            goto accepted;
+        }
+
+        getsockname(connfd, (struct sockaddr *)&local, &local_len);
+        priskv_inet_ntop((struct sockaddr *)&local, conn->local_addr);
+        priskv_inet_ntop((struct sockaddr *)&peer, conn->peer_addr);
+
+        if (priskv_acl_verify((struct sockaddr *)&peer)) {
+            priskv_tcp_cm_reply reply = {0};
+
+            priskv_log_error("TCP: <%s - %s> ACL verification failed\n", conn->local_addr,
+                             conn->peer_addr);
+            /* best effort, the socket buffer of a new connection is empty */
+            reply.status = htobe16(PRISKV_RDMA_CM_REJ_STATUS_ACL_REFUSE);
+            reply.rej.version = htobe16(PRISKV_RDMA_CM_VERSION);
+            reply.rej.status = reply.status;
+            if (send(connfd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+                priskv_log_debug("TCP: <%s - %s> failed to reject: %m\n", conn->local_addr,
+                                 conn->peer_addr);
+            }
+            close(connfd);
+            free(conn->rx_buf);
+            free(conn);
+            continue;
+        }
+
+        setsockopt(connfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        conn->zerocopy = !setsockopt(connfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+
+accepted:
+        pthread_spin_lock(&listener->lock);
+        list_add_tail(&listener->conns, &conn->node);
+        listener->nconns++;
+        pthread_spin_unlock(&listener->lock);
+
+        /* the idlest worker thread handles the connection, EPOLLOUT flushes the pending data */
+        priskv_set_fd_handler(connfd, priskv_tcp_handle_in, priskv_tcp_handle_out, conn);
+        conn->thread = priskv_threadpool_find_iothread(g_threadpool);
+        priskv_thread_add_event_handler(conn->thread, connfd);
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.fd = connfd;
+        epoll_ctl(priskv_thread_get_epollfd(conn->thread), EPOLL_CTL_MOD, connfd, &event);
+        if (conn->doorbell >= 0) {
+            priskv_set_fd_handler(conn->doorbell, priskv_tcp_handle_doorbell, NULL, conn);
+            priskv_thread_add_event_handler(conn->thread, conn->doorbell);
+        }
+
+        priskv_log_info("TCP: <%s - %s> accepted by thread %d, zerocopy %s\n", conn->local_addr,
+                        conn->peer_addr, priskv_thread_get_index(conn->thread),
+                        conn->zerocopy ? "on" : "off");
+    }
+}
+
+static void priskv_tcp_handle_kick(int fd, void *opaque, uint32_t events)
+{
+    uint64_t kick;
+
+    while (read(fd, &kick, sizeof(kick)) > 0) {
+        ;
+    }
+}
+
+static int priskv_tcp_listen_one(char *addr, int port, priskv_rdma_conn_cap *cap)
+{
+    struct addrinfo hints = {0}, *res;
+    char service[8];
+    priskv_tcp_listener *listener;
+    int one = 1, fd, ret;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+    snprintf(service, sizeof(service), "%d", port);
+    ret = getaddrinfo(addr, service, &hints, &res);
+    if (ret) {
+        priskv_log_error("TCP: getaddrinfo %s failed: %s\n", addr, gai_strerror(ret));
+        return -1;
+    }
+
+    fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        priskv_log_error("TCP: socket failed: %m\n");
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, res->ai_addr, res->ai_addrlen) || listen(fd, PRISKV_TCP_MAX_LISTEN_BACKLOG)) {
+        priskv_log_error("TCP: failed to listen on %s:%d: %m\n", addr, port);
+        freeaddrinfo(res);
+        close(fd);
+        return -1;
+    }
+
+    listener = &g_tcp.listeners[g_tcp.nlisteners++];
+    listener->fd = fd;
+    listener->conn_cap = *cap;
+    priskv_inet_ntop(res->ai_addr, listener->address);
+    pthread_spin_init(&listener->lock, 0);
+    list_head_init(&listener->conns);
+    freeaddrinfo(res);
+
+    return 0;
+}
+
+/* the listeners of TCP and shm share the epoll fd of main thread */
+static int priskv_tcp_start(void *kv)
+{
+    if (g_tcp.epollfd >= 0) {
+        return 0;
+    }
+
+    if (priskv_rdma_handler_init(kv)) {
+        return -1;
+    }
+
+    g_tcp.kv = kv;
+    list_head_init(&g_tcp.draining);
+    g_tcp.epollfd = epoll_create1(EPOLL_CLOEXEC);
+    g_tcp.eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((g_tcp.epollfd < 0) || (g_tcp.eventfd < 0)) {
+        priskv_log_error("TCP: failed to create epoll fd/event fd: %m\n");
+        return -1;
+    }
+
+    priskv_set_fd_handler(g_tcp.eventfd, priskv_tcp_handle_kick, NULL, NULL);
+    if (priskv_add_event_fd(g_tcp.epollfd, g_tcp.eventfd)) {
+        priskv_log_error("TCP: failed to add event fd into epoll fd %m\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int priskv_tcp_listener_ready(priskv_tcp_listener *listener)
+{
+    priskv_set_fd_handler(listener->fd, priskv_tcp_handle_accept, NULL, listener);
+    if (priskv_add_event_fd(g_tcp.epollfd, listener->fd)) {
+        priskv_log_error("TCP: failed to add listen fd into epoll fd %m\n");
+        return -1;
+    }
+
+    priskv_log_notice("TCP: <%s> ready\n", listener->address);
+    return 0;
+}
+
+int priskv_tcp_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_conn_cap *cap)
+{
+    if (priskv_tcp_start(kv)) {
+        return -1;
+    }
+
+    for (int i = 0; i < naddr; i++) {
+        if (priskv_tcp_listen_one(addr[i], port, cap) ||
+            priskv_tcp_listener_ready(&g_tcp.listeners[g_tcp.nlisteners - 1])) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* the socket directory is owned by us and writable by nobody else, other users allowed to connect
+ * by shm may only pass through it */
+static int priskv_shm_prepare_dir(const char *dir)
+{
+    mode_t mode = g_shm_nallow_uids ? 0711 : 0700;
+    struct stat st;
+
+    if (mkdir(dir, mode) && (errno != EEXIST)) {
+        priskv_log_error("TCP: failed to create %s: %m\n", dir);
+        return -1;
+    }
+
+    if (lstat(dir, &st) || !S_ISDIR(st.st_mode) || (st.st_uid != geteuid()) ||
+        (st.st_mode & 022)) {
+        priskv_log_error("TCP: %s is not a directory private to uid %d\n", dir, geteuid());
+        return -1;
+    }
+
+    if (((st.st_mode & 0777) != mode) && chmod(dir, mode)) {
+        priskv_log_error("TCP: failed to chmod %s: %m\n", dir);
+        return -1;
+    }
+
+    return 0;
+}
+
+int priskv_shm_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_conn_cap *cap)
+{
+    struct sockaddr_un sun = {.sun_family = AF_UNIX};
+    priskv_tcp_listener *listener;
+    int fd;
+
+    if (priskv_tcp_start(kv)) {
+        return -1;
+    }
+
+    if (priskv_shm_prepare_dir(g_shm_dir)) {
+        return -1;
+    }
+
+    /* the co-located clients find the server by port, regardless of the bound addresses */
+    priskv_shm_sock_path(g_shm_dir, port, sun.sun_path);
+    unlink(sun.sun_path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        priskv_log_error("TCP: socket failed: %m\n");
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) ||
+        chmod(sun.sun_path, g_shm_nallow_uids ? 0666 : 0600) ||
+        listen(fd, PRISKV_TCP_MAX_LISTEN_BACKLOG)) {
+        priskv_log_error("TCP: failed to listen on %s: %m\n", sun.sun_path);
+        close(fd);
+        return -1;
+    }
+
+    listener = &g_tcp.listeners[g_tcp.nlisteners++];
+    listener->fd = fd;
+    listener->shm = true;
+    listener->conn_cap = *cap;
+    snprintf(listener->address, sizeof(listener->address), "%s", sun.sun_path);
+    pthread_spin_init(&listener->lock, 0);
+    list_head_init(&listener->conns);
+
+    return priskv_tcp_listener_ready(listener);
+}
+
+int priskv_tcp_get_fd(void)
+{
+    return g_tcp.epollfd;
+}
+
+void priskv_tcp_process(void)
+{
+    priskv_events_process(g_tcp.epollfd, 0);
+
+    for (int i = 0; i < g_tcp.nlisteners; i++) {
+        priskv_tcp_close_disconnected(&g_tcp.listeners[i]);
+    }
+    priskv_tcp_check_draining();
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#ifndef __PRISKV_SERVER_TCP__
+#define __PRISKV_SERVER_TCP__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include <sys/types.h>
+
+#include "rdma.h"
+
+/* copying a small value is cheaper than the page pinning and the completion of MSG_ZEROCOPY */
+#define PRISKV_TCP_ZEROCOPY_MIN (16 * 1024)
+/* stop reading requests from a connection if the responses pile up */
+#define PRISKV_TCP_MAX_TX_PENDING (64UL * 1024 * 1024)
+
+extern const char *g_shm_dir;
+extern uint64_t g_shm_ring_size;
+
+#define PRISKV_SHM_MAX_ALLOW_UIDS 16
+/* the users besides the server's own allowed to connect by shm */
+extern uid_t g_shm_allow_uids[PRISKV_SHM_MAX_ALLOW_UIDS];
+extern int g_shm_nallow_uids;
+
+int priskv_tcp_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_conn_cap *cap);
+/* listen to a unix socket in @g_shm_dir for the same-host transport, see priskv-shm.h */
+int priskv_shm_listen(char **addr, int naddr, int port, void *kv, priskv_rdma_conn_cap *cap);
+int priskv_tcp_get_fd(void);
+void priskv_tcp_process(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __PRISKV_SERVER_TCP__ */
@@ -0,0 +1,108 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Backend test helpers: run an operation and drive the event loop of the device until it
+ * calls back.
+ */
+
+#ifndef __PRISKV_TEST_BACKEND_H__
+#define __PRISKV_TEST_BACKEND_H__
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../backend/backend.h"
+#include "priskv-event.h"
+
+typedef struct test_waiter {
+    bool done;
+    priskv_backend_status status;
+    uint32_t length;
+} test_waiter;
+
+static inline void test_cb(priskv_backend_status status, uint32_t length, void *arg)
+{
+    test_waiter *w = arg;
+
+    w->done = true;
+    w->status = status;
+    w->length = length;
+}
+
+static inline void test_wait(priskv_backend_device *bdev, test_waiter *w)
+{
+    for (int i = 0; i < 1000 && !w->done; i++) {
+        priskv_events_process(bdev->epollfd, 10);
+    }
+    assert(w->done);
+}
+
+static inline priskv_backend_status test_set(priskv_backend_device *bdev, const char *key,
+                                             uint8_t *val, uint64_t valuelen)
+{
+    test_waiter w = {0};
+
+    priskv_backend_set(bdev, key, val, valuelen, 0, test_cb, &w);
+    test_wait(bdev, &w);
+
+    return w.status;
+}
+
+static inline priskv_backend_status test_get(priskv_backend_device *bdev, const char *key,
+                                             uint8_t *val, uint64_t valuelen, uint32_t *length)
+{
+    test_waiter w = {0};
+
+    priskv_backend_get(bdev, key, val, valuelen, test_cb, &w);
+    test_wait(bdev, &w);
+    *length = w.length;
+
+    return w.status;
+}
+
+static inline priskv_backend_status test_test(priskv_backend_device *bdev, const char *key,
+                                              uint32_t *length)
+{
+    test_waiter w = {0};
+
+    priskv_backend_test(bdev, key, test_cb, &w);
+    test_wait(bdev, &w);
+    *length = w.length;
+
+    return w.status;
+}
+
+static inline void test_del(priskv_backend_device *bdev, const char *key)
+{
+    test_waiter w = {0};
+
+    priskv_backend_del(bdev, key, test_cb, &w);
+    test_wait(bdev, &w);
+    assert(w.status == PRISKV_BACKEND_STATUS_OK);
+}
+
+static inline priskv_backend_status test_evict_key(priskv_backend_device *bdev, uint32_t *length)
+{
+    test_waiter w = {0};
+
+    bdev->bdrv->evict(bdev, test_cb, &w);
+    test_wait(bdev, &w);
+    *length = w.length;
+
+    return w.status;
+}
+
+#endif /* __PRISKV_TEST_BACKEND_H__ */
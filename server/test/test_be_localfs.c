@@ -0,0 +1,314 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Local filesystem backend tests over several directories
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+
+#include "../crc.h"
+#include "test_backend.h"
+
+#define TEST_DEVICES 3
+#define TEST_STRIPE_SIZE 4096
+
+static int epollfd;
+static char dirs[TEST_DEVICES][PATH_MAX];
+
+/* number of directories holding a file of @key */
+static int test_copies(const char *key)
+{
+    char path[PATH_MAX * 2];
+    int copies = 0;
+
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dirs[i], key);
+        copies += !access(path, F_OK);
+    }
+
+    return copies;
+}
+
+static priskv_backend_device *test_open(const char *opts)
+{
+    char address[PATH_MAX * 4];
+
+    snprintf(address, sizeof(address), "localfs:%s,%s,%s&%s", dirs[0], dirs[1], dirs[2], opts);
+
+    return priskv_backend_open(address, epollfd);
+}
+
+/* keys spread over the directories, a large value is striped over all of them */
+static void test_stripe(void)
+{
+    priskv_backend_device *bdev = test_open("size=1MB&stripe=4096");
+    uint64_t biglen = 3 * TEST_STRIPE_SIZE + 100;
+    uint8_t *big = malloc(biglen), *buf = malloc(biglen);
+    uint8_t val[64];
+    char key[32], path[PATH_MAX * 2];
+    uint32_t length, home;
+    int spread = 0;
+
+    assert(bdev);
+
+    for (int i = 0; i < 32; i++) {
+        snprintf(key, sizeof(key), "key-%d", i);
+        memset(val, i, sizeof(val));
+        assert(test_set(bdev, key, val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+        assert(test_copies(key) == 1);
+    }
+    for (int d = 0; d < TEST_DEVICES; d++) {
+        for (int i = 0; i < 32; i++) {
+            snprintf(path, sizeof(path), "%s/key-%d", dirs[d], i);
+            if (!access(path, F_OK)) {
+                spread++;
+                break;
+            }
+        }
+    }
+    assert(spread > 1);
+
+    for (uint64_t i = 0; i < biglen; i++) {
+        big[i] = i % 251;
+    }
+    assert(test_set(bdev, "big", big, biglen) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_copies("big") == TEST_DEVICES);
+    assert(test_test(bdev, "big", &length) == PRISKV_BACKEND_STATUS_OK && length == biglen);
+    assert(test_get(bdev, "big", buf, biglen, &length) == PRISKV_BACKEND_STATUS_OK);
+    assert(length == biglen && !memcmp(buf, big, biglen));
+    assert(test_get(bdev, "big", buf, biglen - 1, &length) ==
+           PRISKV_BACKEND_STATUS_VALUE_TOO_BIG);
+
+    /* a smaller value drops the stale stripes */
+    assert(test_set(bdev, "big", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_copies("big") == 1);
+    assert(test_get(bdev, "big", buf, biglen, &length) == PRISKV_BACKEND_STATUS_OK);
+    assert(length == sizeof(val) && !memcmp(buf, val, sizeof(val)));
+
+    assert(test_set(bdev, "big", big, biglen) == PRISKV_BACKEND_STATUS_OK);
+    test_del(bdev, "big");
+    assert(test_copies("big") == 0);
+    assert(test_get(bdev, "big", buf, biglen, &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+
+    /* a SET failing on one stripe drops the whole key, not a mix of old and new stripes */
+    assert(test_set(bdev, "torn", big, biglen) == PRISKV_BACKEND_STATUS_OK);
+    home = priskv_crc32((uint8_t *)"torn", strlen("torn")) % TEST_DEVICES;
+    snprintf(path, sizeof(path), "%s/torn", dirs[(home + 1) % TEST_DEVICES]);
+    assert(!unlink(path) && !mkdir(path, 0755));
+    memset(big, 'n', biglen);
+    assert(test_set(bdev, "torn", big, biglen) != PRISKV_BACKEND_STATUS_OK);
+    assert(test_copies("torn") == 1);
+    assert(test_get(bdev, "torn", buf, biglen, &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+    assert(!rmdir(path));
+
+    for (int i = 0; i < 32; i++) {
+        snprintf(key, sizeof(key), "key-%d", i);
+        test_del(bdev, key);
+        assert(test_copies(key) == 0);
+    }
+
+    free(big);
+    free(buf);
+    assert(!priskv_backend_close(bdev));
+}
+
+/* a new key goes to the directory with the most free space */
+static void test_place_free(void)
+{
+    priskv_backend_device *bdev = test_open("size=64KB&place=free");
+    uint8_t val[16 << 10];
+    char key[32];
+
+    assert(bdev);
+    memset(val, 'f', sizeof(val));
+
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        snprintf(key, sizeof(key), "free-%d", i);
+        assert(test_set(bdev, key, val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    }
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        char path[PATH_MAX * 2];
+        int found = 0;
+
+        for (int k = 0; k < TEST_DEVICES; k++) {
+            snprintf(path, sizeof(path), "%s/free-%d", dirs[i], k);
+            found += !access(path, F_OK);
+        }
+        assert(found == 1);
+    }
+
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        snprintf(key, sizeof(key), "free-%d", i);
+        test_del(bdev, key);
+    }
+    assert(!priskv_backend_close(bdev));
+}
+
+/* space is accounted per directory, eviction frees the one short of space */
+static void test_evict(void)
+{
+    priskv_backend_device *bdev = test_open("size=32KB");
+    uint8_t val[12 << 10];
+    uint32_t length;
+    char key[32];
+    int i;
+
+    assert(bdev);
+    memset(val, 'e', sizeof(val));
+
+    /* fill until some directory can't take another value */
+    for (i = 0; bdev->bdrv->is_cacheable(bdev, sizeof(val)); i++) {
+        snprintf(key, sizeof(key), "evict-%d", i);
+        assert(test_set(bdev, key, val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    }
+    assert(i >= 2);
+
+    assert(test_evict_key(bdev, &length) == PRISKV_BACKEND_STATUS_OK && length == sizeof(val));
+    assert(bdev->bdrv->is_cacheable(bdev, sizeof(val)));
+
+    assert(!bdev->bdrv->clearup(bdev));
+    for (int k = 0; k < i; k++) {
+        snprintf(key, sizeof(key), "evict-%d", k);
+        assert(test_copies(key) == 0);
+    }
+    assert(!priskv_backend_close(bdev));
+}
+
+/* SETs written in one event pass, then acknowledged once durable as the sync mode says */
+static void test_sync(const char *sync)
+{
+    char opts[64], key[32];
+    test_waiter w[16] = {0};
+    uint8_t val[16][256], buf[256];
+    priskv_backend_device *bdev;
+    uint32_t length;
+
+    snprintf(opts, sizeof(opts), "size=1MB&sync=%s", sync);
+    bdev = test_open(opts);
+    assert(bdev);
+
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "sync-%d", i);
+        memset(val[i], i, sizeof(val[i]));
+        priskv_backend_set(bdev, key, val[i], sizeof(val[i]), 0, test_cb, &w[i]);
+    }
+    for (int i = 0; i < 16; i++) {
+        test_wait(bdev, &w[i]);
+        assert(w[i].status == PRISKV_BACKEND_STATUS_OK && w[i].length == sizeof(val[i]));
+    }
+
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "sync-%d", i);
+        assert(test_get(bdev, key, buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_OK);
+        assert(length == sizeof(buf) && !memcmp(buf, val[i], length));
+        test_del(bdev, key);
+        assert(test_copies(key) == 0);
+    }
+
+    assert(!priskv_backend_close(bdev));
+}
+
+/* a file removed behind the backend reads as a missing key */
+static void test_vanished(void)
+{
+    priskv_backend_device *bdev = test_open("size=1MB");
+    char path[PATH_MAX * 2];
+    uint8_t val[64], buf[64];
+    uint32_t length;
+
+    assert(bdev);
+    memset(val, 'x', sizeof(val));
+
+    assert(test_set(bdev, "vanished", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        snprintf(path, sizeof(path), "%s/vanished", dirs[i]);
+        unlink(path);
+    }
+
+    assert(test_get(bdev, "vanished", buf, sizeof(buf), &length) ==
+           PRISKV_BACKEND_STATUS_NOT_FOUND);
+    assert(test_test(bdev, "vanished", &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+    test_del(bdev, "vanished");
+
+    assert(!priskv_backend_close(bdev));
+}
+
+/* TEST and DEL complete on the event loop, not from the submitting call */
+static void test_async(void)
+{
+    priskv_backend_device *bdev = test_open("size=1MB");
+    test_waiter w = {0};
+    uint32_t length;
+    uint8_t val[64];
+
+    assert(bdev);
+    memset(val, 'a', sizeof(val));
+    assert(test_set(bdev, "async", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+
+    priskv_backend_test(bdev, "async", test_cb, &w);
+    assert(!w.done);
+    test_wait(bdev, &w);
+    assert(w.status == PRISKV_BACKEND_STATUS_OK && w.length == sizeof(val));
+
+    memset(&w, 0, sizeof(w));
+    priskv_backend_del(bdev, "async", test_cb, &w);
+    assert(!w.done);
+    test_wait(bdev, &w);
+    assert(w.status == PRISKV_BACKEND_STATUS_OK && w.length == sizeof(val));
+    assert(test_copies("async") == 0);
+
+    /* a key the policy doesn't know may be answered right away */
+    assert(test_test(bdev, "async", &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+
+    assert(!priskv_backend_close(bdev));
+}
+
+int main()
+{
+    char cmd[PATH_MAX * 2];
+
+    epollfd = epoll_create1(0);
+    assert(epollfd >= 0);
+
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        strcpy(dirs[i], "/tmp/priskv-test-localfs-XXXXXX");
+        assert(mkdtemp(dirs[i]));
+    }
+
+    test_stripe();
+    test_place_free();
+    test_evict();
+    test_sync("none");
+    test_sync("group");
+    test_sync("write");
+    test_vanished();
+    test_async();
+
+    close(epollfd);
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", dirs[i]);
+        assert(!system(cmd));
+    }
+    printf("TEST localfs: OK\n");
+
+    return 0;
+}
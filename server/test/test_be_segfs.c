@@ -0,0 +1,226 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Segment store backend tests
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "test_backend.h"
+
+#define TEST_SEGMENT_SIZE (1UL << 20)
+#define TEST_VALUE_SIZE (256UL << 10)
+
+static int epollfd;
+static char address[PATH_MAX];
+
+static void test_basic(void)
+{
+    priskv_backend_device *bdev = priskv_backend_open(address, epollfd);
+    uint8_t val[64], buf[64];
+    uint32_t length;
+
+    assert(bdev);
+    memset(val, 'v', sizeof(val));
+
+    assert(test_set(bdev, "foo", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_get(bdev, "foo", buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_OK);
+    assert(length == sizeof(val));
+    assert(!memcmp(buf, val, sizeof(val)));
+
+    /* the buffer is too small for the value */
+    assert(test_get(bdev, "foo", buf, sizeof(buf) / 2, &length) ==
+           PRISKV_BACKEND_STATUS_VALUE_TOO_BIG);
+    assert(test_get(bdev, "bar", buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+
+    assert(test_test(bdev, "foo", &length) == PRISKV_BACKEND_STATUS_OK && length == sizeof(val));
+
+    test_del(bdev, "foo");
+    assert(test_test(bdev, "foo", &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+
+    /* a value never spans segments */
+    uint8_t *big = malloc(TEST_SEGMENT_SIZE + 1);
+    assert(test_set(bdev, "big", big, TEST_SEGMENT_SIZE + 1) ==
+           PRISKV_BACKEND_STATUS_VALUE_TOO_BIG);
+    free(big);
+
+    assert(!priskv_backend_close(bdev));
+}
+
+/* overwrite far more than the capacity, the GC recycles the dead segments */
+static void test_gc(void)
+{
+    priskv_backend_device *bdev = priskv_backend_open(address, epollfd);
+    uint8_t *val = malloc(TEST_VALUE_SIZE), *buf = malloc(TEST_VALUE_SIZE);
+    uint32_t length;
+
+    assert(bdev);
+
+    for (int i = 0; i < 64; i++) {
+        memset(val, i, TEST_VALUE_SIZE);
+        assert(test_set(bdev, i % 2 ? "odd" : "even", val, TEST_VALUE_SIZE) ==
+               PRISKV_BACKEND_STATUS_OK);
+    }
+
+    assert(test_get(bdev, "even", buf, TEST_VALUE_SIZE, &length) == PRISKV_BACKEND_STATUS_OK);
+    memset(val, 62, TEST_VALUE_SIZE);
+    assert(length == TEST_VALUE_SIZE && !memcmp(buf, val, TEST_VALUE_SIZE));
+
+    assert(test_get(bdev, "odd", buf, TEST_VALUE_SIZE, &length) == PRISKV_BACKEND_STATUS_OK);
+    memset(val, 63, TEST_VALUE_SIZE);
+    assert(length == TEST_VALUE_SIZE && !memcmp(buf, val, TEST_VALUE_SIZE));
+
+    test_del(bdev, "even");
+    test_del(bdev, "odd");
+
+    free(val);
+    free(buf);
+    assert(!priskv_backend_close(bdev));
+}
+
+/* the LRU key goes first, a GET refreshes a key */
+static void test_evict(void)
+{
+    priskv_backend_device *bdev = priskv_backend_open(address, epollfd);
+    uint8_t val[16], buf[16];
+    uint32_t length;
+
+    assert(bdev);
+    memset(val, 'e', sizeof(val));
+
+    assert(test_set(bdev, "k1", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_set(bdev, "k2", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_get(bdev, "k1", buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_OK);
+
+    assert(test_evict_key(bdev, &length) == PRISKV_BACKEND_STATUS_OK && length == sizeof(val));
+    assert(test_get(bdev, "k2", buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_NOT_FOUND);
+
+    assert(test_evict_key(bdev, &length) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_evict_key(bdev, &length) == PRISKV_BACKEND_STATUS_NO_SPACE);
+
+    assert(!priskv_backend_close(bdev));
+}
+
+/* the index survives a clean close */
+static void test_checkpoint(void)
+{
+    priskv_backend_device *bdev = priskv_backend_open(address, epollfd);
+    uint8_t val[128], buf[128];
+    char key[32];
+    uint32_t length;
+
+    assert(bdev);
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "ckpt-%d", i);
+        memset(val, i, sizeof(val));
+        assert(test_set(bdev, key, val, sizeof(val) - i) == PRISKV_BACKEND_STATUS_OK);
+    }
+    assert(!priskv_backend_close(bdev));
+
+    bdev = priskv_backend_open(address, epollfd);
+    assert(bdev);
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "ckpt-%d", i);
+        memset(val, i, sizeof(val));
+        assert(test_get(bdev, key, buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_OK);
+        assert(length == sizeof(val) - i && !memcmp(buf, val, length));
+        test_del(bdev, key);
+    }
+    assert(!priskv_backend_close(bdev));
+}
+
+/* buddy extents of the value region go through O_DIRECT, other buffers via page cache */
+static void test_direct(const char *dir)
+{
+    const uint32_t block_size = 4096;
+    uint64_t region_size = 16 * block_size;
+    uint8_t *region = aligned_alloc(block_size, region_size);
+    uint8_t val[100], buf[100];
+    char direct_address[PATH_MAX];
+    priskv_backend_device *bdev;
+    uint32_t length;
+
+    assert(region);
+    priskv_backend_set_value_region(region, region_size, block_size);
+    snprintf(direct_address, sizeof(direct_address), "segfs:%s&size=%lu&segment=%lu&direct=1",
+             dir, 6 * TEST_SEGMENT_SIZE, TEST_SEGMENT_SIZE);
+    bdev = priskv_backend_open(direct_address, epollfd);
+    assert(bdev);
+
+    /* an extent shorter than a block, the tail of its block is padding */
+    memset(region, 'd', block_size);
+    assert(test_set(bdev, "direct", region, 100) == PRISKV_BACKEND_STATUS_OK);
+    memset(region + block_size, 0, block_size);
+    assert(test_get(bdev, "direct", region + block_size, 100, &length) ==
+           PRISKV_BACKEND_STATUS_OK);
+    assert(length == 100 && !memcmp(region + block_size, region, 100));
+
+    /* a multi-block extent */
+    for (uint64_t i = 0; i < 3 * block_size; i++) {
+        region[4 * block_size + i] = i % 251;
+    }
+    assert(test_set(bdev, "multi", region + 4 * block_size, 3 * block_size - 1) ==
+           PRISKV_BACKEND_STATUS_OK);
+    assert(test_get(bdev, "multi", region + 8 * block_size, 3 * block_size, &length) ==
+           PRISKV_BACKEND_STATUS_OK);
+    assert(length == 3 * block_size - 1 &&
+           !memcmp(region + 8 * block_size, region + 4 * block_size, length));
+
+    /* a buffer outside the region */
+    memset(val, 'p', sizeof(val));
+    assert(test_set(bdev, "paged", val, sizeof(val)) == PRISKV_BACKEND_STATUS_OK);
+    assert(test_get(bdev, "paged", buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_OK);
+    assert(length == sizeof(val) && !memcmp(buf, val, sizeof(val)));
+    assert(test_get(bdev, "direct", buf, sizeof(buf), &length) == PRISKV_BACKEND_STATUS_OK);
+    assert(length == 100 && !memcmp(buf, region, 100));
+
+    test_del(bdev, "direct");
+    test_del(bdev, "multi");
+    test_del(bdev, "paged");
+    assert(!priskv_backend_close(bdev));
+    free(region);
+}
+
+int main()
+{
+    char dir[] = "/tmp/priskv-test-segfs-XXXXXX";
+    char cmd[PATH_MAX];
+
+    assert(mkdtemp(dir));
+    snprintf(address, sizeof(address), "segfs:%s&size=%lu&segment=%lu", dir,
+             6 * TEST_SEGMENT_SIZE, TEST_SEGMENT_SIZE);
+
+    epollfd = epoll_create1(0);
+    assert(epollfd >= 0);
+
+    test_basic();
+    test_gc();
+    test_evict();
+    test_checkpoint();
+    test_direct(dir);
+
+    close(epollfd);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    assert(!system(cmd));
+    printf("TEST segfs: OK\n");
+
+    return 0;
+}
@@ -38,6 +38,8 @@
 #include "priskv-protocol-helper.h"
 #include "priskv-utils.h"
 
+extern char *tiering_backend_address;
+
 typedef struct test_kv {
     uint16_t keylen;
     uint8_t *key;
@@ -667,6 +669,596 @@ static int get_key_in_updating(void *kv)
     return 0;
 }
 
+static int set_key_cond_test(void *kv)
+{
+    const char *key = __func__;
+    uint16_t keylen = strlen(key) + 1;
+    const char *value = "value";
+    uint32_t valuelen = strlen(value) + 1;
+    uint8_t *set_value_in_kv;
+    uint32_t existlen = 0;
+    void *keynode;
+    int ret;
+
+    /* SETNX of an absent key */
+    ret = priskv_set_key_cond(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                              PRISKV_KEY_MAX_TIMEOUT, PRISKV_REQUEST_FLAG_NX, 0, &existlen,
+                              &keynode);
+    if (ret != PRISKV_RESP_STATUS_OK) {
+        printf("TEST KV: [%s] SETNX absent key, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    /* SETNX of a key in process */
+    ret = priskv_set_key_cond(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen * 2,
+                              PRISKV_KEY_MAX_TIMEOUT, PRISKV_REQUEST_FLAG_NX, 0, &existlen,
+                              &keynode);
+    if ((ret != PRISKV_RESP_STATUS_KEY_EXISTS) || (existlen != valuelen) || keynode) {
+        printf("TEST KV: [%s] SETNX key in process, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    /* replace version 0 by version 2, then version 1 and 2 are rejected */
+    ret = priskv_set_key_cond(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                              PRISKV_KEY_MAX_TIMEOUT, PRISKV_REQUEST_FLAG_VERSION, 2, &existlen,
+                              &keynode);
+    if (ret != PRISKV_RESP_STATUS_OK) {
+        printf("TEST KV: [%s] SET version 2, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+    priskv_set_key_end(keynode);
+
+    for (uint32_t version = 1; version <= 2; version++) {
+        ret = priskv_set_key_cond(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                                  PRISKV_KEY_MAX_TIMEOUT, PRISKV_REQUEST_FLAG_VERSION, version,
+                                  &existlen, &keynode);
+        if (ret != PRISKV_RESP_STATUS_KEY_EXISTS) {
+            printf("TEST KV: [%s] SET version %u over 2, status [%s] [FAILED]\n", __func__,
+                   version, priskv_resp_status_str(ret));
+            return 1;
+        }
+    }
+
+    ret = priskv_set_key_cond(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                              PRISKV_KEY_MAX_TIMEOUT, PRISKV_REQUEST_FLAG_VERSION, 3, &existlen,
+                              &keynode);
+    if ((ret != PRISKV_RESP_STATUS_OK) || (((priskv_key *)keynode)->version != 3)) {
+        printf("TEST KV: [%s] SET version 3, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+    priskv_set_key_end(keynode);
+
+    /* a plain SET always replaces */
+    ret = priskv_set_key(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                         PRISKV_KEY_MAX_TIMEOUT, &keynode);
+    if ((ret != PRISKV_RESP_STATUS_OK) || ((priskv_key *)keynode)->version) {
+        printf("TEST KV: [%s] SET over version 3, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+    priskv_set_key_end(keynode);
+
+    ret = priskv_delete_key(kv, (uint8_t *)key, keylen);
+    if (ret != PRISKV_RESP_STATUS_OK) {
+        printf("TEST KV: [%s] delete key from kv, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    return 0;
+}
+
+/* linked by -Wl,--wrap=priskv_buddy_alloc, runs @buddy_alloc_hook once in the next allocation */
+void *__real_priskv_buddy_alloc(void *buddy, uint32_t size);
+static void (*buddy_alloc_hook)(void);
+
+void *__wrap_priskv_buddy_alloc(void *buddy, uint32_t size)
+{
+    void (*hook)(void) = buddy_alloc_hook;
+
+    buddy_alloc_hook = NULL;
+    if (hook) {
+        hook();
+    }
+
+    return __real_priskv_buddy_alloc(buddy, size);
+}
+
+static void *version_race_kv;
+static const char version_race_key[] = "set_key_version_race_test";
+
+static void set_version_1(void)
+{
+    uint32_t existlen;
+    uint8_t *val;
+    void *keynode;
+
+    assert(priskv_set_key_cond(version_race_kv, (uint8_t *)version_race_key,
+                               sizeof(version_race_key), &val, 8, PRISKV_KEY_MAX_TIMEOUT,
+                               PRISKV_REQUEST_FLAG_VERSION, 1, &existlen,
+                               &keynode) == PRISKV_RESP_STATUS_OK);
+    priskv_set_key_end(keynode);
+}
+
+/* a SET of version 1 gets in between the pop and the insert of a SET of version 2 */
+static int set_key_version_race_test(void *kv)
+{
+    uint32_t existlen, valuelen;
+    uint8_t *val;
+    void *keynode;
+    int ret, nodes;
+
+    version_race_kv = kv;
+    buddy_alloc_hook = set_version_1;
+    ret = priskv_set_key_cond(kv, (uint8_t *)version_race_key, sizeof(version_race_key), &val, 8,
+                              PRISKV_KEY_MAX_TIMEOUT, PRISKV_REQUEST_FLAG_VERSION, 2, &existlen,
+                              &keynode);
+    if ((ret != PRISKV_RESP_STATUS_OK) || buddy_alloc_hook) {
+        printf("TEST KV: [%s] SET version 2, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+    priskv_set_key_end(keynode);
+
+    ret = priskv_get_key(kv, (uint8_t *)version_race_key, sizeof(version_race_key), &val,
+                         &valuelen, &keynode);
+    if ((ret != PRISKV_RESP_STATUS_OK) || (((priskv_key *)keynode)->version != 2)) {
+        printf("TEST KV: [%s] GET version 2, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+    priskv_get_key_end(keynode);
+
+    /* the node of version 1 is replaced, not left behind */
+    for (nodes = 0; priskv_delete_key(kv, (uint8_t *)version_race_key,
+                                      sizeof(version_race_key)) == PRISKV_RESP_STATUS_OK;
+         nodes++) {
+    }
+    if (nodes != 1) {
+        printf("TEST KV: [%s] %d nodes of the key [FAILED]\n", __func__, nodes);
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint32_t parked_get_woken;
+
+static void parked_get_wake(priskv_parked_get *pget)
+{
+    parked_get_woken++;
+}
+
+static int park_get_test(void *kv)
+{
+    const char *key = __func__;
+    uint16_t keylen = strlen(key) + 1;
+    const char *value = "value";
+    uint32_t valuelen = strlen(value) + 1;
+    uint8_t *set_value_in_kv, *get_value_in_kv;
+    uint32_t get_valuelen_in_kv;
+    priskv_parked_get pget = {.wake = parked_get_wake};
+    void *keynode, *get_keynode;
+    int ret;
+
+    ret = priskv_set_key(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                         PRISKV_KEY_MAX_TIMEOUT, &keynode);
+    if (ret != PRISKV_RESP_STATUS_OK) {
+        printf("TEST KV: [%s] set key, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    /* the GET of a key in process is woken by the end of SET */
+    ret = priskv_get_key(kv, (uint8_t *)key, keylen, &get_value_in_kv, &get_valuelen_in_kv,
+                         &get_keynode);
+    if ((ret != PRISKV_RESP_STATUS_KEY_UPDATING) || !priskv_park_get(kv, get_keynode, &pget)) {
+        printf("TEST KV: [%s] park GET, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    memcpy(set_value_in_kv, value, valuelen);
+    priskv_set_key_end(keynode);
+    if ((parked_get_woken != 1) || pget.timedout || priskv_unpark_get(kv, &pget)) {
+        printf("TEST KV: [%s] wake parked GET [FAILED]\n", __func__);
+        return 1;
+    }
+
+    /* the key is done already */
+    if (priskv_park_get(kv, get_keynode, &pget)) {
+        printf("TEST KV: [%s] park GET of a done key [FAILED]\n", __func__);
+        return 1;
+    }
+    priskv_get_key_end(get_keynode);
+
+    /* the GET gives up after the deadline */
+    ret = priskv_set_key(kv, (uint8_t *)key, keylen, &set_value_in_kv, valuelen,
+                         PRISKV_KEY_MAX_TIMEOUT, &keynode);
+    if ((ret != PRISKV_RESP_STATUS_OK) || !priskv_park_get(kv, keynode, &pget)) {
+        printf("TEST KV: [%s] park GET again, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    priskv_expire_parked_gets(kv);
+    if (parked_get_woken != 1) {
+        printf("TEST KV: [%s] parked GET expires early [FAILED]\n", __func__);
+        return 1;
+    }
+
+    usleep((PRISKV_KV_PARKED_GET_TIMEOUT_MS + 10) * 1000);
+    priskv_expire_parked_gets(kv);
+    if ((parked_get_woken != 2) || !pget.timedout) {
+        printf("TEST KV: [%s] parked GET timeout [FAILED]\n", __func__);
+        return 1;
+    }
+
+    memcpy(set_value_in_kv, value, valuelen);
+    priskv_set_key_end(keynode);
+    if (parked_get_woken != 2) {
+        printf("TEST KV: [%s] expired GET woken again [FAILED]\n", __func__);
+        return 1;
+    }
+
+    ret = priskv_delete_key(kv, (uint8_t *)key, keylen);
+    if (ret != PRISKV_RESP_STATUS_OK) {
+        printf("TEST KV: [%s] delete key from kv, status [%s] [FAILED]\n", __func__,
+               priskv_resp_status_str(ret));
+        return 1;
+    }
+
+    return 0;
+}
+
+static priskv_tiering_req *serialize_req_new(void *kv, const char *key)
+{
+    priskv_tiering_req *treq = calloc(1, sizeof(priskv_tiering_req) + strlen(key) + 1);
+
+    assert(treq);
+    treq->kv = kv;
+    treq->key = treq->keybuf;
+    treq->keylen = strlen(key);
+    memcpy(treq->key, key, treq->keylen);
+    treq->cmd = PRISKV_COMMAND_GET;
+    treq->hash_head_index = 0; /* all in the same bucket */
+    list_node_init(&treq->node);
+
+    return treq;
+}
+
+static int key_serialize_test(void *kv)
+{
+    priskv_tiering_req *a = serialize_req_new(kv, "serialize-a");
+    priskv_tiering_req *b = serialize_req_new(kv, "serialize-b");
+    priskv_tiering_req *c = serialize_req_new(kv, "serialize-a-longer");
+    priskv_tiering_req *flush = serialize_req_new(kv, "serialize-a");
+    int ret = 1;
+
+    /* the different keys in the same bucket go in parallel */
+    if (!priskv_key_serialize_enter(a) || !priskv_key_serialize_enter(b) ||
+        !priskv_key_serialize_enter(c)) {
+        printf("TEST KV: [%s] different keys in a bucket serialized [FAILED]\n", __func__);
+        goto out;
+    }
+
+    priskv_key_serialize_exit(a);
+    priskv_key_serialize_exit(b);
+    priskv_key_serialize_exit(c);
+
+    /* the key is free again, and a GET reads the memory while the key is written back */
+    a->cmd = flush->cmd = PRISKV_COMMAND_SET;
+    if (!priskv_key_serialize_enter(a)) {
+        printf("TEST KV: [%s] key busy after exit [FAILED]\n", __func__);
+        goto out;
+    }
+
+    priskv_key_serialize_handover(a, flush);
+    b->key = a->key;
+    b->keylen = a->keylen;
+    if (priskv_key_serialize_enter(b) || !b->shared) {
+        printf("TEST KV: [%s] GET during write back [FAILED]\n", __func__);
+        goto out;
+    }
+
+    priskv_key_serialize_exit(flush);
+    ret = 0;
+
+out:
+    free(a);
+    free(b);
+    free(c);
+    free(flush);
+    return ret;
+}
+
+/* the values fill a small KV, a dirty key gets demoted rather than evicted */
+static int dirty_key_evict_test(void)
+{
+    uint32_t max_keys = 8, value_block_size = 4096, valuelen = value_block_size * 2;
+    uint64_t value_blocks = 4;
+    uint16_t max_key_length = 16;
+    uint8_t *key_base = calloc(max_keys, priskv_mem_key_size(max_key_length));
+    uint8_t *value_base = calloc(1, priskv_buddy_mem_size(value_blocks, value_block_size));
+    const char *keys[] = {"dirty-a", "dirty-b", "dirty-c", "dirty-d"};
+    bool expected[][4] = {
+        {true, false, true, false}, /* "dirty-b" is evicted, "dirty-a" is dirty */
+        {false, false, true, true}, /* "dirty-a" is evicted once clean */
+    };
+    void *kv, *keynode, *dirty_keynode = NULL;
+    uint8_t *val;
+    uint32_t len;
+    int ret = 1;
+
+    kv = priskv_new_kv(key_base, value_base, max_keys, max_key_length, value_block_size,
+                       value_blocks);
+    assert(kv);
+
+    for (int i = 0; i < 4; i++) {
+        if (i == 3) {
+            priskv_set_key_dirty(dirty_keynode, false);
+        }
+
+        if (priskv_set_key(kv, (uint8_t *)keys[i], strlen(keys[i]), &val, valuelen,
+                           PRISKV_KEY_MAX_TIMEOUT, &keynode) != PRISKV_RESP_STATUS_OK) {
+            printf("TEST KV: [%s] set %s [FAILED]\n", __func__, keys[i]);
+            goto out;
+        }
+        priskv_set_key_end(keynode);
+
+        if (i == 0) {
+            dirty_keynode = keynode;
+            priskv_set_key_dirty(dirty_keynode, true);
+        }
+
+        if (i < 2) {
+            continue;
+        }
+
+        for (int j = 0; j < 4; j++) {
+            int status = priskv_get_key(kv, (uint8_t *)keys[j], strlen(keys[j]), &val, &len,
+                                        &keynode);
+            priskv_get_key_end(keynode);
+            if ((status == PRISKV_RESP_STATUS_OK) != expected[i - 2][j]) {
+                printf("TEST KV: [%s] get %s after setting %s [FAILED]\n", __func__, keys[j],
+                       keys[i]);
+                goto out;
+            }
+        }
+    }
+    ret = 0;
+
+out:
+    priskv_destroy_kv(kv);
+    free(key_base);
+    free(value_base);
+    return ret;
+}
+
+/* a stub backend holding the SETs till completed by demote_test */
+#define TEST_STUB_MAX_SETS 128
+typedef struct test_stub_write {
+    char key[16];
+    uint8_t byte; /* the first byte of value */
+    uint64_t valuelen;
+    priskv_backend_driver_cb cb;
+    void *cbarg;
+} test_stub_write;
+static test_stub_write test_stub_sets[TEST_STUB_MAX_SETS];
+static uint32_t test_stub_nsets;
+
+static int test_stub_open(priskv_backend_device *bdev)
+{
+    return 0;
+}
+
+static int test_stub_close(priskv_backend_device *bdev)
+{
+    return 0;
+}
+
+static bool test_stub_is_cacheable(priskv_backend_device *bdev, uint64_t valuelen)
+{
+    return true;
+}
+
+static void test_stub_get(priskv_backend_device *bdev, const char *key, uint8_t *val,
+                          uint64_t valuelen, priskv_backend_driver_cb cb, void *cbarg)
+{
+    cb(PRISKV_BACKEND_STATUS_NOT_FOUND, 0, cbarg);
+}
+
+static void test_stub_set(priskv_backend_device *bdev, const char *key, uint8_t *val,
+                          uint64_t valuelen, uint64_t timeout, priskv_backend_driver_cb cb,
+                          void *cbarg)
+{
+    test_stub_write *set = &test_stub_sets[test_stub_nsets++];
+
+    assert(test_stub_nsets <= TEST_STUB_MAX_SETS);
+    snprintf(set->key, sizeof(set->key), "%s", key);
+    set->byte = val[0];
+    set->valuelen = valuelen;
+    set->cb = cb;
+    set->cbarg = cbarg;
+}
+
+static void test_stub_miss(priskv_backend_device *bdev, const char *key,
+                           priskv_backend_driver_cb cb, void *cbarg)
+{
+    cb(PRISKV_BACKEND_STATUS_NOT_FOUND, 0, cbarg);
+}
+
+static void test_stub_evict(priskv_backend_device *bdev, priskv_backend_driver_cb cb, void *cbarg)
+{
+    cb(PRISKV_BACKEND_STATUS_NOT_FOUND, 0, cbarg);
+}
+
+static int test_stub_clearup(priskv_backend_device *bdev)
+{
+    return 0;
+}
+
+static priskv_backend_driver test_stub_driver = {
+    .name = "stub",
+    .open = test_stub_open,
+    .close = test_stub_close,
+    .is_cacheable = test_stub_is_cacheable,
+    .get = test_stub_get,
+    .set = test_stub_set,
+    .del = test_stub_miss,
+    .test = test_stub_miss,
+    .evict = test_stub_evict,
+    .clearup = test_stub_clearup,
+};
+
+static void test_stub_complete(uint32_t i, priskv_backend_status status)
+{
+    test_stub_sets[i].cb(status, test_stub_sets[i].valuelen, test_stub_sets[i].cbarg);
+    test_stub_sets[i].cb = NULL;
+}
+
+static int test_set_dirty(void *kv, const char *key, uint32_t valuelen, uint8_t byte, bool dirty)
+{
+    void *keynode;
+    uint8_t *val;
+    int status;
+
+    status = priskv_set_key(kv, (uint8_t *)key, strlen(key), &val, valuelen,
+                            PRISKV_KEY_MAX_TIMEOUT, &keynode);
+    if (status == PRISKV_RESP_STATUS_OK) {
+        memset(val, byte, valuelen);
+        priskv_set_key_end(keynode);
+        priskv_set_key_dirty(keynode, dirty);
+    }
+
+    return status;
+}
+
+static bool test_key_exists(void *kv, const char *key)
+{
+    void *keynode;
+    uint8_t *val;
+    uint32_t len;
+    int status = priskv_get_key(kv, (uint8_t *)key, strlen(key), &val, &len, &keynode);
+
+    priskv_get_key_end(keynode);
+    return status == PRISKV_RESP_STATUS_OK;
+}
+
+/* called in the iothread with the stub backend, see demote_test */
+static int demote_test_run(void *arg)
+{
+    uint32_t max_keys = 256, value_block_size = 4096, nkeys = 64;
+    uint64_t value_blocks = nkeys;
+    uint16_t max_key_length = 16;
+    uint8_t *key_base = calloc(max_keys, priskv_mem_key_size(max_key_length));
+    uint8_t *value_base = calloc(1, priskv_buddy_mem_size(value_blocks, value_block_size));
+    char key[16];
+    uint32_t ndemoted;
+    void *kv;
+    int ret = 1;
+
+    kv = priskv_new_kv(key_base, value_base, max_keys, max_key_length, value_block_size,
+                       value_blocks);
+    assert(kv);
+
+    /* the dirty keys fill the memory, the least recently used ones get demoted on the watermark */
+    for (uint32_t i = 0; i < nkeys; i++) {
+        snprintf(key, sizeof(key), "demote-%u", i);
+        if (test_set_dirty(kv, key, value_block_size, i, true) != PRISKV_RESP_STATUS_OK) {
+            printf("TEST KV: [%s] set %s [FAILED]\n", __func__, key);
+            goto out;
+        }
+    }
+    if (!test_stub_nsets || strcmp(test_stub_sets[0].key, "demote-0") ||
+        (test_stub_sets[0].byte != 0) || (test_stub_sets[0].valuelen != value_block_size)) {
+        printf("TEST KV: [%s] write demote-0 to backend [FAILED]\n", __func__);
+        goto out;
+    }
+
+    /* no clean key to evict, each SET demotes one more till PRISKV_TIERING_MAX_DEMOTIONS */
+    for (uint32_t i = 0; i < nkeys; i++) {
+        snprintf(key, sizeof(key), "full-%u", i);
+        if (test_set_dirty(kv, key, value_block_size, 0, false) != PRISKV_RESP_STATUS_NO_MEM) {
+            printf("TEST KV: [%s] set %s without clean key [FAILED]\n", __func__, key);
+            goto out;
+        }
+    }
+    if (test_stub_nsets != PRISKV_TIERING_MAX_DEMOTIONS) {
+        printf("TEST KV: [%s] %u demotions in flight over the cap [FAILED]\n", __func__,
+               test_stub_nsets);
+        goto out;
+    }
+
+    /* the first demotion fails, the others get written */
+    ndemoted = test_stub_nsets;
+    test_stub_complete(0, PRISKV_BACKEND_STATUS_ERROR);
+    for (uint32_t i = 1; i < ndemoted; i++) {
+        test_stub_complete(i, PRISKV_BACKEND_STATUS_OK);
+    }
+
+    /* the demoted keys get evicted, the failed one stays dirty in memory */
+    for (uint32_t i = 1; i < ndemoted; i++) {
+        snprintf(key, sizeof(key), "clean-%u", i);
+        if (test_set_dirty(kv, key, value_block_size, 0, false) != PRISKV_RESP_STATUS_OK) {
+            printf("TEST KV: [%s] set %s over a demoted key [FAILED]\n", __func__, key);
+            goto out;
+        }
+    }
+    for (uint32_t i = 1; i < ndemoted; i++) {
+        snprintf(key, sizeof(key), "demote-%u", i);
+        if (test_key_exists(kv, key)) {
+            printf("TEST KV: [%s] demoted %s not evicted [FAILED]\n", __func__, key);
+            goto out;
+        }
+    }
+    if (!test_key_exists(kv, "demote-0")) {
+        printf("TEST KV: [%s] key of failed demotion evicted [FAILED]\n", __func__);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    for (uint32_t i = 0; i < test_stub_nsets; i++) {
+        if (test_stub_sets[i].cb) {
+            test_stub_complete(i, PRISKV_BACKEND_STATUS_OK);
+        }
+    }
+    priskv_destroy_kv(kv);
+    free(key_base);
+    free(value_base);
+    return ret;
+}
+
+/* demote mode writes the dirty keys to a stub backend from an iothread */
+static int demote_test(void)
+{
+    static char stub_address[] = "stub:test";
+    priskv_threadpool *pool;
+    int ret;
+
+    priskv_backend_register(&test_stub_driver);
+    tiering_backend_address = stub_address;
+    tiering_enabled = true;
+    tiering_write_mode = PRISKV_TIERING_WRITE_DEMOTE;
+
+    pool = priskv_threadpool_create_with_hooks("test", 1, 0, 0, priskv_get_thread_backend_hooks());
+    assert(pool);
+    ret = priskv_thread_call_function(priskv_threadpool_get_iothread(pool, 0), demote_test_run,
+                                      NULL);
+    priskv_threadpool_destroy(pool);
+
+    tiering_enabled = false;
+    tiering_write_mode = PRISKV_TIERING_WRITE_THROUGH;
+    tiering_backend_address = NULL;
+
+    return ret;
+}
+
 static int test_hash_bucket_count()
 {
     void *kv;
@@ -888,7 +1480,50 @@ int main()
 
     printf("TEST KV: get UPDATING key [OK]\n");
 
-    /* step 16, set keys to empty KV without timeout */
+    /* step 16, conditional SET */
+    ret = set_key_cond_test(kv);
+    if (ret) {
+        return ret;
+    }
+
+    ret = set_key_version_race_test(kv);
+    if (ret) {
+        return ret;
+    }
+
+    printf("TEST KV: conditional SET [OK]\n");
+
+    /* step 17, park GET on UPDATING key */
+    ret = park_get_test(kv);
+    if (ret) {
+        return ret;
+    }
+
+    printf("TEST KV: park GET on UPDATING key [OK]\n");
+
+    /* step 18, tiering requests serialized by key */
+    ret = key_serialize_test(kv);
+    if (ret) {
+        return ret;
+    }
+
+    printf("TEST KV: serialize tiering requests by key [OK]\n");
+
+    /* step 19, dirty key demoted rather than evicted */
+    ret = dirty_key_evict_test();
+    if (ret) {
+        return ret;
+    }
+
+    printf("TEST KV: dirty key demoted rather than evicted [OK]\n");
+
+    ret = demote_test();
+    if (ret) {
+        return ret;
+    }
+    printf("TEST KV: demote dirty keys to backend [OK]\n");
+
+    /* step 20, set keys to empty KV without timeout */
     ret = get_keys(kv, test_kvs, max_keys);
     if (ret) {
         return ret;
@@ -0,0 +1,195 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qos.h"
+
+#define TEST_DEPTH 128
+
+static priskv_qos_conf test_conf[PRISKV_QOS_CLASS_MAX] = {
+    {.weight = 8, .budget = 0},
+    {.weight = 4, .budget = 0},
+    {.weight = 1, .budget = 0},
+};
+
+static void test_fifo(void)
+{
+    priskv_qos qos;
+    priskv_qos_queue queue;
+    priskv_qos_item item = {0};
+    priskv_qos_class cls;
+
+    priskv_qos_init(&qos, test_conf);
+    assert(!priskv_qos_queue_init(&queue, &queue, TEST_DEPTH));
+    assert(priskv_qos_queue_empty(&queue));
+    assert(!priskv_qos_dequeue(&qos, &cls, &item));
+
+    for (uint32_t i = 0; i < TEST_DEPTH; i++) {
+        item.len = i;
+        item.cost = PRISKV_QOS_MIN_COST;
+        assert(!priskv_qos_enqueue(&qos, &queue, PRISKV_QOS_CLASS_NORMAL, &item));
+    }
+    assert(priskv_qos_enqueue(&qos, &queue, PRISKV_QOS_CLASS_NORMAL, &item) == -ENOSPC);
+    assert(!priskv_qos_queue_empty(&queue));
+    assert(priskv_qos_queue_len(&queue) == TEST_DEPTH);
+
+    /* the requests of a connection keep the order */
+    for (uint32_t i = 0; i < TEST_DEPTH; i++) {
+        assert(priskv_qos_dequeue(&qos, &cls, &item) == &queue);
+        assert(cls == PRISKV_QOS_CLASS_NORMAL);
+        assert(item.len == i);
+    }
+
+    assert(priskv_qos_queue_empty(&queue));
+    assert(!priskv_qos_dequeue(&qos, &cls, &item));
+    priskv_qos_queue_deinit(&queue);
+}
+
+static void test_weight(void)
+{
+    priskv_qos qos;
+    priskv_qos_queue queue;
+    priskv_qos_item item = {.cost = PRISKV_QOS_QUANTUM};
+    priskv_qos_class cls;
+    uint32_t dequeued[PRISKV_QOS_CLASS_MAX] = {0};
+
+    priskv_qos_init(&qos, test_conf);
+    assert(!priskv_qos_queue_init(&queue, &queue, TEST_DEPTH));
+
+    for (uint32_t i = 0; i < TEST_DEPTH; i++) {
+        for (int c = 0; c < PRISKV_QOS_CLASS_MAX; c++) {
+            assert(!priskv_qos_enqueue(&qos, &queue, c, &item));
+        }
+    }
+
+    /* the backlogged classes share by weight 8:4:1 */
+    for (uint32_t i = 0; i < 13 * 8; i++) {
+        assert(priskv_qos_dequeue(&qos, &cls, &item));
+        dequeued[cls]++;
+    }
+    assert(dequeued[PRISKV_QOS_CLASS_HIGH] == 64);
+    assert(dequeued[PRISKV_QOS_CLASS_NORMAL] == 32);
+    assert(dequeued[PRISKV_QOS_CLASS_LOW] == 8);
+
+    /* the remaining requests are dequeued finally */
+    while (priskv_qos_dequeue(&qos, &cls, &item)) {
+        dequeued[cls]++;
+    }
+    for (int c = 0; c < PRISKV_QOS_CLASS_MAX; c++) {
+        assert(dequeued[c] == TEST_DEPTH);
+    }
+
+    priskv_qos_queue_deinit(&queue);
+}
+
+static void test_round_robin(void)
+{
+    priskv_qos qos;
+    priskv_qos_queue queues[4];
+    priskv_qos_item item = {.cost = PRISKV_QOS_MIN_COST};
+    priskv_qos_class cls;
+    uint32_t dequeued[4] = {0};
+    void *owner;
+
+    priskv_qos_init(&qos, test_conf);
+    for (int q = 0; q < 4; q++) {
+        assert(!priskv_qos_queue_init(&queues[q], &queues[q], TEST_DEPTH));
+    }
+
+    /* a greedy connection does not starve the others of the same class */
+    for (uint32_t i = 0; i < TEST_DEPTH; i++) {
+        assert(!priskv_qos_enqueue(&qos, &queues[0], PRISKV_QOS_CLASS_NORMAL, &item));
+    }
+    for (int q = 1; q < 4; q++) {
+        assert(!priskv_qos_enqueue(&qos, &queues[q], PRISKV_QOS_CLASS_NORMAL, &item));
+    }
+
+    for (int i = 0; i < 8; i++) {
+        owner = priskv_qos_dequeue(&qos, &cls, &item);
+        dequeued[(priskv_qos_queue *)owner - queues]++;
+    }
+    for (int q = 1; q < 4; q++) {
+        assert(dequeued[q] == 1);
+        assert(priskv_qos_queue_empty(&queues[q]));
+    }
+
+    /* detach drops the queued requests */
+    priskv_qos_queue_detach(&qos, &queues[0]);
+    assert(priskv_qos_queue_empty(&queues[0]));
+    assert(!priskv_qos_dequeue(&qos, &cls, &item));
+
+    for (int q = 0; q < 4; q++) {
+        priskv_qos_queue_deinit(&queues[q]);
+    }
+}
+
+static void test_budget(void)
+{
+    priskv_qos qos;
+    priskv_qos_queue queue;
+    priskv_qos_item item = {.cost = PRISKV_QOS_MIN_COST};
+    priskv_qos_class cls;
+    priskv_qos_conf conf[PRISKV_QOS_CLASS_MAX];
+
+    memcpy(conf, test_conf, sizeof(conf));
+    conf[PRISKV_QOS_CLASS_LOW].budget = 1024 * 1024;
+    priskv_qos_init(&qos, conf);
+    assert(!priskv_qos_queue_init(&queue, &queue, TEST_DEPTH));
+
+    assert(!priskv_qos_enqueue(&qos, &queue, PRISKV_QOS_CLASS_LOW, &item));
+    assert(!priskv_qos_enqueue(&qos, &queue, PRISKV_QOS_CLASS_LOW, &item));
+    assert(priskv_qos_dequeue(&qos, &cls, &item));
+    assert(cls == PRISKV_QOS_CLASS_LOW);
+
+    /* the class over budget waits for completions, the others keep going */
+    priskv_qos_charge(&qos, PRISKV_QOS_CLASS_LOW, 1024 * 1024);
+    assert(!priskv_qos_dequeue(&qos, &cls, &item));
+    assert(!priskv_qos_enqueue(&qos, &queue, PRISKV_QOS_CLASS_HIGH, &item));
+    assert(priskv_qos_dequeue(&qos, &cls, &item));
+    assert(cls == PRISKV_QOS_CLASS_HIGH);
+    assert(!priskv_qos_dequeue(&qos, &cls, &item));
+
+    priskv_qos_uncharge(&qos, PRISKV_QOS_CLASS_LOW, 1024 * 1024);
+    assert(priskv_qos_dequeue(&qos, &cls, &item));
+    assert(cls == PRISKV_QOS_CLASS_LOW);
+    assert(priskv_qos_queue_empty(&queue));
+
+    priskv_qos_queue_deinit(&queue);
+}
+
+int main()
+{
+    test_fifo();
+    test_weight();
+    test_round_robin();
+    test_budget();
+
+    return 0;
+}
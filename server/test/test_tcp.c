@@ -0,0 +1,283 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * TCP transport tests over loopback, the server runs in this process and the client connects by
+ * priskv_connect_tcp.
+ */
+
+#include <assert.h>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "priskv-protocol.h"
+#include "priskv-protocol-helper.h"
+#include "priskv-threads.h"
+#include "priskv-log.h"
+#include "acl.h"
+#include "kv.h"
+#include "tcp.h"
+#include "../../client/priskv.h"
+
+#define TEST_ADDR "127.0.0.1"
+#define TEST_PORT 18612
+#define TEST_MAX_KEYS 1024
+#define TEST_MAX_KEY_LENGTH 128
+#define TEST_VALUE_BLOCK_SIZE 4096
+#define TEST_VALUE_BLOCKS 1024 /* 4 MiB */
+#define TEST_BIG_VALUE (1024 * 1024)
+#define TEST_DRAIN_WAIT_MS 10000
+
+extern priskv_threadpool *g_threadpool;
+
+/* from memory.h, whose priskv_key conflicts with the one of client API */
+void *priskv_mem_anon(uint16_t max_key_length, uint32_t max_keys, uint32_t value_block_size,
+                      uint64_t value_blocks, uint8_t threads);
+uint8_t *priskv_mem_key_addr(void *ctx);
+uint8_t *priskv_mem_value_addr(void *ctx);
+
+static void *kv;
+static volatile bool stop;
+
+/* the main thread of server */
+static void *test_server_loop(void *arg)
+{
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = priskv_tcp_get_fd()};
+    int epollfd = epoll_create1(0);
+
+    assert(epollfd >= 0);
+    assert(!epoll_ctl(epollfd, EPOLL_CTL_ADD, event.data.fd, &event));
+    while (!stop) {
+        epoll_wait(epollfd, &event, 1, 10);
+        priskv_tcp_process();
+    }
+    close(epollfd);
+
+    return NULL;
+}
+
+static void test_fill(uint8_t *buf, uint32_t len, uint8_t seed)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = (i * 7 + seed) % 251;
+    }
+}
+
+static int test_set(priskv_client *client, const char *key, uint8_t *val, uint32_t len)
+{
+    priskv_sgl sgl = {.iova = (uint64_t)val, .length = len, .mem = NULL};
+
+    return priskv_set(client, key, &sgl, 1, PRISKV_KEY_MAX_TIMEOUT);
+}
+
+static int test_get(priskv_client *client, const char *key, uint8_t *buf, uint32_t len,
+                    uint32_t *valuelen)
+{
+    priskv_sgl sgl = {.iova = (uint64_t)buf, .length = len, .mem = NULL};
+
+    return priskv_get(client, key, &sgl, 1, valuelen);
+}
+
+static void test_set_get_del(priskv_client *client)
+{
+    uint8_t val[100], buf[100];
+    uint32_t valuelen;
+
+    test_fill(val, sizeof(val), 1);
+    assert(test_set(client, "small", val, sizeof(val)) == PRISKV_STATUS_OK);
+    assert(test_get(client, "small", buf, sizeof(buf), &valuelen) == PRISKV_STATUS_OK);
+    assert((valuelen == sizeof(val)) && !memcmp(buf, val, valuelen));
+
+    assert(test_get(client, "small", buf, 10, &valuelen) == PRISKV_STATUS_VALUE_TOO_BIG);
+    assert(valuelen == sizeof(val));
+
+    assert(priskv_delete(client, "small") == PRISKV_STATUS_OK);
+    assert(test_get(client, "small", buf, sizeof(buf), &valuelen) == PRISKV_STATUS_NO_SUCH_KEY);
+    assert(priskv_delete(client, "small") == PRISKV_STATUS_NO_SUCH_KEY);
+
+    printf("TEST TCP: SET/GET/DEL [OK]\n");
+}
+
+/* the value spans many receive buffers of server, and the GET is sent by MSG_ZEROCOPY */
+static void test_big_value(priskv_client *client)
+{
+    uint8_t *val = malloc(TEST_BIG_VALUE), *buf = calloc(1, TEST_BIG_VALUE);
+    uint32_t valuelen;
+
+    assert(val && buf);
+    test_fill(val, TEST_BIG_VALUE, 2);
+    assert(test_set(client, "big", val, TEST_BIG_VALUE) == PRISKV_STATUS_OK);
+    assert(test_get(client, "big", buf, TEST_BIG_VALUE, &valuelen) == PRISKV_STATUS_OK);
+    assert((valuelen == TEST_BIG_VALUE) && !memcmp(buf, val, valuelen));
+
+    free(val);
+    free(buf);
+    printf("TEST TCP: value larger than the receive buffer [OK]\n");
+}
+
+/* the server answers the SET before its value, then drops the value from the stream */
+static void test_rejected_set(priskv_client *client)
+{
+    uint32_t len = TEST_VALUE_BLOCK_SIZE * TEST_VALUE_BLOCKS * 2;
+    uint8_t *val = malloc(len), small[100], buf[100];
+    uint32_t valuelen;
+
+    assert(val);
+    test_fill(val, len, 3);
+    assert(test_set(client, "huge", val, len) != PRISKV_STATUS_OK);
+    assert(test_get(client, "huge", buf, sizeof(buf), &valuelen) == PRISKV_STATUS_NO_SUCH_KEY);
+
+    /* the next request is parsed at the right place of the stream */
+    test_fill(small, sizeof(small), 4);
+    assert(test_set(client, "after-huge", small, sizeof(small)) == PRISKV_STATUS_OK);
+    assert(test_get(client, "after-huge", buf, sizeof(buf), &valuelen) == PRISKV_STATUS_OK);
+    assert((valuelen == sizeof(small)) && !memcmp(buf, small, valuelen));
+    assert(priskv_delete(client, "after-huge") == PRISKV_STATUS_OK);
+
+    free(val);
+    printf("TEST TCP: rejected SET drains its value [OK]\n");
+}
+
+static void test_xsend(int fd, const void *data, size_t len)
+{
+    while (len) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+
+        assert(n > 0);
+        data = (const uint8_t *)data + n;
+        len -= n;
+    }
+}
+
+/* connect by the raw protocol, the client library always reads the responses */
+static int test_raw_connect(void)
+{
+    struct sockaddr_in sin = {.sin_family = AF_INET, .sin_port = htons(TEST_PORT)};
+    priskv_rdma_cm_req req = {0};
+    priskv_tcp_cm_reply reply;
+    int fd, rcvbuf = 4096;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    inet_pton(AF_INET, TEST_ADDR, &sin.sin_addr);
+    assert(!connect(fd, (struct sockaddr *)&sin, sizeof(sin)));
+
+    req.version = htobe16(PRISKV_RDMA_CM_VERSION);
+    req.max_sgl = htobe16(1);
+    req.max_key_length = htobe16(TEST_MAX_KEY_LENGTH);
+    req.max_inflight_command = htobe16(16);
+    test_xsend(fd, &req, sizeof(req));
+    assert(recv(fd, &reply, sizeof(reply), MSG_WAITALL) == sizeof(reply));
+    assert(!reply.status);
+
+    return fd;
+}
+
+/* the GETs of the big value are never read, close with the MSG_ZEROCOPY sends in flight */
+static void test_close_inflight(priskv_client *client)
+{
+    uint8_t buf[sizeof(priskv_request) + sizeof(priskv_keyed_sgl) + TEST_MAX_KEY_LENGTH] = {0};
+    priskv_request *req = (priskv_request *)buf;
+    uint64_t inuse = priskv_get_value_blocks_inuse(kv);
+    uint8_t *val = malloc(TEST_BIG_VALUE);
+    uint32_t valuelen;
+    int fd;
+
+    assert(val);
+    test_fill(val, TEST_BIG_VALUE, 5);
+    assert(test_set(client, "pinned", val, TEST_BIG_VALUE) == PRISKV_STATUS_OK);
+
+    fd = test_raw_connect();
+    req->command = htobe16(PRISKV_COMMAND_GET);
+    req->nsgl = htobe16(1);
+    req->key_length = htobe16(strlen("pinned"));
+    req->timeout = htobe64(PRISKV_KEY_MAX_TIMEOUT);
+    req->sgls[0].length = htobe32(TEST_BIG_VALUE);
+    memcpy(priskv_request_key(req, 1), "pinned", strlen("pinned"));
+    for (int i = 0; i < 8; i++) {
+        req->request_id = i;
+        test_xsend(fd, buf, priskv_request_size(1, strlen("pinned")));
+    }
+    usleep(200 * 1000);
+    close(fd);
+
+    /* the value stays readable and writable while the closed connection drains */
+    memset(val, 0, TEST_BIG_VALUE);
+    assert(test_get(client, "pinned", val, TEST_BIG_VALUE, &valuelen) == PRISKV_STATUS_OK);
+    assert(valuelen == TEST_BIG_VALUE);
+    assert(priskv_delete(client, "pinned") == PRISKV_STATUS_OK);
+
+    /* the drained connection releases the value it pinned */
+    for (int ms = 0; priskv_get_value_blocks_inuse(kv) != inuse; ms += 10) {
+        assert(ms < TEST_DRAIN_WAIT_MS);
+        usleep(10 * 1000);
+    }
+
+    test_fill(val, TEST_BIG_VALUE, 6);
+    assert(test_set(client, "pinned", val, TEST_BIG_VALUE) == PRISKV_STATUS_OK);
+    assert(priskv_delete(client, "pinned") == PRISKV_STATUS_OK);
+
+    free(val);
+    printf("TEST TCP: close with MSG_ZEROCOPY in flight [OK]\n");
+}
+
+int main()
+{
+    priskv_rdma_conn_cap cap = {.max_sgl = PRISKV_RDMA_DEFAULT_SGL,
+                                .max_key_length = TEST_MAX_KEY_LENGTH,
+                                .max_inflight_command = PRISKV_RDMA_DEFAULT_INFLIGHT_COMMAND};
+    char addr[] = TEST_ADDR, *addrs[] = {addr};
+    priskv_client *client;
+    void *mem;
+    pthread_t thread;
+
+    /* by TCP even if a server listens by shm on this host */
+    unsetenv("PRISKV_SHM");
+
+    mem = priskv_mem_anon(TEST_MAX_KEY_LENGTH, TEST_MAX_KEYS, TEST_VALUE_BLOCK_SIZE,
+                          TEST_VALUE_BLOCKS, 1);
+    assert(mem);
+    kv = priskv_new_kv(priskv_mem_key_addr(mem), priskv_mem_value_addr(mem), TEST_MAX_KEYS,
+                       TEST_MAX_KEY_LENGTH, TEST_VALUE_BLOCK_SIZE, TEST_VALUE_BLOCKS);
+    assert(kv);
+
+    g_threadpool = priskv_threadpool_create("test", 2, 0, 0);
+    assert(g_threadpool);
+    assert(!priskv_acl_add("any"));
+    assert(!priskv_tcp_listen(addrs, 1, TEST_PORT, kv, &cap));
+    assert(!pthread_create(&thread, NULL, test_server_loop, NULL));
+
+    client = priskv_connect_tcp(TEST_ADDR, TEST_PORT, NULL, 0, 1);
+    assert(client);
+
+    test_set_get_del(client);
+    test_big_value(client);
+    test_rejected_set(client);
+    test_close_inflight(client);
+
+    priskv_close(client);
+    stop = true;
+    pthread_join(thread, NULL);
+
+    return 0;
+}
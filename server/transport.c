@@ -0,0 +1,62 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#include <string.h>
+
+#include "transport.h"
+#include "tcp.h"
+
+static priskv_transport_driver priskv_transport_drivers[] = {
+    {
+        .name = "rdma",
+        .listen = priskv_rdma_listen,
+        .get_fd = priskv_rdma_get_fd,
+        .process = priskv_rdma_process,
+    },
+    {
+        .name = "tcp",
+        .listen = priskv_tcp_listen,
+        .get_fd = priskv_tcp_get_fd,
+        .process = priskv_tcp_process,
+    },
+    {
+        .name = "shm",
+        .listen = priskv_shm_listen,
+        .get_fd = priskv_tcp_get_fd,
+        .process = priskv_tcp_process,
+    },
+};
+
+priskv_transport_driver *priskv_transport_find(const char *name)
+{
+    for (int i = 0; i < sizeof(priskv_transport_drivers) / sizeof(priskv_transport_drivers[0]); i++) {
+        if (!strcmp(priskv_transport_drivers[i].name, name)) {
+            return &priskv_transport_drivers[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2025 ByteDance Ltd. and/or its affiliates
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Authors:
+ *   Jinlong Xuan <15563983051@163.com>
+ *   Xu Ji <sov.matrixac@gmail.com>
+ *   Yu Wang <wangyu.steph@bytedance.com>
+ *   Bo Liu <liubo.2024@bytedance.com>
+ *   Zhenwei Pi <pizhenwei@bytedance.com>
+ *   Rui Zhang <zhangrui.1203@bytedance.com>
+ *   Changqi Lu <luchangqi.123@bytedance.com>
+ *   Enhua Zhou <zhouenhua@bytedance.com>
+ */
+
+#ifndef __PRISKV_SERVER_TRANSPORT__
+#define __PRISKV_SERVER_TRANSPORT__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include "priskv-threads.h"
+#include "rdma.h"
+
+/* a transport serves the same priskv_request/priskv_response on the KV */
+typedef struct priskv_transport_driver {
+    const char *name;
+    int (*listen)(char **addr, int naddr, int port, void *kv, priskv_rdma_conn_cap *cap);
+    /* the epoll fd watched by the main thread, process() handles its events */
+    int (*get_fd)(void);
+    void (*process)(void);
+} priskv_transport_driver;
+
+priskv_transport_driver *priskv_transport_find(const char *name);
+
+typedef struct priskv_rdma_conn priskv_rdma_conn;
+typedef struct priskv_rdma_rw_work priskv_rdma_rw_work;
+
+/*
+ * A client connection of any transport is served by the request handler of rdma.c, so all of them
+ * get tiering, QoS and parked GETs alike. The transport moves the requests, the responses and the
+ * values by these ops, which are called in the thread of connection.
+ */
+typedef struct priskv_transport_ops {
+    const char *name; /* prefix of logs */
+    /* the handler is done with @req, the buffer takes another request */
+    int (*recv)(priskv_rdma_conn *conn, priskv_request *req);
+    /* send @len bytes of @resp, then call priskv_rdma_conn_send_done */
+    int (*send)(priskv_rdma_conn *conn, priskv_response *resp, uint32_t len);
+    /*
+     * move the value of @req from client into [@val, @val + @len) on @set, or back to client,
+     * then call priskv_rdma_conn_rw_done. A stream transport may answer a GET ahead of the value
+     * by priskv_rdma_conn_rw_respond.
+     */
+    int (*rw)(priskv_rdma_conn *conn, priskv_rdma_rw_work *work, priskv_request *req, uint8_t *val,
+              uint32_t len, bool set);
+    /* close @conn on error, NULL if the transport finds the closing connections by itself */
+    void (*close)(priskv_rdma_conn *conn);
+} priskv_transport_ops;
+
+/* prepare the request handler, called by the listen() of each transport */
+int priskv_rdma_handler_init(void *kv);
+
+priskv_rdma_conn *priskv_rdma_conn_new(const priskv_transport_ops *ops, void *transport, void *kv,
+                                       priskv_rdma_conn_cap *cap, const char *local_addr,
+                                       const char *peer_addr, priskv_thread *thread);
+void *priskv_rdma_conn_transport(priskv_rdma_conn *conn);
+/* the buffers of requests, @nreqs of @size bytes each */
+uint8_t *priskv_rdma_conn_requests(priskv_rdma_conn *conn, uint32_t *size, uint32_t *nreqs);
+
+/* queue a request of @len bytes received into a request buffer */
+int priskv_rdma_conn_recv(priskv_rdma_conn *conn, priskv_request *req, uint32_t len);
+/* handle the queued requests of the thread in the order of QoS */
+void priskv_rdma_conn_dispatch(priskv_rdma_conn *conn);
+void priskv_rdma_conn_send_done(priskv_rdma_conn *conn, priskv_response *resp);
+void priskv_rdma_conn_rw_done(priskv_rdma_conn *conn, priskv_rdma_rw_work *work);
+int priskv_rdma_conn_rw_respond(priskv_rdma_conn *conn, priskv_rdma_rw_work *work);
+/* the value of SET never arrives, drop it */
+void priskv_rdma_conn_rw_abort(priskv_rdma_conn *conn, priskv_rdma_rw_work *work);
+
+void priskv_rdma_conn_close_async(priskv_rdma_conn *conn);
+/* called by main thread once the transport stops receiving, the inflight works stay valid */
+void priskv_rdma_conn_close(priskv_rdma_conn *conn);
+void priskv_rdma_conn_free(priskv_rdma_conn *conn);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __PRISKV_SERVER_TRANSPORT__ */